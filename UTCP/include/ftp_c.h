@@ -43,6 +43,12 @@ CUT_FTPClient
 	Make certain helper functions virtual
 	GetDirInfo accepts path parameter
 	Add PeekResponseCode
+	Add active mode data port pool, EPRT support
+	Add PASV pipelining for consecutive transfers
+	Add PipelineCommands
+	Record data connection and reply trace events
+	Cache the TYPE and working directory of the server to skip redundant commands
+	Add ReceiveFileRange
 */
 
 #ifndef  __CUT_FTP_CLIENT
@@ -52,6 +58,24 @@ CUT_FTPClient
 
 class CUT_FTPClient;
 
+// number of idle listening sockets kept for active mode transfers
+#define FTP_DATAPORT_POOL_SIZE	4
+
+// a PASV reply received ahead of time is only used within this time (ms)
+#define FTP_PASV_AHEAD_TIMEOUT	5000
+
+// the server may hash a large file for minutes, its reply is waited for this long (s)
+#define FTP_HASH_TIMEOUT		600
+
+// default number of commands PipelineCommands keeps outstanding
+#define FTP_PIPELINE_WINDOW		16
+
+// pre-bound listening socket for active mode data connections
+typedef struct CUT_DATALISTENERTag{
+	SOCKET			sock;		// listening socket
+	unsigned short	port;		// local port the socket is bound to
+}CUT_DATALISTENER;
+
 
 //=================================================================
 // Data transfer socket class
@@ -78,23 +102,15 @@ protected:
 
 	virtual int		OnSSLCertificate(const SSL * ssl, const X509* certificate, int verifyResult);
 
+	// Use an already listening socket as server socket
+	virtual int		AttachListener(SOCKET s, unsigned short port);
+	// Take the server socket back so CloseConnection leaves it listening
+	virtual SOCKET	DetachListener(unsigned short * port = NULL);
+
 public:
-	virtual int SocketOnConnected(SOCKET s, const char * lpszName)
-	{
-		UNREFERENCED_PARAMETER(s);
-		UNREFERENCED_PARAMETER(lpszName);
-
-	    //If SSL is enabled, perform the handshake etc.
-		if (m_isSSL) {
-			int res = ConnectSSL();
-			if (res == UTE_ERROR) {
-				CloseConnection();
-				return OnError(UTE_ERROR);
-			}
-		}
-
-		return UTE_SUCCESS;
-	}
+	virtual int SocketOnConnected(SOCKET s, const char * lpszName);
+
+	virtual int CloseConnection();
 };
 
 // directory infomation linked list - ascii fileName for internal use
@@ -167,6 +183,25 @@ protected: // changed to protected to allow for inheritance
 	int					m_nDataPortMin;
 	int					m_nDataPortMax;
 
+	CUT_DATALISTENER	m_dataListeners[FTP_DATAPORT_POOL_SIZE];	//idle listeners, ring buffer
+	int					m_nListenerHead;			//index of the oldest idle listener
+	int					m_nListenerCount;			//number of idle listeners
+	int					m_nListenerPoolSize;		//max idle listeners, 0 disables the pool
+	BOOL				m_bUseEPRT;					//use EPRT instead of PORT
+
+	BOOL				m_bPipelinePASV;			//send PASV for the next transfer before the current one is confirmed
+	int					m_nPASVAhead;				//0: none, 1: PASV sent ahead, 2: reply received
+	int					m_nPASVAheadCode;			//response code of the PASV sent ahead
+	DWORD				m_dwPASVAheadTime;			//tickcount the reply was received
+	char				m_szPASVAhead[100];			//reply of the PASV sent ahead
+
+	int					m_nServerType;				//TYPE in effect on the server, -1 if unknown
+	char				m_szServerDir[MAX_PATH+1];	//working directory on the server, empty if unknown
+
+	long				m_lRangeOffset;				//REST offset of the next RETR, 0 for none
+	long				m_lRangeLength;				//bytes to receive of the next RETR, 0 for all
+	OpenMsgType			m_nRangeType;				//how the next RETR opens its destination
+
 	/////////////////////
 	// helper functions
 	/////////////////////
@@ -203,6 +238,34 @@ protected: // changed to protected to allow for inheritance
 	// Get the directory information in a DOS format
 	virtual void	GetInfoInDOSFormat( CUT_DIRINFOA * di);
 
+	// Active mode data port management
+	// Open a listener for the data connection and announce it with PORT or EPRT
+	virtual int		OpenDataPort();
+	// Close the data connection, recycle the listener into the pool if allowed
+	virtual int		CloseDataPort(BOOL recycle);
+	// Bind a new listener within the data port range
+	virtual int		BindDataListener(CUT_DATALISTENER * listener);
+	// Bind listeners until the pool is full
+	virtual int		FillDataPortPool();
+	// Address of the control connection to announce, returns the EPRT protocol family
+	virtual int		GetDataPortFamily(LPSTR address, int maxLen);
+	// Close all idle listeners
+	virtual int		ClearDataPortPool();
+
+	// Passive mode pipelining
+	// Send PASV, or return the reply of the PASV sent ahead
+	virtual int		RequestPASV(LPSTR response, int maxlen);
+	// Send PASV for the next transfer if pipelining is enabled
+	virtual int		SendPASVAhead();
+	// Read the reply of the PASV sent ahead, call after the final reply of the transfer
+	virtual int		ReceivePASVAhead();
+
+	// Forget the cached TYPE and working directory, the next command will be sent regardless
+	virtual void	ClearServerState();
+
+	// End a RETR cut short by ReceiveFileRange, after its data connection is closed
+	virtual int		AbortTransfer();
+
 public:
 	virtual void setsMode(FTPSMode mode) {m_sMode = mode;};
 
@@ -225,6 +288,9 @@ public:
 	virtual int		ReceiveFile(LPCWSTR sourceFile, LPCTSTR destFile);
 #endif
 
+	// Retrieve part of a file, starting at offset
+	virtual int		ReceiveFileRange(CUT_DataSource & dest, LPCSTR sourceFile, long offset, long length, OpenMsgType type);
+
 	// Resume File receive
 	virtual int		ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile);
 	virtual int		ResumeReceiveFile(LPCSTR sourceFile, LPCTSTR destFile);
@@ -283,9 +349,24 @@ public:
 	virtual int		GetSize(LPCWSTR path, long * size);
 #endif
 
+	// get last modification time of a file, in UTC
+	virtual int		GetModTime(LPCSTR path, SYSTEMTIME * time);
+#if defined _UNICODE
+	virtual int		GetModTime(LPCWSTR path, SYSTEMTIME * time);
+#endif
+
 	// Send a No Operation command
 	virtual int		NoOp();
 
+	// Ask for the extensions of the server (FEAT), see GetMultiLineResponse for the list
+	virtual int		GetFeatures();
+
+	// Hash of a file computed by the server, command is HASH or an X command like XCRC
+	virtual int		GetFileHash(LPCSTR command, LPCSTR path, LPSTR reply, int maxlen);
+
+	// Select the algorithm of the HASH command
+	virtual int		SetHashAlgorithm(LPCSTR algorithm);
+
 	// Set/Get the transfer type to  0:ASCII  1:IMAGE
 	int		SetTransferType(int type);
 	int		GetTransferType() const;
@@ -321,6 +402,18 @@ public:
 	int		SetDataPortRange(int min, int max);
 	int		GetDataPortRange(int * min, int * max);
 
+	// Set/Get the number of listening sockets kept for active mode (0 - FTP_DATAPORT_POOL_SIZE)
+	int		SetDataPortPoolSize(int size);
+	int		GetDataPortPoolSize() const;
+
+	// Set/Get usage of EPRT (RFC 2428) instead of PORT for active mode
+	void	SetUseEPRT(BOOL useEPRT);
+	BOOL	GetUseEPRT() const;
+
+	// Set/Get PASV pipelining, set when another passive transfer follows the next one
+	void	SetPipelinePASV(BOOL pipeline);
+	BOOL	GetPipelinePASV() const;
+
 	// Get the current Directory information
 	virtual int		GetDirInfo();
 	virtual int		GetDirInfo(LPCSTR path);
@@ -351,6 +444,9 @@ public:
 
 	// send a custom to be excuted on the server
 	virtual int		Quote(LPCSTR command);
+
+	// send a list of commands without waiting for each reply, codes receives the reply code of each command
+	virtual int		PipelineCommands(LPCSTR * commands, int count, int * codes, int window = FTP_PIPELINE_WINDOW);
 #if defined _UNICODE
 	virtual int		Quote(LPCWSTR command);
 #endif
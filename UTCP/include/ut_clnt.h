@@ -25,6 +25,9 @@ simplify WINSOCKVER define
 remove pragma statements+comments
 Remove existing secure functionality
 Add OpenSSL secure functionality
+Add receive buffer for ReceiveLine
+Add process wide TLS session cache
+Record connect and handshake trace spans
 */
 
 #ifndef IncludeCUT_WSClient
@@ -57,6 +60,17 @@ Add OpenSSL secure functionality
 #endif
 
 #define WSC_BUFFER_SIZE     256
+#define WSC_RECV_BUFFER_SIZE    4096
+
+// TLS session cache
+#define WSC_SSL_CACHE_SIZE      16
+#define WSC_SSL_CACHE_KEY_SIZE  300
+
+typedef struct CUT_SSLCacheEntry {
+    char            key[WSC_SSL_CACHE_KEY_SIZE];    // "host:port"
+    SSL_SESSION *   session;                        // holds one reference
+    DWORD           lastUsed;
+} CUT_SSLCacheEntry;
 
 
 class CUT_Socket
@@ -164,6 +178,11 @@ protected:
 
     BYTE m_hostent[MAXGETHOSTSTRUCT];
 
+    // data read ahead by ReceiveLine, returned first by all receive functions
+    char m_szRecvBuf[WSC_RECV_BUFFER_SIZE];
+    int m_nRecvBufPos;           // start of unread data
+    int m_nRecvBufLen;           // end of unread data
+
 	////////////////////////////////////////////////////////////////////////////
 	//
 	// SSL specific
@@ -177,11 +196,24 @@ protected:
 	SSL_CTX *		m_ctx;
 	SSL *			m_ssl;
 	SSL_SESSION *	m_reuseSession;
+	char			m_szSessionKey[WSC_SSL_CACHE_KEY_SIZE];	// key in the session cache, empty if not cached
+
+	static CUT_SSLCacheEntry	m_sessionCache[WSC_SSL_CACHE_SIZE];
+	static CRITICAL_SECTION		m_sessionCacheLock;
+	static long					m_nHandshakes;
+	static long					m_nHandshakesResumed;
 
 	virtual int SSLSend(LPCSTR data, int len);
 	virtual int SSLReceive(LPSTR buffer, int maxSize, bool peek = false);
 	virtual SSL_SESSION * SSLGetCurrentSession();
 	virtual int SSLSetReuseSession(SSL_SESSION * reuseSession);	//use NULL to disable
+	virtual int SSLSetSessionKey(LPCSTR key);	//use the session cache for this key, NULL to disable
+	virtual int SSLCacheApplySession();
+	virtual int SSLCacheStoreSession(BOOL remove);
+public:
+	// number of TLS handshakes performed by all clients, and how many of them resumed a session
+	static void SSLGetHandshakeStats(long * handshakes, long * resumed);
+protected:
 
     // This function is used to process async winsock
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
@@ -37,6 +37,24 @@ Modification made April 2010:
 
 Modification made May 2012:
 -Clear recieve buffer if failed to initiate a data connection for STOR, RETR or LIST.
+
+Active mode data connections:
+-Listening sockets are kept in a small pool and reused across transfers
+-Added EPRT support
+
+Passive mode data connections:
+-The PASV for the next transfer can be sent before the final reply of the current transfer
+
+Added PipelineCommands for batched metadata commands
+
+The control connection uses the process wide TLS session cache, data connections keep
+resuming the session of the control connection
+
+The TYPE and working directory last confirmed by the server are cached, SetTransferType
+and ChDir do not send a command when the requested state is already in effect
+
+A passive RETR stopped by its data source (UTE_DS_WRITE_FAILED) still reads the reply
+of the server, so the control connection stays usable
 */
 
 #ifdef _WINSOCK_2_0_
@@ -54,6 +72,7 @@ Modification made May 2012:
 #include "ut_strop.h"
 
 #include "Output.h"
+#include "Trace.h"
 
 /***************************************************
 
@@ -96,6 +115,95 @@ int CUT_WSDataClient::OnSSLCertificate(const SSL * ssl, const X509* certificate,
 	return ptrFTPClient->OnSSLCertificate(ssl, certificate, verifyResult);
 }
 
+/***************************************************
+AttachListener
+    Uses a socket that is already bound and
+    listening as the server socket, as if
+    WaitForConnect was called.
+Params
+    s       - listening socket
+    port    - port the socket is bound to
+Return
+    UTE_SOCK_ALREADY_OPEN   - a server socket is already in use
+    UTE_SUCCESS             - success
+****************************************************/
+int CUT_WSDataClient::AttachListener(SOCKET s, unsigned short port) {
+    if(m_serverSocket != INVALID_SOCKET)
+        return OnError(UTE_SOCK_ALREADY_OPEN);
+
+    m_serverSocket = s;
+    m_nAcceptPort = port;
+
+    return OnError(UTE_SUCCESS);
+}
+
+/***************************************************
+DetachListener
+    Releases the server socket without closing it,
+    so a following CloseConnection only closes
+    the data connection.
+Params
+    [port]  - receives the port of the socket
+Return
+    the server socket, INVALID_SOCKET if none
+****************************************************/
+SOCKET CUT_WSDataClient::DetachListener(unsigned short * port) {
+    SOCKET s = m_serverSocket;
+
+    if (port != NULL)
+        *port = (unsigned short)m_nAcceptPort;
+
+    m_serverSocket = INVALID_SOCKET;
+    m_nAcceptPort = 0;
+
+    return s;
+}
+
+/***************************************************
+SocketOnConnected
+    Called when the data connection is made,
+    either by connecting or by accepting.
+    Performs the SSL handshake if needed.
+Params
+    s           - the connected socket
+    lpszName    - address of the peer
+Return
+    UTE_SUCCESS - success
+    UTE_ERROR   - SSL handshake failed
+****************************************************/
+int CUT_WSDataClient::SocketOnConnected(SOCKET s, const char * lpszName) {
+    UNREFERENCED_PARAMETER(s);
+    UNREFERENCED_PARAMETER(lpszName);
+
+    TraceEvent(Trace_DataOpen, m_isSSL, 0);
+
+    //If SSL is enabled, perform the handshake etc.
+    if (m_isSSL) {
+        int res = ConnectSSL();
+        if (res == UTE_ERROR) {
+            CloseConnection();
+            return OnError(UTE_ERROR);
+        }
+    }
+
+    return UTE_SUCCESS;
+}
+
+/***************************************************
+CloseConnection
+    Closes the data connection
+Params
+    none
+Return
+    see CUT_WSClient::CloseConnection
+****************************************************/
+int CUT_WSDataClient::CloseConnection() {
+    if (m_socket != INVALID_SOCKET)
+        TraceEvent(Trace_DataClose, 0, 0);
+
+    return CUT_WSClient::CloseConnection();
+}
+
 /***************************************************
 
     CUT_FTPClient class implementation
@@ -121,7 +229,19 @@ CUT_FTPClient::CUT_FTPClient() :
     m_sMode(FTP),
     m_dataSecLevel(0),					//Default is clear data
     m_nDataPortMin(10000),
-    m_nDataPortMax(32000)
+    m_nDataPortMax(32000),
+    m_nListenerHead(0),
+    m_nListenerCount(0),
+    m_nListenerPoolSize(FTP_DATAPORT_POOL_SIZE),
+    m_bUseEPRT(FALSE),
+    m_bPipelinePASV(FALSE),
+    m_nPASVAhead(0),
+    m_nPASVAheadCode(0),
+    m_dwPASVAheadTime(0),
+    m_nServerType(-1),
+    m_lRangeOffset(0),
+    m_lRangeLength(0),
+    m_nRangeType(UTM_OM_WRITING)
 {
 
     // initialize pointer
@@ -129,6 +249,8 @@ CUT_FTPClient::CUT_FTPClient() :
 
     //set up the defaults
     m_szResponse[0]         = '\0';     // Last response from the server
+    m_szPASVAhead[0]        = '\0';
+    m_szServerDir[0]        = '\0';
     m_nDataPort              =   10000 + GetTickCount()%20000;
     if(m_nDataPort > 32000 || m_nDataPort < 0)
         m_nDataPort = 10000;
@@ -183,6 +305,7 @@ int CUT_FTPClient::FTPConnect(LPCSTR hostname,LPCSTR userName,LPCSTR password,LP
     m_szResponse [0]= '\0';
     m_lastResponseCode = 0;
     m_cachedResponse = false;
+    ClearServerState();
 
 	if (m_sMode != FTP) {
 		if (m_sMode == FTPS) {	//in case of implicit SSL, negatiate security version with v23
@@ -277,6 +400,9 @@ int CUT_FTPClient::Close() {
 
     CloseConnection();
     m_wsData.CloseConnection();
+    ClearDataPortPool();
+    m_nPASVAhead = 0;
+    ClearServerState();
 
     m_nConnected = FALSE;
 
@@ -325,8 +451,7 @@ Return
 ****************************************/
 int CUT_FTPClient::ReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
 {
-    int rt,loop,len;
-    char addr[32];
+    int rt;
 
 
 
@@ -335,44 +460,20 @@ int CUT_FTPClient::ReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
 
 	m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
-    //open up a data port, if the one requested is busy then
-    //increment to the next port, try 128 times then fail
-    for(loop=0; loop < 128; loop++) {
-        if( m_wsData.WaitForConnect((unsigned short)m_nDataPort) == UTE_SUCCESS )
-            break;
-        m_nDataPort++;
-        }
-
-    if(loop == 128)
-        return OnError(UTE_SVR_DATA_CONNECT_FAILED);
-
-    //get the host address
-    GetHostAddress(addr,sizeof(addr));
-
-    //create the port set up string
-    len = (int)strlen(addr);
-    for(loop=0;loop<len;loop++){
-        if(addr[loop]=='.')
-            addr[loop] = ',';
-        }
-
-    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"PORT %s,%d,%d\r\n",addr,HIBYTE(m_nDataPort),LOBYTE(m_nDataPort));
-    //send the PORT command
-    Send(m_szBuf);
-
-    //setup the next port number
-    m_nDataPort++;
-    //if(m_nDataPort > 32000 || m_nDataPort < 0)
-    //    m_nDataPort = 10000;
-	if(m_nDataPort > m_nDataPortMax || m_nDataPort < m_nDataPortMin)
-		m_nDataPort = m_nDataPortMin;
+    //open up a data port and announce it to the server
+    rt = OpenDataPort();
+    if(rt != UTE_SUCCESS)
+        return OnError(rt);
 
-    //check for a return of 2??
-    rt = GetResponseCode(this);
-    if(rt < 200 || rt >=300){
-        //close the connection down
-        m_wsData.CloseConnection();
-        return OnError(UTE_PORT_FAILED);
+    //start at an offset, see ReceiveFileRange
+    if(m_lRangeOffset > 0) {
+        _snprintf(m_szBuf,sizeof(m_szBuf)-1,"REST %ld\r\n",m_lRangeOffset);
+        Send(m_szBuf);
+        rt = GetResponseCode(this);
+        if(rt != 350){
+            CloseDataPort(FALSE);
+            return OnError(UTE_REST_COMMAND_NOT_SUPPORTED);
+            }
         }
 
     //send the RETR command
@@ -383,14 +484,14 @@ int CUT_FTPClient::ReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     rt = GetResponseCode(this);
     if(rt < 100 || rt >=300){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_RETR_FAILED);
         }
 
     //wait for a connection on the data port
     if(m_wsData.WaitForAccept(5)!= UTE_SUCCESS){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         ClearReceiveBuffer();
         return OnError(UTE_SVR_DATA_CONNECT_FAILED);
         }
@@ -400,16 +501,20 @@ int CUT_FTPClient::ReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     m_wsData.AcceptConnection();
 
     //retrieve the file
-    rt = m_wsData.Receive(dest, UTM_OM_WRITING,5);
+    rt = m_wsData.Receive(dest, m_nRangeType, 5, m_lRangeLength);
 
-    //close the connection down
-    m_wsData.CloseConnection();
+    //close the connection down, keep the listener if all went well
+    CloseDataPort(rt == UTE_SUCCESS);
 
     if(rt != UTE_SUCCESS) {
         GetResponseCode(this);
         return rt;
     }
 
+    //the server may still be sending
+    if(m_lRangeLength > 0)
+        return AbortTransfer();
+
     //check for a return of 2??
     rt = GetResponseCode(this);
     if(rt < 200 || rt >=300)
@@ -417,6 +522,72 @@ int CUT_FTPClient::ReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     else
         return OnError(UTE_SUCCESS);
 }
+/***************************************
+ReceiveFileRange
+    Retrieves part of the specified file from
+    the currently connected FTP site. The
+    transfer starts at offset (REST) and is
+    aborted (ABOR) once length bytes arrived.
+    Use binary mode, offsets of ASCII transfers
+    are not well defined.
+Params
+    dest        - data source to receive to
+    sourceFile  - name of the file to receive
+    offset      - first byte to receive
+    length      - number of bytes to receive, 0 for the rest of the file
+    type        - UTM_OM_WRITING or UTM_OM_APPEND
+Return
+    UTE_SUCCESS                     - success
+    UTE_SVR_DATA_CONNECT_FAILED     - data port could not be opened
+    UTE_PORT_FAILED                 - PORT command failed
+    UTE_REST_COMMAND_NOT_SUPPORTED  - REST command failed
+    UTE_RETR_FAILED                 - RETR command failed
+    UTE_CONNECT_TERMINATED          - Connection terminated before completion
+****************************************/
+int CUT_FTPClient::ReceiveFileRange(CUT_DataSource & dest, LPCSTR sourceFile, long offset, long length, OpenMsgType type)
+{
+    m_lRangeOffset = offset;
+    m_lRangeLength = length;
+    m_nRangeType = type;
+
+    int rt = ReceiveFile(dest, sourceFile);
+
+    m_lRangeOffset = 0;
+    m_lRangeLength = 0;
+    m_nRangeType = UTM_OM_WRITING;
+
+    return rt;
+}
+
+/***************************************
+AbortTransfer
+    Ends a RETR that was cut short after the
+    requested number of bytes. The data
+    connection must be closed already.
+    The server replies to the RETR (226 if
+    everything was sent, 426 otherwise) and
+    then to the ABOR.
+Params
+    none
+Return
+    UTE_SUCCESS                     - success
+    UTE_CONNECT_TERMINATED          - ABOR failed
+****************************************/
+int CUT_FTPClient::AbortTransfer()
+{
+    Send("ABOR\r\n");
+
+    //reply to the RETR
+    GetResponseCode(this);
+
+    //reply to the ABOR
+    int rt = GetResponseCode(this);
+    if(rt < 200 || rt >=300)
+        return OnError(UTE_CONNECT_TERMINATED);
+    else
+        return OnError(UTE_SUCCESS);
+}
+
 /***************************************
 ResumeReceiveFile
     Retrieves the specified file from the
@@ -460,8 +631,7 @@ Return
 ****************************************/
 int CUT_FTPClient::ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
 {
-    int rt,loop,len;
-    char addr[32];
+    int rt;
     OpenMsgType fileType = UTM_OM_WRITING;  // by default we will write a file unless it exist
                                             // then we will append to it
 
@@ -470,43 +640,10 @@ int CUT_FTPClient::ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
 
 	m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
-    //open up a data port, if the one requested is busy then
-    //increment to the next port, try 128 times then fail
-    for(loop=0; loop < 128; loop++) {
-        if( m_wsData.WaitForConnect((unsigned short)m_nDataPort) == UTE_SUCCESS )
-            break;
-        m_nDataPort++;
-        }
-
-    if(loop == 128)
-        return OnError(UTE_SVR_DATA_CONNECT_FAILED);
-
-    //get the host address
-    GetHostAddress(addr,sizeof(addr));
-
-    //create the port set up string
-    len = (int)strlen(addr);
-    for(loop=0;loop<len;loop++){
-        if(addr[loop]=='.')
-            addr[loop] = ',';
-        }
-
-    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"PORT %s,%d,%d\r\n",addr,HIBYTE(m_nDataPort),LOBYTE(m_nDataPort));
-    //send the PORT command
-    Send(m_szBuf);
-
-    //setup the next port number
-    m_nDataPort++;
-    if(m_nDataPort > 32000 || m_nDataPort < 0)
-        m_nDataPort = 10000;
-
-    //check for a return of 2??
-    rt = GetResponseCode(this);
-    if(rt < 200 || rt >=300){
-        //close the connection down
-        m_wsData.CloseConnection();
-        return OnError(UTE_PORT_FAILED);
-        }
+    //open up a data port and announce it to the server
+    rt = OpenDataPort();
+    if(rt != UTE_SUCCESS)
+        return OnError(rt);
 
     rt = dest.Open (UTM_OM_READING);
 
@@ -522,7 +659,7 @@ int CUT_FTPClient::ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     rt = GetResponseCode(this);
     if( rt != 350){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_REST_COMMAND_NOT_SUPPORTED);
         }
     fileType = UTM_OM_APPEND ; // appending
@@ -536,14 +673,14 @@ int CUT_FTPClient::ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     rt = GetResponseCode(this);
     if(rt < 100 || rt >=300){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_RETR_FAILED);
         }
 
     //wait for a connection on the data port
     if(m_wsData.WaitForAccept(5)!= UTE_SUCCESS){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         ClearReceiveBuffer();
         return OnError(UTE_SVR_DATA_CONNECT_FAILED);
         }
@@ -555,8 +692,8 @@ int CUT_FTPClient::ResumeReceiveFile(CUT_DataSource & dest, LPCSTR sourceFile)
     //retrieve the file based on the fileType  UTM_OM_APPEND if it does exist UTM_OM_WRITING if we need to creat it
     rt = m_wsData.Receive(dest, fileType);
 
-    //close the connection down
-    m_wsData.CloseConnection();
+    //close the connection down, keep the listener if all went well
+    CloseDataPort(rt == UTE_SUCCESS);
 
     if(rt != UTE_SUCCESS)
         return rt;
@@ -634,16 +771,15 @@ int CUT_FTPClient::ResumeReceiveFilePASV(CUT_DataSource & dest, LPCSTR sourceFil
 
 
 
-    //send the port command
-    Send("PASV\r\n");
 
     m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
     // we need to get the full IP address and port number from the
     // PASV return line, so that we can originate the data connection.
 
+    //send PASV, unless it was already sent during the previous transfer
     //check for a return of 2??, which indicates success
-    rt = GetResponseCode( this, responseBuf, sizeof(responseBuf) );
+    rt = RequestPASV(responseBuf, sizeof(responseBuf));
     if(rt < 200 || rt >299)
         return OnError(UTE_PORT_FAILED);
 
@@ -740,8 +876,12 @@ int CUT_FTPClient::ResumeReceiveFilePASV(CUT_DataSource & dest, LPCSTR sourceFil
         return rt;
     }
 
+    //ask for the next data port while the server finishes this transfer
+    SendPASVAhead();
+
     //check for a return of 2??
     rt = GetResponseCode(this);
+    ReceivePASVAhead();
     if(rt < 200 || rt >=300)
         return OnError(UTE_CONNECT_TERMINATED);
     else
@@ -780,16 +920,15 @@ int CUT_FTPClient::ReceiveFilePASV(CUT_DataSource & dest, LPCSTR sourceFile) {
     char    *token;
 
 
-    //send the port command
-    Send("PASV\r\n");
 
     m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
     // we need to get the full IP address and port number from the
     // PASV return line, so that we can originate the data connection.
 
+    //send PASV, unless it was already sent during the previous transfer
     //check for a return of 2??, which indicates success
-    rt = GetResponseCode( this, responseBuf, sizeof(responseBuf) );
+    rt = RequestPASV(responseBuf, sizeof(responseBuf));
     if(rt < 200 || rt >299)
         return OnError(UTE_PORT_FAILED);
 
@@ -835,6 +974,17 @@ int CUT_FTPClient::ReceiveFilePASV(CUT_DataSource & dest, LPCSTR sourceFile) {
         return OnError(UTE_ABORTED);
         }
 
+    //start at an offset, see ReceiveFileRange
+    if(m_lRangeOffset > 0) {
+        _snprintf(m_szBuf,sizeof(m_szBuf)-1,"REST %ld\r\n",m_lRangeOffset);
+        Send(m_szBuf);
+        rt = GetResponseCode(this);
+        if(rt != 350){
+            m_wsData.CloseConnection();
+            return OnError(UTE_REST_COMMAND_NOT_SUPPORTED);
+            }
+        }
+
     //send the RETR command
     _snprintf(m_szBuf,sizeof(m_szBuf)-1,"RETR %s\r\n",sourceFile);
     Send(m_szBuf);
@@ -856,16 +1006,28 @@ int CUT_FTPClient::ReceiveFilePASV(CUT_DataSource & dest, LPCSTR sourceFile) {
         }
 
     //retrieve the file
-    rt = m_wsData.Receive(dest, UTM_OM_WRITING);
+    rt = m_wsData.Receive(dest, m_nRangeType, 0, m_lRangeLength);
 
     //close the connection down
     m_wsData.CloseConnection();
 
-    if(rt != UTE_SUCCESS)
+    if(rt != UTE_SUCCESS) {
+        //the data source stopped the transfer, the server still replies to the RETR
+        if(rt == UTE_DS_WRITE_FAILED)
+            GetResponseCode(this);
         return rt;
+    }
+
+    //the server may still be sending
+    if(m_lRangeLength > 0)
+        return AbortTransfer();
+
+    //ask for the next data port while the server finishes this transfer
+    SendPASVAhead();
 
     //check for a return of 2??
     rt = GetResponseCode(this);
+    ReceivePASVAhead();
     if(rt < 200 || rt >=300)
         return OnError(UTE_CONNECT_TERMINATED);
     else
@@ -915,57 +1077,21 @@ Return
 ****************************************/
 int CUT_FTPClient::SendFile(CUT_DataSource & source, LPCSTR destFile)
 {
-    int     rt, loop, len;
-    char    addr[32];
+    int     rt;
 
     if (m_nFirewallMode)
         return SendFilePASV(source, destFile);
 
 	m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
-    //open up a data port, if the one requested is busy then
-    //increment to the next port, try 128 times then fail
-    for(loop=0;loop<128;loop++){
-		if(m_wsData.WaitForConnect((unsigned short)m_nDataPort)==UTE_SUCCESS)
-            break;
-        m_nDataPort++;
-        }
-
-    if(loop==128)
-        return OnError(UTE_SVR_DATA_CONNECT_FAILED);
-
-    //get the host address
-    GetHostAddress(addr,sizeof(addr));
-
-    //create the port set up string
-    len = (int)strlen(addr);
-    for(loop=0;loop<len;loop++){
-        if(addr[loop]=='.')
-            addr[loop] = ',';
-        }
-
-    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"PORT %s,%d,%d\r\n",addr,HIBYTE(m_nDataPort),LOBYTE(m_nDataPort));
-    //send the port command
-    Send(m_szBuf);
-
-    //setup the next port number
-    m_nDataPort++;
-    //if(m_nDataPort > 32000 || m_nDataPort < 0)
-    //    m_nDataPort = 10000;
-	if(m_nDataPort > m_nDataPortMax || m_nDataPort < m_nDataPortMin)
-		m_nDataPort = m_nDataPortMin;
-
-    //check for a return of 2??
-    rt = GetResponseCode(this);
-    if(rt < 200 || rt >=300){
-        //close the connection down
-        m_wsData.CloseConnection();
-        return OnError(UTE_PORT_FAILED);
-        }
+    //open up a data port and announce it to the server
+    rt = OpenDataPort();
+    if(rt != UTE_SUCCESS)
+        return OnError(rt);
 
     // Check for abortion flag
     if(IsAborted()) {
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_ABORTED);
         }
 
@@ -977,14 +1103,14 @@ int CUT_FTPClient::SendFile(CUT_DataSource & source, LPCSTR destFile)
     rt = GetResponseCode(this);
     if(rt < 100 || rt >=300){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_STOR_FAILED);
         }
 
     //wait for a connection on the data port
     if(m_wsData.WaitForAccept(5)!= UTE_SUCCESS){
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         ClearReceiveBuffer();
         return OnError(UTE_SVR_DATA_CONNECT_FAILED);
         }
@@ -995,8 +1121,8 @@ int CUT_FTPClient::SendFile(CUT_DataSource & source, LPCSTR destFile)
     //retrieve the file
     rt = m_wsData.Send(source);
 
-    //close the connection down
-    m_wsData.CloseConnection();
+    //close the connection down, keep the listener if all went well
+    CloseDataPort(rt == UTE_SUCCESS);
 
     if(rt != UTE_SUCCESS) {
         GetResponseCode(this);
@@ -1071,16 +1197,15 @@ int CUT_FTPClient::SendFilePASV(CUT_DataSource & source, LPCSTR destFile) {
     char    responseBuf[100];
 
 
-    //send the port command
-    Send("PASV\r\n");
 
     m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
     // we need to get the full IP address and port number from the
     // PASV return line, so that we can originate the data connection.
 
+    //send PASV, unless it was already sent during the previous transfer
     //check for a return of 2??, which indicates success
-    rt = GetResponseCode( this, responseBuf, sizeof(responseBuf) );
+    rt = RequestPASV(responseBuf, sizeof(responseBuf));
     if(rt < 200 || rt >299)
         return OnError(UTE_PORT_FAILED);
 
@@ -1156,8 +1281,12 @@ int CUT_FTPClient::SendFilePASV(CUT_DataSource & source, LPCSTR destFile) {
         return rt;
     }
 
+    //ask for the next data port while the server finishes this transfer
+    SendPASVAhead();
+
     //check for a return of 2??
     rt = GetResponseCode(this);
+    ReceivePASVAhead();
     if(rt < 200 || rt >=300)
         return OnError(UTE_CONNECT_TERMINATED);
     else
@@ -1217,6 +1346,9 @@ int CUT_FTPClient::RenameFile(LPCSTR sourceFile,LPCSTR destFile){
 
     int     rt;
 
+    // the working directory could be renamed
+    m_szServerDir[0] = '\0';
+
     // send rename from command
     _snprintf(m_szBuf,sizeof(m_szBuf)-1,"RNFR %s\r\n",sourceFile);
     Send(m_szBuf);
@@ -1308,6 +1440,12 @@ int CUT_FTPClient::ChDir(LPCSTR directory){
 
     int     rt;
 
+    // already there, only absolute paths are cached
+    if(directory[0] == '/' && strcmp(directory, m_szServerDir) == 0)
+        return OnError(UTE_SUCCESS);
+
+    m_szServerDir[0] = '\0';
+
     _snprintf(m_szBuf,sizeof(m_szBuf)-1,"CWD %s\r\n",directory); // FEB 1999 added /
     Send(m_szBuf);
 
@@ -1315,8 +1453,11 @@ int CUT_FTPClient::ChDir(LPCSTR directory){
     rt = GetResponseCode(this);
     if(rt == 0)
         return OnError(UTE_NO_RESPONSE);   //no response
-    else if(rt >=200 && rt <=299)
+    else if(rt >=200 && rt <=299) {
+        if(directory[0] == '/' && strlen(directory) < sizeof(m_szServerDir))
+            strcpy(m_szServerDir, directory);
         return OnError(UTE_SUCCESS);
+    }
 
     return OnError(UTE_SVR_REQUEST_DENIED);
 }
@@ -1335,6 +1476,8 @@ int CUT_FTPClient::CdUp(){
 
     int     rt;
 
+    m_szServerDir[0] = '\0';
+
     Send("CDUP\r\n");
 
     //check for a return of 2??
@@ -1399,6 +1542,9 @@ int CUT_FTPClient::RmDir(LPCSTR directory){
 
     int     rt;
 
+    // the working directory could be removed
+    m_szServerDir[0] = '\0';
+
     _snprintf(m_szBuf,sizeof(m_szBuf)-1,"RMD %s\r\n",directory);
     Send(m_szBuf);
 
@@ -1436,6 +1582,64 @@ int CUT_FTPClient::GetSize(LPCWSTR path, long * size) {
 	return GetSize(AC(path), size);}
 #endif
 /***************************************
+GetModTime
+    Asks the server for the last modification
+    time of a file (MDTM, RFC 3659). Unlike
+    the LIST output it is exact to the second.
+Params
+    path    - file on the server
+    time    - receives the time in UTC
+Return
+    UTE_SUCCESS             - success
+    UTE_NO_RESPONSE         - no response
+    UTE_SVR_NOT_SUPPORTED   - server does not know MDTM
+    UTE_SVR_REQUEST_DENIED  - server has no time for the file
+****************************************/
+int CUT_FTPClient::GetModTime(LPCSTR path, SYSTEMTIME * time) {
+	int     rt;
+
+	_snprintf(m_szBuf,sizeof(m_szBuf)-1,"MDTM %s\r\n",path);
+	Send(m_szBuf);
+	//check for a return of 213
+    rt = GetResponseCode(this);
+    if(rt == 0)
+        return OnError(UTE_NO_RESPONSE);   //no response
+    else if(rt == 213) {
+    	//Response is "213 YYYYMMDDHHMMSS", optionally followed by fractions of a second
+    	LPCSTR response = GetMultiLineResponse(0);
+    	response += 4;	//skip "213 "
+
+    	const int digits[6] = {4, 2, 2, 2, 2, 2};
+    	WORD values[6];
+    	for(int i = 0; i < 6; i++) {
+    		values[i] = 0;
+    		for(int j = 0; j < digits[i]; j++, response++) {
+    			if (*response < '0' || *response > '9')
+    				return OnError(UTE_SVR_NOT_SUPPORTED);
+    			values[i] = values[i]*10 + (*response - '0');
+    		}
+    	}
+
+    	memset(time, 0, sizeof(SYSTEMTIME));
+    	time->wYear = values[0];
+    	time->wMonth = values[1];
+    	time->wDay = values[2];
+    	time->wHour = values[3];
+    	time->wMinute = values[4];
+    	time->wSecond = values[5];
+
+        return OnError(UTE_SUCCESS);
+    }
+    else if(rt == 500 || rt == 502)
+        return OnError(UTE_SVR_NOT_SUPPORTED);
+    return OnError(UTE_SVR_REQUEST_DENIED);
+}
+
+#if defined _UNICODE
+int CUT_FTPClient::GetModTime(LPCWSTR path, SYSTEMTIME * time) {
+	return GetModTime(AC(path), time);}
+#endif
+/***************************************
 NoOp
     Performs a No-op operation. This is
     usually used to check and see if the
@@ -1462,6 +1666,110 @@ int CUT_FTPClient::NoOp(){
     return OnError(UTE_SVR_REQUEST_DENIED);
 }
 /***************************************
+GetFeatures
+    Asks the server for the extensions it
+    supports (RFC 2389). Each extension is
+    a line of the multi-line response, starting
+    with a space.
+Params
+    none
+Return
+    UTE_SUCCESS             - success
+    UTE_NO_RESPONSE         - no response
+    UTE_SVR_NOT_SUPPORTED   - server does not know FEAT
+****************************************/
+int CUT_FTPClient::GetFeatures(){
+
+    int     rt;
+
+    Send("FEAT\r\n");
+
+    //check for a return of 211
+    rt = GetResponseCode(this);
+    if(rt == 0)
+        return OnError(UTE_NO_RESPONSE);   //no response
+    else if(rt == 211)
+        return OnError(UTE_SUCCESS);
+    return OnError(UTE_SVR_NOT_SUPPORTED);
+}
+/***************************************
+GetFileHash
+    Asks the server for the hash of a file.
+    The format of the reply depends on the
+    command, e.g. HASH replies with the
+    algorithm, range, hash and file name,
+    XCRC with the hash only.
+Params
+    command     - HASH, XCRC, XMD5, XSHA1 or XSHA256
+    path        - file to hash
+    reply       - receives the reply, without the code
+    maxlen      - size of reply
+Return
+    UTE_SUCCESS             - success
+    UTE_NO_RESPONSE         - no response, the connection is closed
+    UTE_ABORTED             - aborted, the connection is closed
+    UTE_SVR_NOT_SUPPORTED   - the server did not hash the file
+****************************************/
+int CUT_FTPClient::GetFileHash(LPCSTR command, LPCSTR path, LPSTR reply, int maxlen){
+
+    int     rt;
+
+    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"%s %s\r\n",command,path);
+    Send(m_szBuf);
+
+    //hashing large files can take a while, wait longer than for other replies.
+    //A reply that comes after giving up would be taken for the one of the next command,
+    //so the connection is closed instead
+    int waited = 0;
+    while(!m_cachedResponse && WaitForReceive(1, 0) != UTE_SUCCESS) {
+        if(IsAborted()) {
+            Close();
+            return OnError(UTE_ABORTED);
+        }
+        if(++waited >= FTP_HASH_TIMEOUT) {
+            Close();
+            return OnError(UTE_NO_RESPONSE);
+        }
+    }
+
+    //check for a return of 2??
+    rt = GetResponseCode(this, reply, maxlen);
+    if(rt == 0) {
+        Close();
+        return OnError(UTE_NO_RESPONSE);   //no response
+    }
+    else if(rt >=200 && rt <=299)
+        return OnError(UTE_SUCCESS);
+    return OnError(UTE_SVR_NOT_SUPPORTED);
+}
+/***************************************
+SetHashAlgorithm
+    Selects the algorithm used by the HASH
+    command, one of those listed with HASH
+    in the FEAT response.
+Params
+    algorithm   - e.g. SHA-256
+Return
+    UTE_SUCCESS             - success
+    UTE_NO_RESPONSE         - no response
+    UTE_SVR_NOT_SUPPORTED   - algorithm not available
+****************************************/
+int CUT_FTPClient::SetHashAlgorithm(LPCSTR algorithm){
+
+    int     rt;
+
+    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"OPTS HASH %s\r\n",algorithm);
+    Send(m_szBuf);
+
+    //check for a return of 200
+    rt = GetResponseCode(this);
+    if(rt == 0)
+        return OnError(UTE_NO_RESPONSE);   //no response
+    else if(rt >=200 && rt <=299)
+        return OnError(UTE_SUCCESS);
+    return OnError(UTE_SVR_NOT_SUPPORTED);
+}
+/***************************************
 SetTransferType
     Sets the data transfer type. The data
     representation type used for data transfer and
@@ -1520,6 +1828,14 @@ int CUT_FTPClient::SetTransferType(int type){
     if(type <0 || type >1)
         return OnError(UTE_PARAMETER_INVALID_VALUE);
 
+    //already in effect
+    if(type == m_nServerType) {
+        m_nTransferType = type;
+        return OnError(UTE_SUCCESS);
+    }
+
+    m_nServerType = -1;
+
     //send the type info
     if(type ==0)        //ascii
         Send("TYPE A\r\n");
@@ -1534,6 +1850,7 @@ int CUT_FTPClient::SetTransferType(int type){
 
     else if(rt >=200 && rt <=299) {
         m_nTransferType = type;
+        m_nServerType = type;
         return OnError(UTE_SUCCESS);
         }
     return OnError(UTE_SVR_REQUEST_DENIED);
@@ -1915,6 +2232,9 @@ int CUT_FTPClient::SetDataPortRange(int min, int max) {
 
 	m_nDataPort = m_nDataPortMin + GetTickCount()%(m_nDataPortMax-m_nDataPortMin);
 
+	//idle listeners may be outside the new range
+	ClearDataPortPool();
+
 	return UTE_SUCCESS;
 }
 
@@ -1928,6 +2248,391 @@ int CUT_FTPClient::GetDataPortRange(int * min, int * max) {
 	return UTE_SUCCESS;
 }
 
+/***************************************
+SetDataPortPoolSize
+    Sets the number of idle listening sockets
+    kept for active mode transfers. Listeners
+    are handed out oldest first, so a port is
+    only reused after all other pooled ports
+    have been used once.
+Params
+    size - 0 to FTP_DATAPORT_POOL_SIZE, 0 disables the pool
+Return
+    UTE_SUCCESS - success
+    UTE_ERROR   - invalid size
+****************************************/
+int CUT_FTPClient::SetDataPortPoolSize(int size) {
+	if (size < 0 || size > FTP_DATAPORT_POOL_SIZE)
+		return UTE_ERROR;
+
+	m_nListenerPoolSize = size;
+	ClearDataPortPool();
+
+	return UTE_SUCCESS;
+}
+
+int CUT_FTPClient::GetDataPortPoolSize() const {
+	return m_nListenerPoolSize;
+}
+
+/***************************************
+SetUseEPRT
+    Use EPRT (RFC 2428) instead of PORT to
+    announce the data port. If the server does
+    not recognize EPRT, PORT is used for the
+    remainder of the session. Over IPv6, EPRT
+    is always used.
+Params
+    useEPRT - TRUE to use EPRT
+Return
+    none
+****************************************/
+void CUT_FTPClient::SetUseEPRT(BOOL useEPRT) {
+	m_bUseEPRT = useEPRT;
+}
+
+BOOL CUT_FTPClient::GetUseEPRT() const {
+	return m_bUseEPRT;
+}
+
+/***************************************
+SetPipelinePASV
+    When set, the passive mode transfer functions
+    send the PASV for the next transfer right
+    after the data of the current transfer is
+    done, so the reply arrives together with
+    the final reply of the transfer instead of
+    costing an extra round trip.
+    Only enable when a passive transfer follows.
+Params
+    pipeline - TRUE to send PASV ahead
+Return
+    none
+****************************************/
+void CUT_FTPClient::SetPipelinePASV(BOOL pipeline) {
+	m_bPipelinePASV = pipeline;
+}
+
+BOOL CUT_FTPClient::GetPipelinePASV() const {
+	return m_bPipelinePASV;
+}
+
+/***************************************
+RequestPASV
+    Sends the PASV command and returns the reply.
+    If a PASV was sent ahead during the previous
+    transfer and its reply is recent enough, that
+    reply is returned instead.
+Params
+    response    - buffer for the response line
+    maxlen      - size of the buffer
+Return
+    response code
+****************************************/
+int CUT_FTPClient::RequestPASV(LPSTR response, int maxlen) {
+    if (m_nPASVAhead == 2) {
+        m_nPASVAhead = 0;
+        if (GetTickCount() - m_dwPASVAheadTime < FTP_PASV_AHEAD_TIMEOUT) {
+            strncpy(response, m_szPASVAhead, maxlen-1);
+            response[maxlen-1] = 0;
+            return m_nPASVAheadCode;
+        }
+    }
+
+    Send("PASV\r\n");
+
+    return GetResponseCode(this, response, maxlen);
+}
+
+/***************************************
+SendPASVAhead
+    Sends PASV for the next transfer if pipelining
+    is enabled. Must be followed by ReceivePASVAhead
+    after the final reply of the current transfer
+    was read.
+Params
+    none
+Return
+    UTE_SUCCESS - success
+****************************************/
+int CUT_FTPClient::SendPASVAhead() {
+    m_nPASVAhead = 0;
+
+    if (!m_bPipelinePASV)
+        return UTE_SUCCESS;
+
+    Send("PASV\r\n");
+    m_nPASVAhead = 1;
+
+    return UTE_SUCCESS;
+}
+
+/***************************************
+ReceivePASVAhead
+    Reads the reply of the PASV sent ahead and
+    keeps it for the next RequestPASV.
+Params
+    none
+Return
+    UTE_SUCCESS - success
+    UTE_ERROR   - no usable reply
+****************************************/
+int CUT_FTPClient::ReceivePASVAhead() {
+    if (m_nPASVAhead != 1)
+        return UTE_SUCCESS;
+
+    m_nPASVAheadCode = GetResponseCode(this, m_szPASVAhead, sizeof(m_szPASVAhead));
+    if (m_nPASVAheadCode < 200 || m_nPASVAheadCode > 299) {
+        m_nPASVAhead = 0;
+        return UTE_ERROR;
+    }
+
+    m_dwPASVAheadTime = GetTickCount();
+    m_nPASVAhead = 2;
+
+    return UTE_SUCCESS;
+}
+
+/***************************************
+ClearServerState
+    Forgets the TYPE and working directory
+    last confirmed by the server, so the next
+    SetTransferType and ChDir send their
+    command regardless.
+Params
+    none
+Return
+    none
+****************************************/
+void CUT_FTPClient::ClearServerState() {
+    m_nServerType = -1;
+    m_szServerDir[0] = '\0';
+}
+
+/***************************************
+BindDataListener
+    Binds a new listening socket on the next
+    free port within the data port range.
+Params
+    listener - receives the socket and port
+Return
+    UTE_SUCCESS         - success
+    UTE_DATAPORT_FAILED - no free port found
+****************************************/
+int CUT_FTPClient::BindDataListener(CUT_DATALISTENER * listener) {
+    int loop;
+    unsigned short port;
+    SOCKET s;
+
+    //if the port requested is busy then increment
+    //to the next port, try 128 times then fail
+    for(loop = 0; loop < 128; loop++) {
+        if(m_nDataPort > m_nDataPortMax || m_nDataPort < m_nDataPortMin)
+            m_nDataPort = m_nDataPortMin;
+
+        port = (unsigned short)m_nDataPort;
+        m_nDataPort++;
+
+        if(m_wsData.WaitForConnect(port) == UTE_SUCCESS) {
+            listener->sock = m_wsData.DetachListener();
+            listener->port = port;
+            return UTE_SUCCESS;
+        }
+
+        //a failed bind leaves the socket open, get rid of it before trying the next port
+        s = m_wsData.DetachListener();
+        if (s != INVALID_SOCKET)
+            m_wsData.SocketClose(s);
+    }
+
+    return UTE_DATAPORT_FAILED;
+}
+
+/***************************************
+FillDataPortPool
+    Binds listeners until the pool holds
+    the requested number of sockets.
+Params
+    none
+Return
+    UTE_SUCCESS         - success
+    UTE_DATAPORT_FAILED - not all listeners could be bound
+****************************************/
+int CUT_FTPClient::FillDataPortPool() {
+    CUT_DATALISTENER listener;
+
+    while(m_nListenerCount < m_nListenerPoolSize) {
+        if (BindDataListener(&listener) != UTE_SUCCESS)
+            return UTE_DATAPORT_FAILED;
+
+        m_dataListeners[(m_nListenerHead+m_nListenerCount)%FTP_DATAPORT_POOL_SIZE] = listener;
+        m_nListenerCount++;
+    }
+
+    return UTE_SUCCESS;
+}
+
+/***************************************
+ClearDataPortPool
+    Closes all idle listeners.
+Params
+    none
+Return
+    UTE_SUCCESS - success
+****************************************/
+int CUT_FTPClient::ClearDataPortPool() {
+    while(m_nListenerCount > 0) {
+        m_wsData.SocketClose(m_dataListeners[m_nListenerHead].sock);
+        m_nListenerHead = (m_nListenerHead+1)%FTP_DATAPORT_POOL_SIZE;
+        m_nListenerCount--;
+    }
+
+    m_nListenerHead = 0;
+
+    return UTE_SUCCESS;
+}
+
+/***************************************
+GetDataPortFamily
+    Gets the local address of the control
+    connection, which is the address the
+    server connects back to in active mode.
+    The data listeners are IPv4 only, so an
+    IPv6 control connection cannot use them.
+Params
+    address - receives the address in text
+    maxLen  - length of the buffer
+Return
+    1   - IPv4 address
+    -1  - error, or not an IPv4 connection
+****************************************/
+int CUT_FTPClient::GetDataPortFamily(LPSTR address, int maxLen) {
+    SOCKADDR_STORAGE local;
+    int len = sizeof(local);
+
+    if (m_socket == INVALID_SOCKET || getsockname(m_socket, (LPSOCKADDR)&local, &len) == SOCKET_ERROR)
+        return -1;
+
+    if (local.ss_family != AF_INET)
+        return -1;
+
+    if (GetHostAddress(address, maxLen) != UTE_SUCCESS)
+        return -1;
+
+    return 1;
+}
+
+/***************************************
+OpenDataPort
+    Prepares the data port for an active mode
+    transfer. The oldest idle listener of the
+    pool is used, if the pool is empty it is
+    refilled. The port is announced to the
+    server with EPRT or PORT.
+Params
+    none
+Return
+    UTE_SUCCESS         - success
+    UTE_DATAPORT_FAILED - data port could not be opened
+    UTE_PORT_FAILED     - PORT/EPRT command failed
+****************************************/
+int CUT_FTPClient::OpenDataPort() {
+    CUT_DATALISTENER listener;
+    char    addr[64];
+    int     rt = 0, loop, len;
+    int     family = GetDataPortFamily(addr, sizeof(addr));
+    BOOL    useEPRT = m_bUseEPRT;
+    BOOL    sendPort = !useEPRT;
+
+    if (family == -1)
+        return UTE_DATAPORT_FAILED;
+
+    if (m_nListenerCount == 0)
+        FillDataPortPool();
+
+    if (m_nListenerCount > 0) {
+        listener = m_dataListeners[m_nListenerHead];
+        m_nListenerHead = (m_nListenerHead+1)%FTP_DATAPORT_POOL_SIZE;
+        m_nListenerCount--;
+    } else if (BindDataListener(&listener) != UTE_SUCCESS) {
+        return UTE_DATAPORT_FAILED;
+    }
+
+    if (m_wsData.AttachListener(listener.sock, listener.port) != UTE_SUCCESS) {
+        m_wsData.SocketClose(listener.sock);
+        return UTE_DATAPORT_FAILED;
+    }
+
+    if (useEPRT) {
+        _snprintf(m_szBuf,sizeof(m_szBuf)-1,"EPRT |%d|%s|%d|\r\n",family,addr,listener.port);
+        Send(m_szBuf);
+
+        rt = GetResponseCode(this);
+        if (rt == 500 || rt == 501 || rt == 502) {
+            //EPRT not understood, stick to PORT from now on
+            m_bUseEPRT = FALSE;
+            sendPort = TRUE;
+        }
+    }
+
+    if (sendPort) {
+        //create the port set up string
+        len = (int)strlen(addr);
+        for(loop=0;loop<len;loop++){
+            if(addr[loop]=='.')
+                addr[loop] = ',';
+            }
+
+        _snprintf(m_szBuf,sizeof(m_szBuf)-1,"PORT %s,%d,%d\r\n",addr,HIBYTE(listener.port),LOBYTE(listener.port));
+        Send(m_szBuf);
+
+        rt = GetResponseCode(this);
+    }
+
+    //check for a return of 2??
+    if(rt < 200 || rt >=300){
+        //nothing connected to the listener yet, so it can be reused
+        CloseDataPort(TRUE);
+        return UTE_PORT_FAILED;
+        }
+
+    return UTE_SUCCESS;
+}
+
+/***************************************
+CloseDataPort
+    Closes the data connection. The listener
+    is put back into the pool only when
+    recycle is set, otherwise it is closed.
+    Only recycle after a clean transfer, a
+    listener with a stray pending connection
+    would hand it to the next transfer.
+Params
+    recycle - TRUE to keep the listener
+Return
+    UTE_SUCCESS - success
+****************************************/
+int CUT_FTPClient::CloseDataPort(BOOL recycle) {
+    CUT_DATALISTENER listener;
+
+    listener.sock = m_wsData.DetachListener(&listener.port);
+
+    //close the connection down
+    m_wsData.CloseConnection();
+
+    if (listener.sock == INVALID_SOCKET)
+        return UTE_SUCCESS;
+
+    if (recycle && m_nListenerCount < m_nListenerPoolSize) {
+        m_dataListeners[(m_nListenerHead+m_nListenerCount)%FTP_DATAPORT_POOL_SIZE] = listener;
+        m_nListenerCount++;
+    } else {
+        m_wsData.SocketClose(listener.sock);
+    }
+
+    return UTE_SUCCESS;
+}
+
 /***************************************
 GetDirInfo
     Retrieves the current directory infomation
@@ -1955,53 +2660,17 @@ int CUT_FTPClient::GetDirInfo(LPCWSTR path){
 #endif
 int CUT_FTPClient::GetDirInfo(LPCSTR path){
 
-    int     rt,loop,len;
-    char    addr[32];
+    int     rt;
 
     if (m_nFirewallMode)
         return GetDirInfoPASV(path);
 
 	m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
-    //open up a data port, if the one requested is busy then
-    //increment to the next port, try 50 times then fail
-    for(loop=0;loop<128;loop++) {
-		if(m_wsData.WaitForConnect((unsigned short)m_nDataPort)==UTE_SUCCESS)
-            break;
-        m_nDataPort++;
-        }
-
-    if(loop==128)
-        return OnError(UTE_DATAPORT_FAILED);
-
-    //get the host address
-    GetHostAddress( addr,sizeof(addr) );
-
-    //create the port set up string
-    len = (int)strlen(addr);
-    for(loop=0;loop<len;loop++){
-        if(addr[loop]=='.')
-            addr[loop] = ',';
-    }
-    _snprintf(m_szBuf,sizeof(m_szBuf)-1,"PORT %s,%d,%d\r\n",addr,HIBYTE(m_nDataPort),LOBYTE(m_nDataPort));
-
-    //setup the next port number
-    m_nDataPort++;
-    //if(m_nDataPort > 32000 || m_nDataPort < 0)
-    //    m_nDataPort = 10000;
-    	if(m_nDataPort > m_nDataPortMax || m_nDataPort < m_nDataPortMin)
-		m_nDataPort = m_nDataPortMin;
-
-    //send the port command
-    Send(m_szBuf);
-
-    //check for a return of 2??
-    rt = GetResponseCode(this);
-    if(rt < 200 || rt >299){
-        //close the connection down
-        m_wsData.CloseConnection();
-        return OnError(UTE_PORT_FAILED);
-        }
+    //open up a data port and announce it to the server
+    rt = OpenDataPort();
+    if(rt != UTE_SUCCESS)
+        return OnError(rt);
 
     //send the list command
     if (path != NULL)
@@ -2013,7 +2682,7 @@ int CUT_FTPClient::GetDirInfo(LPCSTR path){
     //wait for a connection on the data port
     if(m_wsData.WaitForAccept(15)!= UTE_SUCCESS){  // GW: July 18 the wait Time Out is increased to 15 sec
         //close the connection down
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         ClearReceiveBuffer();
         return OnError(UTE_SVR_DATA_CONNECT_FAILED);
         }
@@ -2022,7 +2691,7 @@ int CUT_FTPClient::GetDirInfo(LPCSTR path){
 	  //check for a return of 100 or 200 code
     rt = GetResponseCode(this);
     if(rt < 100 || rt >=300) {
-        m_wsData.CloseConnection();
+        CloseDataPort(FALSE);
         return OnError(UTE_SVR_DATA_CONNECT_FAILED);
         }
 
@@ -2037,7 +2706,7 @@ int CUT_FTPClient::GetDirInfo(LPCSTR path){
 	for(;;) {
         // Check for abortion flag
         if(IsAborted()) {
-            m_wsData.CloseConnection();
+            CloseDataPort(FALSE);
             return OnError(UTE_ABORTED);
             }
 
@@ -2082,7 +2751,7 @@ int CUT_FTPClient::GetDirInfo(LPCSTR path){
         }
 
     //close the connection down
-    m_wsData.CloseConnection();
+    CloseDataPort(TRUE);
 
     //check for a return of 2??
     rt = GetResponseCode(this);
@@ -2130,8 +2799,6 @@ int CUT_FTPClient::GetDirInfoPASV(LPCSTR path){
     int     port;
     UINT    loop;
 
-    //send the port command
-    Send("PASV\r\n");
 
     m_wsData.SSLSetReuseSession(SSLGetCurrentSession());
 
@@ -2139,8 +2806,9 @@ int CUT_FTPClient::GetDirInfoPASV(LPCSTR path){
     // we need to get the full IP address and port number from the
     // PASV return line, so that we can originate the data connection.
 
+    //send PASV, unless it was already sent during the previous transfer
     //check for a return of 2??
-    rt = GetResponseCode(this, responseBuf, sizeof(responseBuf));
+    rt = RequestPASV(responseBuf, sizeof(responseBuf));
     if(rt < 200 || rt >299)
         return OnError(UTE_PORT_FAILED);
 
@@ -2261,18 +2929,16 @@ int CUT_FTPClient::GetDirInfoPASV(LPCSTR path){
     //close the connection down
     m_wsData.CloseConnection();
 
-    //check for a return of 2??
+    //ask for the next data port while the server finishes this transfer
+    SendPASVAhead();
+
+    //check for a return of 2??, a preliminary reply is followed by the final one
     rt = GetResponseCode(this);
-    if (rt < 200 || rt >= 300) {
-        if (rt <200) {
-            rt = GetResponseCode(this);
-            if (rt < 200 || rt >= 300)
-                return OnError(UTE_LIST_FAILED);
-            else
-                return OnError(UTE_SUCCESS);
-            }
+    if (rt < 200)
+        rt = GetResponseCode(this);
+    ReceivePASVAhead();
+    if (rt < 200 || rt >= 300)
         return OnError(UTE_LIST_FAILED);
-        }
     else
         return OnError(UTE_SUCCESS);
 }
@@ -2596,6 +3262,8 @@ int CUT_FTPClient::PeekResponseCode(CUT_WSClient *ws, LPSTR string, int maxlen)
     strncpy(m_szResponse, m_szBuf, MAX_PATH);
     m_szResponse[MAX_PATH - 1] = '\0';
 
+    TraceEvent(Trace_ReplyReceived, code, 0);
+
     //copy the rest of the data
     if(string != NULL) {
         maxlen--;
@@ -3170,6 +3838,8 @@ int CUT_FTPClient::Quote(LPCSTR command) {
         return OnError(UTE_QUOTE_LINE_IS_EMPTY);
     // clear response list
     m_listResponse.ClearList();
+    // a custom command can change any state
+    ClearServerState();
     int rt = 0;
     SendAsLine(command, (int)strlen(command),256);
     // we will leave the server error messages to be handled by the developer
@@ -3180,6 +3850,70 @@ int CUT_FTPClient::Quote(LPCSTR command) {
     return OnError(UTE_SUCCESS);
 }
 
+/***************************************
+PipelineCommands
+    Sends a list of commands on the control
+    connection without waiting for the reply
+    of each command first. At most window
+    commands are outstanding, replies are
+    matched to the commands in order.
+    Only use for commands that have a single
+    reply and do not open a data connection.
+Params
+    commands    - CRLF terminated commands
+    count       - number of commands
+    codes       - receives the reply code of each
+                  command, 0 if it was not sent or
+                  no reply was received
+    [window]    - max outstanding commands
+Return
+    UTE_SUCCESS     - all commands got a reply
+    UTE_NO_RESPONSE - connection lost
+    UTE_ABORTED     - aborted, remaining commands were not sent
+****************************************/
+int CUT_FTPClient::PipelineCommands(LPCSTR * commands, int count, int * codes, int window) {
+    int     sent = 0, received = 0, i;
+    BOOL    aborted = FALSE;
+
+    if (window < 1)
+        window = 1;
+
+    // the commands could rename or remove the working directory
+    m_szServerDir[0] = '\0';
+
+	// v4.2 change to eliminate C4127: conditional expression is constant
+    for(;;) {
+        //keep the window filled
+        while(!aborted && sent < count && sent - received < window) {
+            if (IsAborted()) {
+                aborted = TRUE;
+                break;
+            }
+            Send(commands[sent]);
+            sent++;
+        }
+
+        if (received == sent)
+            break;
+
+        codes[received] = GetResponseCode(this);
+        if (codes[received] == 0) {
+            for(i = received; i < count; i++)
+                codes[i] = 0;
+            return OnError(UTE_NO_RESPONSE);
+        }
+        received++;
+    }
+
+    for(i = sent; i < count; i++)
+        codes[i] = 0;
+
+    if (aborted)
+        return OnError(UTE_ABORTED);
+
+    return OnError(UTE_SUCCESS);
+}
+
 
 /**************************************************************
 SocketOnConnected(SOCKET s, const char *lpszName)
@@ -3246,6 +3980,13 @@ int CUT_FTPClient::SocketOnConnected(SOCKET s, const char *lpszName){
 
 	m_dataSecLevel = performProt?1:0;	//do not call the function yet, let FTPConnecth andle that after authentication
 
+	//resume an earlier session with this server if possible
+	char sessionKey[WSC_SSL_CACHE_KEY_SIZE];
+	_snprintf(sessionKey, sizeof(sessionKey)-1, "%s:%u", lpszName, (unsigned int)ntohs(m_sockAddr.sin_port));
+	sessionKey[sizeof(sessionKey)-1] = 0;
+	SSLSetSessionKey(sessionKey);
+	SSLSetReuseSession(NULL);
+
 	if (m_sMode == FTPS) {	//just connect ssl
 		rt = ConnectSSL();
 		if (rt != UTE_SUCCESS)
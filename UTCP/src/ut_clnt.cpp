@@ -25,6 +25,8 @@
 NppFTP:
 Modification made April 2010:
 -Replaced existing secure functionality with OpenSSL functionality
+-ReceiveLine reads ahead into a persistent buffer instead of peeking
+-Process wide TLS session cache, keyed by host:port
 */
 
 #ifdef _WINSOCK_2_0_
@@ -38,6 +40,8 @@ Modification made April 2010:
 
 #include "ut_clnt.h"
 
+#include "Trace.h"
+
 #include "ut_strop.h"
 
 
@@ -48,6 +52,11 @@ Modification made April 2010:
 #endif
 
 
+CUT_SSLCacheEntry	CUT_WSClient::m_sessionCache[WSC_SSL_CACHE_SIZE];
+CRITICAL_SECTION	CUT_WSClient::m_sessionCacheLock;
+long				CUT_WSClient::m_nHandshakes = 0;
+long				CUT_WSClient::m_nHandshakesResumed = 0;
+
 /***********************************************
 Constructor
 ************************************************/
@@ -66,6 +75,8 @@ CUT_WSClient::CUT_WSClient() :
 	m_hAsyncWnd(NULL),						// Initialize window handle with NULL
 	m_lSendTimeOut(30000),				// Set default Send Time Out value
 	m_lRecvTimeOut(30000),				// Set default Receive Time Out value
+	m_nRecvBufPos(0),					// Initialize the receive buffer
+	m_nRecvBufLen(0),
 
 	m_isSSL(false),
 	m_SSLconnected(false),
@@ -83,11 +94,14 @@ CUT_WSClient::CUT_WSClient() :
 		SSL_load_error_strings();
 		//ERR_load_BIO_strings();
 		OpenSSL_add_all_algorithms();
+		InitializeCriticalSection(&m_sessionCacheLock);
+		memset(m_sessionCache, 0, sizeof(m_sessionCache));
 		isSSLInit = true;
 	}
 
 	// Initialize address array
     m_szAddress[0]    = 0;
+    m_szSessionKey[0] = 0;
 
     //initialize the Windows Socket DLL
     if( WSAStartup(WINSOCKVER, &m_data) != 0 )
@@ -135,6 +149,7 @@ int CUT_WSClient::Connect(unsigned int port, LPCWSTR address, long timeout, int
 int CUT_WSClient::Connect(unsigned int port, LPCSTR address, long timeout, int family, int sockType)
 {
 	int	nError = UTE_SUCCESS;
+	TraceSpan span(Span_SocketConnect, port);
 
     if(m_socket != INVALID_SOCKET)
         return OnError(UTE_SOCK_ALREADY_OPEN);
@@ -572,6 +587,10 @@ int CUT_WSClient::CloseConnection(){
     m_nLocalPort = 0;
     m_nAcceptPort = 0;
 
+    //discard any buffered data of the old connection
+    m_nRecvBufPos = 0;
+    m_nRecvBufLen = 0;
+
     strcpy(m_szAddress, "");
 
     return OnError(rt);
@@ -666,12 +685,17 @@ int CUT_WSClient::ConnectSSL() {
 	if (m_SSLconnected)
 		return UTE_SUCCESS;
 
+	TraceSpan span(Span_Handshake);
+
 	SSL_set_fd(m_ssl, m_socket);
 
 	//Session reuse mod: If m_reuseSession is set, set it as the current SSL session
 	//m_reuseSession should be set just prior to a Connect() call.
+	//Otherwise a session from the session cache is used, if any
 	if (m_reuseSession != NULL) {
 		SSL_set_session(m_ssl, m_reuseSession);
+	} else {
+		SSLCacheApplySession();
 	}
 	int rc = SSL_connect(m_ssl);
 	if (rc < 1) {
@@ -683,9 +707,14 @@ int CUT_WSClient::ConnectSSL() {
 			printf("*** %s\n", buf);
 		}
 
+		SSLCacheStoreSession(TRUE);
 		return UTE_ERROR;
 	}
 
+	InterlockedIncrement(&m_nHandshakes);
+	if (SSL_session_reused(m_ssl))
+		InterlockedIncrement(&m_nHandshakesResumed);
+
 
 
 	X509* cert = SSL_get_peer_certificate(m_ssl);
@@ -700,6 +729,8 @@ int CUT_WSClient::ConnectSSL() {
 
 	m_SSLconnected = true;
 
+	SSLCacheStoreSession(FALSE);
+
 	return UTE_SUCCESS;
 }
 
@@ -803,6 +834,15 @@ int CUT_WSClient::SSLSend(LPCSTR data, int len) {
 }
 
 int CUT_WSClient::SSLReceive(LPSTR buffer, int maxSize, bool peek) {
+	//data buffered by ReceiveLine comes first
+	if (m_nRecvBufPos < m_nRecvBufLen) {
+		int size = min(maxSize, m_nRecvBufLen - m_nRecvBufPos);
+		memcpy(buffer, &m_szRecvBuf[m_nRecvBufPos], size);
+		if (!peek)
+			m_nRecvBufPos += size;
+		return size;
+	}
+
 	if (m_isSSL && m_SSLconnected) {
 		if (!peek) {
 			int size = SSL_read(m_ssl, (char *)buffer, maxSize);
@@ -831,6 +871,136 @@ int CUT_WSClient::SSLSetReuseSession(SSL_SESSION * reuseSession) {
 	return UTE_SUCCESS;
 }
 
+/***************************************************
+SSLSetSessionKey
+    Sets the key of the connection in the process
+    wide session cache. Connections with the same key
+    resume each others TLS sessions. The key is
+    normally "host:port".
+    Not used when a session was set with
+    SSLSetReuseSession.
+Params
+    key - cache key, NULL or empty to disable
+Return
+    UTE_SUCCESS
+****************************************************/
+int CUT_WSClient::SSLSetSessionKey(LPCSTR key) {
+	if (key == NULL)
+		key = "";
+
+	strncpy(m_szSessionKey, key, sizeof(m_szSessionKey)-1);
+	m_szSessionKey[sizeof(m_szSessionKey)-1] = 0;
+
+	return UTE_SUCCESS;
+}
+
+/***************************************************
+SSLCacheApplySession
+    Sets the cached session for the session key,
+    if any, on the SSL object to be resumed by the
+    next handshake
+Params
+    none
+Return
+    UTE_SUCCESS - a session will be resumed
+    UTE_ERROR   - no session cached
+****************************************************/
+int CUT_WSClient::SSLCacheApplySession() {
+	int rt = UTE_ERROR;
+
+	if (m_szSessionKey[0] == 0 || m_ssl == NULL)
+		return rt;
+
+	EnterCriticalSection(&m_sessionCacheLock);
+	for(int i = 0; i < WSC_SSL_CACHE_SIZE; i++) {
+		CUT_SSLCacheEntry & entry = m_sessionCache[i];
+		if (entry.session != NULL && !strcmp(entry.key, m_szSessionKey)) {
+			//SSL_set_session takes its own reference
+			if (SSL_set_session(m_ssl, entry.session) == 1) {
+				entry.lastUsed = GetTickCount();
+				rt = UTE_SUCCESS;
+			}
+			break;
+		}
+	}
+	LeaveCriticalSection(&m_sessionCacheLock);
+
+	return rt;
+}
+
+/***************************************************
+SSLCacheStoreSession
+    Stores the session of the current connection
+    in the cache for the session key, replacing the
+    least recently used entry if the cache is full.
+    With session tickets the server may have issued
+    a new ticket, so this is done after every
+    handshake.
+Params
+    remove - TRUE to remove the entry instead, after
+             a failed handshake
+Return
+    UTE_SUCCESS
+****************************************************/
+int CUT_WSClient::SSLCacheStoreSession(BOOL remove) {
+	if (m_szSessionKey[0] == 0 || m_ssl == NULL)
+		return UTE_SUCCESS;
+
+	SSL_SESSION * session = NULL;
+	if (!remove)
+		session = SSL_get1_session(m_ssl);
+
+	SSL_SESSION * oldSession = NULL;
+	int slot = -1;
+
+	EnterCriticalSection(&m_sessionCacheLock);
+	for(int i = 0; i < WSC_SSL_CACHE_SIZE; i++) {
+		CUT_SSLCacheEntry & entry = m_sessionCache[i];
+		if (entry.session != NULL && !strcmp(entry.key, m_szSessionKey)) {
+			slot = i;
+			break;
+		}
+		if (slot == -1 || entry.session == NULL ||
+		    (m_sessionCache[slot].session != NULL && entry.lastUsed < m_sessionCache[slot].lastUsed))
+			slot = i;
+	}
+
+	CUT_SSLCacheEntry & entry = m_sessionCache[slot];
+	if (remove && strcmp(entry.key, m_szSessionKey)) {
+		//nothing cached for this key
+	} else {
+		oldSession = entry.session;
+		entry.session = session;
+		entry.lastUsed = GetTickCount();
+		strcpy(entry.key, m_szSessionKey);
+	}
+	LeaveCriticalSection(&m_sessionCacheLock);
+
+	//free outside the lock, the session may still be in use by another connection
+	if (oldSession != NULL)
+		SSL_SESSION_free(oldSession);
+
+	return UTE_SUCCESS;
+}
+
+/***************************************************
+SSLGetHandshakeStats
+    Returns the number of TLS handshakes done by
+    all clients in the process and how many of
+    them resumed a previous session
+Params
+    handshakes - receives the number of handshakes
+    resumed    - receives the number of resumed handshakes
+Return
+    none
+****************************************************/
+void CUT_WSClient::SSLGetHandshakeStats(long * handshakes, long * resumed) {
+	if (handshakes)
+		*handshakes = m_nHandshakes;
+	if (resumed)
+		*resumed = m_nHandshakesResumed;
+}
+
 /***************************************************
 Send
     Sends the given data to the client.
@@ -1196,6 +1366,8 @@ Return
     UTE_SUCCESS - success
 ****************************************************/
 int CUT_WSClient::WaitForReceive(long secs,long uSecs){
+	if (m_nRecvBufPos < m_nRecvBufLen)
+		return UTE_SUCCESS;
 	if (m_SSLconnected) {
 			if (SSL_pending(m_ssl)) {
 				return UTE_SUCCESS;
@@ -1403,6 +1575,8 @@ ReceiveLine
     Receives a line of data. This function will receive data
     until the maxDataLen is reached or a '\n' is encountered.
     This function will also return when the timeOut has expired.
+    Data is read ahead into the receive buffer of the client,
+    anything after the '\n' is kept for the next receive call.
 Params
     data       - data buffer for receiving data
     maxDataLen - length of the data buffer
@@ -1412,16 +1586,39 @@ Return
 ****************************************************/
 int CUT_WSClient::ReceiveLine(LPSTR data,int maxDataLen,int timeOut){
 
-	int     rt, count = 0;
-	char    *tempBuf = NULL;
-    LPSTR   dataPtr = data; // point to the begining of the buffer
+	int     rt, len, count = 0;
+	char    *lineEnd;
 
     maxDataLen --;
 
-    tempBuf = new char[maxDataLen+1];
+    if(maxDataLen < 0)
+        return 0;
+
+    data[0] = 0;
 
 	while(maxDataLen > 0) {
 
+        // consume buffered data up to and including the first LF
+        len = m_nRecvBufLen - m_nRecvBufPos;
+        if(len > 0) {
+            if(len > maxDataLen)
+                len = maxDataLen;
+
+            lineEnd = (char *)memchr(&m_szRecvBuf[m_nRecvBufPos], '\n', len);
+            if(lineEnd != NULL)
+                len = (int)(lineEnd - &m_szRecvBuf[m_nRecvBufPos]) + 1;
+
+            memcpy(&data[count], &m_szRecvBuf[m_nRecvBufPos], len);
+            m_nRecvBufPos += len;
+            count += len;
+            maxDataLen -= len;
+            data[count] = 0;
+
+            if(lineEnd != NULL)
+                break;
+            continue;
+        }
+
 		if(IsAborted()) {
 			break;
 		}
@@ -1432,35 +1629,17 @@ int CUT_WSClient::ReceiveLine(LPSTR data,int maxDataLen,int timeOut){
 				break;
 		}
 
-		// look at the data coming in
-		rt = SSLReceive(tempBuf,maxDataLen, true);
+        // refill the buffer, it is empty so this reads from the connection
+        m_nRecvBufPos = 0;
+        m_nRecvBufLen = 0;
+		rt = SSLReceive(m_szRecvBuf, sizeof(m_szRecvBuf));
 		//error checking
 		if(rt < 1 ) {
 			break;
 		}
-
-        // find the first LF
-		for(int x = 0; x < rt; x ++){
-			if(tempBuf[x] == '\n'){
-				rt = SSLReceive(dataPtr,x+1);
-				dataPtr[x+1] = 0;
-				count += x + 1;
-				delete [] tempBuf;
-				return count;
-			}
-		}
-
-        // if the LF is not found then copy what is available
-		rt = SSLReceive(dataPtr, rt);
-		count += rt;
-		dataPtr[rt] = 0;
-
-		// move the current position of the pointer to the new point
-		dataPtr = &dataPtr[rt];
-		maxDataLen -= rt;
+        m_nRecvBufLen = rt;
 	}
 
-	delete [] tempBuf;
 	return count;
 }
 /***************************************************
@@ -1476,6 +1655,8 @@ See Also: WaitForReceive
 ****************************************************/
 BOOL CUT_WSClient::IsDataWaiting() const
 {
+	if (m_nRecvBufPos < m_nRecvBufLen)
+		return TRUE;
 	return SocketIsDataWaiting(m_socket);
 }
 
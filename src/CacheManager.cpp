@@ -0,0 +1,400 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "CacheManager.h"
+#include "SyncManifest.h"
+#include "Thread.h"
+
+#include <algorithm>
+
+const int ConditionCacheWork = 0;
+const int ConditionCacheStop = 1;
+const int ConditionCacheCount = 2;
+
+CacheManager::CacheManager() :
+	m_monitor(ConditionCacheCount),
+	m_running(false),
+	m_stopping(false),
+	m_evicting(false),
+	m_limit(0),
+	m_totalSize(0)
+{
+}
+
+CacheManager::~CacheManager() {
+	if (m_running)
+		OutErr("[NppFTP.CacheManager] Error: worker still running\n");
+
+	Clear();
+}
+
+int CacheManager::Start() {
+	if (m_running)
+		return 0;
+
+	m_stopping = false;
+	m_running = true;
+
+	ThreadHandle thread = Thread::Start(&WorkerThread, this);
+	if (thread == NULL) {
+		m_running = false;
+		return -1;
+	}
+	Thread::Detach(thread);
+
+	return 0;
+}
+
+int CacheManager::Stop() {
+	if (!m_running)
+		return 0;
+
+	m_monitor.Enter();
+		m_stopping = true;
+		m_monitor.Signal(ConditionCacheWork);
+		m_monitor.Wait(ConditionCacheStop);
+	m_monitor.Exit();
+
+	m_running = false;
+	m_stopping = false;
+
+	return 0;
+}
+
+int CacheManager::SetLimit(ULONGLONG limit) {
+	m_monitor.Enter();
+		m_limit = limit;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+ULONGLONG CacheManager::GetTotalSize() {
+	ULONGLONG totalSize;
+
+	m_monitor.Enter();
+		totalSize = m_totalSize;
+	m_monitor.Exit();
+
+	return totalSize;
+}
+
+int CacheManager::AddDirectory(const TCHAR * dir) {
+	if (!dir || !dir[0])
+		return -1;
+
+	m_monitor.Enter();
+		for(size_t i = 0; i < m_dirs.size(); i++) {
+			if (!lstrcmpi(m_dirs[i], dir)) {
+				m_monitor.Exit();
+				return 0;
+			}
+		}
+		m_dirs.push_back(SU::DupString(dir));
+		m_scanDirs.push_back(SU::DupString(dir));
+		m_monitor.Signal(ConditionCacheWork);
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::Clear() {
+	m_monitor.Enter();
+		for(size_t i = 0; i < m_files.size(); i++)
+			SU::FreeTChar(m_files[i].path);
+		m_files.clear();
+		for(size_t i = 0; i < m_dirs.size(); i++)
+			SU::FreeTChar(m_dirs[i]);
+		m_dirs.clear();
+		for(size_t i = 0; i < m_scanDirs.size(); i++)
+			SU::FreeTChar(m_scanDirs[i]);
+		m_scanDirs.clear();
+		m_totalSize = 0;
+		m_evicting = false;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::Touch(const TCHAR * path) {
+	if (!path)
+		return -1;
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesEx(path, GetFileExInfoStandard, &attributes))
+		return -1;
+	if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		return -1;
+
+	ULONGLONG size = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	FILETIME now;
+	::GetSystemTimeAsFileTime(&now);
+
+	m_monitor.Enter();
+		if (!InDirectory(path)) {
+			m_monitor.Exit();
+			return 1;
+		}
+		AddFile(path, size, FileTimeToInt(now));
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::Pin(const TCHAR * path) {
+	if (!path)
+		return -1;
+
+	//A file about to be uploaded was just used
+	Touch(path);
+
+	m_monitor.Enter();
+		bool found = false;
+		int index = FindFile(path, &found);
+		if (found)
+			m_files[index].pins++;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::Unpin(const TCHAR * path) {
+	if (!path)
+		return -1;
+
+	m_monitor.Enter();
+		bool found = false;
+		int index = FindFile(path, &found);
+		if (found && m_files[index].pins > 0)	//notifications may be sent twice
+			m_files[index].pins--;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::Evict(const TCHAR ** files, int count) {
+	m_monitor.Enter();
+		for(size_t i = 0; i < m_files.size(); i++)
+			m_files[i].open = false;
+
+		for(int i = 0; i < count; i++) {
+			bool found = false;
+			int index = FindFile(files[i], &found);
+			if (found)
+				m_files[index].open = true;
+		}
+
+		if (m_limit > 0 && m_totalSize > m_limit) {
+			m_evicting = true;
+			m_monitor.Signal(ConditionCacheWork);
+		}
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::WorkerThread(void * param) {
+	CacheManager * manager = (CacheManager*)param;
+	return manager->WorkerLoop();
+}
+
+int CacheManager::WorkerLoop() {
+	while(true) {
+		m_monitor.Enter();
+			while(!m_stopping && !NeedsWork())
+				m_monitor.Wait(ConditionCacheWork);
+
+			if (m_stopping) {
+				m_monitor.Exit();
+				break;
+			}
+
+			TCHAR * dir = NULL;
+			if (!m_scanDirs.empty()) {
+				dir = m_scanDirs.front();
+				m_scanDirs.erase(m_scanDirs.begin());
+			}
+		m_monitor.Exit();
+
+		//Scan first, so the eviction knows of all files
+		if (dir) {
+			ScanDirectory(dir);
+			SU::FreeTChar(dir);
+			continue;
+		}
+
+		if (EvictFile() == 0)
+			Sleep(CACHE_EVICT_INTERVAL);
+	}
+
+	m_monitor.Enter();
+		m_monitor.Signal(ConditionCacheStop);
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int CacheManager::ScanDirectory(const TCHAR * dir) {
+	std::vector<tstring> dirs;
+	dirs.push_back(dir);
+
+	int count = 0;
+	while(!dirs.empty()) {
+		tstring current = dirs.back();
+		dirs.pop_back();
+
+		tstring search = current + TEXT("\\*");
+		WIN32_FIND_DATA findData;
+		HANDLE hFind = ::FindFirstFile(search.c_str(), &findData);
+		if (hFind == INVALID_HANDLE_VALUE)
+			continue;
+
+		do {
+			if (!lstrcmp(findData.cFileName, TEXT(".")) || !lstrcmp(findData.cFileName, TEXT("..")))
+				continue;
+
+			tstring path = current + TEXT("\\") + findData.cFileName;
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				dirs.push_back(path);
+				continue;
+			}
+
+			//Not a cached copy, e.g. a synchronization manifest
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)
+				continue;
+
+			//Last access times may not be maintained, use whichever is later
+			ULONGLONG lastUse = (std::max)(FileTimeToInt(findData.ftLastAccessTime), FileTimeToInt(findData.ftLastWriteTime));
+			ULONGLONG size = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+
+			m_monitor.Enter();
+				if (m_stopping) {
+					m_monitor.Exit();
+					::FindClose(hFind);
+					return -1;
+				}
+				bool found = false;
+				FindFile(path.c_str(), &found);
+				if (!found)	//a touched file is more recent than the scan
+					AddFile(path.c_str(), size, lastUse);
+			m_monitor.Exit();
+			count++;
+		} while(::FindNextFile(hFind, &findData));
+
+		::FindClose(hFind);
+	}
+
+	OutDebug("[NppFTP.CacheManager] Indexed %d files in %T, cache size %I64u bytes", count, dir, GetTotalSize());
+
+	return 0;
+}
+
+int CacheManager::EvictFile() {
+	TCHAR * path = NULL;
+	ULONGLONG size = 0;
+
+	m_monitor.Enter();
+		ULONGLONG target = m_limit / 100 * CACHE_EVICT_TARGET;
+		if (m_limit == 0 || m_totalSize <= target) {
+			m_evicting = false;
+			m_monitor.Exit();
+			return 1;
+		}
+
+		int lru = -1;
+		for(size_t i = 0; i < m_files.size(); i++) {
+			const CacheFile & file = m_files[i];
+			if (file.pins > 0 || file.open)
+				continue;
+			if (lru == -1 || file.lastUse < m_files[lru].lastUse)
+				lru = (int)i;
+		}
+
+		if (lru == -1) {
+			m_evicting = false;
+			m_monitor.Exit();
+			return 1;
+		}
+
+		//Removed from the index before deleting, a file touched meanwhile is simply indexed again
+		path = m_files[lru].path;
+		size = m_files[lru].size;
+		m_totalSize -= size;
+		m_files.erase(m_files.begin()+lru);
+	m_monitor.Exit();
+
+	if (SyncManifest::EvictLocal(path) == 0) {
+		OutDebug("[NppFTP.CacheManager] Evicted %T (%I64u bytes)", path, size);
+	} else {
+		OutDebug("[NppFTP.CacheManager] Unable to evict %T: %u", path, ::GetLastError());
+	}
+
+	SU::FreeTChar(path);
+
+	return 0;
+}
+
+int CacheManager::AddFile(const TCHAR * path, ULONGLONG size, ULONGLONG lastUse) {
+	bool found = false;
+	int index = FindFile(path, &found);
+
+	if (found) {
+		m_totalSize -= m_files[index].size;
+	} else {
+		CacheFile file;
+		file.path = SU::DupString(path);
+		file.pins = 0;
+		file.open = false;
+		m_files.insert(m_files.begin()+index, file);
+	}
+
+	m_files[index].size = size;
+	m_files[index].lastUse = lastUse;
+	m_totalSize += size;
+
+	return index;
+}
+
+int CacheManager::FindFile(const TCHAR * path, bool * found) {
+	vCacheFile::iterator it = std::lower_bound(m_files.begin(), m_files.end(), path, &CacheManager::ComparePath);
+	*found = (it != m_files.end() && !lstrcmpi(it->path, path));
+	return (int)(it - m_files.begin());
+}
+
+bool CacheManager::InDirectory(const TCHAR * path) {
+	for(size_t i = 0; i < m_dirs.size(); i++) {
+		int len = lstrlen(m_dirs[i]);
+		if (!_tcsnicmp(m_dirs[i], path, len) && path[len] == TEXT('\\'))
+			return true;
+	}
+
+	return false;
+}
+
+bool CacheManager::NeedsWork() {
+	return !m_scanDirs.empty() || m_evicting;
+}
+
+bool CacheManager::ComparePath(const CacheFile & file, const TCHAR * path) {
+	return lstrcmpi(file.path, path) < 0;
+}
+
+ULONGLONG CacheManager::FileTimeToInt(const FILETIME & time) {
+	return ((ULONGLONG)time.dwHighDateTime << 32) | time.dwLowDateTime;
+}
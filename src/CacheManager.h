@@ -0,0 +1,92 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CACHEMANAGER_H
+#define CACHEMANAGER_H
+
+#include "Monitor.h"
+
+//Fraction of the limit the cache is reduced to once it is exceeded, so not every download triggers eviction
+#define CACHE_EVICT_TARGET		90	//percent
+//Pause between two evicted files, eviction runs in the background and should not hog the disk
+#define CACHE_EVICT_INTERVAL	20	//ms
+
+//Index of the files in the cache directories, with their size and time of last use
+//Keeps the cache below a byte budget by deleting the least recently used files,
+//except files open in Notepad++ and files with an upload pending.
+//Directories are scanned and files deleted by a worker thread, all access is locked
+class CacheManager {
+public:
+							CacheManager();
+	virtual					~CacheManager();
+
+	//Only to be called by creating thread
+	virtual int				Start();
+	virtual int				Stop();
+
+	virtual int				SetLimit(ULONGLONG limit);	//bytes, 0 for no limit
+	virtual ULONGLONG		GetTotalSize();
+
+	virtual int				AddDirectory(const TCHAR * dir);	//scanned in the background
+	virtual int				Clear();
+
+	virtual int				Touch(const TCHAR * path);	//file was used, ignored if not in a cache directory
+	virtual int				Pin(const TCHAR * path);	//file must not be evicted until unpinned
+	virtual int				Unpin(const TCHAR * path);
+
+							//start eviction if over the limit, files is the list of files open in the editor
+	virtual int				Evict(const TCHAR ** files, int count);
+
+	static int				WorkerThread(void * param);
+private:
+	struct CacheFile {
+		TCHAR*				path;
+		ULONGLONG			size;
+		ULONGLONG			lastUse;	//FILETIME
+		int					pins;
+		bool				open;
+	};
+
+	typedef std::vector<CacheFile> vCacheFile;
+
+	int						WorkerLoop();
+	int						ScanDirectory(const TCHAR * dir);
+	int						EvictFile();	//return 1 if nothing was left to evict
+
+	int						AddFile(const TCHAR * path, ULONGLONG size, ULONGLONG lastUse);	//must be locked
+	int						FindFile(const TCHAR * path, bool * found);	//must be locked, returns insertion index
+	bool					InDirectory(const TCHAR * path);	//must be locked
+	bool					NeedsWork();	//must be locked
+
+	static bool				ComparePath(const CacheFile & file, const TCHAR * path);
+	static ULONGLONG		FileTimeToInt(const FILETIME & time);
+
+	Monitor					m_monitor;
+	bool					m_running;
+	bool					m_stopping;
+	bool					m_evicting;
+
+	ULONGLONG				m_limit;
+	ULONGLONG				m_totalSize;
+
+	vCacheFile				m_files;	//sorted by path, case insensitive
+	std::vector<TCHAR*>		m_dirs;
+	std::vector<TCHAR*>		m_scanDirs;	//waiting to be scanned
+};
+
+#endif //CACHEMANAGER_H
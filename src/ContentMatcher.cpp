@@ -0,0 +1,146 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "ContentMatcher.h"
+
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+ContentMatcher::ContentMatcher(const char * pattern) :
+	m_pattern(pattern)
+{
+	Reset();
+}
+
+ContentMatcher::~ContentMatcher() {
+}
+
+int ContentMatcher::Reset() {
+	m_carry.clear();
+	m_found = false;
+	m_matchOffset = -1;
+	m_position = 0;
+
+	return 0;
+}
+
+bool ContentMatcher::Feed(const char * data, size_t length) {
+	if (m_found || length == 0)
+		return m_found;
+
+	size_t patternLength = m_pattern.size();
+	if (patternLength == 0) {
+		m_found = true;
+		m_matchOffset = 0;
+		return true;
+	}
+
+	//Matches starting in the previous chunk: search its end followed by the start of this one
+	if (!m_carry.empty()) {
+		size_t carryLength = m_carry.size();
+		std::string boundary = m_carry;
+		boundary.append(data, (std::min)(length, patternLength-1));
+		const char * match = Search(boundary.data(), boundary.size(), m_pattern.data(), patternLength);
+		if (match != NULL && (size_t)(match - boundary.data()) < carryLength) {
+			m_found = true;
+			m_matchOffset = m_position - (long)carryLength + (long)(match - boundary.data());
+			return true;
+		}
+	}
+
+	const char * match = Search(data, length, m_pattern.data(), patternLength);
+	if (match != NULL) {
+		m_found = true;
+		m_matchOffset = m_position + (long)(match - data);
+		return true;
+	}
+
+	//Keep the last patternLength-1 bytes seen, they may be the start of a match
+	size_t keep = patternLength-1;
+	if (length >= keep) {
+		m_carry.assign(data + length - keep, keep);
+	} else {
+		m_carry.append(data, length);
+		if (m_carry.size() > keep)
+			m_carry.erase(0, m_carry.size() - keep);
+	}
+	m_position += (long)length;
+
+	return false;
+}
+
+bool ContentMatcher::Found() const {
+	return m_found;
+}
+
+long ContentMatcher::GetMatchOffset() const {
+	return m_matchOffset;
+}
+
+const char* ContentMatcher::GetPattern() const {
+	return m_pattern.c_str();
+}
+
+size_t ContentMatcher::GetPatternLength() const {
+	return m_pattern.size();
+}
+
+const char* ContentMatcher::Search(const char * data, size_t length, const char * pattern, size_t patternLength) {
+	if (patternLength == 0)
+		return data;
+	if (patternLength > length)
+		return NULL;
+	if (patternLength == 1)
+		return (const char*)memchr(data, pattern[0], length);
+
+	size_t last = length - patternLength;	//last possible start of a match
+	size_t i = 0;
+
+#ifdef __SSE2__
+	//Compare the first and last byte of the pattern at 16 positions at once, only verify where both are equal
+	const __m128i first = _mm_set1_epi8(pattern[0]);
+	const __m128i final = _mm_set1_epi8(pattern[patternLength-1]);
+	for(; i + 16 <= last + 1; i += 16) {
+		__m128i blockFirst = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i blockFinal = _mm_loadu_si128((const __m128i*)(data + i + patternLength - 1));
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(final, blockFinal)));
+		while(mask != 0) {
+			unsigned int bit = __builtin_ctz(mask);
+			if (!memcmp(data + i + bit + 1, pattern + 1, patternLength - 2))
+				return data + i + bit;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	//Skip to candidates with memchr, which the C library vectorizes
+	while(i <= last) {
+		const char * candidate = (const char*)memchr(data + i, pattern[0], last - i + 1);
+		if (candidate == NULL)
+			return NULL;
+		i = candidate - data;
+		if (data[i + patternLength - 1] == pattern[patternLength-1] && !memcmp(data + i + 1, pattern + 1, patternLength - 2))
+			return data + i;
+		i++;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,57 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTENTMATCHER_H
+#define CONTENTMATCHER_H
+
+//Finds a byte string in data that arrives in chunks, e.g. while a file is being received.
+//Matches that span two chunks are found as well. Case sensitive, no encoding is assumed.
+class ContentMatcher {
+public:
+							ContentMatcher(const char * pattern);
+	virtual					~ContentMatcher();
+
+	virtual int				Reset();	//start of the next file
+
+	virtual bool			Feed(const char * data, size_t length);	//true once the pattern was found
+	virtual bool			Found() const;
+	virtual long			GetMatchOffset() const;	//offset of the first match, -1 if none
+
+	virtual const char*		GetPattern() const;
+	virtual size_t			GetPatternLength() const;
+
+	//First occurrence of pattern in data, NULL if none. Uses SSE2 when the compiler targets it
+	static const char*		Search(const char * data, size_t length, const char * pattern, size_t patternLength);
+private:
+	std::string				m_pattern;
+	std::string				m_carry;	//end of the previous chunk, shorter than the pattern
+	bool					m_found;
+	long					m_matchOffset;
+	long					m_position;	//offset of the start of the next chunk
+};
+
+//Receives the files found by a content search, called from the searching threads
+class SearchListener {
+public:
+							SearchListener() {};
+	virtual					~SearchListener() {};
+
+	virtual int				OnFileFound(const char * path) = 0;
+};
+
+#endif //CONTENTMATCHER_H
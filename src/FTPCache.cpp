@@ -24,8 +24,32 @@
 const char * FTPCache::CacheElem = "Cache";
 const int PathCacheSize = MAX_PATH+10;	//paths generally do not exceed MAX_PATH, but if it happens often buffer reallocation may need some profiling (e.g. set ceiling instead of just allocating)
 
+//True if the path is absolute and contains no elements PathSearchAndQualify would change
+static bool IsQualifiedPath(const TCHAR * path) {
+	bool isDrive = (path[0] != 0 && path[1] == TEXT(':') && path[2] == TEXT('\\'));
+	bool isUNC = (path[0] == TEXT('\\') && path[1] == TEXT('\\'));
+	if (!isDrive && !isUNC)
+		return false;
+
+	for(const TCHAR * cur = path+2; *cur != 0; cur++) {
+		if (*cur == TEXT('/'))
+			return false;
+		if (*cur == TEXT('\\') && cur[1] == TEXT('.')) {
+			if (cur[2] == TEXT('\\') || cur[2] == 0)
+				return false;
+			if (cur[2] == TEXT('.') && (cur[3] == TEXT('\\') || cur[3] == 0))
+				return false;
+		}
+	}
+
+	return true;
+}
+
 FTPCache::FTPCache() :
-	m_cacheParent(NULL)
+	m_cacheParent(NULL),
+	m_revision(0),
+	m_localIndex(true),
+	m_externalIndex(false)
 {
 	m_activeHost = SU::DupString(TEXT(""));
 	m_activeUser = SU::DupString(TEXT(""));
@@ -38,6 +62,7 @@ FTPCache::~FTPCache() {
 
 int FTPCache::SetCacheParent(FTPCache * cacheParent) {
 	m_cacheParent = cacheParent;
+	m_revision++;
 
 	return 0;
 }
@@ -72,6 +97,7 @@ int FTPCache::DeletePathMap(int i) {
 	SU::FreeTChar(m_vCachePaths[i].localpath);	//StringConversion
 
 	m_vCachePaths.erase(m_vCachePaths.begin()+i);
+	m_revision++;
 	return 0;
 }
 
@@ -81,6 +107,7 @@ int FTPCache::AddPathMap(PathMap pathmap) {
 		pathmap.localpathExpanded = expPath;
 	}
 	m_vCachePaths.push_back(pathmap);
+	m_revision++;
 	return 0;
 }
 
@@ -96,6 +123,7 @@ int FTPCache::SetPathMap(PathMap pathmap, int i) {
 		pathmap.localpathExpanded = expPath;
 	}
 	m_vCachePaths[i] = pathmap;
+	m_revision++;
 	return 0;
 }
 
@@ -110,6 +138,7 @@ int FTPCache::SwapPathMap(int indexa, int indexb) {
 		return 0;
 
 	std::swap(m_vCachePaths[indexa], m_vCachePaths[indexb]);
+	m_revision++;
 
 	return 0;
 }
@@ -120,56 +149,48 @@ int FTPCache::Clear() {
 		SU::FreeTChar(m_vCachePaths[i].localpath);	//StringCOnversion
 	}
 	m_vCachePaths.clear();
+	m_revision++;
 	return 0;
 }
 
 // should return 0 on success
 int FTPCache::GetExternalPathFromLocal(const TCHAR * localpath, char * extbuf, int extsize) const {
 
+	//Paths from Notepad++ are already fully qualified
 	TCHAR expanded[MAX_PATH];
-	BOOL res = PathSearchAndQualify(localpath, expanded, MAX_PATH);
-	
-	if (res == FALSE) {
-		OutErr("[GetExternalPathFromLocal] res is false");	
-		return -1;
-	}
+	if (!IsQualifiedPath(localpath)) {
+		BOOL res = PathSearchAndQualify(localpath, expanded, MAX_PATH);
 
-	//OutMsg("[GetExternalPathFromLocal] Search file path = '%S', host = '%S', user = '%S'", expanded, m_activeHost, m_activeUser);
-
-	for (size_t i = 0; i < m_vCachePaths.size(); i++) {
-	
-		//OutMsg("[GetExternalPathFromLocal] Looking in '%S'", m_vCachePaths[i].localpathExpanded);	
-	
-		const TCHAR * postfix = NULL;
-		if ( IsPathPrefixLocal(expanded, m_vCachePaths[i].localpathExpanded, &postfix) ) {
-			//get actual path using postfix
-			return PU::ConcatLocalToExternal(m_vCachePaths[i].externalpath, postfix, extbuf, extsize);
+		if (res == FALSE) {
+			OutErr("[GetExternalPathFromLocal] res is false");
+			return -1;
 		}
+		localpath = expanded;
 	}
-	
-	//OutMsg("[GetExternalPathFromLocal] did not find file in IsPathPrefixLocal. Will search parent folder");
 
-	if (!m_cacheParent) {
+	UpdateIndex();
+
+	const TCHAR * postfix = NULL;
+	int i = m_localIndex.Match(localpath, &postfix);
+	if (i == -1) {
 		OutErr("[GetExternalPathFromLocal] At root folder. End of search. No match was found.");
 		return 1;
 	}
 
-	return m_cacheParent->GetExternalPathFromLocal(localpath, extbuf, extsize);
+	//get actual path using postfix
+	return PU::ConcatLocalToExternal(m_vIndexMaps[i]->externalpath, postfix, extbuf, extsize);
 }
 
 int FTPCache::GetLocalPathFromExternal(const char * externalpath, TCHAR * localbuf, int localsize) const {
-	for (size_t i = 0; i < m_vCachePaths.size(); i++) {
-		const char * postfix = NULL;
-		if ( IsPathPrefixExternal(externalpath, m_vCachePaths[i].externalpath, &postfix) ) {
-			//get actual path using postfix
-			return PU::ConcatExternalToLocal(m_vCachePaths[i].localpathExpanded, postfix, localbuf, localsize);
-		}
-	}
+	UpdateIndex();
 
-	if (!m_cacheParent)
+	const char * postfix = NULL;
+	int i = m_externalIndex.Match(externalpath, &postfix);
+	if (i == -1)
 		return 1;
 
-	return m_cacheParent->GetLocalPathFromExternal(externalpath, localbuf, localsize);
+	//get actual path using postfix
+	return PU::ConcatExternalToLocal(m_vIndexMaps[i]->localpathExpanded, postfix, localbuf, localsize);
 }
 
 int FTPCache::ClearCurrentCache(bool permanent) {
@@ -209,6 +230,17 @@ int FTPCache::ClearCurrentCache(bool permanent) {
 	return 0;
 }
 
+int FTPCache::GetLocalPaths(std::vector<const TCHAR*> & paths) const {
+	UpdateIndex();
+
+	for(size_t i = 0; i < m_vIndexMaps.size(); i++) {
+		if (m_vIndexMaps[i]->localpathExpanded != NULL)
+			paths.push_back(m_vIndexMaps[i]->localpathExpanded);
+	}
+
+	return 0;
+}
+
 TiXmlElement* FTPCache::SaveCache(const FTPCache * cache) {
 	TiXmlElement * cacheElem = new TiXmlElement(FTPCache::CacheElem);
 
@@ -274,55 +306,10 @@ int FTPCache::AddPathMap(const TCHAR * localpath, const char * externalpath) {
 	map.localpathExpanded = expPath;
 
 	m_vCachePaths.push_back(map);
+	m_revision++;
 	return 0;
 }
 
-bool FTPCache::IsPathPrefixLocal(const TCHAR * localpath, const TCHAR * prefix, const TCHAR ** postfix) const {
-
-	int commonsize = PathCommonPrefix(localpath, prefix, NULL);
-	int prefixsize = lstrlen(prefix);
-
-	if (commonsize != prefixsize)
-		return false;
-
-	*postfix = localpath+prefixsize;
-	return true;
-
-/*
-	while(*prefix != 0) {
-		if (*localpath == 0)
-			return false;
-
-		if (*localpath != *prefix)
-			return false;
-
-		localpath++;
-		prefix++;
-	}
-
-	*postfix = localpath;
-
-	return true;
-*/
-}
-
-bool FTPCache::IsPathPrefixExternal(const char * localpath, const char * prefix, const char ** postfix) const {
-	while(*prefix != 0) {
-		if (*localpath == 0)
-			return false;
-
-		if (*localpath != *prefix)
-			return false;
-
-		localpath++;
-		prefix++;
-	}
-
-	*postfix = localpath;
-
-	return true;
-}
-
 int FTPCache::ExpandPaths() {
 	for(size_t i = 0; i < m_vCachePaths.size(); i++) {
 		TCHAR * expPath = ExpandPath(m_vCachePaths[i].localpath);
@@ -331,6 +318,7 @@ int FTPCache::ExpandPaths() {
 			m_vCachePaths[i].localpathExpanded = expPath;
 		}
 	}
+	m_revision++;
 	return 0;
 }
 
@@ -361,3 +349,56 @@ TCHAR* FTPCache::ExpandPath(const TCHAR * path) {
 
 	return expanded;
 }
+
+int FTPCache::GetRevisions(vRevisionStamp & stamps) const {
+	stamps.clear();
+	for(const FTPCache * cache = this; cache != NULL; cache = cache->m_cacheParent) {
+		RevisionStamp stamp = {cache, cache->m_revision};
+		stamps.push_back(stamp);
+	}
+
+	return 0;
+}
+
+//Rebuilds the prefix tries when this cache or one of its parents changed
+//The order of the path maps is kept: the first matching path map wins, then the ones of the parent
+int FTPCache::UpdateIndex() const {
+	//Each cache of the chain is compared on its own, a sum could stay equal after a reparent
+	vRevisionStamp revisions;
+	GetRevisions(revisions);
+
+	bool current = (revisions.size() == m_indexRevisions.size());
+	for(size_t i = 0; current && i < revisions.size(); i++) {
+		current = (revisions[i].cache == m_indexRevisions[i].cache && revisions[i].revision == m_indexRevisions[i].revision);
+	}
+	if (current)
+		return 0;
+
+	m_vIndexMaps.clear();
+	CollectPathMaps(m_vIndexMaps);
+
+	m_localIndex.Clear();
+	m_externalIndex.Clear();
+	for(size_t i = 0; i < m_vIndexMaps.size(); i++) {
+		const PathMap * map = m_vIndexMaps[i];
+		if (map->localpathExpanded == NULL || map->externalpath == NULL)
+			continue;
+		m_localIndex.Insert(map->localpathExpanded, (int)i);
+		m_externalIndex.Insert(map->externalpath, (int)i);
+	}
+
+	m_indexRevisions = revisions;
+
+	return 0;
+}
+
+int FTPCache::CollectPathMaps(std::vector<const PathMap*> & maps) const {
+	for(size_t i = 0; i < m_vCachePaths.size(); i++) {
+		maps.push_back(&m_vCachePaths[i]);
+	}
+
+	if (m_cacheParent)
+		m_cacheParent->CollectPathMaps(maps);
+
+	return 0;
+}
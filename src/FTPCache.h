@@ -27,6 +27,31 @@ struct PathMap {
 
 typedef std::vector<PathMap> vPathMap;
 
+//Prefix trie over paths, used to find the PathMap for a path in a single pass
+//Each prefix stores a value, lookups return the lowest value of all prefixes matching the path
+//Local paths are compared case insensitive and only match on a path separator
+template <class T>
+class PathTrie {
+public:
+							PathTrie(bool local) : m_local(local) { Clear(); };
+
+	void					Clear();
+	void					Insert(const T * prefix, int value);
+	int						Match(const T * path, const T ** postfix) const;	//return -1 if no match
+private:
+	struct Node {
+		T					c;
+		int					child;
+		int					sibling;
+		int					value;
+	};
+
+	T						Fold(T c) const { return m_local?(T)_totlower((TCHAR)c):c; };
+
+	bool					m_local;
+	std::vector<Node>		m_nodes;	//m_nodes[0] is the root
+};
+
 class FTPCache {
 public:
 	static const char *		CacheElem;
@@ -50,23 +75,100 @@ public:
 	virtual int				GetLocalPathFromExternal(const char * externalpath, TCHAR * localbuf, int localsize) const;
 
 	virtual int				ClearCurrentCache(bool permanent);
+	virtual int				GetLocalPaths(std::vector<const TCHAR*> & paths) const;	//expanded, including those of the parent
 
 	static TiXmlElement*	SaveCache(const FTPCache * cache);
 	static FTPCache*		LoadCache(const TiXmlElement * cacheElem);
 private:
 	int						AddPathMap(const TCHAR * localpath, const char * externalpath);	//localpath in UTF-8
 
-	virtual bool			IsPathPrefixLocal(const TCHAR * localpath, const TCHAR * prefix, const TCHAR ** postfix) const;
-	virtual bool			IsPathPrefixExternal(const char * localpath, const char * prefix, const char ** postfix) const;
-
 	int						ExpandPaths();
 	TCHAR*					ExpandPath(const TCHAR * path);
 
+	struct RevisionStamp {
+		const FTPCache*		cache;
+		int					revision;
+	};
+	typedef std::vector<RevisionStamp> vRevisionStamp;
+
+	int						GetRevisions(vRevisionStamp & stamps) const;	//this cache followed by its parents
+	int						UpdateIndex() const;
+	int						CollectPathMaps(std::vector<const PathMap*> & maps) const;
+
 	vPathMap				m_vCachePaths;
 	FTPCache*				m_cacheParent;
 
+	int						m_revision;			//incremented on every change of the path maps
+	mutable vRevisionStamp	m_indexRevisions;	//revisions of this cache and its parents the index was built for
+	mutable std::vector<const PathMap*>	m_vIndexMaps;	//own path maps followed by the ones of the parent
+	mutable PathTrie<TCHAR>	m_localIndex;
+	mutable PathTrie<char>	m_externalIndex;
+
 	TCHAR*					m_activeHost;
 	TCHAR*					m_activeUser;
 };
 
+template <class T>
+void PathTrie<T>::Clear() {
+	Node root = {0, -1, -1, -1};
+	m_nodes.clear();
+	m_nodes.push_back(root);
+}
+
+template <class T>
+void PathTrie<T>::Insert(const T * prefix, int value) {
+	int node = 0;
+
+	for(; *prefix != 0; prefix++) {
+		T c = Fold(*prefix);
+		int child = m_nodes[node].child;
+		while(child != -1 && m_nodes[child].c != c)
+			child = m_nodes[child].sibling;
+
+		if (child == -1) {
+			Node newNode = {c, -1, m_nodes[node].child, -1};
+			child = (int)m_nodes.size();
+			m_nodes.push_back(newNode);
+			m_nodes[node].child = child;
+		}
+		node = child;
+	}
+
+	if (m_nodes[node].value == -1 || value < m_nodes[node].value)
+		m_nodes[node].value = value;
+}
+
+template <class T>
+int PathTrie<T>::Match(const T * path, const T ** postfix) const {
+	int node = 0;
+	int best = m_nodes[0].value;
+	int bestLen = 0;
+
+	for(int i = 0; path[i] != 0; i++) {
+		T c = Fold(path[i]);
+		int child = m_nodes[node].child;
+		while(child != -1 && m_nodes[child].c != c)
+			child = m_nodes[child].sibling;
+
+		if (child == -1)
+			break;
+		node = child;
+
+		int value = m_nodes[node].value;
+		if (value == -1 || (best != -1 && value > best))
+			continue;
+
+		//local paths only match complete path components
+		if (m_local && path[i] != '\\' && path[i+1] != '\\' && path[i+1] != 0)
+			continue;
+
+		best = value;
+		bestLen = i+1;
+	}
+
+	if (best != -1)
+		*postfix = path+bestLen;
+	return best;
+}
+
 #endif //FTPCACHE_H
@@ -19,14 +19,22 @@
 #include "StdInc.h"
 #include "FTPClientWrapper.h"
 
+#include "OperationMetrics.h"
+
 FTPClientWrapper::FTPClientWrapper(Client_Type type, const char * host, int port, const char * user, const char * password) :
 	m_type(type),
 	m_connected(false),
 	m_aborting(false),
+	m_wasAborted(false),
 	m_busy(false),
+	m_pipelining(false),
+	m_transferSize(-1),
+	m_listComplete(true),
 	m_timeout(30),
 	m_progmon(NULL),
-	m_certificates(NULL)
+	m_certificates(NULL),
+	m_syncState(NULL),
+	m_verifyHash(Hash_None)
 {
 	m_hostname = SU::strdup(host);
 	m_port = port;
@@ -63,6 +71,74 @@ int FTPClientWrapper::SetCertificates(vX509 * x509Vect) {
 	return 0;
 }
 
+int FTPClientWrapper::SetPipelining(bool pipelining) {
+	m_pipelining = pipelining;
+	return 0;
+}
+
+int FTPClientWrapper::SetTransferSize(long size) {
+	m_transferSize = size;
+	return 0;
+}
+
+int FTPClientWrapper::SetSyncState(SyncState * syncState) {
+	m_syncState = syncState;
+	return 0;
+}
+
+SyncState* FTPClientWrapper::GetSyncState() {
+	return m_syncState;
+}
+
+int FTPClientWrapper::SetVerifyHash(Hash_Type hashType) {
+	m_verifyHash = hashType;
+	return 0;
+}
+
+int FTPClientWrapper::PerformBatch(BatchItem * items, int count) {
+	TraceSpan span(Span_Batch, count);
+
+	int ret = 0;
+	bool aborted = false;
+
+	for(int i = 0; i < count; i++) {
+		BatchItem & item = items[i];
+
+		aborted = aborted || m_aborting;	//each operation resets m_aborting
+		if (aborted) {
+			item.result = -1;
+			ret = -1;
+			continue;
+		}
+
+		switch(item.operation) {
+			case Batch_Delete:
+				item.result = DeleteFile(item.path);
+				break;
+			case Batch_MkDir:
+				item.result = MkDir(item.path);
+				break;
+			case Batch_RmDir:
+				item.result = RmDir(item.path);
+				break;
+			case Batch_Rename:
+				item.result = Rename(item.path, item.newPath);
+				break;
+			case Batch_Chmod:
+				item.result = Chmod(item.path, item.mode);
+				break;
+			default:
+				item.result = -1;
+				break;
+		}
+
+		if (item.result == -1)
+			ret = -1;
+	}
+
+	return OnReturn(ret);
+}
+
 int FTPClientWrapper::ReleaseDir(FTPFile* files, int /*size*/) {
 	if (!files)
 		return -1;
@@ -80,7 +156,101 @@ int FTPClientWrapper::Abort() {
 	return 0;
 }
 
+bool FTPClientWrapper::WasAborted() {
+	return m_wasAborted;
+}
+
+bool FTPClientWrapper::WasListComplete() {
+	return m_listComplete;
+}
+
+int FTPClientWrapper::EndAbort() {
+	return OnReturn(-1);
+}
+
+int FTPClientWrapper::VerifyTransfer(const char * ftpfile, TransferHash & hash) {
+	Hash_Type type = hash.GetType();
+	if (type == Hash_None || m_aborting)
+		return 0;
+
+	unsigned char localHash[HASH_MAX_SIZE];
+	unsigned char remoteHash[HASH_MAX_SIZE];
+	int size = hash.Finish(localHash);
+
+	LONGLONG start = OperationMetrics::Now();
+	int res = GetRemoteHash(ftpfile, type, remoteHash);
+	LONGLONG checkTime = OperationMetrics::Now() - start;
+
+	int result = 0;
+	if (res == -1) {
+		OutDebug("[NppFTP.FTPClientWrapper] No %s hash of %s available, transfer not verified", TransferHash::GetName(type), ftpfile);
+		result = -1;
+	} else if (memcmp(localHash, remoteHash, size)) {
+		OutErr("[NppFTP.FTPClientWrapper] %s hash of %s does not match the server", TransferHash::GetName(type), ftpfile);
+		result = 1;
+		if (m_syncState)
+			m_syncState->Remove(ftpfile);	//the signature is of the bad data
+	}
+
+	if (m_progmon)
+		m_progmon->OnVerified(hash.GetTime(), checkTime, result);
+
+	return (result == 1)?1:0;
+}
+
+int FTPClientWrapper::CompareFile(const TCHAR * localfile, const char * ftpfile) {
+	Hash_Type type = GetVerifyType();
+	if (type == Hash_None)
+		return -1;
+
+	HANDLE hFile = ::CreateFile(localfile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return -1;
+
+	TransferHash hash(type);
+	char buffer[16*1024];
+	DWORD bytesRead = 0;
+	BOOL res = TRUE;
+	while((res = ::ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL)) && bytesRead > 0)
+		hash.Update(buffer, bytesRead);
+	::CloseHandle(hFile);
+
+	if (!res)
+		return -1;
+
+	unsigned char localHash[HASH_MAX_SIZE];
+	unsigned char remoteHash[HASH_MAX_SIZE];
+	int size = hash.Finish(localHash);
+	if (GetRemoteHash(ftpfile, type, remoteHash) == -1)
+		return -1;
+
+	return memcmp(localHash, remoteHash, size)?1:0;
+}
+
+Hash_Type FTPClientWrapper::ChooseHash(unsigned int available) {
+	if (m_verifyHash == Hash_None)
+		return Hash_None;
+
+	if (available & (1 << m_verifyHash))
+		return m_verifyHash;
+
+	//Otherwise the cheapest one the server has
+	for(int i = Hash_None+1; i < Hash_TypeMax; i++) {
+		if (available & (1 << i))
+			return (Hash_Type)i;
+	}
+
+	return Hash_None;
+}
+
 int FTPClientWrapper::OnReturn(int res) {
+	m_wasAborted = m_aborting;
 	m_aborting = false;
+	m_transferSize = -1;
+	return res;
+}
+
+int FTPClientWrapper::OnQueryReturn(int res) {
+	m_wasAborted = m_aborting;
 	return res;
 }
@@ -25,6 +25,9 @@
 #include <libssh/sftp.h>
 #include "FTPFile.h"
 #include "SSLCertificates.h"
+#include "SyncState.h"
+#include "ContentMatcher.h"
+#include "TransferHash.h"
 
 enum Client_Type { Client_SSL, Client_SSH };
 
@@ -32,6 +35,21 @@ enum Security_Mode {Mode_FTP = 0, Mode_FTPES = 1, Mode_FTPS = 2, Mode_SFTP = 3,
 enum Connection_Mode {Mode_Passive = 0, Mode_Active = 1, Mode_ConnectionMax = 2};
 enum Transfer_Mode {Mode_Binary = 0, Mode_ASCII = 1, Mode_TransferMax = 2};
 enum AuthenticationMethods {Method_Password=0x01, Method_Key=0x02, Method_Interactive=0x04, Method_All=0x07};
+enum Batch_Operation {Batch_Delete = 0, Batch_MkDir = 1, Batch_RmDir = 2, Batch_Rename = 3, Batch_Chmod = 4};
+
+//Single item of a batched metadata operation
+struct BatchItem {
+	Batch_Operation			operation;
+	char*					path;
+	char*					newPath;	//Batch_Rename only
+	int						mode;		//Batch_Chmod only, permission bits (e.g. 0755)
+	int						result;		//0 on success, -1 on failure
+};
+
+typedef std::vector<BatchItem> vBatch;
+
+//Time in ms after the last reply before IsConnected checks the connection itself
+#define CONNECTION_PROBE_TIME	15000
 
 
 // =================================================================================================
@@ -54,6 +72,7 @@ public:
 	virtual DWORD       LastAction();
 
 	virtual BOOL			IsConnected();
+	virtual int				ResetLiveness();	//call before connecting
 protected:
 	virtual int				GetResponseCode(CUT_WSClient *ws,LPSTR string = NULL,int maxlen = 0);
 
@@ -73,6 +92,9 @@ protected:
 	vX509*					m_certificates;
 	
 	DWORD  m_lastAction;
+
+	volatile LONG			m_dead;			//set on send errors, missing replies and 421
+	DWORD					m_lastReply;	//tickcount of the last reply, 0 if none yet
 };
 
 // =================================================================================================
@@ -91,6 +113,11 @@ public:
 	virtual int				SetProgressMonitor(ProgressMonitor * progmon);
 	virtual int				SetTimeout(int timeout);
 	virtual int				SetCertificates(vX509 * x509Vect);
+	virtual int				SetPipelining(bool pipelining);	//true if another transfer directly follows the next one
+	virtual int				SetTransferSize(long size);		//size of the next download if already known, -1 otherwise
+	virtual int				SetSyncState(SyncState * syncState);
+	virtual SyncState*		GetSyncState();
+	virtual int				SetVerifyHash(Hash_Type hashType);	//preferred hash to verify transfers with, Hash_None to not verify
 
 	virtual int				Connect() = 0;
 	virtual int				Disconnect() = 0;
@@ -103,6 +130,9 @@ public:
 
 	virtual int				Cwd(const char * path) = 0;
 	virtual int				Pwd(char* buf, size_t size) = 0;	//Guarantee no trailing slash (unless root)
+	virtual int				GetSize(const char * path, long * size) = 0;
+							//Exact to the second, unlike an FTP listing. Asked ahead of a transfer, so an abort is left pending for it; check WasAborted
+	virtual int				GetModTime(const char * path, FILETIME * mtime) = 0;
 
 	//Modifying operations
 	virtual int				Rename(const char * from, const char * to) = 0;
@@ -115,14 +145,35 @@ public:
 	virtual int				ReceiveFile(const TCHAR * localfile, const char * ftpfile) = 0;
 	virtual int				SendFile(HANDLE hFile, const char * ftpfile) = 0;
 	virtual int				ReceiveFile(HANDLE hFile, const char * ftpfile) = 0;
+							//Receive length bytes from offset, or the rest of the file if length is 0, always binary
+	virtual int				ReceiveFileRange(const TCHAR * localfile, const char * ftpfile, long offset, long length, bool append) = 0;
+							//Stream the file through matcher without storing it, stops at the first match
+	virtual int				ScanFile(const char * ftpfile, ContentMatcher * matcher) = 0;
 	virtual int				DeleteFile(const char * path) = 0;
+	virtual int				Chmod(const char * path, int mode) = 0;
+
+	//Performs all items, the result of each item is set. Returns -1 if any item failed
+	virtual int				PerformBatch(BatchItem * items, int count);
+							//Compare by the hash the server computes: 0 if equal, 1 if different, -1 if the server cannot tell
+	virtual int				CompareFile(const TCHAR * localfile, const char * ftpfile);
 	
 	virtual DWORD LastAction() = 0;
 
 	virtual bool			IsConnected();
 	virtual int				Abort();
+	virtual bool			WasAborted();	//the last operation ended because Abort was called
+	virtual bool			WasListComplete();	//false if the last GetDir left out entries it could not represent
+	virtual int				EndAbort();	//ends an abort left pending by GetModTime when the transfer is not started, returns -1
 protected:
 	virtual int				OnReturn(int res);	//for use with time consuming operations
+	int						OnQueryReturn(int res);	//like OnReturn, but the abort stays pending for the operation that follows
+
+							//Hash for the next transfer, the server has to be able to compute it. Hash_None if transfers are not verified
+	virtual Hash_Type		GetVerifyType() = 0;
+	virtual int				GetRemoteHash(const char * ftpfile, Hash_Type type, unsigned char * digest) = 0;
+							//Compare the hash of a completed transfer with the one of the server, return 1 on a mismatch
+	virtual int				VerifyTransfer(const char * ftpfile, TransferHash & hash);
+	Hash_Type				ChooseHash(unsigned int available);	//available: bit per Hash_Type
 
 	Client_Type				m_type;
 	
@@ -134,11 +185,17 @@ protected:
 	char *					m_password;
 
 	bool					m_aborting;	//since assignment to bools is pretty much atomic, no synchronization will be used.
+	bool					m_wasAborted;
 	bool					m_busy;
+	bool					m_pipelining;
+	long					m_transferSize;	//cleared by OnReturn
+	bool					m_listComplete;
 
 	int						m_timeout;
 	ProgressMonitor*		m_progmon;
 	vX509*					m_certificates;
+	SyncState*				m_syncState;
+	Hash_Type				m_verifyHash;
 };
 
 // =================================================================================================
@@ -159,6 +216,8 @@ public:
 
 	virtual int				Cwd(const char * path);
 	virtual int				Pwd(char* buf, size_t size);
+	virtual int				GetSize(const char * path, long * size);
+	virtual int				GetModTime(const char * path, FILETIME * mtime);
 	
 	virtual int 			NoOp();	
 
@@ -173,13 +232,18 @@ public:
 	virtual int				ReceiveFile(const TCHAR * localfile, const char * ftpfile);
 	virtual int				SendFile(HANDLE hFile, const char * ftpfile);
 	virtual int				ReceiveFile(HANDLE hFile, const char * ftpfile);
+	virtual int				ReceiveFileRange(const TCHAR * localfile, const char * ftpfile, long offset, long length, bool append);
+	virtual int				ScanFile(const char * ftpfile, ContentMatcher * matcher);
 	virtual int				DeleteFile(const char * path);
+	virtual int				Chmod(const char * path, int mode);
 
 	virtual DWORD				LastAction();
 
 	virtual bool			IsConnected();
 
 	//Class specific operations
+							//Search the files below path with grep on the server, -1 if the server does not allow it
+	virtual int				ExecSearch(const char * path, const char * pattern, SearchListener * listener);
 	virtual int				SetKeyFile(const TCHAR * keyFile);
 	virtual int				SetPassphrase(const char * passphrase);
 	virtual int				SetUseAgent(bool useAgent);
@@ -199,10 +263,25 @@ protected:
 	HANDLE					OpenFile(const TCHAR* file, bool write);
 	FILETIME				ConvertFiletime(uint32_t nTime, uint32_t nNanosecs);
 
+							//Transfer without OnReturn, so a mismatch can be transferred again. The handle is closed
+	int						SendHandle(HANDLE hFile, const char * ftpfile, TransferHash & hash);
+	int						ReceiveHandle(HANDLE hFile, const char * ftpfile, TransferHash & hash);
+
+							//Run a command in the shell of the account, with no input. Its output ends with the exit status line
+	ssh_channel				ExecCommand(const std::string & command);
+							//Output of the command, 0 once it has ended, -1 on errors, abort or no output for timeout ms
+	int						ReadChannel(ssh_channel channel, char * buf, int size, DWORD timeout);
+
+	virtual int				OnReturn(int res);
+	virtual Hash_Type		GetVerifyType();
+	virtual int				GetRemoteHash(const char * ftpfile, Hash_Type type, unsigned char * digest);	//hash command run on the server
+
 	TCHAR*					m_keyFile;
 	char*					m_passphrase;
 	bool					m_useAgent;
 	unsigned int			m_acceptedMethods;
+	DWORD					m_lastSuccess;	//tickcount of the last successful operation
+	unsigned int			m_hashCommands;	//bit per Hash_Type, cleared once the command turns out to be missing
 };
 
 // =================================================================================================
@@ -219,6 +298,7 @@ public:
 	virtual int				SetProgressMonitor(ProgressMonitor * progmon);
 	virtual int				SetTimeout(int timeout);
 	virtual int				SetCertificates(vX509 * x509Vect);
+	virtual int				SetPipelining(bool pipelining);
 
 	virtual int				Connect();
 	virtual int				Disconnect();
@@ -229,6 +309,8 @@ public:
 
 	virtual int				Cwd(const char * path);
 	virtual int				Pwd(char* buf, size_t size);
+	virtual int				GetSize(const char * path, long * size);
+	virtual int				GetModTime(const char * path, FILETIME * mtime);
 
 	//Modifying operations
 	virtual int				Rename(const char * from, const char * to);
@@ -241,7 +323,12 @@ public:
 	virtual int				ReceiveFile(const TCHAR * localfile, const char * ftpfile);
 	virtual int				SendFile(HANDLE hFile, const char * ftpfile);
 	virtual int				ReceiveFile(HANDLE hFile, const char * ftpfile);
+	virtual int				ReceiveFileRange(const TCHAR * localfile, const char * ftpfile, long offset, long length, bool append);
+	virtual int				ScanFile(const char * ftpfile, ContentMatcher * matcher);
 	virtual int				DeleteFile(const char * path);
+	virtual int				Chmod(const char * path, int mode);
+
+	virtual int				PerformBatch(BatchItem * items, int count);
 
 	virtual DWORD				LastAction();
 
@@ -254,13 +341,23 @@ public:
 	virtual int				SetConnectionMode(Connection_Mode cMode);
 	virtual int				SetTransferMode(Transfer_Mode tMode);
 	virtual int				SetPortRange(int min, int max);
+	virtual int				SetDataPortPool(int size);
+	virtual int				SetUseEPRT(bool useEPRT);
 	virtual int				SetListParams(const char * params);
 
 	virtual int				Quote(const char * quote);
 protected:
+	virtual Hash_Type		GetVerifyType();
+	virtual int				GetRemoteHash(const char * ftpfile, Hash_Type type, unsigned char * digest);
+	virtual int				ReadFeatures();	//the hashes the server offers
+
 	FtpSSLWrapper			m_client;
 	CUT_FTPClient::FTPSMode	m_mode;
 	char*					m_ftpListParams;
+	unsigned int			m_hashFeatures;		//bit per Hash_Type, algorithms of the HASH command
+	unsigned int			m_xhashFeatures;	//bit per Hash_Type, XCRC, XMD5, XSHA1 and XSHA256
+	Hash_Type				m_hashSelected;		//current algorithm of the HASH command
+	bool					m_modTimeSupported;	//cleared once MDTM turns out to be missing
 
 	FILETIME				ConvertFiletime(int day, int month, int year, int hour, int minute);
 };
@@ -341,4 +438,71 @@ public:
 	virtual long			Seek(long offset, int origin);
 };
 
+//Feeds received data to a ContentMatcher, the write fails once it matched to end the transfer early
+class MatchDataSource : public CUT_DataSource {
+protected:
+	ContentMatcher*			m_matcher;
+public:
+							MatchDataSource(ContentMatcher * matcher);
+	virtual					~MatchDataSource();
+
+	// Virtual clone constructor
+	virtual CUT_DataSource *	clone();
+
+	// Opens data file type == UTM_OM_READING, UTM_OM_WRITING, UTM_OM_APPEND
+	virtual int				Open(OpenMsgType type);
+
+	// Close message
+	virtual int				Close();
+
+	// Read one line
+	virtual int				ReadLine(LPSTR buffer, size_t maxsize);
+
+	// Write one line
+	virtual int				WriteLine(LPCSTR buffer);
+
+	// Read data
+	virtual int				Read(LPSTR buffer, size_t count);
+
+	// Write data
+	virtual int				Write(LPCSTR buffer, size_t count);
+
+	// Move a current pointer to the specified location.
+	virtual long			Seek(long offset, int origin);
+};
+
+//Passes the data through to another data source and hashes it on the way, in either direction
+class HashDataSource : public CUT_DataSource {
+protected:
+	CUT_DataSource*			m_source;
+	TransferHash*			m_hash;
+public:
+							HashDataSource(CUT_DataSource * source, TransferHash * hash);
+	virtual					~HashDataSource();
+
+	// Virtual clone constructor
+	virtual CUT_DataSource *	clone();
+
+	// Opens data file type == UTM_OM_READING, UTM_OM_WRITING, UTM_OM_APPEND
+	virtual int				Open(OpenMsgType type);
+
+	// Close message
+	virtual int				Close();
+
+	// Read one line
+	virtual int				ReadLine(LPSTR buffer, size_t maxsize);
+
+	// Write one line
+	virtual int				WriteLine(LPCSTR buffer);
+
+	// Read data
+	virtual int				Read(LPSTR buffer, size_t count);
+
+	// Write data
+	virtual int				Write(LPCSTR buffer, size_t count);
+
+	// Move a current pointer to the specified location.
+	virtual long			Seek(long offset, int origin);
+};
+
 #endif //FTPCLIENTWRAPPER_H
@@ -29,10 +29,45 @@
 
 extern char * _HostsFile;
 
+//Commands of GNU coreutils and BusyBox, per Hash_Type. None for CRC32, cksum uses another polynomial
+static const char * HashCommands[Hash_TypeMax] = {NULL, NULL, "md5sum", "sha1sum", "sha256sum"};
+#define HASH_COMMANDS_ALL	((1 << Hash_MD5) | (1 << Hash_SHA1) | (1 << Hash_SHA256))
+
+//Single quoted argument for a POSIX shell
+static std::string ShellQuote(const char * argument) {
+	std::string quoted = "'";
+	for(const char * c = argument; *c != 0; c++) {
+		if (*c == '\'')
+			quoted += "'\\''";
+		else
+			quoted += *c;
+	}
+	quoted += "'";
+
+	return quoted;
+}
+
+//Echoed after each command, proves the shell ran it and tells its exit status
+#define EXEC_STATUS			"NPPFTP_STATUS:"
+//Max time a search on the server may go without output
+#define EXEC_SEARCH_TIMEOUT	(5*60*1000)
+
+//Exit status from the line echoed after a command, false for any other line
+static bool ParseExecStatus(const std::string & line, int * status) {
+	const size_t prefixLen = sizeof(EXEC_STATUS)-1;
+	if (line.compare(0, prefixLen, EXEC_STATUS) != 0)
+		return false;
+
+	*status = atoi(line.c_str()+prefixLen);
+	return true;
+}
+
 FTPClientWrapperSSH::FTPClientWrapperSSH(const char * host, int port, const char * user, const char * password) :
 	FTPClientWrapper(Client_SSH, host, port, user, password),
 	m_useAgent(false),
-	m_acceptedMethods(SSH_AUTH_METHOD_PASSWORD)
+	m_acceptedMethods(SSH_AUTH_METHOD_PASSWORD),
+	m_lastSuccess(0),
+	m_hashCommands(HASH_COMMANDS_ALL)
 {
 	m_keyFile = SU::DupString(TEXT(""));
 	m_passphrase = SU::strdup("");
@@ -48,6 +83,8 @@ FTPClientWrapper* FTPClientWrapperSSH::Clone() {
 	wrapper->SetTimeout(m_timeout);
 	wrapper->SetProgressMonitor(m_progmon);
 	wrapper->SetCertificates(m_certificates);
+	wrapper->SetSyncState(m_syncState);
+	wrapper->SetVerifyHash(m_verifyHash);
 
 	wrapper->SetKeyFile(m_keyFile);
 	wrapper->SetPassphrase(m_passphrase);
@@ -65,18 +102,24 @@ DWORD FTPClientWrapperSSH::LastAction() {
 }
 
 int FTPClientWrapperSSH::Connect() {
+	TraceSpan span(Span_Connect);
+
 	if (m_connected)
 		return 0;
 
 	int retcode = connect_ssh();
 
-	if (retcode == 0)
+	if (retcode == 0) {
 		m_connected = true;
+		m_hashCommands = HASH_COMMANDS_ALL;	//could be another server behind the same name
+	}
 
 	return OnReturn(retcode);
 }
 
 int FTPClientWrapperSSH::Disconnect() {
+	TraceSpan span(Span_Disconnect);
+
 	if (!m_connected)
 		return 0;
 
@@ -88,12 +131,16 @@ int FTPClientWrapperSSH::Disconnect() {
 }
 
 int FTPClientWrapperSSH::GetDir(const char * path, FTPFile** files) {
+	TraceSpan span(Span_GetDir);
+
 	sftp_dir dir;
 	sftp_attributes sfile;
 	FTPFile file;
 	std::vector<FTPFile> vFiles;
 	int count = 0;
 
+	m_listComplete = true;
+
 	dir = sftp_opendir(m_sftpsession, path);
 	if(!dir) {
 		OutErr("[NppFTP.SSH] Directory not opened(%s)\n", ssh_get_error(m_sshsession));
@@ -114,6 +161,13 @@ int FTPClientWrapperSSH::GetDir(const char * path, FTPFile** files) {
 		if (!strcmp(sfile->name, ".") || !strcmp(sfile->name, ".."))
 			continue;
 
+		if (strlen(path) + 1 + strlen(sfile->name) > MAX_PATH) {
+			OutErr("[NppFTP.SSH] Path too long, left out of the listing of %s: %s", path, sfile->name);
+			m_listComplete = false;
+			sftp_attributes_free(sfile);
+			continue;
+		}
+
 		strcpy(file.filePath, path);
 		if (!endslash) {
 			strcat(file.filePath, "/");
@@ -152,6 +206,7 @@ int FTPClientWrapperSSH::GetDir(const char * path, FTPFile** files) {
 	/* when file=NULL, an error has occured OR the directory listing is end of file */
 	if(!sftp_dir_eof(dir)){
 		OutErr("[NppFTP.SSH] Unexpected end of directory list: %s\n", ssh_get_error(m_sshsession));
+		m_listComplete = false;
 		if (count == 0)
 			return OnReturn(-1);
 	}
@@ -200,6 +255,32 @@ int FTPClientWrapperSSH::Pwd(char* buf, size_t size) {
 	return OnReturn(0);
 }
 
+int FTPClientWrapperSSH::GetSize(const char * path, long * size) {
+	sftp_attributes fattr = sftp_stat(m_sftpsession, path);
+	if (fattr == NULL) {
+		OutErr("[NppFTP.SSH] Unable to get size of %s (%s)\n", path, ssh_get_error(m_sshsession));
+		return OnReturn(-1);
+	}
+
+	*size = (long)fattr->size;
+	sftp_attributes_free(fattr);
+
+	return OnReturn(0);
+}
+
+int FTPClientWrapperSSH::GetModTime(const char * path, FILETIME * mtime) {
+	sftp_attributes fattr = sftp_stat(m_sftpsession, path);
+	if (fattr == NULL) {
+		OutErr("[NppFTP.SSH] Unable to get modification time of %s (%s)\n", path, ssh_get_error(m_sshsession));
+		return OnQueryReturn(-1);
+	}
+
+	*mtime = ConvertFiletime(fattr->mtime, fattr->mtime_nseconds);
+	sftp_attributes_free(fattr);
+
+	return OnQueryReturn(0);
+}
+
 int FTPClientWrapperSSH::Rename(const char * from, const char * to) {
 	int retcode = sftp_rename(m_sftpsession, from, to);
 
@@ -231,21 +312,65 @@ int FTPClientWrapperSSH::MkFile(const char * path) {
 }
 
 int FTPClientWrapperSSH::SendFile(const TCHAR * localfile, const char * ftpfile) {
-	HANDLE hFile = OpenFile(localfile, false);
-	if (hFile == INVALID_HANDLE_VALUE) {
-		return OnReturn(-1);
+	int res = -1;
+	for(int attempt = 1; attempt <= VERIFY_ATTEMPTS; attempt++) {
+		HANDLE hFile = OpenFile(localfile, false);
+		if (hFile == INVALID_HANDLE_VALUE) {
+			return OnReturn(-1);
+		}
+
+		TransferHash hash(GetVerifyType());
+		res = SendHandle(hFile, ftpfile, hash);
+		if (res == -1 || VerifyTransfer(ftpfile, hash) != 1)
+			break;
+
+		res = -1;
+		if (attempt < VERIFY_ATTEMPTS)
+			OutMsg("[NppFTP.SSH] Uploading %s again", ftpfile);
 	}
 
-	return SendFile(hFile, ftpfile);
+	return OnReturn(res);
 }
 
 int FTPClientWrapperSSH::ReceiveFile(const TCHAR * localfile, const char * ftpfile) {
-	HANDLE hFile = OpenFile(localfile, true);
-	if (hFile == INVALID_HANDLE_VALUE) {
-		return OnReturn(-1);
+	int res = -1;
+	for(int attempt = 1; attempt <= VERIFY_ATTEMPTS; attempt++) {
+		HANDLE hFile = OpenFile(localfile, true);
+		if (hFile == INVALID_HANDLE_VALUE) {
+			return OnReturn(-1);
+		}
+
+		TransferHash hash(GetVerifyType());
+		res = ReceiveHandle(hFile, ftpfile, hash);
+		if (res == -1 || VerifyTransfer(ftpfile, hash) != 1)
+			break;
+
+		res = -1;
+		if (attempt < VERIFY_ATTEMPTS)
+			OutMsg("[NppFTP.SSH] Downloading %s again", ftpfile);
 	}
 
-	return ReceiveFile(hFile, ftpfile);
+	return OnReturn(res);
+}
+
+int FTPClientWrapperSSH::SendFile(HANDLE hFile, const char * ftpfile) {
+	//The handle is closed after the transfer, so a mismatch cannot be sent again
+	TransferHash hash(GetVerifyType());
+	int res = SendHandle(hFile, ftpfile, hash);
+	if (res == 0 && VerifyTransfer(ftpfile, hash) == 1)
+		res = -1;
+
+	return OnReturn(res);
+}
+
+int FTPClientWrapperSSH::ReceiveFile(HANDLE hFile, const char * ftpfile) {
+	//The handle is closed after the transfer, so a mismatch cannot be received again
+	TransferHash hash(GetVerifyType());
+	int res = ReceiveHandle(hFile, ftpfile, hash);
+	if (res == 0 && VerifyTransfer(ftpfile, hash) == 1)
+		res = -1;
+
+	return OnReturn(res);
 }
 
 int FTPClientWrapperSSH::NoOp() {
@@ -254,7 +379,9 @@ int FTPClientWrapperSSH::NoOp() {
 	return 0;
 }
 
-int FTPClientWrapperSSH::ReceiveFile(HANDLE hFile, const char * ftpfile) {
+int FTPClientWrapperSSH::ReceiveHandle(HANDLE hFile, const char * ftpfile, TransferHash & hash) {
+	TraceSpan span(Span_ReceiveFile);
+
 	int retcode = 0;
 	int res = TRUE;
 	sftp_file sfile = NULL;
@@ -263,25 +390,40 @@ int FTPClientWrapperSSH::ReceiveFile(HANDLE hFile, const char * ftpfile) {
 	DWORD len = 0;
 	long totalReceived = 0;
 	long totalSize = -1;
+	SyncSignature signature;
+	unsigned long remoteTime = 0;
+	bool remoteTimeKnown = false;
 
 	sfile = sftp_open(m_sftpsession, ftpfile, (O_RDONLY), 0664);	//default rw-rw-r-- permission
 	if (sfile == NULL) {
 		OutErr("[NppFTP.SSH] File not opened %s (%s)\n", ftpfile, ssh_get_error(m_sshsession));
-		return OnReturn(-1);
+		CloseHandle(hFile);
+		return -1;
 	}
 
-	sftp_attributes fattr = sftp_stat(m_sftpsession, ftpfile);
-	if (fattr == NULL) {
-		totalSize = -1;
-	} else {
-		totalSize = (long)fattr->size;
-		sftp_attributes_free(fattr);
+	totalSize = m_transferSize;
+	if (m_syncState) {
+		//The modification time tells later on if the remote file is still this version
+		sftp_attributes fattr = sftp_fstat(sfile);
+		if (fattr != NULL) {
+			remoteTime = fattr->mtime;
+			remoteTimeKnown = true;
+			totalSize = (long)fattr->size;
+			sftp_attributes_free(fattr);
+		}
+	}
+	if (totalSize < 0) {
+		sftp_attributes fattr = sftp_stat(m_sftpsession, ftpfile);
+		if (fattr != NULL) {
+			totalSize = (long)fattr->size;
+			sftp_attributes_free(fattr);
+		}
 	}
 
 	if (m_aborting) {
 		CloseHandle(hFile);
 		sftp_close(sfile);
-		return OnReturn(-1);
+		return -1;
 	}
 
 	retcode = sftp_read(sfile, buf, bufsize);
@@ -290,6 +432,8 @@ int FTPClientWrapperSSH::ReceiveFile(HANDLE hFile, const char * ftpfile) {
 		if (res == FALSE)
 			break;
 
+		signature.Update(buf, len);
+		hash.Update(buf, len);
 		totalReceived += len;
 
 		if (m_progmon)
@@ -301,18 +445,231 @@ int FTPClientWrapperSSH::ReceiveFile(HANDLE hFile, const char * ftpfile) {
 	sftp_close(sfile);
 	CloseHandle(hFile);
 
-	return OnReturn((res == FALSE || retcode < 0 || m_aborting)?-1:0);
+	bool success = !(res == FALSE || retcode < 0 || m_aborting);
+	if (m_syncState) {
+		if (success && remoteTimeKnown) {
+			signature.Finish();
+			m_syncState->Set(ftpfile, signature, remoteTime);
+		} else {
+			m_syncState->Remove(ftpfile);
+		}
+	}
+
+	return success?0:-1;
 }
 
-int FTPClientWrapperSSH::SendFile(HANDLE hFile, const char * ftpfile) {
+int FTPClientWrapperSSH::ReceiveFileRange(const TCHAR * localfile, const char * ftpfile, long offset, long length, bool append) {
+	TraceSpan span(Span_ReceiveFile);
+
 	int retcode = 0;
 	int res = TRUE;
 	sftp_file sfile = NULL;
 	const int bufsize = 4096;
 	char buf[bufsize];
 	DWORD len = 0;
+	long totalReceived = 0;
+
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	if (append) {
+		if (PU::CreateLocalDirFile(localfile) != -1)
+			hFile = ::CreateFile(localfile, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, 0, NULL);
+		if (hFile != INVALID_HANDLE_VALUE)
+			::SetFilePointer(hFile, 0, NULL, FILE_END);
+	} else {
+		hFile = OpenFile(localfile, true);
+	}
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return OnReturn(-1);
+	}
+
+	sfile = sftp_open(m_sftpsession, ftpfile, (O_RDONLY), 0);
+	if (sfile == NULL) {
+		OutErr("[NppFTP.SSH] File not opened %s (%s)\n", ftpfile, ssh_get_error(m_sshsession));
+		CloseHandle(hFile);
+		return OnReturn(-1);
+	}
+
+	if (offset > 0 && sftp_seek64(sfile, (uint64_t)offset) < 0) {
+		OutErr("[NppFTP.SSH] Unable to seek in %s (%s)\n", ftpfile, ssh_get_error(m_sshsession));
+		sftp_close(sfile);
+		CloseHandle(hFile);
+		return OnReturn(-1);
+	}
+
+	while(!m_aborting) {
+		int toRead = bufsize;
+		if (length > 0) {
+			if (length - totalReceived < toRead)
+				toRead = (int)(length - totalReceived);
+			if (toRead == 0)
+				break;
+		}
+
+		retcode = sftp_read(sfile, buf, toRead);
+		if (retcode <= 0)
+			break;
+
+		res = WriteFile(hFile, buf, retcode, &len, NULL);
+		if (res == FALSE)
+			break;
+
+		totalReceived += len;
+
+		if (m_progmon)
+			m_progmon->OnDataReceived(totalReceived, (length > 0)?length:-1);
+	}
+
+	sftp_close(sfile);
+	CloseHandle(hFile);
+
+	bool success = !(res == FALSE || retcode < 0 || m_aborting);
+	return OnReturn(success?0:-1);
+}
+
+int FTPClientWrapperSSH::ScanFile(const char * ftpfile, ContentMatcher * matcher) {
+	TraceSpan span(Span_ReceiveFile);
+
+	int retcode = 0;
+	sftp_file sfile = NULL;
+	const int bufsize = 16384;
+	char buf[bufsize];
+	long totalReceived = 0;
+
+	matcher->Reset();
+
+	sfile = sftp_open(m_sftpsession, ftpfile, (O_RDONLY), 0);
+	if (sfile == NULL) {
+		OutErr("[NppFTP.SSH] File not opened %s (%s)\n", ftpfile, ssh_get_error(m_sshsession));
+		return OnReturn(-1);
+	}
+
+	//Closing the file ends the transfer, so reading simply stops at the first match
+	while(!m_aborting) {
+		retcode = sftp_read(sfile, buf, bufsize);
+		if (retcode <= 0)
+			break;
+
+		totalReceived += retcode;
+		if (m_progmon)
+			m_progmon->OnDataReceived(totalReceived, -1);
+
+		if (matcher->Feed(buf, retcode))
+			break;
+	}
+
+	sftp_close(sfile);
+
+	bool success = !(retcode < 0 || m_aborting);
+	return OnReturn(success?0:-1);
+}
+
+int FTPClientWrapperSSH::ExecSearch(const char * path, const char * pattern, SearchListener * listener) {
+	//Fixed string, names of matching files only, bytes compared as they are
+	std::string command = "LC_ALL=C grep -rlF -e ";
+	command += ShellQuote(pattern);
+	command += " -- ";
+	command += ShellQuote(path);
+
+	ssh_channel channel = ExecCommand(command);
+	if (channel == NULL)
+		return OnReturn(-1);
+
+	//One path per line, reported as soon as the line is complete.
+	//Results start with the searched path, other lines, like a message of the login shell, are ignored
+	std::string line;
+	char buf[4096];
+	size_t pathLen = strlen(path);
+	int found = 0;
+	int status = -1;
+	int len = 0;
+	while((len = ReadChannel(channel, buf, sizeof(buf), EXEC_SEARCH_TIMEOUT)) > 0) {
+		for(int i = 0; i < len; i++) {
+			if (buf[i] != '\n') {
+				line += buf[i];
+				continue;
+			}
+			if (!ParseExecStatus(line, &status) && line.size() > pathLen && !line.compare(0, pathLen, path)) {
+				listener->OnFileFound(line.c_str());
+				found++;
+			}
+			line.clear();
+		}
+	}
+
+	ssh_channel_close(channel);
+	ssh_channel_free(channel);
+
+	//0: found, 1: nothing found, 2: errors, e.g. unreadable files, which still leaves the results valid.
+	//Anything else, like a shell without grep or one that did not run the command, means the files have to be searched here
+	bool success = (len == 0) && (status == 0 || status == 1 || (status == 2 && found > 0));
+	if (!success && !m_aborting)
+		OutDebug("[NppFTP.SSH] Remote search failed with status %d", status);
+
+	return OnReturn(success?0:-1);
+}
+
+ssh_channel FTPClientWrapperSSH::ExecCommand(const std::string & command) {
+	ssh_channel channel = ssh_channel_new(m_sshsession);
+	if (channel == NULL)
+		return NULL;
+
+	if (ssh_channel_open_session(channel) != SSH_OK) {
+		OutDebug("[NppFTP.SSH] Unable to open a channel for a command (%s)", ssh_get_error(m_sshsession));
+		ssh_channel_free(channel);
+		return NULL;
+	}
+
+	//An account limited to SFTP has a shell like nologin, which ignores the command and exits with 1 as well.
+	//So the status only counts when echoed by the shell itself
+	std::string shellCommand = command;
+	shellCommand += " 2>/dev/null; echo " EXEC_STATUS "$?";
+
+	if (ssh_channel_request_exec(channel, shellCommand.c_str()) != SSH_OK) {
+		OutDebug("[NppFTP.SSH] Server does not allow executing commands (%s)", ssh_get_error(m_sshsession));
+		ssh_channel_close(channel);
+		ssh_channel_free(channel);
+		return NULL;
+	}
+
+	//No input will follow, a command reading it ends instead of waiting
+	ssh_channel_send_eof(channel);
+
+	return channel;
+}
+
+int FTPClientWrapperSSH::ReadChannel(ssh_channel channel, char * buf, int size, DWORD timeout) {
+	DWORD start = GetTickCount();
+	while(!m_aborting) {
+		int len = ssh_channel_read_timeout(channel, buf, size, 0, 500);
+		if (len != 0)
+			return (len > 0)?len:-1;
+
+		if (ssh_channel_is_eof(channel))
+			return 0;
+
+		if (GetTickCount() - start >= timeout) {	//check for abort in between
+			OutDebug("[NppFTP.SSH] Command on the server gave no output for %u seconds", (unsigned int)(timeout/1000));
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+int FTPClientWrapperSSH::SendHandle(HANDLE hFile, const char * ftpfile, TransferHash & hash) {
+	TraceSpan span(Span_SendFile);
+
+	int retcode = 0;
+	int res = TRUE;
+	sftp_file sfile = NULL;
+	const int bufsize = SYNC_BLOCK_SIZE;	//one block per write, so blocks can be skipped
+	char buf[bufsize];
+	DWORD len = 0;
 	long totalSent = 0;
+	long totalWritten = 0;
 	long totalSize = -1;
+	int block = 0;
+	long remotePos = 0;
 
 	DWORD highsize;
 	DWORD lowsize = ::GetFileSize(hFile, &highsize);
@@ -320,25 +677,54 @@ int FTPClientWrapperSSH::SendFile(HANDLE hFile, const char * ftpfile) {
 	//totalSize |= lowsize;
 	totalSize = lowsize;
 
-	sfile = sftp_open(m_sftpsession, ftpfile, (O_WRONLY|O_CREAT|O_TRUNC), 0664);	//default rw-rw-r-- permission
+	//If the remote file is still the version last synchronized, only the changed blocks are written
+	SyncSignature base;
+	SyncSignature signature;
+	unsigned long baseTime = 0;
+	bool delta = false;
+	if (m_syncState && m_syncState->Get(ftpfile, &base, &baseTime) == 0 && base.GetBlockCount() > 1) {
+		sftp_attributes fattr = sftp_stat(m_sftpsession, ftpfile);
+		if (fattr != NULL) {
+			delta = (fattr->size == (uint64_t)base.GetSize() && fattr->mtime == baseTime);
+			sftp_attributes_free(fattr);
+		}
+	}
+
+	int flags = delta?(O_WRONLY):(O_WRONLY|O_CREAT|O_TRUNC);
+	sfile = sftp_open(m_sftpsession, ftpfile, flags, 0664);	//default rw-rw-r-- permission
 	if (sfile == NULL) {
 		CloseHandle(hFile);
-		return OnReturn(-1);
+		return -1;
 	}
 
 	if (m_aborting) {
 		CloseHandle(hFile);
 		sftp_close(sfile);
-		return OnReturn(-1);
+		return -1;
 	}
 
 	res = ReadFile(hFile, buf, bufsize, &len, NULL);
 	while(res == TRUE && len > 0 && !m_aborting) {
-		retcode = sftp_write(sfile, buf, len);
-		if (retcode <= 0)
-			break;
+		signature.Update(buf, len);
+		hash.Update(buf, len);
+		if (len < (DWORD)bufsize)
+			signature.Finish();	//last block
+
+		if (!delta || !signature.BlockEquals(base, block)) {
+			if (remotePos != totalSent) {
+				retcode = sftp_seek64(sfile, (uint64_t)totalSent);
+				if (retcode < 0)
+					break;
+			}
+			retcode = sftp_write(sfile, buf, len);
+			if (retcode <= 0)
+				break;
+			remotePos = totalSent + len;
+			totalWritten += len;
+		}
 
 		totalSent += len;
+		block++;
 
 		if (m_progmon)
 			m_progmon->OnDataSent(totalSent, totalSize);
@@ -346,10 +732,37 @@ int FTPClientWrapperSSH::SendFile(HANDLE hFile, const char * ftpfile) {
 		res = ReadFile(hFile, buf, bufsize, &len, NULL);
 	}
 
+	bool success = !(res == FALSE || retcode < 0 || m_aborting);
+
+	//The file was not truncated on open
+	if (success && delta && totalSent < base.GetSize()) {
+		sftp_attributes_struct attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.flags = SSH_FILEXFER_ATTR_SIZE;
+		attr.size = (uint64_t)totalSent;
+		if (sftp_setstat(m_sftpsession, ftpfile, &attr) < 0)
+			success = false;
+	}
+
+	if (delta && success)
+		OutDebug("[NppFTP.SSH] Delta upload of %s: %ld of %ld bytes written", ftpfile, totalWritten, totalSent);
+
+	if (m_syncState) {
+		sftp_attributes fattr = success?sftp_fstat(sfile):NULL;
+		if (fattr != NULL && fattr->size == (uint64_t)totalSent) {
+			signature.Finish();
+			m_syncState->Set(ftpfile, signature, fattr->mtime);
+		} else {
+			m_syncState->Remove(ftpfile);
+		}
+		if (fattr != NULL)
+			sftp_attributes_free(fattr);
+	}
+
 	sftp_close(sfile);
 	CloseHandle(hFile);
 
-	return OnReturn((res == FALSE || retcode < 0 || m_aborting)?-1:0);
+	return success?0:-1;
 
 }
 
@@ -359,10 +772,26 @@ int FTPClientWrapperSSH::DeleteFile(const char * path) {
 	return (retcode == 0)?0:-1;
 }
 
+int FTPClientWrapperSSH::Chmod(const char * path, int mode) {
+	int retcode = sftp_chmod(m_sftpsession, path, (mode_t)mode);
+
+	return OnReturn((retcode == 0)?0:-1);
+}
+
 bool FTPClientWrapperSSH::IsConnected() {
 	if (!m_connected)
 		return false;
 
+	//Only checks the state of the session, libssh clears it on socket errors
+	if (ssh_is_connected(m_sshsession) == 0) {
+		Disconnect();
+		return false;
+	}
+
+	//A recent successful operation is proof enough, only do a roundtrip when idle
+	if (m_lastSuccess != 0 && (GetTickCount() - m_lastSuccess) < CONNECTION_PROBE_TIME)
+		return true;
+
 	char * sftppath = sftp_canonicalize_path(m_sftpsession, ".");
 	if (!sftppath) {
 		//the connection is probably not available.
@@ -371,10 +800,103 @@ bool FTPClientWrapperSSH::IsConnected() {
 		return false;
 	}
 	free(sftppath);
+	m_lastSuccess = GetTickCount();
 
 	return true;
 }
 
+int FTPClientWrapperSSH::OnReturn(int res) {
+	res = FTPClientWrapper::OnReturn(res);
+	if (res != -1 && m_connected)
+		m_lastSuccess = GetTickCount();
+
+	return res;
+}
+
+Hash_Type FTPClientWrapperSSH::GetVerifyType() {
+	return ChooseHash(m_hashCommands);
+}
+
+int FTPClientWrapperSSH::GetRemoteHash(const char * ftpfile, Hash_Type type, unsigned char * digest) {
+	//libssh has no call for the check-file extension of SFTP, so the shell is used
+	if (HashCommands[type] == NULL)
+		return -1;
+
+	std::string command = HashCommands[type];
+	command += " -- ";
+	command += ShellQuote(ftpfile);
+
+	//Every transfer would try again, so a server that cannot run the command is not asked anymore
+	ssh_channel channel = ExecCommand(command);
+	if (channel == NULL) {
+		m_hashCommands = 0;
+		return -1;
+	}
+
+	//"<hash>  <file>", a hash preceded by a backslash if the name had to be escaped, then the status line
+	std::string output;
+	char buf[512];
+	int len = 0;
+	while((len = ReadChannel(channel, buf, sizeof(buf), (DWORD)m_timeout*1000)) > 0) {
+		if (output.size() < 8*sizeof(buf))
+			output.append(buf, len);
+	}
+
+	ssh_channel_close(channel);
+	ssh_channel_free(channel);
+
+	if (len < 0) {
+		if (!m_aborting) {
+			OutDebug("[NppFTP.SSH] No hash of %s received, transfers are no longer verified", ftpfile);
+			m_hashCommands = 0;
+		}
+		return -1;
+	}
+
+	std::string hashLine;
+	int status = -1;
+	bool hasStatus = false;
+	size_t start = 0;
+	while(start < output.size()) {
+		size_t end = output.find('\n', start);
+		if (end == std::string::npos)
+			end = output.size();
+		std::string line = output.substr(start, end-start);
+		if (ParseExecStatus(line, &status))
+			hasStatus = true;
+		else if (hashLine.empty())
+			hashLine = line;
+		start = end+1;
+	}
+
+	if (!hasStatus) {
+		OutDebug("[NppFTP.SSH] Server does not run commands, transfers are not verified");
+		m_hashCommands = 0;
+		return -1;
+	}
+
+	if (status != 0) {
+		//127: not found by the shell. Other errors, like an unreadable file, only concern this file
+		if (status == 127) {
+			OutDebug("[NppFTP.SSH] Server has no %s", HashCommands[type]);
+			m_hashCommands &= ~(1 << type);
+		}
+		return -1;
+	}
+
+	if (!hashLine.empty() && hashLine[0] == '\\')
+		hashLine.erase(0, 1);
+	hashLine = hashLine.substr(0, hashLine.find_first_of(" \t\r"));
+
+	if (TransferHash::ParseDigest(hashLine.c_str(), type, digest) == -1) {
+		OutDebug("[NppFTP.SSH] %s did not output a hash, transfers are not verified", HashCommands[type]);
+		m_hashCommands = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
 int FTPClientWrapperSSH::SetKeyFile(const TCHAR * keyFile) {
 	SU::FreeTChar(m_keyFile);
 	m_keyFile = SU::DupString(keyFile);
@@ -22,10 +22,27 @@
 #include "SSLCertificates.h"
 #include "MessageDialog.h"
 
+//Commands that return a single hash of a whole file, per Hash_Type
+static const char * XHashCommands[Hash_TypeMax] = {NULL, "XCRC", "XMD5", "XSHA1", "XSHA256"};
+
+//Items that cannot be turned into commands fail without being sent
+static bool IsSendableBatchItem(const BatchItem & item) {
+	if (!item.path)
+		return false;
+	if (item.operation == Batch_Rename)
+		return item.newPath != NULL;
+
+	return item.operation >= Batch_Delete && item.operation <= Batch_Chmod;
+}
+
 FTPClientWrapperSSL::FTPClientWrapperSSL(const char * host, int port, const char * user, const char * password) :
 	FTPClientWrapper(Client_SSL, host, port, user, password),
 	m_mode(CUT_FTPClient::FTP),
-	m_ftpListParams(NULL)
+	m_ftpListParams(NULL),
+	m_hashFeatures(0),
+	m_xhashFeatures(0),
+	m_hashSelected(Hash_None),
+	m_modTimeSupported(true)
 {
 	m_client.setsMode(m_mode);
 }
@@ -46,10 +63,18 @@ FTPClientWrapper* FTPClientWrapperSSL::Clone() {
 	wrapper->SetTimeout(m_timeout);
 	wrapper->SetProgressMonitor(m_progmon);
 	wrapper->SetCertificates(m_certificates);
+	wrapper->SetSyncState(m_syncState);
+	wrapper->SetVerifyHash(m_verifyHash);
 
 	wrapper->m_client.SetFireWallMode(m_client.GetFireWallMode());
 	wrapper->m_client.SetTransferType(m_client.GetTransferType());
 
+	int min = 0, max = 0;
+	m_client.GetDataPortRange(&min, &max);
+	wrapper->m_client.SetDataPortRange(min, max);
+	wrapper->m_client.SetDataPortPoolSize(m_client.GetDataPortPoolSize());
+	wrapper->m_client.SetUseEPRT(m_client.GetUseEPRT());
+
 	return wrapper;
 }
 
@@ -74,23 +99,46 @@ int FTPClientWrapperSSL::SetTimeout(int timeout) {
 	return ret;
 }
 
+int FTPClientWrapperSSL::SetPipelining(bool pipelining) {
+	int ret = FTPClientWrapper::SetPipelining(pipelining);
+	//Only has effect in passive mode, active mode listeners are pooled already.
+	//A verified transfer waits for the server to hash the file, a PASV sent ahead could time out meanwhile
+	bool verifying = (ChooseHash(m_hashFeatures | m_xhashFeatures) != Hash_None);
+	m_client.SetPipelinePASV((pipelining && !verifying)?TRUE:FALSE);
+
+	return ret;
+}
+
 DWORD FTPClientWrapperSSL::LastAction() {
 	return m_client.LastAction();
 }
 
 int FTPClientWrapperSSL::Connect() {
+	TraceSpan span(Span_Connect);
+
 	if (m_connected)
 		return OnReturn(0);
 
 	m_client.SetControlPort(m_port);
+	m_client.ResetLiveness();
 	int retcode = m_client.FTPConnect(m_hostname, m_username, m_password, "");
-	if (retcode == UTE_SUCCESS)
+	if (retcode == UTE_SUCCESS) {
 		m_connected = true;
+		m_modTimeSupported = true;	//could be another server behind the same name
+		ReadFeatures();
+		SetPipelining(m_pipelining);	//the queue sets it before connecting, when it was not known yet whether transfers are verified
+	}
+
+	long handshakes = 0, resumed = 0;
+	CUT_WSClient::SSLGetHandshakeStats(&handshakes, &resumed);
+	if (handshakes > 0)
+		OutDebug("[NppFTP.SSL] TLS sessions resumed: %ld of %ld handshakes", resumed, handshakes);
 
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
 int FTPClientWrapperSSL::Disconnect() {
+	TraceSpan span(Span_Disconnect);
 
 	OutDebug("[NppFTP.SSL] now disconnecting.");
 
@@ -112,10 +160,13 @@ int FTPClientWrapperSSL::Disconnect() {
 }
 
 int FTPClientWrapperSSL::GetDir(const char * path, FTPFile** files) {
+	TraceSpan span(Span_GetDir);
 	int retcode = 0;
 	CUT_DIRINFO di;
 	FTPFile * ftpfiles;
 
+	m_listComplete = true;
+
 	//store original directory
 	//commented out: Cwd is not used in NppFTP at the moment
 	//char curpath[MAX_PATH];
@@ -162,17 +213,24 @@ int FTPClientWrapperSSL::GetDir(const char * path, FTPFile** files) {
 
 		ftpfile.filePath[0] = 0;
 
-		char * utf8name = SU::TCharToUtf8(di.fileName);
 		char nameCpy[MAX_PATH+1];	//buffer used to handle symlinks
-
-		strcpy(nameCpy, utf8name);
-		SU::FreeChar(utf8name);
+		if (SU::TCharToUtf8(di.fileName, nameCpy, MAX_PATH+1) == -1) {
+			OutErr("[NppFTP.SSL] Name too long, left out of the listing of %s: %T", path, di.fileName);
+			m_listComplete = false;
+			continue;
+		}
 
 		char * linkLocation = strstr(nameCpy, " -> ");
 		if (linkLocation != NULL) {
 			*linkLocation = 0;
 		}
 
+		if (strlen(path) + 1 + strlen(nameCpy) > MAX_PATH) {
+			OutErr("[NppFTP.SSL] Path too long, left out of the listing of %s: %s", path, nameCpy);
+			m_listComplete = false;
+			continue;
+		}
+
 		strcpy(ftpfile.filePath, path);
 		if (!endslash) {
 			strcat(ftpfile.filePath, "/");
@@ -198,7 +256,7 @@ int FTPClientWrapperSSL::GetDir(const char * path, FTPFile** files) {
 		}
 */
 
-		strcpy(ftpfile.mod, SU::TCharToUtf8(di.mod));
+		SU::TCharToUtf8(di.mod, ftpfile.mod, sizeof(ftpfile.mod));
 
 		ftpfile.fileSize = (long)di.fileSize;
 
@@ -250,6 +308,31 @@ int FTPClientWrapperSSL::Pwd(char* buf, size_t size) {
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
+int FTPClientWrapperSSL::GetSize(const char * path, long * size) {
+	//SIZE is only exact in binary mode
+	SetTransferMode(Mode_Binary);
+
+	int retcode = m_client.GetSize(path, size);
+
+	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
+}
+
+int FTPClientWrapperSSL::GetModTime(const char * path, FILETIME * mtime) {
+	if (!m_modTimeSupported)
+		return OnQueryReturn(-1);	//save the roundtrip
+
+	SYSTEMTIME st;
+	int retcode = m_client.GetModTime(path, &st);
+	if (retcode == UTE_SVR_NOT_SUPPORTED) {
+		OutMsg("[NppFTP.SSL] The server does not support MDTM, downloads will not be matched to local copies");
+		m_modTimeSupported = false;
+	}
+	if (retcode == UTE_SUCCESS && !SystemTimeToFileTime(&st, mtime))
+		retcode = UTE_ERROR;
+
+	return OnQueryReturn((retcode == UTE_SUCCESS)?0:-1);
+}
+
 int FTPClientWrapperSSL::Rename(const char * from, const char * to) {
 	int retcode = m_client.RenameFile(from, to);
 
@@ -277,6 +360,7 @@ int FTPClientWrapperSSL::MkFile(const char * path) {
 }
 
 int FTPClientWrapperSSL::SendFile(const TCHAR * localfile, const char * ftpfile) {
+	TraceSpan span(Span_SendFile);
 
 	m_client.SetCurrentTotal(-1);
 	HANDLE hFile = ::CreateFile(localfile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
@@ -287,48 +371,127 @@ int FTPClientWrapperSSL::SendFile(const TCHAR * localfile, const char * ftpfile)
 		CloseHandle(hFile);
 	}
 
-	int retcode = m_client.SendFile(localfile, ftpfile);
+	int retcode = UTE_ERROR;
+	for(int attempt = 1; attempt <= VERIFY_ATTEMPTS; attempt++) {
+		TransferHash hash(GetVerifyType());
+		CUT_FileDataSource fds(localfile);
+		HashDataSource ds(&fds, &hash);
+		retcode = m_client.SendFile(ds, ftpfile);
+		if (retcode != UTE_SUCCESS || VerifyTransfer(ftpfile, hash) != 1)
+			break;
+
+		retcode = UTE_ERROR;
+		if (attempt < VERIFY_ATTEMPTS)
+			OutMsg("[NppFTP.SSL] Uploading %s again", ftpfile);
+	}
 
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
 int FTPClientWrapperSSL::ReceiveFile(const TCHAR * localfile, const char * ftpfile) {
+	TraceSpan span(Span_ReceiveFile);
+
 	int res = PU::CreateLocalDirFile(localfile);
 	if (res == -1)
-		return -1;
+		return OnReturn(-1);
 
-	long size = 0;
-	m_client.SetCurrentTotal(-1);
-	int sizeres = m_client.GetSize(ftpfile, &size);
-	if (sizeres == UTE_SUCCESS)
-		m_client.SetCurrentTotal(size);
+	//The size is only used for progress, skip the SIZE command if the listing already told
+	long size = m_transferSize;
+	m_client.SetCurrentTotal(size);
+	if (size < 0) {
+		int sizeres = m_client.GetSize(ftpfile, &size);
+		if (sizeres == UTE_SUCCESS)
+			m_client.SetCurrentTotal(size);
+	}
 
-	int retcode = m_client.ReceiveFile(ftpfile, localfile);
+	int retcode = UTE_ERROR;
+	for(int attempt = 1; attempt <= VERIFY_ATTEMPTS; attempt++) {
+		TransferHash hash(GetVerifyType());
+		CUT_FileDataSource fds(localfile);
+		HashDataSource ds(&fds, &hash);
+		retcode = m_client.ReceiveFile(ds, ftpfile);
+		if (retcode != UTE_SUCCESS || VerifyTransfer(ftpfile, hash) != 1)
+			break;
+
+		retcode = UTE_ERROR;
+		if (attempt < VERIFY_ATTEMPTS)
+			OutMsg("[NppFTP.SSL] Downloading %s again", ftpfile);
+	}
 
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
 int FTPClientWrapperSSL::SendFile(HANDLE hFile, const char * ftpfile) {
+	TraceSpan span(Span_SendFile);
 
 	m_client.SetCurrentTotal(-1);
 	DWORD lowsize = ::GetFileSize(hFile, NULL);
 	m_client.SetCurrentTotal((long)lowsize);
 
+	//The data source closes the handle, so a mismatch cannot be sent again
+	TransferHash hash(GetVerifyType());
 	HandleDataSource hds(hFile, true, false);
-	int retcode = m_client.SendFile(hds, ftpfile);
+	HashDataSource ds(&hds, &hash);
+	int retcode = m_client.SendFile(ds, ftpfile);
+	if (retcode == UTE_SUCCESS && VerifyTransfer(ftpfile, hash) == 1)
+		retcode = UTE_ERROR;
 
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
 int FTPClientWrapperSSL::ReceiveFile(HANDLE hFile, const char * ftpfile) {
-	long size = 0;
-	m_client.SetCurrentTotal(-1);
-	int sizeres = m_client.GetSize(ftpfile, &size);
-	if (sizeres == UTE_SUCCESS)
-		m_client.SetCurrentTotal(size);
+	TraceSpan span(Span_ReceiveFile);
+
+	//The size is only used for progress, skip the SIZE command if the listing already told
+	long size = m_transferSize;
+	m_client.SetCurrentTotal(size);
+	if (size < 0) {
+		int sizeres = m_client.GetSize(ftpfile, &size);
+		if (sizeres == UTE_SUCCESS)
+			m_client.SetCurrentTotal(size);
+	}
 
+	//The data source closes the handle, so a mismatch cannot be received again
+	TransferHash hash(GetVerifyType());
 	HandleDataSource hds(hFile, false, true);
-	int retcode = m_client.ReceiveFile(hds, ftpfile);
+	HashDataSource ds(&hds, &hash);
+	int retcode = m_client.ReceiveFile(ds, ftpfile);
+	if (retcode == UTE_SUCCESS && VerifyTransfer(ftpfile, hash) == 1)
+		retcode = UTE_ERROR;
+
+	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
+}
+
+int FTPClientWrapperSSL::ReceiveFileRange(const TCHAR * localfile, const char * ftpfile, long offset, long length, bool append) {
+	TraceSpan span(Span_ReceiveFile);
+
+	int res = PU::CreateLocalDirFile(localfile);
+	if (res == -1)
+		return OnReturn(-1);
+
+	//REST offsets are only meaningful for binary transfers
+	SetTransferMode(Mode_Binary);
+	m_client.SetCurrentTotal((length > 0)?length:-1);
+
+	CUT_FileDataSource ds(localfile);
+	int retcode = m_client.ReceiveFileRange(ds, ftpfile, offset, length, append?UTM_OM_APPEND:UTM_OM_WRITING);
+
+	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
+}
+
+int FTPClientWrapperSSL::ScanFile(const char * ftpfile, ContentMatcher * matcher) {
+	TraceSpan span(Span_ReceiveFile);
+
+	SetTransferMode(Mode_Binary);
+	m_client.SetCurrentTotal(-1);
+
+	matcher->Reset();
+	MatchDataSource ds(matcher);
+	int retcode = m_client.ReceiveFile(ds, ftpfile);
+
+	//A match cuts the transfer short on purpose
+	if (matcher->Found())
+		return OnReturn(0);
 
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
@@ -339,6 +502,97 @@ int	 FTPClientWrapperSSL::DeleteFile(const char * path) {
 	return OnReturn((retcode == UTE_SUCCESS)?0:-1);
 }
 
+int FTPClientWrapperSSL::Chmod(const char * path, int mode) {
+	BatchItem item;
+	item.operation = Batch_Chmod;
+	item.path = (char*)path;
+	item.newPath = NULL;
+	item.mode = mode;
+	item.result = -1;
+
+	return PerformBatch(&item, 1);
+}
+
+int FTPClientWrapperSSL::PerformBatch(BatchItem * items, int count) {
+	TraceSpan span(Span_Batch, count);
+
+	if (count < 1)
+		return OnReturn(0);
+
+	//A rename takes two commands, RNFR and RNTO
+	char ** commands = new char*[count*2];
+	int * codes = new int[count*2];
+	int nrCommands = 0;
+	int ret = 0;
+
+	for(int i = 0; i < count; i++) {
+		const BatchItem & item = items[i];
+		if (!IsSendableBatchItem(item))
+			continue;
+
+		int len = strlen(item.path) + 32;
+		char * command = new char[len];
+
+		switch(item.operation) {
+			case Batch_Delete:
+				sprintf(command, "DELE %s\r\n", item.path);
+				break;
+			case Batch_MkDir:
+				sprintf(command, "MKD %s\r\n", item.path);
+				break;
+			case Batch_RmDir:
+				sprintf(command, "RMD %s\r\n", item.path);
+				break;
+			case Batch_Chmod:
+				sprintf(command, "SITE CHMOD %o %s\r\n", item.mode & 07777, item.path);
+				break;
+			case Batch_Rename: {
+				sprintf(command, "RNFR %s\r\n", item.path);
+				commands[nrCommands] = command;
+				nrCommands++;
+				command = new char[strlen(item.newPath) + 32];
+				sprintf(command, "RNTO %s\r\n", item.newPath);
+				break; }
+		}
+
+		commands[nrCommands] = command;
+		nrCommands++;
+	}
+
+	m_client.PipelineCommands((LPCSTR*)commands, nrCommands, codes);
+
+	//Match the replies to the items, in the same order the commands were built
+	int c = 0;
+	for(int i = 0; i < count; i++) {
+		BatchItem & item = items[i];
+		if (!IsSendableBatchItem(item)) {
+			item.result = -1;
+			ret = -1;
+			continue;
+		}
+
+		int code = codes[c];
+
+		if (item.operation == Batch_Rename) {
+			c++;
+			item.result = (code >= 300 && code <= 399 && codes[c] >= 200 && codes[c] <= 299)?0:-1;
+		} else {
+			item.result = (code >= 200 && code <= 299)?0:-1;
+		}
+		c++;
+
+		if (item.result == -1)
+			ret = -1;
+	}
+
+	for(int i = 0; i < nrCommands; i++)
+		delete [] commands[i];
+	delete [] commands;
+	delete [] codes;
+
+	return OnReturn(ret);
+}
+
 bool FTPClientWrapperSSL::IsConnected() {
 	if (!m_connected)
 		return false;
@@ -419,6 +673,18 @@ int FTPClientWrapperSSL::SetPortRange(int min, int max) {
 	return 0;
 }
 
+int FTPClientWrapperSSL::SetDataPortPool(int size) {
+	int retcode = m_client.SetDataPortPoolSize(size);
+
+	return (retcode == UTE_SUCCESS)?0:-1;
+}
+
+int FTPClientWrapperSSL::SetUseEPRT(bool useEPRT) {
+	m_client.SetUseEPRT(useEPRT?TRUE:FALSE);
+
+	return 0;
+}
+
 int FTPClientWrapperSSL::SetListParams(const char * params) {
 	if (m_ftpListParams)
 		SU::free(m_ftpListParams);
@@ -432,6 +698,96 @@ int FTPClientWrapperSSL::Quote(const char * quote) {
 	return (retcode == UTE_SUCCESS)?0:-1;
 }
 
+Hash_Type FTPClientWrapperSSL::GetVerifyType() {
+	//ASCII transfers convert line endings, the data is not the file as stored on the server
+	if (m_client.GetTransferType() != 1)
+		return Hash_None;
+
+	return ChooseHash(m_hashFeatures | m_xhashFeatures);
+}
+
+int FTPClientWrapperSSL::GetRemoteHash(const char * ftpfile, Hash_Type type, unsigned char * digest) {
+	char reply[512];
+	int retcode = UTE_ERROR;
+
+	if (m_hashFeatures & (1 << type)) {
+		if (m_hashSelected != type) {
+			retcode = m_client.SetHashAlgorithm(TransferHash::GetName(type));
+			if (retcode != UTE_SUCCESS)
+				return -1;
+			m_hashSelected = type;
+		}
+		retcode = m_client.GetFileHash("HASH", ftpfile, reply, sizeof(reply));
+	} else if (m_xhashFeatures & (1 << type)) {
+		retcode = m_client.GetFileHash(XHashCommands[type], ftpfile, reply, sizeof(reply));
+	}
+
+	if (retcode != UTE_SUCCESS)
+		return -1;
+
+	return TransferHash::ParseDigest(reply, type, digest);
+}
+
+int FTPClientWrapperSSL::ReadFeatures() {
+	m_hashFeatures = 0;
+	m_xhashFeatures = 0;
+	m_hashSelected = Hash_None;
+
+	if (m_verifyHash == Hash_None)
+		return 0;	//save the roundtrip
+
+	int retcode = m_client.GetFeatures();
+	if (retcode != UTE_SUCCESS)
+		return -1;
+
+	//e.g. " HASH SHA-256;SHA-1*;MD5" and " XCRC", the asterisk marks the current algorithm
+	int count = m_client.GetMultiLineResponseLineCount();
+	for(int i = 0; i < count; i++) {
+		const char * line = m_client.GetMultiLineResponse(i);
+		if (line == NULL || line[0] != ' ')
+			continue;
+		line++;
+
+		if (!_strnicmp(line, "HASH ", 5)) {
+			std::string list = line+5;
+			size_t start = 0;
+			while(start < list.size()) {
+				size_t end = list.find(';', start);
+				if (end == std::string::npos)
+					end = list.size();
+
+				std::string name = list.substr(start, end-start);
+				bool selected = false;
+				if (!name.empty() && name[name.size()-1] == '*') {
+					selected = true;
+					name.erase(name.size()-1);
+				}
+				for(int t = Hash_None+1; t < Hash_TypeMax; t++) {
+					if (!_stricmp(name.c_str(), TransferHash::GetName((Hash_Type)t))) {
+						m_hashFeatures |= (1 << t);
+						if (selected)
+							m_hashSelected = (Hash_Type)t;
+					}
+				}
+
+				start = end+1;
+			}
+			continue;
+		}
+
+		for(int t = Hash_None+1; t < Hash_TypeMax; t++) {
+			size_t len = strlen(XHashCommands[t]);
+			if (!_strnicmp(line, XHashCommands[t], len) && (line[len] == 0 || line[len] == ' '))
+				m_xhashFeatures |= (1 << t);
+		}
+	}
+
+	if (m_hashFeatures == 0 && m_xhashFeatures == 0)
+		OutMsg("[NppFTP.SSL] The server cannot hash files, transfers will not be verified");
+
+	return 0;
+}
+
 FILETIME FTPClientWrapperSSL::ConvertFiletime(int day, int month, int year, int hour, int minute) {
 	FILETIME ft;
 	SYSTEMTIME st;
@@ -459,7 +815,10 @@ FtpSSLWrapper::FtpSSLWrapper() :
 	m_isAborted(FALSE),
 	m_progmon(NULL),
 	m_currentTotal(-1),
-	m_certificates(NULL)
+	m_certificates(NULL),
+	m_lastAction(0),
+	m_dead(FALSE),
+	m_lastReply(0)
 {
 }
 
@@ -489,11 +848,23 @@ int FtpSSLWrapper::Send(LPCSTR data, int len) {
 	}
 	OutClnt("-> %s", datacpy);
 	delete [] datacpy;
+
+	if (_TraceEnabled) {
+		//pack the command verb, e.g. 'RETR'
+		int verb = 0;
+		for(int i = 0; i < 4 && i < datalen && data[i] != ' ' && data[i] != '\r'; i++)
+			verb |= ((unsigned char)data[i]) << (8*i);
+		TraceWrite(Trace_CommandSent, verb, datalen);
+	}
 	
 	
 	m_lastAction = GetTickCount();
 
-	return CUT_WSClient::Send(data, len);
+	int rt = CUT_WSClient::Send(data, len);
+	if (rt == 0 && m_socket != INVALID_SOCKET)	//FTPConnect sends QUIT on a closed socket first
+		m_dead = TRUE;
+
+	return rt;
 }
 
 int FtpSSLWrapper::SetProgressMonitor(ProgressMonitor * progmon) {
@@ -521,9 +892,15 @@ int FtpSSLWrapper::GetResponseCode(CUT_WSClient *ws,LPSTR string,int maxlen) {
 
 	if (res == 0) {
 		//OutErr("[FTP] No response from server");
+		m_dead = TRUE;
 		return res;
 	}
 
+	if (res == 421)	//service not available, server closes the connection
+		m_dead = TRUE;
+	else
+		m_lastReply = GetTickCount();
+
 	int index = 0;
 	for(;; index++){
 		const char * pbuf = GetMultiLineResponse(index);
@@ -549,6 +926,8 @@ BOOL FtpSSLWrapper::ReceiveFileStatus(long bytesReceived) {
 	if (res == FALSE)
 		return res;
 
+	TraceEvent(Trace_BytesReceived, 0, bytesReceived);
+
 	if (m_progmon)
 		m_progmon->OnDataReceived(bytesReceived, m_currentTotal);
 
@@ -560,6 +939,8 @@ BOOL FtpSSLWrapper::SendFileStatus(long bytesSent) {
 	if (res == FALSE)
 		return res;
 
+	TraceEvent(Trace_BytesSent, 0, bytesSent);
+
 	if (m_progmon)
 		m_progmon->OnDataSent(bytesSent, m_currentTotal);
 
@@ -647,12 +1028,21 @@ int FtpSSLWrapper::OnSSLCertificate(const SSL * ssl, const X509* certificate, in
 }
 
 BOOL FtpSSLWrapper::IsConnected() {
+	if (m_dead)
+		return FALSE;
+
+	//A recent reply is proof enough, only probe the socket when idle
+	if (m_lastReply != 0 && (GetTickCount() - m_lastReply) < CONNECTION_PROBE_TIME)
+		return TRUE;
+
 	if (IsDataWaiting())
 		PeekResponseCode(this);
 
 	BOOL connected = CUT_WSClient::IsConnected();
-	if (connected == FALSE)
+	if (connected == FALSE) {
+		m_dead = TRUE;
 		return FALSE;
+	}
 
 	//also test if sending is possible
 
@@ -669,12 +1059,19 @@ BOOL FtpSSLWrapper::IsConnected() {
 	int rt1 = select(-1,NULL,&writeSet,NULL,&tv);
 
     if(rt1 == SOCKET_ERROR || rt1 == 0) {
+		m_dead = TRUE;
 		return FALSE;
     }
 
     return TRUE;
 }
 
+int FtpSSLWrapper::ResetLiveness() {
+	m_dead = FALSE;
+	m_lastReply = 0;
+	return 0;
+}
+
 
 ////////////////////////
 
@@ -827,3 +1224,121 @@ int HandleDataSource::Write(LPCSTR buffer, size_t count) {
 long HandleDataSource::Seek(long /*offset*/, int /*origin*/) {
 	return -1;
 }
+
+//////////////////////////
+
+MatchDataSource::MatchDataSource(ContentMatcher * matcher) :
+	m_matcher(matcher)
+{
+}
+
+MatchDataSource::~MatchDataSource() {
+}
+
+// Virtual clone constructor
+CUT_DataSource *MatchDataSource::clone() {
+	return new MatchDataSource(m_matcher);
+}
+
+// Opens data file type == UTM_OM_READING, UTM_OM_WRITING, UTM_OM_APPEND
+int MatchDataSource::Open(OpenMsgType type) {
+	if (type != UTM_OM_WRITING)
+		return -1;
+
+	return UTE_SUCCESS;
+}
+
+// Close message
+int MatchDataSource::Close() {
+	return 0;
+}
+
+// Read one line
+int MatchDataSource::ReadLine(LPSTR /*buffer*/, size_t /*maxsize*/) {
+	return -1;
+}
+
+// Write one line
+int MatchDataSource::WriteLine(LPCSTR /*buffer*/){
+	return -1;
+}
+
+// Read data
+int MatchDataSource::Read(LPSTR /*buffer*/, size_t /*count*/) {
+	return -1;
+}
+
+// Write data
+int MatchDataSource::Write(LPCSTR buffer, size_t count) {
+	if (m_matcher->Feed(buffer, count))
+		return -1;	//no need for the rest of the file
+
+	return count;
+}
+
+// Move a current pointer to the specified location.
+long MatchDataSource::Seek(long /*offset*/, int /*origin*/) {
+	return -1;
+}
+
+//////////////////////////
+
+HashDataSource::HashDataSource(CUT_DataSource * source, TransferHash * hash) :
+	m_source(source),
+	m_hash(hash)
+{
+}
+
+HashDataSource::~HashDataSource() {
+}
+
+// Virtual clone constructor
+CUT_DataSource *HashDataSource::clone() {
+	return new HashDataSource(m_source, m_hash);
+}
+
+// Opens data file type == UTM_OM_READING, UTM_OM_WRITING, UTM_OM_APPEND
+int HashDataSource::Open(OpenMsgType type) {
+	if (type == UTM_OM_APPEND)
+		return -1;	//the hash would miss the start of the file
+
+	return m_source->Open(type);
+}
+
+// Close message
+int HashDataSource::Close() {
+	return m_source->Close();
+}
+
+// Read one line
+int HashDataSource::ReadLine(LPSTR /*buffer*/, size_t /*maxsize*/) {
+	return -1;
+}
+
+// Write one line
+int HashDataSource::WriteLine(LPCSTR /*buffer*/){
+	return -1;
+}
+
+// Read data
+int HashDataSource::Read(LPSTR buffer, size_t count) {
+	int len = m_source->Read(buffer, count);
+	if (len > 0)
+		m_hash->Update(buffer, len);
+
+	return len;
+}
+
+// Write data
+int HashDataSource::Write(LPCSTR buffer, size_t count) {
+	int len = m_source->Write(buffer, count);
+	if (len > 0)
+		m_hash->Update(buffer, len);
+
+	return len;
+}
+
+// Move a current pointer to the specified location.
+long HashDataSource::Seek(long /*offset*/, int /*origin*/) {
+	return -1;
+}
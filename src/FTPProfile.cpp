@@ -24,6 +24,7 @@
 #include <algorithm>
 
 const char * FTPProfile::ProfilesElement = "Profiles";
+int FTPProfile::ProfileRevision = 0;
 
 FTPProfile::FTPProfile() :
 	m_name(NULL),
@@ -41,6 +42,8 @@ FTPProfile::FTPProfile() :
 	m_connectionMode(Mode_Passive),
 	m_dataPortMin(10000),
 	m_dataPortMax(32000),
+	m_dataPortPool(FTP_DATAPORT_POOL_SIZE),
+	m_useEPRT(false),
 	m_ftpListParams(NULL),
 	m_initialDir(NULL),
 	m_keyFile(NULL),
@@ -61,6 +64,8 @@ FTPProfile::FTPProfile(const TCHAR * name) :
 	m_connectionMode(Mode_Passive),
 	m_dataPortMin(10000),
 	m_dataPortMax(32000),
+	m_dataPortPool(FTP_DATAPORT_POOL_SIZE),
+	m_useEPRT(false),
 	m_useAgent(false),
 	m_acceptedMethods(Method_Password)
 {
@@ -88,6 +93,8 @@ FTPProfile::FTPProfile(const TCHAR * name, const FTPProfile* other) :
 	m_connectionMode(other->m_connectionMode),
 	m_dataPortMin(other->m_dataPortMin),
 	m_dataPortMax(other->m_dataPortMax),
+	m_dataPortPool(other->m_dataPortPool),
+	m_useEPRT(other->m_useEPRT),
 	m_useAgent(other->m_useAgent),
 	m_acceptedMethods(other->m_acceptedMethods)
 {
@@ -210,6 +217,8 @@ FTPClientWrapper* FTPProfile::CreateWrapper() {
 
 			SSLwrapper->SetConnectionMode(m_connectionMode);
 			SSLwrapper->SetPortRange(m_dataPortMin, m_dataPortMax);
+			SSLwrapper->SetDataPortPool(m_dataPortPool);
+			SSLwrapper->SetUseEPRT(m_useEPRT);
 			SSLwrapper->SetListParams(m_ftpListParams);
 			break; }
 		case Mode_SecurityMax:
@@ -244,6 +253,7 @@ int FTPProfile::SetHostname(const char * hostname) {
 	SU::free(m_hostname);
 	m_hostname = SU::strdup(hostname);
 	m_cache->SetEnvironment(m_hostname, m_username);
+	ProfileRevision++;
 	return 0;
 }
 
@@ -266,6 +276,7 @@ int FTPProfile::SetUsername(const char * username) {
 	SU::free(m_username);
 	m_username = SU::strdup(username);
 	m_cache->SetEnvironment(m_hostname, m_username);
+	ProfileRevision++;
 	return 0;
 }
 
@@ -377,6 +388,27 @@ int FTPProfile::SetDataPortRange(int min, int max) {
 	return 0;
 }
 
+int FTPProfile::GetDataPortPool() const {
+	return m_dataPortPool;
+}
+
+int FTPProfile::SetDataPortPool(int size) {
+	if (size < 0 || size > FTP_DATAPORT_POOL_SIZE)
+		return -1;
+
+	m_dataPortPool = size;
+	return 0;
+}
+
+bool FTPProfile::GetUseEPRT() const {
+	return m_useEPRT;
+}
+
+int FTPProfile::SetUseEPRT(bool useEPRT) {
+	m_useEPRT = useEPRT;
+	return 0;
+}
+
 const char * FTPProfile::GetListParams() const {
 	return m_ftpListParams;
 }
@@ -647,6 +679,11 @@ FTPProfile* FTPProfile::LoadProfile(const TiXmlElement * profileElem) {
 
 		profileElem->Attribute("dataPortMin", (int*)(&profile->m_dataPortMin));
 		profileElem->Attribute("dataPortMax", (int*)(&profile->m_dataPortMax));
+		profileElem->Attribute("dataPortPool", &profile->m_dataPortPool);
+
+		int useEPRT = 0;
+		profileElem->Attribute("useEPRT", &useEPRT);
+		profile->m_useEPRT = (useEPRT != 0);
 
 		attrstr = profileElem->Attribute("listParams");
 		if (!attrstr)
@@ -743,6 +780,8 @@ TiXmlElement* FTPProfile::SaveProfile() const {
 
 	profileElem->SetAttribute("dataPortMin", m_dataPortMin);
 	profileElem->SetAttribute("dataPortMax", m_dataPortMax);
+	profileElem->SetAttribute("dataPortPool", m_dataPortPool);
+	profileElem->SetAttribute("useEPRT", m_useEPRT?1:0);
 
 	profileElem->SetAttribute("listParams", m_ftpListParams);
 
@@ -813,6 +852,9 @@ int FTPProfile::Sanitize() {
 	if (m_dataPortMax > 65001)
 		m_dataPortMax = 65001;
 
+	if (m_dataPortPool < 0 || m_dataPortPool > FTP_DATAPORT_POOL_SIZE)
+		m_dataPortPool = FTP_DATAPORT_POOL_SIZE;
+
 	m_acceptedMethods = (AuthenticationMethods)(m_acceptedMethods & Method_All);
 
 	return 0;
@@ -867,10 +909,15 @@ tstring FTPProfile::CompactTypeVector(vString vect) const {
 
 int FTPProfile::SortVector(vProfile & pVect) {
 	std::sort(pVect.begin(), pVect.end(), &FTPProfile::CompareProfile);
+	ProfileRevision++;
 
 	return 0;
 }
 
+int FTPProfile::GetProfileRevision() {
+	return ProfileRevision;
+}
+
 bool FTPProfile::CompareProfile(const FTPProfile * prof1, const FTPProfile * prof2) {
 	int res = 0;
 	res = lstrcmpi(prof1->GetName(), prof2->GetName());
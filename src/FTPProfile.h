@@ -70,6 +70,10 @@ public:
 
 	int						GetDataPortRange(int * min, int * max) const;
 	int						SetDataPortRange(int min, int max);
+	int						GetDataPortPool() const;
+	int						SetDataPortPool(int size);		//listeners kept open for active mode, 0 to FTP_DATAPORT_POOL_SIZE
+	bool					GetUseEPRT() const;
+	int						SetUseEPRT(bool useEPRT);
 
 	const char*				GetListParams() const;
 	int						SetListParams(const char * listParams);
@@ -111,6 +115,7 @@ public:
 	static TiXmlElement*	SaveProfiles(const vProfile profiles);
 
 	static int				SortVector(vProfile & pVect);
+	static int				GetProfileRevision();	//changes whenever a profile vector is sorted or a hostname or username changes
 private:
 	static FTPProfile*		LoadProfile(const TiXmlElement * profileElem);
 	TiXmlElement*			SaveProfile() const;	//return value only valid as long as profile object exists
@@ -121,6 +126,8 @@ private:
 
 	static bool				CompareProfile(const FTPProfile * prof1, const FTPProfile * prof2);
 
+	static int				ProfileRevision;
+
 	TCHAR*					m_name;
 
 	FTPCache*				m_cache;
@@ -141,6 +148,8 @@ private:
 
 	int						m_dataPortMin;
 	int						m_dataPortMax;
+	int						m_dataPortPool;
+	bool					m_useEPRT;
 
 	char*					m_ftpListParams;
 
@@ -19,17 +19,21 @@
 #include "StdInc.h"
 #include "FTPQueue.h"
 
+#include "Thread.h"
+
 const int ConditionQueueOps = 0;
 const int ConditionQueueStop = 1;
 const int ConditionQueueAcked = 2;
 const int ConditionCount = 3;
 
-FTPQueue::FTPQueue(FTPClientWrapper* wrapper) :
+FTPQueue::FTPQueue(FTPClientWrapper* wrapper, OperationMetrics * metrics) :
 	m_wrapper(wrapper),
 	m_running(false),
 	m_stopping(false),
 	m_performing(false),
-	m_activeOp(NULL)
+	m_priority(Thread::PriorityNormal),
+	m_activeOp(NULL),
+	m_metrics(metrics)
 {
 	m_monitor = new Monitor(ConditionCount);
 	m_wrapper->SetProgressMonitor(this);
@@ -41,6 +45,11 @@ FTPQueue::~FTPQueue() {
 		OutErr("[Queue] Error: queue still running\n");
 }
 
+int FTPQueue::SetPriority(int priority) {
+	m_priority = priority;
+	return 0;
+}
+
 int FTPQueue::Initialize() {
 	if (m_running)
 		return 0;
@@ -48,7 +57,8 @@ int FTPQueue::Initialize() {
 	m_stopping = false;
 	m_running = true;
 
-	::CreateThread(NULL, 0, &ThreadProc, this, 0, NULL);
+	ThreadHandle thread = Thread::Start(&QueueThread, this, m_priority);
+	Thread::Detach(thread);
 
 	return 0;
 }
@@ -77,6 +87,8 @@ int FTPQueue::Deinitialize() {
 		//Remove any remaining messages (most notably Progress messages)
 		m_queue.front()->ClearPendingNotifications();
 		m_queue.front()->SendNotification(QueueOperation::QueueEventRemove);
+		if (m_queue.front() != m_activeOp)	//the loop ended the wait of the operation it started
+			TraceEvent(Trace_SpanEnd, Span_QueueWait, (INT_PTR)m_queue.front());
 		delete m_queue.front();
 		m_queue.pop_front();
 	}
@@ -102,11 +114,15 @@ int FTPQueue::AddQueueOp(QueueOperation * op) {
 		}
 	m_monitor->Exit();
 
+	op->OnEnqueued();
+
 	//Can safely inform queueWindow, Add is called by window thread
 	op->SendNotification(QueueOperation::QueueEventAdd);
 
 	m_monitor->Enter();
 		m_queue.push_back(op);
+		TraceEvent(Trace_QueueAdd, op->GetType(), m_queue.size());
+		TraceEvent(Trace_SpanBegin, Span_QueueWait, (INT_PTR)op);
 		if (m_queue.size() == 1)
 			m_monitor->Signal(ConditionQueueOps);
 	m_monitor->Exit();
@@ -134,6 +150,7 @@ int FTPQueue::ClearQueue() {
 		}
 		while (!m_queue.empty()) {
 			m_queue.front()->SendNotification(QueueOperation::QueueEventRemove);
+			TraceEvent(Trace_SpanEnd, Span_QueueWait, (INT_PTR)m_queue.front());
 			delete m_queue.front();
 			m_queue.pop_front();
 		}
@@ -161,6 +178,7 @@ int FTPQueue::CancelQueueOp(QueueOperation * op) {
 			//m_queue.pop_front();
 			if (queueop == op) {
 				m_queue.erase(m_queue.begin()+i);
+				TraceEvent(Trace_SpanEnd, Span_QueueWait, (INT_PTR)queueop);
 				queueop->SendNotification(QueueOperation::QueueEventRemove);
 				delete queueop;
 				break;
@@ -176,6 +194,8 @@ int FTPQueue::CancelQueueOp(QueueOperation * op) {
 
 int FTPQueue::QueueLoop() {
 	QueueOperation * op = NULL;
+	bool pipeline = false;
+	bool chained = false;
 
 	while(!m_stopping) {
 
@@ -191,12 +211,31 @@ int FTPQueue::QueueLoop() {
 			op = m_queue.front();
 			m_activeOp = op;
 			m_performing = true;
+
+			//If another transfer is waiting, the client can prepare its data connection during this one
+			pipeline = (op->UsesDataConnection() && m_queue.size() > 1 && m_queue[1]->UsesDataConnection());
 		m_monitor->Exit();
 
+		TraceEvent(Trace_SpanEnd, Span_QueueWait, (INT_PTR)op);
+		op->OnStarted();
+
 		op->SendNotification(QueueOperation::QueueEventStart);
 		op->SetRunning(true);
-		Sleep(500);
-		op->Perform();
+		if (!chained) {
+			TraceSpan span(Span_QueueDelay);
+			Sleep(500);
+		}
+		m_wrapper->SetPipelining(pipeline);
+		TraceEvent(Trace_QueueStart, op->GetType(), 0);
+		{
+			TraceSpan span(Span_Perform, op->GetType());
+			op->Perform();
+		}
+		TraceEvent(Trace_QueueEnd, op->GetType(), op->GetResult());
+		op->OnCompleted();
+		if (m_metrics)
+			m_metrics->Record(op);
+		chained = pipeline;	//the next transfer was announced to the client, start it right away
 		op->SetRunning(false);
 		op->SendNotification(QueueOperation::QueueEventEnd);
 
@@ -230,6 +269,7 @@ int FTPQueue::OnDataReceived(long received, long total) {
 	m_monitor->Exit();
 
 
+	m_activeOp->OnTransferred(received, total);
 	if (total == -1) {
 		m_activeOp->SetProgress(-1.0f);
 	} else {
@@ -249,6 +289,7 @@ int FTPQueue::OnDataSent(long sent, long total) {
 	m_monitor->Exit();
 
 
+	m_activeOp->OnTransferred(sent, total);
 	if (total == -1) {
 		m_activeOp->SetProgress(-1.0f);
 	} else {
@@ -259,11 +300,19 @@ int FTPQueue::OnDataSent(long sent, long total) {
 	return 0;
 }
 
-int FTPQueue::QueueThread(FTPQueue* queue) {
-	return queue->QueueLoop();
+int FTPQueue::OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result) {
+	m_monitor->Enter();
+		if (!m_performing || !m_activeOp) {	//not called from performing thread?
+			m_monitor->Exit();
+			return -1;
+		}
+	m_monitor->Exit();
+
+	m_activeOp->OnVerified(hashTime, checkTime, result);
+	return 0;
 }
 
-DWORD WINAPI ThreadProc(LPVOID param) {
+int FTPQueue::QueueThread(void * param) {
 	FTPQueue* queue = (FTPQueue*)param;
-	return FTPQueue::QueueThread(queue);
+	return queue->QueueLoop();
 }
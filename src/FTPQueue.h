@@ -22,6 +22,7 @@
 #include "FTPClientWrapper.h"
 #include "Monitor.h"
 #include "QueueOperation.h"
+#include "OperationMetrics.h"
 
 typedef std::deque<QueueOperation*> VQueue;
 
@@ -33,10 +34,11 @@ Some notes about threading:
 
 class FTPQueue : public ProgressMonitor {
 public:
-							FTPQueue(FTPClientWrapper* wrapper);
+							FTPQueue(FTPClientWrapper* wrapper, OperationMetrics * metrics = NULL);
 	virtual					~FTPQueue();
 
 	//Only to be called by creating thread
+	virtual int				SetPriority(int priority);	//Thread::Priority of the queue thread, before Initialize
 	virtual int				Initialize();
 	virtual int				Deinitialize();
 
@@ -49,19 +51,20 @@ public:
 
 	virtual int				OnDataReceived(long received, long total);
 	virtual int				OnDataSent(long sent, long total);
+	virtual int				OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result);
 
-	static int				QueueThread(FTPQueue* queue);
+	static int				QueueThread(void * param);
 private:
 	Monitor*				m_monitor;
 	FTPClientWrapper*		m_wrapper;
 	bool					m_running;
 	bool					m_stopping;
 	bool					m_performing;
+	int						m_priority;
 	QueueOperation*			m_activeOp;
+	OperationMetrics*		m_metrics;
 
 	VQueue					m_queue;
 };
 
-DWORD WINAPI ThreadProc(LPVOID param);
-
 #endif //FTPQUEUE_H
@@ -20,6 +20,7 @@
 #include "FTPSession.h"
 
 #include "FTPWindow.h"
+#include "Thread.h"
 
 void CALLBACK FTPSessionTimerProc(PVOID lpHandle, BOOLEAN TimerOrWaitFired) {
   FTPSession* obj = (FTPSession*) lpHandle;
@@ -33,9 +34,16 @@ FTPSession::FTPSession() :
 
 	m_mainWrapper(NULL),
 	m_transferWrapper(NULL),
+	m_followWrapper(NULL),
 
 	m_mainQueue(NULL),
 	m_transferQueue(NULL),
+	m_followQueue(NULL),
+
+	m_followPath(NULL),
+	m_followLocal(NULL),
+	m_followOffset(-1),
+	m_followInterval(FOLLOW_INTERVAL_MIN),
 
 	m_running(false),
 
@@ -106,14 +114,22 @@ int FTPSession::StartSession(FTPProfile * sessionProfile) {
 		return -1;
 	}
 
+	m_syncState.Clear();
 	m_mainWrapper->SetCertificates(m_certificates);
+	m_mainWrapper->SetSyncState(&m_syncState);
+	m_mainWrapper->SetVerifyHash(m_ftpSettings->GetVerifyHash());
 	m_transferWrapper = m_mainWrapper->Clone();
+	m_followWrapper = m_mainWrapper->Clone();	//only connects once a file is followed
 
-	m_mainQueue = new FTPQueue(m_mainWrapper);
-	m_transferQueue = new FTPQueue(m_transferWrapper);
+	m_metrics.Reset();
+	m_mainQueue = new FTPQueue(m_mainWrapper, &m_metrics);
+	m_transferQueue = new FTPQueue(m_transferWrapper, &m_metrics);
+	m_followQueue = new FTPQueue(m_followWrapper, &m_metrics);
 
 	m_mainQueue->Initialize();
 	m_transferQueue->Initialize();
+	m_followQueue->SetPriority(Thread::PriorityBelowNormal);
+	m_followQueue->Initialize();
 
 	m_rootObject = new FileObject("/", true, false);
 	m_rootObject->SetParent(m_rootObject);
@@ -150,7 +166,10 @@ int FTPSession::TerminateSession() {
 		m_timerIsInit = false;
   }
 
+	StopFollow();
 	Clear();
+	m_metrics.OutputSummary();
+
 	if (m_currentProfile) {
 		m_currentProfile->Release();
 	}
@@ -322,7 +341,7 @@ int FTPSession::GetDirectoryHierarchy(const char * inputDir) {
 	return 0;
 }
 
-int FTPSession::DownloadFileCache(const char * sourcefile) {
+int FTPSession::DownloadFileCache(const char * sourcefile, TCHAR * cachefile, int cachesize) {
 	if (!m_running)
 		return -1;
 
@@ -336,9 +355,139 @@ int FTPSession::DownloadFileCache(const char * sourcefile) {
 	if (res != 0)
 		return res;
 
+	//No need to download if the cached copy is the version listed just now. Only SFTP lists the time to the second,
+	//for FTP the download compares the exact time instead
+	FileObject * file = FindPathObject(sourcefile);
+	bool exactListing = (m_currentProfile->GetSecurityMode() == Mode_SFTP);
+	if (exactListing && file && file->IsFresh() && m_syncState.IsCacheCurrent(sourcefile, target, file->GetSize(), file->GetMTime())) {
+		if (cachefile)
+			lstrcpyn(cachefile, target, cachesize);
+		return 2;
+	}
+
 	return DownloadFile(sourcefile, target, false, 0);
 }
 
+int FTPSession::PreviewFileCache(const char * sourcefile) {
+	if (!m_running)
+		return -1;
+
+	if (sourcefile == NULL)
+		return -1;
+
+	//The offsets of the tail come from the listing, small files are downloaded as a whole
+	FileObject * file = FindPathObject(sourcefile);
+	if (!file || file->GetSize() <= 2*PREVIEW_SIZE)
+		return DownloadFileCache(sourcefile);
+
+	TCHAR cachefile[MAX_PATH];
+	cachefile[0] = 0;
+
+	int res = m_currentProfile->GetCacheLocal(sourcefile, cachefile, MAX_PATH);
+	if (res != 0)
+		return res;
+
+	//name.preview.ext, keeps the extension for the language of the file
+	const TCHAR * ext = PathFindExtension(cachefile);
+	if (lstrlen(cachefile) + 8 >= MAX_PATH)
+		return -1;
+
+	TCHAR target[MAX_PATH];
+	lstrcpyn(target, cachefile, (int)(ext - cachefile) + 1);
+	lstrcat(target, TEXT(".preview"));
+	lstrcat(target, ext);
+
+	QueueDownload * dldop = new QueueDownload(m_hNotify, sourcefile, target, Mode_Binary, 0);
+	dldop->SetSize(file->GetSize());
+	dldop->SetPreview(PREVIEW_SIZE);
+	m_transferQueue->AddQueueOp(dldop);
+
+	return 0;
+}
+
+int FTPSession::StartFollow(const char * sourcefile) {
+	if (!m_running)
+		return -1;
+
+	if (sourcefile == NULL)
+		return -1;
+
+	TCHAR target[MAX_PATH];
+	target[0] = 0;
+
+	int res = m_currentProfile->GetCacheLocal(sourcefile, target, MAX_PATH);
+	if (res != 0)
+		return res;
+
+	StopFollow();
+
+	m_followPath = SU::strdup(sourcefile);
+	m_followLocal = SU::DupString(target);
+	m_followOffset = -1;
+	m_followInterval = FOLLOW_INTERVAL_MIN;
+
+	return OnFollowTimer();
+}
+
+int FTPSession::StopFollow() {
+	::KillTimer(m_hNotify, FOLLOW_TIMER_ID);
+
+	if (m_followQueue)
+		m_followQueue->ClearQueue();
+
+	if (m_followPath) {
+		SU::free(m_followPath);
+		SU::FreeTChar(m_followLocal);
+		m_followPath = NULL;
+		m_followLocal = NULL;
+	}
+
+	return 0;
+}
+
+const char* FTPSession::GetFollowPath() {
+	return m_followPath;
+}
+
+int FTPSession::OnFollowTimer() {
+	::KillTimer(m_hNotify, FOLLOW_TIMER_ID);	//rescheduled when the poll is done
+
+	if (!m_running || !m_followPath)
+		return -1;
+
+	QueueFollow * followop = new QueueFollow(m_hNotify, m_followPath, m_followLocal, m_followOffset);
+	m_followQueue->AddQueueOp(followop);
+
+	return 0;
+}
+
+int FTPSession::OnFollowDone(QueueFollow * followop) {
+	//Stopped, or another file followed, meanwhile
+	if (!m_running || !m_followPath || strcmp(followop->GetExternalPath(), m_followPath))
+		return 0;
+
+	if (followop->GetResult() == -1) {
+		if (followop->IsInitial()) {
+			StopFollow();
+			return -1;
+		}
+	} else {
+		m_followOffset = followop->GetOffset();
+	}
+
+	if (followop->GetResult() != -1 && followop->GetReceived() > 0) {
+		m_followInterval = FOLLOW_INTERVAL_MIN;
+	} else {
+		m_followInterval *= 2;
+		if (m_followInterval > FOLLOW_INTERVAL_MAX)
+			m_followInterval = FOLLOW_INTERVAL_MAX;
+	}
+
+	::SetTimer(m_hNotify, FOLLOW_TIMER_ID, m_followInterval, NULL);
+
+	return 0;
+}
+
 int FTPSession::DownloadFile(const char * sourcefile, const TCHAR * target, bool targetIsDir, int code) {
 	if (!m_running)
 		return -1;
@@ -346,20 +495,23 @@ int FTPSession::DownloadFile(const char * sourcefile, const TCHAR * target, bool
 	if (sourcefile == NULL || target == NULL)
 		return -1;
 
-	TCHAR * sourcenamelocal = SU::Utf8ToTChar(PU::FindExternalFilename(sourcefile));
+	Utf8ToTCharStr sourcenamelocal(PU::FindExternalFilename(sourcefile));
 
 	TCHAR * targetfile;
 	if (targetIsDir) {
 		targetfile = new TCHAR[MAX_PATH];
-		PU::ConcatLocal(target, sourcenamelocal, targetfile, MAX_PATH);
+		PU::ConcatLocal(target, sourcenamelocal.c_str(), targetfile, MAX_PATH);
 	} else {
 		targetfile = (TCHAR*)target;
 	}
 
-	Transfer_Mode tMode = m_currentProfile->GetFileTransferMode(sourcenamelocal);
-	SU::FreeTChar(sourcenamelocal);
+	Transfer_Mode tMode = m_currentProfile->GetFileTransferMode(sourcenamelocal.c_str());
 
 	QueueDownload * dldop = new QueueDownload(m_hNotify, sourcefile, targetfile, tMode, code);
+	FileObject * file = FindPathObject(sourcefile);
+	if (file && file->IsFresh()) {
+		dldop->SetSize(file->GetSize());
+	}
 	m_transferQueue->AddQueueOp(dldop);
 
 	if (targetIsDir) {
@@ -376,11 +528,13 @@ int FTPSession::DownloadFileHandle(const char * sourcefile, HANDLE target) {
 	if (sourcefile == NULL || target == NULL)
 		return -1;
 
-	TCHAR * sourcenamelocal = SU::Utf8ToTChar(PU::FindExternalFilename(sourcefile));
-	Transfer_Mode tMode = m_currentProfile->GetFileTransferMode(sourcenamelocal);
-	SU::FreeTChar(sourcenamelocal);
+	Utf8ToTCharStr sourcenamelocal(PU::FindExternalFilename(sourcefile));
+	Transfer_Mode tMode = m_currentProfile->GetFileTransferMode(sourcenamelocal.c_str());
 
 	QueueDownloadHandle * dldop = new QueueDownloadHandle(m_hNotify, sourcefile, target, tMode);
+	FileObject * file = FindPathObject(sourcefile);
+	if (file && file->IsFresh())
+		dldop->SetSize(file->GetSize());
 	m_transferQueue->AddQueueOp(dldop);
 
 	return 0;
@@ -507,6 +661,54 @@ int FTPSession::Rename(const char * oldpath, const char * newpath) {
 	return 0;
 }
 
+int FTPSession::Batch(const vBatch & items) {
+	if (!m_running)
+		return -1;
+
+	if (items.empty())
+		return 0;
+
+	QueueBatch * batchop = new QueueBatch(m_hNotify, items);
+
+	m_mainQueue->AddQueueOp(batchop);
+
+	return 0;
+}
+
+int FTPSession::Search(const char * path, const char * pattern) {
+	if (!m_running)
+		return -1;
+
+	if (path == NULL || pattern == NULL || pattern[0] == 0)
+		return -1;
+
+	//A transfer, it streams the files, so it is queued and aborted as one
+	QueueSearch * searchop = new QueueSearch(m_hNotify, path, pattern);
+	m_transferQueue->AddQueueOp(searchop);
+
+	return 0;
+}
+
+int FTPSession::Sync(const char * dir) {
+	if (!m_running)
+		return -1;
+
+	if (dir == NULL)
+		return -1;
+
+	TCHAR target[MAX_PATH];
+	target[0] = 0;
+
+	int res = m_currentProfile->GetCacheLocal(dir, target, MAX_PATH);
+	if (res != 0)
+		return res;
+
+	QueueSync * syncop = new QueueSync(m_hNotify, dir, target, m_currentProfile, m_ftpSettings->GetSyncHashes());
+	m_transferQueue->AddQueueOp(syncop);
+
+	return 0;
+}
+
 FileObject* FTPSession::GetRootObject() {
 	char dir[MAX_PATH];
 	strcpy(dir, m_currentProfile->GetInitialDir());
@@ -596,6 +798,14 @@ int FTPSession::CancelOperation(QueueOperation * cancelOp) {
 	return m_transferQueue->CancelQueueOp(cancelOp);
 }
 
+OperationMetrics* FTPSession::GetMetrics() {
+	return &m_metrics;
+}
+
+int FTPSession::ExportMetrics(const TCHAR * file) {
+	return m_metrics.ExportJSON(file);
+}
+
 int FTPSession::Clear() {
 
 	OutDebug("[FTPSession.Clear] Now clearing the transfer queue.");
@@ -604,7 +814,12 @@ int FTPSession::Clear() {
 		m_mainQueue->ClearQueue();
 	if (m_transferQueue)
 		m_transferQueue->ClearQueue();
+	if (m_followQueue)
+		m_followQueue->ClearQueue();
 
+	if (m_followWrapper) {
+		m_followWrapper->Abort();
+	}
 	if (m_transferWrapper) {
 		m_transferWrapper->Abort();
 	}
@@ -612,6 +827,11 @@ int FTPSession::Clear() {
 		m_mainWrapper->Abort();
 	}
 
+	if (m_followQueue) {
+		m_followQueue->Deinitialize();
+		delete m_followQueue;
+		m_followQueue = NULL;
+	}
 	if (m_transferQueue) {
 		m_transferQueue->Deinitialize();
 		delete m_transferQueue;
@@ -623,6 +843,13 @@ int FTPSession::Clear() {
 		m_mainQueue = NULL;
 	}
 
+	//Not reported to the window, the follow connection is not part of the session state it shows
+	if (m_followWrapper) {
+		m_followWrapper->Disconnect();
+		delete m_followWrapper;
+		m_followWrapper = NULL;
+	}
+
 	QueueDisconnect * opdisc = new QueueDisconnect(m_hNotify);
 
 	if (m_transferWrapper) {
@@ -27,6 +27,14 @@
 
 class FTPWindow;
 
+//Bytes fetched of both the head and the tail of a file by PreviewFileCache
+#define PREVIEW_SIZE		(1024*1024)
+
+//Polling of a followed file, the interval doubles up to the maximum while the file does not grow
+#define FOLLOW_TIMER_ID			1
+#define FOLLOW_INTERVAL_MIN		1000
+#define FOLLOW_INTERVAL_MAX		60000
+
 class FTPSession {
 public:
 							FTPSession();
@@ -50,9 +58,19 @@ public:
 	int						GetDirectory(const char * dir);
 	int           GetDirectoryHierarchy(const char * dir);
 
-	int						DownloadFileCache(const char * sourcefile);	//return 0 on download, -1 on error, 1 when no cache match was found
+							//return 0 on download, -1 on error, 1 when no cache match was found,
+							//2 when the cached copy is up to date, cachefile then receives its path
+	int						DownloadFileCache(const char * sourcefile, TCHAR * cachefile = NULL, int cachesize = 0);
 	int						DownloadFile(const char * sourcefile, const TCHAR * target, bool targetIsDir, int code = 1);
 	int						DownloadFileHandle(const char * sourcefile, HANDLE target);
+	int						PreviewFileCache(const char * sourcefile);	//as DownloadFileCache, large files only get their head and tail
+
+							//Keep the cached copy of a growing file up to date, one file at a time
+	int						StartFollow(const char * sourcefile);
+	int						StopFollow();
+	const char*				GetFollowPath();	//NULL if no file is followed
+	int						OnFollowTimer();
+	int						OnFollowDone(QueueFollow * followop);	//schedules the next poll
 
 	int						UploadFileCache(const TCHAR * sourcefile);	//return 0 on upload, -1 on error, 1 when no cache match was found
 	int						UploadFile(const TCHAR * sourcefile, const char * target, bool targetIsDir, int code = 1);
@@ -64,6 +82,9 @@ public:
 	int						MkFile(const char * path);
 	int						DeleteFile(const char * path);
 	int						Rename(const char * oldpath, const char * newpath);
+	int						Batch(const vBatch & items);
+	int						Search(const char * path, const char * pattern);	//files below path containing pattern
+	int						Sync(const char * dir);	//two-way with the cache directory of dir, return 1 when no cache match was found
 
 	FileObject*				GetRootObject();
 	FileObject*				FindPathObject(const char * filepath);
@@ -71,6 +92,9 @@ public:
 	int						AbortOperation();
 	int						AbortTransfer();
 	int						CancelOperation(QueueOperation * cancelOp);
+
+	OperationMetrics*		GetMetrics();
+	int						ExportMetrics(const TCHAR * file);
 	
 private:
 	int						Clear();
@@ -84,9 +108,19 @@ private:
 
 	FTPClientWrapper*		m_mainWrapper;
 	FTPClientWrapper*		m_transferWrapper;
+	FTPClientWrapper*		m_followWrapper;
 
 	FTPQueue*				m_mainQueue;		//file/directory operations
 	FTPQueue*				m_transferQueue;	//file transfers
+	FTPQueue*				m_followQueue;		//polling of the followed file, low priority
+
+	char*					m_followPath;
+	TCHAR*					m_followLocal;
+	long					m_followOffset;		//-1 until the first poll
+	int						m_followInterval;	//milliseconds
+
+	OperationMetrics		m_metrics;			//operations of the current or last session
+	SyncState				m_syncState;		//last synchronized version of transferred files
 
 	bool					m_running;
 
@@ -27,8 +27,12 @@ bool	_DebugMode = false;
 FTPSettings::FTPSettings() :
 	m_clearCache(false),
 	m_clearCachePermanent(false),
+	m_cacheSizeLimit(0),
+	m_syncHashes(false),
+	m_verifyHash(Hash_None),
 	m_showOutput(false),
-	m_splitRatio(0.5)
+	m_splitRatio(0.5),
+	m_traceMode(false)
 {
 	m_globalCachePath = SU::DupString(TEXT("%CONFIGDIR%\\Cache\\%USERNAME%@%HOSTNAME%"));
 
@@ -88,6 +92,22 @@ int FTPSettings::SetDebugMode(bool debugMode) {
 	return 0;
 }
 
+bool FTPSettings::GetTraceMode() const {
+	return m_traceMode;
+}
+
+int FTPSettings::SetTraceMode(bool traceMode) {
+	m_traceMode = traceMode;
+
+	if (!m_traceMode)
+		return TraceStop();
+
+	TCHAR tracePath[MAX_PATH];
+	lstrcpy(tracePath, _ConfigPath);
+	::PathAppend(tracePath, TEXT("NppFTP.trace"));
+	return TraceStart(tracePath);
+}
+
 bool FTPSettings::GetClearCache() const {
 	return m_clearCache;
 }
@@ -106,6 +126,38 @@ int FTPSettings::SetClearCachePermanent(bool clearCachePermanent) {
 	return 0;
 }
 
+int FTPSettings::GetCacheSizeLimit() const {
+	return m_cacheSizeLimit;
+}
+
+int FTPSettings::SetCacheSizeLimit(int cacheSizeLimit) {
+	if (cacheSizeLimit < 0)
+		cacheSizeLimit = 0;
+	m_cacheSizeLimit = cacheSizeLimit;
+	return 0;
+}
+
+bool FTPSettings::GetSyncHashes() const {
+	return m_syncHashes;
+}
+
+int FTPSettings::SetSyncHashes(bool syncHashes) {
+	m_syncHashes = syncHashes;
+	return 0;
+}
+
+Hash_Type FTPSettings::GetVerifyHash() const {
+	return m_verifyHash;
+}
+
+int FTPSettings::SetVerifyHash(Hash_Type verifyHash) {
+	if (verifyHash < Hash_None || verifyHash >= Hash_TypeMax)
+		return -1;
+
+	m_verifyHash = verifyHash;
+	return 0;
+}
+
 bool FTPSettings::GetOutputShown() const {
 	return m_showOutput;
 }
@@ -196,6 +248,13 @@ int FTPSettings::LoadSettings(const TiXmlElement * settingsElem) {
 	}
 	m_debugMode = (debugModeState != 0);
 	_DebugMode = m_debugMode;
+
+	int traceModeState = 0;
+	const char * traceModeStr = settingsElem->Attribute("traceMode", &traceModeState);
+	if (!traceModeStr) {
+		traceModeState = 0;
+	}
+	SetTraceMode(traceModeState != 0);
 	
 
 	clearState = 0;
@@ -205,6 +264,27 @@ int FTPSettings::LoadSettings(const TiXmlElement * settingsElem) {
 	}
 	m_clearCachePermanent = (clearState != 0);
 
+	int cacheSizeLimit = 0;
+	const char * limitstr = settingsElem->Attribute("cacheSizeLimit", &cacheSizeLimit);
+	if (!limitstr) {
+		cacheSizeLimit = 0;
+	}
+	SetCacheSizeLimit(cacheSizeLimit);
+
+	int syncHashesState = 0;
+	const char * syncHashesStr = settingsElem->Attribute("syncHashes", &syncHashesState);
+	if (!syncHashesStr) {
+		syncHashesState = 0;
+	}
+	m_syncHashes = (syncHashesState != 0);
+
+	int verifyHash = Hash_None;
+	const char * verifyHashStr = settingsElem->Attribute("verifyHash", &verifyHash);
+	if (!verifyHashStr || verifyHash < Hash_None || verifyHash >= Hash_TypeMax) {
+		verifyHash = Hash_None;
+	}
+	SetVerifyHash((Hash_Type)verifyHash);
+
 	return 0;
 }
 
@@ -222,8 +302,12 @@ int FTPSettings::SaveSettings(TiXmlElement * settingsElem) {
 		Encryption::FreeData(challenge);
 	}
 	settingsElem->SetAttribute("debugMode", m_debugMode?1:0);
+	settingsElem->SetAttribute("traceMode", m_traceMode?1:0);
 	settingsElem->SetAttribute("clearCache", m_clearCache?1:0);
 	settingsElem->SetAttribute("clearCachePermanent", m_clearCachePermanent?1:0);
+	settingsElem->SetAttribute("cacheSizeLimit", m_cacheSizeLimit);
+	settingsElem->SetAttribute("syncHashes", m_syncHashes?1:0);
+	settingsElem->SetAttribute("verifyHash", (int)m_verifyHash);
 
 	return 0;
 }
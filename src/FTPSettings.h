@@ -20,6 +20,7 @@
 #define FTPSETTINGS_H
 
 #include "FTPCache.h"
+#include "TransferHash.h"
 
 //Container for various (global) settings
 
@@ -39,12 +40,24 @@ public:
 	bool					GetDebugMode() const;
 	int						SetDebugMode(bool debugMode);
 
+	bool					GetTraceMode() const;
+	int						SetTraceMode(bool traceMode);
+
 	bool					GetClearCache() const;
 	int						SetClearCache(bool clearCache);
 
 	bool					GetClearCachePermanent() const;
 	int						SetClearCachePermanent(bool clearCachePermanent);
 
+	int						GetCacheSizeLimit() const;	//MB, 0 for no limit
+	int						SetCacheSizeLimit(int cacheSizeLimit);
+
+	bool					GetSyncHashes() const;	//synchronization compares the content of files with a changed time
+	int						SetSyncHashes(bool syncHashes);
+
+	Hash_Type				GetVerifyHash() const;	//preferred hash to compare transfers with, Hash_None to not verify
+	int						SetVerifyHash(Hash_Type verifyHash);
+
 	bool					GetOutputShown() const;
 	int						SetOutputShown(bool showOutput);
 
@@ -58,9 +71,13 @@ private:
 	FTPCache				m_globalCache;
 	bool					m_clearCache;
 	bool					m_clearCachePermanent;
+	int						m_cacheSizeLimit;
+	bool					m_syncHashes;
+	Hash_Type				m_verifyHash;
 	bool					m_showOutput;		
 	double					m_splitRatio;
 	bool					m_debugMode;
+	bool					m_traceMode;
 };
 
 #endif //FTPSETTINGS_H
@@ -29,7 +29,8 @@ FileObject::FileObject(const char* path, bool _isDir, bool _isLink) :
 	m_parent(NULL),
 	m_needRefresh(_isDir),	//refresh only required for dirs
 	m_data(NULL),
-	m_size(-1)
+	m_size(-1),
+	m_listTime(0)
 {
 	size_t len = strlen(path)+1;
 	m_path = new char[len];
@@ -71,6 +72,7 @@ FileObject::FileObject(FTPFile * ftpfile) :
 	m_localName = SU::Utf8ToTChar(m_name);
 
 	m_size = ftpfile->fileSize;
+	m_listTime = ::GetTickCount();
 
 	m_ctime = ftpfile->ctime;
 	m_mtime = ftpfile->mtime;
@@ -195,6 +197,13 @@ long FileObject::GetSize() const {
 	return m_size;
 }
 
+bool FileObject::IsFresh() const {
+	if (m_listTime == 0 || m_isDir)
+		return false;
+
+	return (::GetTickCount() - m_listTime) < FILEOBJECT_FRESH_TIME;
+}
+
 const char* FileObject::GetMod() const {
 	return m_mod;
 }
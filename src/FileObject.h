@@ -21,6 +21,9 @@
 
 #include "FTPFile.h"
 
+//Time in ms the size and times of a listed file are trusted without asking the server
+#define FILEOBJECT_FRESH_TIME	30000
+
 class FileObject;
 
 typedef std::vector<FileObject*> FOVector;
@@ -58,6 +61,7 @@ public:
 	virtual void *			GetData() const;
 
 	virtual long			GetSize() const;
+	virtual bool			IsFresh() const;	//listed less than FILEOBJECT_FRESH_TIME ago
 
 	virtual FILETIME		GetCTime() const;
 	virtual FILETIME		GetMTime() const;
@@ -84,6 +88,7 @@ protected:
 	void*					m_data;
 
 	long					m_size;
+	DWORD					m_listTime;	//tickcount of the listing, 0 if not listed
 
 	FILETIME				m_ctime;
 	FILETIME				m_mtime;
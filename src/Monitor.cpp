@@ -19,26 +19,33 @@
 #include "StdInc.h"
 #include "Monitor.h"
 
+struct MonitorData {
+	CRITICAL_SECTION		critMonitor;
+	HANDLE*					conditions;
+};
+
 Monitor::Monitor(int nrConditions) :
 	m_nrConditions(nrConditions),
 	m_enterCount(0)
 {
-	InitializeCriticalSection(&m_critMonitor);
-	m_conditions = new HANDLE[m_nrConditions];
+	m_data = new MonitorData;
+	InitializeCriticalSection(&m_data->critMonitor);
+	m_data->conditions = new HANDLE[m_nrConditions];
 	for(int i = 0; i < m_nrConditions; i++) {
-		m_conditions[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		m_data->conditions[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
 	}
 }
 Monitor::~Monitor() {
-	DeleteCriticalSection(&m_critMonitor);
+	DeleteCriticalSection(&m_data->critMonitor);
 	for(int i = 0; i < m_nrConditions; i++) {
-		CloseHandle(m_conditions[i]);
+		CloseHandle(m_data->conditions[i]);
 	}
-	delete [] m_conditions;
+	delete [] m_data->conditions;
+	delete m_data;
 }
 
 int Monitor::Enter() {
-	EnterCriticalSection(&m_critMonitor);
+	EnterCriticalSection(&m_data->critMonitor);
 
 	m_enterCount++;
 
@@ -48,7 +55,7 @@ int Monitor::Enter() {
 int Monitor::Exit() {
 	if (m_enterCount > 0) {
 		m_enterCount--;
-		LeaveCriticalSection(&m_critMonitor);
+		LeaveCriticalSection(&m_data->critMonitor);
 	} else {
 		return -1;
 	}
@@ -57,11 +64,11 @@ int Monitor::Exit() {
 
 int Monitor::Wait(int condition) {
 	//This can cause a deadlock in rare cases. Just dont do an Enter();Signal(); combo
-	ResetEvent(m_conditions[condition]);
+	ResetEvent(m_data->conditions[condition]);
 
 	Exit();
 
-	WaitForSingleObject(m_conditions[condition], INFINITE);
+	WaitForSingleObject(m_data->conditions[condition], INFINITE);
 
 	Enter();
 
@@ -69,7 +76,7 @@ int Monitor::Wait(int condition) {
 }
 
 int Monitor::Signal(int condition) {
-	SetEvent(m_conditions[condition]);
+	SetEvent(m_data->conditions[condition]);
 
 	return 0;
 }
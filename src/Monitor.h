@@ -19,6 +19,8 @@
 #ifndef MONITOR_H
 #define MONITOR_H
 
+struct MonitorData;	//platform specific, see Monitor.cpp
+
 class Monitor {	//Should actually be: Half-assed monitor
 public:
 							Monitor(int nrConditions);
@@ -31,8 +33,7 @@ public:
 	virtual int				Signal(int condition);
 private:
 	int						m_nrConditions;
-	CRITICAL_SECTION		m_critMonitor;
-	HANDLE*					m_conditions;
+	MonitorData*			m_data;
 
 	int						m_enterCount;
 };
@@ -0,0 +1,54 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "NotifySink.h"
+
+#include "QueueOperation.h"
+
+WindowNotifySink::WindowNotifySink(HWND hNotify) :
+	m_hNotify(hNotify)
+{
+	m_winThread = ::GetWindowThreadProcessId(m_hNotify, NULL);
+}
+
+WindowNotifySink::~WindowNotifySink() {
+}
+
+int WindowNotifySink::Notify(unsigned int message, int code, void * data) {
+	if (IsSinkThread())
+		::SendMessage(m_hNotify, message, code, (LPARAM)data);
+	else
+		::PostMessage(m_hNotify, message, code, (LPARAM)data);
+
+	return 0;
+}
+
+int WindowNotifySink::ClearPending() {
+	MSG msg;
+	BOOL res = ::PeekMessage(&msg, m_hNotify, NotifyMessageMIN, NotifyMessageMAX, PM_REMOVE);
+	while(res == TRUE) {
+		res = ::PeekMessage(&msg, m_hNotify, NotifyMessageMIN, NotifyMessageMAX, PM_REMOVE);
+	}
+
+	return 0;
+}
+
+bool WindowNotifySink::IsSinkThread() {
+	return (m_winThread == ::GetCurrentThreadId());
+}
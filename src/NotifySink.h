@@ -0,0 +1,49 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NOTIFYSINK_H
+#define NOTIFYSINK_H
+
+//Receiver of the notifications of queue operations.
+//A notification on the thread of the sink is handled before Notify returns. From any other thread it is
+//queued, and the operation waits until the sink thread answers with QueueOperation::AckNotification
+class NotifySink {
+public:
+							NotifySink() {};
+	virtual					~NotifySink() {};
+
+	virtual int				Notify(unsigned int message, int code, void * data) = 0;
+	virtual int				ClearPending() = 0;		//drops queued notifications
+	virtual bool			IsSinkThread() = 0;		//called on the thread that handles the notifications
+};
+
+//Notifications as window messages, handled by the window procedure
+class WindowNotifySink : public NotifySink {
+public:
+							WindowNotifySink(HWND hNotify);
+	virtual					~WindowNotifySink();
+
+	virtual int				Notify(unsigned int message, int code, void * data);
+	virtual int				ClearPending();
+	virtual bool			IsSinkThread();
+private:
+	HWND					m_hNotify;
+	DWORD					m_winThread;
+};
+
+#endif //NOTIFYSINK_H
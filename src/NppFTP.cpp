@@ -25,6 +25,7 @@
 #include "DragDropWindow.h"
 #include "FTPSettings.h"
 #include <commctrl.h>
+#include <algorithm>
 
 HWND _MainOutputWindow = NULL;
 char * _HostsFile = NULL;
@@ -35,12 +36,15 @@ NppFTP::NppFTP() :
 	m_ftpSession(NULL),
 	m_ftpWindow(NULL),
 	m_activeSession(false),
+	m_profileIndexRevision(-1),
 	m_configStore(NULL)
 {
 	m_ftpSettings = new FTPSettings();
 }
 
 NppFTP::~NppFTP() {
+	ClearProfileIndex();
+
 	for(size_t i = 0; i < m_profiles.size(); i++) {
 		m_profiles[i]->Release();
 		//delete m_profiles[i];
@@ -97,7 +101,10 @@ int NppFTP::Start(NppData nppData, TCHAR * nppConfigStore, int id, FuncItem func
 		return -1;
 	}
 
-	res = m_ftpWindow->Init(m_ftpSession, &m_profiles, m_ftpSettings);
+	m_cacheManager.SetLimit((ULONGLONG)m_ftpSettings->GetCacheSizeLimit() * 1024 * 1024);
+	m_cacheManager.Start();
+
+	res = m_ftpWindow->Init(m_ftpSession, &m_profiles, m_ftpSettings, &m_cacheManager);
 	if (res == -1) {
 		m_ftpSession->Deinit();
 		m_ftpWindow->Destroy();
@@ -114,6 +121,10 @@ int NppFTP::Start(NppData nppData, TCHAR * nppConfigStore, int id, FuncItem func
 int NppFTP::Stop() {
 	SaveSettings();
 
+	TraceStop();
+
+	m_cacheManager.Stop();
+
 	//delete m_ftpWindow;
 	//delete m_ftpSession;
 
@@ -165,26 +176,10 @@ int NppFTP::OnSave(const TCHAR* path) {
 		return -1;
 	}
 	
-	FTPProfile * matchProfile;
-	for(size_t i = 0; i < m_profiles.size(); i++) {
-	
-		matchProfile = m_profiles.at(i);	
-
-		TCHAR* searchStr = SU::TSprintfNB(
-			TEXT("\\Cache\\%S@%S\\"), 
-			SU::Utf8ToTChar(matchProfile->GetUsername()),
-			SU::Utf8ToTChar(matchProfile->GetHostname())
-		);
-			
-		if (SU::InString(path, searchStr)) {
-			//OutMsg("[NppFTP.NppFTP] MATCH found for '%S' in file '%S'", search, path);
-			break;			
-		}
-		
-		matchProfile = 0;
-	}
-	
-	if (matchProfile == 0) {
+	m_cacheManager.Touch(path);
+
+	FTPProfile * matchProfile = FindCacheProfile(path);
+	if (matchProfile == NULL) {
 		//MessageBoxOutput(TEXT("No FTP profile could be found to upload this file to."));
 		return -1;
 	}
@@ -193,8 +188,8 @@ int NppFTP::OnSave(const TCHAR* path) {
 		//OutMsg("[NppFTP.NppFTP] Checking if file to upload is in current session.");		
 		const FTPProfile * activeProfile = m_ftpSession->GetCurrentProfile();	
 		if(
-			_tcscmp(SU::Utf8ToTChar(activeProfile->GetUsername()), 	SU::Utf8ToTChar(matchProfile->GetUsername())) == 0
-			 && _tcscmp(	SU::Utf8ToTChar(activeProfile->GetHostname()), 	SU::Utf8ToTChar(matchProfile->GetHostname())) == 0			
+			strcmp(activeProfile->GetUsername(), matchProfile->GetUsername()) == 0
+			 && strcmp(activeProfile->GetHostname(), matchProfile->GetHostname()) == 0
 		) {   
 			//OutMsg("[NppFTP.NppFTP] Saved file exists in current session. Uploading to this session");	
 			return m_ftpSession->UploadFileCache(path);		
@@ -223,6 +218,8 @@ int NppFTP::OnActivateLocalFile(const TCHAR* path) {
 	if (!path || !m_ftpWindow)
 		return -1;
 
+	m_cacheManager.Touch(path);
+
 	return m_ftpWindow->OnActivateLocalFile(path);
 }
 
@@ -298,6 +295,98 @@ int NppFTP::LoadSettings() {
 	return result;
 }
 
+//Ordinal, the same ordering MatchProfileCacheKey searches with (lstrcmp is linguistic)
+static bool CompareProfileCacheKey(const ProfileCacheKey & key1, const ProfileCacheKey & key2) {
+	int res = _tcscmp(key1.key, key2.key);
+	if (res == 0)
+		return key1.order < key2.order;
+	return (res < 0);
+}
+
+//compare the key of the index with the first len characters of key
+static int MatchProfileCacheKey(const TCHAR * indexKey, const TCHAR * key, size_t len) {
+	int res = _tcsncmp(indexKey, key, len);
+	if (res != 0)
+		return res;
+	return (indexKey[len] == 0)?0:1;
+}
+
+int NppFTP::BuildProfileIndex() {
+	ClearProfileIndex();
+
+	for(size_t i = 0; i < m_profiles.size(); i++) {
+		FTPProfile * profile = m_profiles.at(i);
+		Utf8ToTCharStr username(profile->GetUsername());
+		Utf8ToTCharStr hostname(profile->GetHostname());
+
+		ProfileCacheKey cacheKey;
+		cacheKey.key = SU::TSprintfNB(TEXT("%T@%T"), username.c_str(), hostname.c_str());
+		cacheKey.order = (int)i;
+		cacheKey.profile = profile;
+
+		if (cacheKey.key == NULL)
+			continue;
+
+		m_profileIndex.push_back(cacheKey);
+	}
+
+	std::sort(m_profileIndex.begin(), m_profileIndex.end(), &CompareProfileCacheKey);
+	m_profileIndexRevision = FTPProfile::GetProfileRevision();
+
+	return 0;
+}
+
+int NppFTP::ClearProfileIndex() {
+	for(size_t i = 0; i < m_profileIndex.size(); i++) {
+		delete [] m_profileIndex[i].key;
+	}
+	m_profileIndex.clear();
+	m_profileIndexRevision = -1;
+
+	return 0;
+}
+
+//Returns the profile whose cache directory "\Cache\user@host\" is part of path, NULL if none
+FTPProfile* NppFTP::FindCacheProfile(const TCHAR * path) {
+	const TCHAR * cacheDir = TEXT("\\Cache\\");
+	const size_t cacheDirLen = lstrlen(cacheDir);
+
+	const TCHAR * cachePos = _tcsstr(path, cacheDir);
+	if (cachePos == NULL)
+		return NULL;	//not in any cache
+
+	if (m_profileIndexRevision != FTPProfile::GetProfileRevision())
+		BuildProfileIndex();
+
+	const ProfileCacheKey * match = NULL;
+	for(; cachePos != NULL; cachePos = _tcsstr(cachePos+1, cacheDir)) {
+		const TCHAR * key = cachePos + cacheDirLen;
+
+		//the username may contain a backslash, try every directory end
+		for(const TCHAR * keyEnd = _tcschr(key, TEXT('\\')); keyEnd != NULL; keyEnd = _tcschr(keyEnd+1, TEXT('\\'))) {
+			size_t len = keyEnd - key;
+			size_t low = 0, high = m_profileIndex.size();
+			while(low < high) {
+				size_t mid = (low + high) / 2;
+				if (MatchProfileCacheKey(m_profileIndex[mid].key, key, len) < 0)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+
+			if (low < m_profileIndex.size() && MatchProfileCacheKey(m_profileIndex[low].key, key, len) == 0) {
+				if (match == NULL || m_profileIndex[low].order < match->order)
+					match = &m_profileIndex[low];
+			}
+		}
+	}
+
+	if (match == NULL)
+		return NULL;
+
+	return match->profile;
+}
+
 int NppFTP::SaveSettings() {
 
 	char xmlPath[MAX_PATH];
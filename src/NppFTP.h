@@ -22,9 +22,19 @@
 #include "FTPWindow.h"
 #include "FTPSession.h"
 #include "SSLCertificates.h"
+#include "CacheManager.h"
 
 #include "Npp/PluginInterface.h"
 
+//Cache directory of a profile, "user@host" in "\Cache\user@host\"
+struct ProfileCacheKey {
+	TCHAR*					key;
+	int						order;		//index in the profile vector, the first profile wins on duplicates
+	FTPProfile*				profile;
+};
+
+typedef std::vector<ProfileCacheKey> vProfileCacheKey;
+
 class NppFTP {
 public:
 							NppFTP();
@@ -45,13 +55,21 @@ private:
 	int						LoadSettings();		//-1 error, 0 success, 1 unable to load
 	int						SaveSettings();
 
+	int						BuildProfileIndex();
+	int						ClearProfileIndex();
+	FTPProfile*				FindCacheProfile(const TCHAR * path);
+
 	FTPSettings*			m_ftpSettings;
 	FTPSession*				m_ftpSession;
 	FTPWindow*				m_ftpWindow;
+	CacheManager			m_cacheManager;
 
 	vProfile				m_profiles;
 	bool					m_activeSession;
 
+	vProfileCacheKey		m_profileIndex;		//sorted by key
+	int						m_profileIndexRevision;
+
 	TCHAR*					m_configStore;
 
 
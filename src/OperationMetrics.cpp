@@ -0,0 +1,261 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "OperationMetrics.h"
+
+#include <stdio.h>
+
+OperationMetrics::OperationMetrics() :
+	m_monitor(0)
+{
+	Reset();
+}
+
+OperationMetrics::~OperationMetrics() {
+}
+
+int OperationMetrics::Record(const QueueOperation * op) {
+	int type = (int)op->GetType();
+	if (type < 0 || type >= QueueOperation::QueueTypeCount)
+		return -1;
+
+	LONGLONG total = op->GetDuration();
+	LONGLONG wait = op->GetWaitTime();
+	LONGLONG firstByte = op->GetTimeToFirstByte();
+	LONGLONG bytes = op->GetBytes();
+
+	int bucket = 0;
+	LONGLONG limit = 1000;	//1ms
+	while(bucket < METRICS_BUCKETS-1 && total >= limit) {
+		bucket++;
+		limit *= 2;
+	}
+
+	m_monitor.Enter();
+		OperationStats & stats = m_stats[type];
+		stats.count++;
+		if (op->GetResult() == -1)
+			stats.failed++;
+		stats.bytes += bytes;
+		stats.totalTime += total;
+		if (total > stats.maxTime)
+			stats.maxTime = total;
+		stats.waitTime += wait;
+		if (bytes > 0)
+			stats.transferTime += op->GetRunTime();
+		if (firstByte >= 0) {
+			stats.firstByteTime += firstByte;
+			stats.firstByteCount++;
+		}
+		stats.verified += op->GetVerifiedCount();
+		stats.mismatches += op->GetMismatchCount();
+		stats.hashTime += op->GetHashTime();
+		stats.checkTime += op->GetCheckTime();
+		stats.histogram[bucket]++;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int OperationMetrics::Reset() {
+	m_monitor.Enter();
+		memset(m_stats, 0, sizeof(m_stats));
+		::GetSystemTimeAsFileTime(&m_startTime);
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int OperationMetrics::GetStats(QueueOperation::QueueType type, OperationStats * stats) {
+	int index = (int)type;
+	if (index < 0 || index >= QueueOperation::QueueTypeCount)
+		return -1;
+
+	m_monitor.Enter();
+		*stats = m_stats[index];
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int OperationMetrics::OutputSummary() {
+	OperationStats stats;
+
+	for(int i = 0; i < QueueOperation::QueueTypeCount; i++) {
+		GetStats((QueueOperation::QueueType)i, &stats);
+		if (stats.count == 0)
+			continue;
+
+		double mean = (double)stats.totalTime / stats.count / 1000.0;
+		double wait = (double)stats.waitTime / stats.count / 1000.0;
+		if (stats.transferTime > 0) {
+			double rate = (double)stats.bytes / ((double)stats.transferTime / 1000000.0) / 1024.0;
+			OutDebug("[NppFTP.Metrics] %s: %d done, %d failed, %.1fms mean, %.1fms queued, %.1f KB/s",
+					GetTypeName((QueueOperation::QueueType)i), stats.count, stats.failed, mean, wait, rate);
+		} else {
+			OutDebug("[NppFTP.Metrics] %s: %d done, %d failed, %.1fms mean, %.1fms queued",
+					GetTypeName((QueueOperation::QueueType)i), stats.count, stats.failed, mean, wait);
+		}
+		if (stats.verified > 0) {
+			OutDebug("[NppFTP.Metrics] %s: %d verified, %d mismatched, %.1fms hashing, %.1fms waiting for the server",
+					GetTypeName((QueueOperation::QueueType)i), stats.verified, stats.mismatches,
+					(double)stats.hashTime / 1000.0, (double)stats.checkTime / 1000.0);
+		}
+	}
+
+	return 0;
+}
+
+int OperationMetrics::ExportJSON(const TCHAR * file) {
+	std::string json;
+	char buffer[1024];
+	OperationStats stats;
+
+	SYSTEMTIME start;
+	::FileTimeToSystemTime(&m_startTime, &start);
+
+	sprintf(buffer, "{\n\t\"version\": 1,\n\t\"started\": \"%04d-%02d-%02dT%02d:%02d:%02dZ\",\n\t\"operations\": [",
+			start.wYear, start.wMonth, start.wDay, start.wHour, start.wMinute, start.wSecond);
+	json += buffer;
+
+	bool first = true;
+	for(int i = 0; i < QueueOperation::QueueTypeCount; i++) {
+		GetStats((QueueOperation::QueueType)i, &stats);
+		if (stats.count == 0)
+			continue;
+
+		double throughput = 0.0;
+		if (stats.transferTime > 0)
+			throughput = (double)stats.bytes / ((double)stats.transferTime / 1000000.0);
+		double firstByte = 0.0;
+		if (stats.firstByteCount > 0)
+			firstByte = (double)stats.firstByteTime / stats.firstByteCount / 1000.0;
+
+		sprintf(buffer,
+			"%s\n\t\t{\n"
+			"\t\t\t\"type\": \"%s\",\n"
+			"\t\t\t\"count\": %d,\n"
+			"\t\t\t\"failed\": %d,\n"
+			"\t\t\t\"bytes\": %I64d,\n"
+			"\t\t\t\"mean_ms\": %.3f,\n"
+			"\t\t\t\"max_ms\": %.3f,\n"
+			"\t\t\t\"mean_queue_wait_ms\": %.3f,\n"
+			"\t\t\t\"mean_first_byte_ms\": %.3f,\n"
+			"\t\t\t\"throughput_bps\": %.1f,\n"
+			"\t\t\t\"verified\": %d,\n"
+			"\t\t\t\"mismatched\": %d,\n"
+			"\t\t\t\"hash_ms\": %.3f,\n"
+			"\t\t\t\"verify_wait_ms\": %.3f,\n"
+			"\t\t\t\"histogram_ms\": [",
+			first?"":",", GetTypeName((QueueOperation::QueueType)i), stats.count, stats.failed, stats.bytes,
+			(double)stats.totalTime / stats.count / 1000.0, (double)stats.maxTime / 1000.0,
+			(double)stats.waitTime / stats.count / 1000.0, firstByte, throughput,
+			stats.verified, stats.mismatches, (double)stats.hashTime / 1000.0, (double)stats.checkTime / 1000.0);
+		json += buffer;
+		first = false;
+
+		//only up to the last used bucket
+		int lastBucket = 0;
+		for(int j = 0; j < METRICS_BUCKETS; j++) {
+			if (stats.histogram[j] > 0)
+				lastBucket = j;
+		}
+		for(int j = 0; j <= lastBucket; j++) {
+			if (j == METRICS_BUCKETS-1)
+				sprintf(buffer, "%s{\"lt\": null, \"count\": %d}", j==0?"":", ", stats.histogram[j]);
+			else
+				sprintf(buffer, "%s{\"lt\": %d, \"count\": %d}", j==0?"":", ", 1 << j, stats.histogram[j]);
+			json += buffer;
+		}
+		json += "]\n\t\t}";
+	}
+	json += "\n\t]\n}\n";
+
+	HANDLE hFile = ::CreateFile(file, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		OutErr("[NppFTP.Metrics] Unable to create %T", file);
+		return -1;
+	}
+
+	DWORD written = 0;
+	BOOL res = ::WriteFile(hFile, json.c_str(), (DWORD)json.size(), &written, NULL);
+	::CloseHandle(hFile);
+	if (res == FALSE || written != json.size()) {
+		OutErr("[NppFTP.Metrics] Unable to write %T", file);
+		return -1;
+	}
+
+	return 0;
+}
+
+LONGLONG OperationMetrics::Now() {
+	static LONGLONG frequency = 0;
+	if (frequency == 0) {
+		LARGE_INTEGER freq;
+		::QueryPerformanceFrequency(&freq);
+		frequency = freq.QuadPart;
+	}
+
+	LARGE_INTEGER ticks;
+	::QueryPerformanceCounter(&ticks);
+
+	//split to avoid overflow
+	return (ticks.QuadPart / frequency) * 1000000 + (ticks.QuadPart % frequency) * 1000000 / frequency;
+}
+
+const char* OperationMetrics::GetTypeName(QueueOperation::QueueType type) {
+	switch(type) {
+		case QueueOperation::QueueTypeConnect:
+			return "connect";
+		case QueueOperation::QueueTypeDisconnect:
+			return "disconnect";
+		case QueueOperation::QueueTypeDownload:
+			return "download";
+		case QueueOperation::QueueTypeUpload:
+			return "upload";
+		case QueueOperation::QueueTypeDirectoryGet:
+			return "getdir";
+		case QueueOperation::QueueTypeDirectoryCreate:
+			return "mkdir";
+		case QueueOperation::QueueTypeDirectoryRemove:
+			return "rmdir";
+		case QueueOperation::QueueTypeFileCreate:
+			return "mkfile";
+		case QueueOperation::QueueTypeFileDelete:
+			return "delete";
+		case QueueOperation::QueueTypeFileRename:
+			return "rename";
+		case QueueOperation::QueueTypeQuote:
+			return "quote";
+		case QueueOperation::QueueTypeDownloadHandle:
+			return "downloadhandle";
+		case QueueOperation::QueueTypeNoOp:
+			return "noop";
+		case QueueOperation::QueueTypeBatch:
+			return "batch";
+		case QueueOperation::QueueTypeFollow:
+			return "follow";
+		case QueueOperation::QueueTypeSearch:
+			return "search";
+		case QueueOperation::QueueTypeSync:
+			return "sync";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,68 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPERATIONMETRICS_H
+#define OPERATIONMETRICS_H
+
+#include "QueueOperation.h"
+#include "Monitor.h"
+
+//Duration histogram buckets, bucket i counts durations below 2^i ms, the last one everything else
+#define METRICS_BUCKETS		20
+
+struct OperationStats {
+	int						count;
+	int						failed;
+	LONGLONG				bytes;
+	LONGLONG				totalTime;		//microseconds, all of the times
+	LONGLONG				maxTime;
+	LONGLONG				waitTime;		//queued until started
+	LONGLONG				transferTime;	//started until completed, only for operations that transferred data
+	LONGLONG				firstByteTime;	//started until first byte
+	int						firstByteCount;
+	int						verified;		//transfers compared with the hash of the server
+	int						mismatches;
+	LONGLONG				hashTime;		//hashing the transferred data
+	LONGLONG				checkTime;		//waiting for the hash of the server
+	int						histogram[METRICS_BUCKETS];
+};
+
+//Aggregates the timings of completed queue operations, per operation type
+//Operations are recorded by the queue threads, so all access is locked
+class OperationMetrics {
+public:
+							OperationMetrics();
+	virtual					~OperationMetrics();
+
+	virtual int				Record(const QueueOperation * op);
+	virtual int				Reset();
+
+	virtual int				GetStats(QueueOperation::QueueType type, OperationStats * stats);
+
+	virtual int				OutputSummary();
+	virtual int				ExportJSON(const TCHAR * file);
+
+	static LONGLONG			Now();	//microseconds
+	static const char*		GetTypeName(QueueOperation::QueueType type);
+private:
+	Monitor					m_monitor;
+	OperationStats			m_stats[QueueOperation::QueueTypeCount];
+	FILETIME				m_startTime;
+};
+
+#endif //OPERATIONMETRICS_H
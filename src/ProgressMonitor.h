@@ -26,6 +26,8 @@ public:
 
 	virtual int				OnDataReceived(long received, long total) = 0;
 	virtual int				OnDataSent(long sent, long total) = 0;
+							//Microseconds spent hashing the data and getting the hash of the server, result -1 if the server gave none, 1 on a mismatch
+	virtual int				OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result) = 0;
 protected:
 };
 
@@ -19,13 +19,58 @@
 #include "StdInc.h"
 #include "QueueOperation.h"
 
+#include "OperationMetrics.h"
+#include "FTPProfile.h"
+
+#include <stdio.h>
+#include <algorithm>
+
 const int QueueConditionAcked = 0;
 const int QueueConditionCount = 1;
 
+const LONGLONG RateSampleTime = 500000;	//microseconds over which the transfer rate is measured
+
+VerifyTally::VerifyTally() :
+	m_hashTime(0),
+	m_checkTime(0),
+	m_verified(0),
+	m_mismatches(0)
+{
+}
+
+int VerifyTally::OnDataReceived(long /*received*/, long /*total*/) {
+	return 0;
+}
+
+int VerifyTally::OnDataSent(long /*sent*/, long /*total*/) {
+	return 0;
+}
+
+int VerifyTally::OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result) {
+	m_hashTime += hashTime;
+	m_checkTime += checkTime;
+	if (result != -1)
+		m_verified++;
+	if (result == 1)
+		m_mismatches++;
+
+	return 0;
+}
+
+int VerifyTally::Add(const VerifyTally & other) {
+	m_hashTime += other.m_hashTime;
+	m_checkTime += other.m_checkTime;
+	m_verified += other.m_verified;
+	m_mismatches += other.m_mismatches;
+
+	return 0;
+}
+
 QueueOperation::QueueOperation(QueueType type, HWND hNotify, int notifyCode, void * notifyData) :
 	m_type(type),
 	m_client(NULL),
 	m_hNotify(hNotify),
+	m_notifySink(NULL),
 	m_notifyCode(notifyCode),
 	m_notifyData(notifyData),
 	m_doConnect(true),
@@ -34,15 +79,30 @@ QueueOperation::QueueOperation(QueueType type, HWND hNotify, int notifyCode, voi
 	m_data(NULL),
 	m_progress(0.0f),
 	m_notifSent(0),
+	m_enqueueTime(0),
+	m_startTime(0),
+	m_firstByteTime(0),
+	m_endTime(0),
+	m_bytes(0),
+	m_totalBytes(-1),
+	m_rateTime(0),
+	m_rateBytes(0),
+	m_rate(0.0),
+	m_hashTime(0),
+	m_checkTime(0),
+	m_verified(0),
+	m_mismatches(0),
 	m_running(false),
 	m_ackMonitor(QueueConditionCount),
 	m_terminating(false)
 {
-	m_winThread = GetWindowThreadProcessId(m_hNotify, NULL);
+	if (m_hNotify)
+		m_notifySink = new WindowNotifySink(m_hNotify);
 }
 
 QueueOperation::~QueueOperation() {
 	Terminate();
+	delete m_notifySink;
 }
 
 int QueueOperation::Terminate() {
@@ -70,6 +130,21 @@ QueueOperation::QueueType QueueOperation::GetType() const {
 	return m_type;
 }
 
+bool QueueOperation::UsesDataConnection() const {
+	switch(m_type) {
+		case QueueTypeDownload:
+		case QueueTypeDownloadHandle:
+		case QueueTypeUpload:
+		case QueueTypeDirectoryGet:
+		case QueueTypeFollow:
+		case QueueTypeSearch:
+		case QueueTypeSync:
+			return true;
+		default:
+			return false;
+	}
+}
+
 int QueueOperation::SetRunning(bool running) {
 	m_running = running;
 	return 0;
@@ -80,6 +155,7 @@ bool QueueOperation::GetRunning() const {
 }
 
 int QueueOperation::SendNotification(QueueEvent event) {
+	const bool trace = _TraceEnabled;	//read once, so a toggle in between cannot leave postTicks unset
 	UINT msg = 0;
 	if (event != QueueEventProgress && (m_notifSent & event) != 0)
 		return 0;		//do not send duplicate notifications, except for progress
@@ -107,9 +183,11 @@ int QueueOperation::SendNotification(QueueEvent event) {
 			break;
 	}
 
-	DWORD curThread = GetCurrentThreadId();
-	if (m_winThread == curThread) {
-		::SendMessage(m_hNotify, msg, m_notifyCode, (LPARAM)this);
+	if (!m_notifySink)
+		return 0;
+
+	if (m_notifySink->IsSinkThread()) {
+		m_notifySink->Notify(msg, m_notifyCode, this);
 		return 0;
 	}
 
@@ -119,8 +197,19 @@ int QueueOperation::SendNotification(QueueEvent event) {
 			return 0;
 		}
 
-		::PostMessage(m_hNotify, msg, m_notifyCode, (LPARAM)this);
+		LARGE_INTEGER postTicks;
+		postTicks.QuadPart = 0;
+		if (trace)
+			::QueryPerformanceCounter(&postTicks);
+
+		m_notifySink->Notify(msg, m_notifyCode, this);
 		m_ackMonitor.Wait(QueueConditionAcked);
+
+		if (trace) {
+			LARGE_INTEGER ackTicks;
+			::QueryPerformanceCounter(&ackTicks);
+			TraceWrite(Trace_Notify, event, ackTicks.QuadPart - postTicks.QuadPart);
+		}
 	m_ackMonitor.Exit();
 
 	return 0;
@@ -134,16 +223,10 @@ int QueueOperation::AckNotification() {
 }
 
 int QueueOperation::ClearPendingNotifications() {
-	if (!m_hNotify)
+	if (!m_notifySink)
 		return -1;
 
-	MSG msg;
-	BOOL res = ::PeekMessage(&msg, m_hNotify, NotifyMessageMIN, NotifyMessageMAX, PM_REMOVE);
-	while(res == TRUE) {
-		res = ::PeekMessage(&msg, m_hNotify, NotifyMessageMIN, NotifyMessageMAX, PM_REMOVE);
-	}
-
-	return 0;
+	return m_notifySink->ClearPending();
 }
 
 int QueueOperation::SetProgress(float progress) {
@@ -155,6 +238,131 @@ float QueueOperation::GetProgress() const {
 	return m_progress;
 }
 
+int QueueOperation::OnEnqueued() {
+	m_enqueueTime = OperationMetrics::Now();
+	return 0;
+}
+
+int QueueOperation::OnStarted() {
+	m_startTime = OperationMetrics::Now();
+	if (m_enqueueTime == 0)
+		m_enqueueTime = m_startTime;
+	m_rateTime = m_startTime;
+	return 0;
+}
+
+int QueueOperation::OnTransferred(long bytes, long total) {
+	LONGLONG now = OperationMetrics::Now();
+
+	if (m_firstByteTime == 0 && bytes > 0)
+		m_firstByteTime = now;
+
+	m_bytes = bytes;
+	m_totalBytes = total;
+
+	//Rate over the last sample period, so it follows changes in speed
+	LONGLONG elapsed = now - m_rateTime;
+	if (elapsed >= RateSampleTime) {
+		m_rate = (double)(m_bytes - m_rateBytes) * 1000000.0 / (double)elapsed;
+		m_rateTime = now;
+		m_rateBytes = m_bytes;
+	}
+
+	return 0;
+}
+
+int QueueOperation::OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result) {
+	//A repeated transfer adds up, it is part of the cost
+	m_hashTime += hashTime;
+	m_checkTime += checkTime;
+	if (result != -1)
+		m_verified++;
+	if (result == 1)
+		m_mismatches++;
+
+	return 0;
+}
+
+int QueueOperation::AddVerified(const VerifyTally & tally) {
+	m_hashTime += tally.m_hashTime;
+	m_checkTime += tally.m_checkTime;
+	m_verified += tally.m_verified;
+	m_mismatches += tally.m_mismatches;
+
+	return 0;
+}
+
+int QueueOperation::OnCompleted() {
+	m_endTime = OperationMetrics::Now();
+	return 0;
+}
+
+LONGLONG QueueOperation::GetBytes() const {
+	return m_bytes;
+}
+
+LONGLONG QueueOperation::GetWaitTime() const {
+	if (m_startTime == 0)
+		return 0;
+	return m_startTime - m_enqueueTime;
+}
+
+LONGLONG QueueOperation::GetRunTime() const {
+	if (m_startTime == 0 || m_endTime == 0)
+		return 0;
+	return m_endTime - m_startTime;
+}
+
+LONGLONG QueueOperation::GetDuration() const {
+	if (m_endTime == 0)
+		return 0;
+	return m_endTime - m_enqueueTime;
+}
+
+LONGLONG QueueOperation::GetTimeToFirstByte() const {
+	if (m_firstByteTime == 0)
+		return -1;
+	return m_firstByteTime - m_startTime;
+}
+
+double QueueOperation::GetRate() const {
+	if (m_rate > 0.0)
+		return m_rate;
+
+	//no full sample yet, use the average so far
+	LONGLONG elapsed = OperationMetrics::Now() - m_startTime;
+	if (m_startTime == 0 || elapsed <= 0)
+		return 0.0;
+	return (double)m_bytes * 1000000.0 / (double)elapsed;
+}
+
+int QueueOperation::GetRemainingTime() const {
+	double rate = GetRate();
+	if (m_totalBytes < 0 || rate <= 0.0)
+		return -1;
+
+	LONGLONG remaining = m_totalBytes - m_bytes;
+	if (remaining < 0)
+		remaining = 0;
+	return (int)((double)remaining / rate + 0.5);
+}
+
+LONGLONG QueueOperation::GetHashTime() const {
+	return m_hashTime;
+}
+
+LONGLONG QueueOperation::GetCheckTime() const {
+	return m_checkTime;
+}
+
+int QueueOperation::GetVerifiedCount() const {
+	return m_verified;
+}
+
+int QueueOperation::GetMismatchCount() const {
+	return m_mismatches;
+}
+
 bool QueueOperation::Equals(const QueueOperation & other) {
 	if (other.GetType() != m_type)
 		return false;
@@ -223,7 +431,9 @@ bool QueueDisconnect::Equals(const QueueOperation & other) {
 
 QueueDownload::QueueDownload(HWND hNotify, const char * externalFile, const TCHAR * localFile, Transfer_Mode tMode, int notifyCode, void * notifyData) :
 	QueueOperation(QueueTypeDownload, hNotify, notifyCode, notifyData),
-	m_tMode(tMode)
+	m_tMode(tMode),
+	m_size(-1),
+	m_previewSize(0)
 {
 	m_localFile = SU::DupString(localFile);
 	m_externalFile = SU::strdup(externalFile);
@@ -246,7 +456,37 @@ int QueueDownload::Perform() {
 		((FTPClientWrapperSSL*)m_client)->SetTransferMode(m_tMode);
 	}
 
-	m_result = m_client->ReceiveFile(m_localFile, m_externalFile);
+	bool preview = (m_previewSize > 0 && m_size > 2*m_previewSize);
+
+	//An FTP listing only tells the minute, so the version is told by the exact time, asked before the transfer
+	SyncState * syncState = m_client->GetSyncState();
+	FILETIME mtime = {0, 0};
+	bool asked = (syncState && !preview && m_size >= 0);
+	bool exact = (asked && m_client->GetModTime(m_externalFile, &mtime) == 0);
+	if (asked && m_client->WasAborted()) {
+		m_result = m_client->EndAbort();
+		return m_result;
+	}
+
+	if (preview) {
+		m_result = PerformPreview();
+	} else if (exact && syncState->IsCacheCurrent(m_externalFile, m_localFile, m_size, mtime)) {
+		OutMsg("[NppFTP.Download] %s is unchanged, using the local file", m_externalFile);
+		m_result = 0;
+	} else {
+		m_client->SetTransferSize(m_size);
+		m_result = m_client->ReceiveFile(m_localFile, m_externalFile);
+	}
+
+	//Remember which version the local file is, so it need not be downloaded again.
+	//A preview is a different local file, it leaves the record of the full download alone
+	if (syncState && !preview) {
+		if (m_result != -1 && exact)
+			syncState->SetCached(m_externalFile, m_localFile, m_size, mtime);
+		else
+			syncState->ClearCached(m_externalFile);
+	}
+
 	return m_result;
 }
 
@@ -266,12 +506,55 @@ const char* QueueDownload::GetExternalPath() {
 	return m_externalFile;
 }
 
+int QueueDownload::SetSize(long size) {
+	m_size = size;
+	return 0;
+}
+
+int QueueDownload::SetPreview(long previewSize) {
+	m_previewSize = previewSize;
+	return 0;
+}
+
+//Head and tail of the file with a marker in between, made read-only so it cannot be uploaded over the original
+int QueueDownload::PerformPreview() {
+	::SetFileAttributes(m_localFile, FILE_ATTRIBUTE_NORMAL);	//the previous preview
+
+	int res = m_client->ReceiveFileRange(m_localFile, m_externalFile, 0, m_previewSize, false);
+	if (res == -1)
+		return -1;
+
+	char marker[200];
+	int len = sprintf(marker, "\r\n\r\n[NppFTP preview: %ld of %ld bytes left out. Download the file to see all of it.]\r\n\r\n",
+							m_size - 2*m_previewSize, m_size);
+
+	HANDLE hFile = ::CreateFile(m_localFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return -1;
+
+	DWORD written = 0;
+	::SetFilePointer(hFile, 0, NULL, FILE_END);
+	BOOL writeres = ::WriteFile(hFile, marker, len, &written, NULL);
+	::CloseHandle(hFile);
+	if (writeres == FALSE)
+		return -1;
+
+	res = m_client->ReceiveFileRange(m_localFile, m_externalFile, m_size - m_previewSize, m_previewSize, true);
+	if (res == -1)
+		return -1;
+
+	::SetFileAttributes(m_localFile, FILE_ATTRIBUTE_READONLY);
+
+	return 0;
+}
+
 //////////////////////////////////////
 
 QueueDownloadHandle::QueueDownloadHandle(HWND hNotify, const char * externalFile, HANDLE hFile, Transfer_Mode tMode, int notifyCode, void * notifyData) :
 	QueueOperation(QueueTypeDownloadHandle, hNotify, notifyCode, notifyData),
 	m_hFile(hFile),
-	m_tMode(tMode)
+	m_tMode(tMode),
+	m_size(-1)
 
 {
 	m_externalFile = SU::strdup(externalFile);
@@ -293,6 +576,7 @@ int QueueDownloadHandle::Perform() {
 		((FTPClientWrapperSSL*)m_client)->SetTransferMode(m_tMode);
 	}
 
+	m_client->SetTransferSize(m_size);
 	m_result = m_client->ReceiveFile(m_hFile, m_externalFile);
 	return m_result;
 }
@@ -313,6 +597,11 @@ const char* QueueDownloadHandle::GetExternalPath() {
 	return m_externalFile;
 }
 
+int QueueDownloadHandle::SetSize(long size) {
+	m_size = size;
+	return 0;
+}
+
 //////////////////////////////////////
 
 QueueUpload::QueueUpload(HWND hNotify, const char * externalFile, const TCHAR * localFile, Transfer_Mode tMode, int notifyCode, void * notifyData) :
@@ -341,6 +630,12 @@ int QueueUpload::Perform() {
 	}
 
 	m_result = m_client->SendFile(m_localFile, m_externalFile);
+
+	//The remote file changed, its listing is no longer that of the cached copy
+	SyncState * syncState = m_client->GetSyncState();
+	if (syncState)
+		syncState->ClearCached(m_externalFile);
+
 	return m_result;
 }
 
@@ -708,3 +1003,1052 @@ bool QueueQuote::Equals(const QueueOperation & other) {
 char * QueueQuote::GetQuote() {
 	return m_quote;
 }
+
+//////////////////////////////////////
+
+QueueBatch::QueueBatch(HWND hNotify, const vBatch & items, int notifyCode, void * notifyData) :
+	QueueOperation(QueueTypeBatch, hNotify, notifyCode, notifyData)
+{
+	for(size_t i = 0; i < items.size(); i++) {
+		BatchItem item = items[i];
+		item.path = SU::strdup(items[i].path);
+		item.newPath = items[i].newPath?SU::strdup(items[i].newPath):NULL;
+		item.result = -1;
+		m_items.push_back(item);
+	}
+}
+
+QueueBatch::~QueueBatch() {
+	for(size_t i = 0; i < m_items.size(); i++) {
+		SU::free(m_items[i].path);
+		if (m_items[i].newPath)
+			SU::free(m_items[i].newPath);
+	}
+}
+
+int QueueBatch::Perform() {
+	if (m_doConnect && !m_client->IsConnected()) {
+		m_result = m_client->Connect();
+		if (m_result == -1)
+			return m_result;
+		m_result = -1;
+	}
+
+	if (m_items.empty()) {
+		m_result = 0;
+		return m_result;
+	}
+
+	m_result = m_client->PerformBatch(&m_items[0], m_items.size());
+	return m_result;
+}
+
+bool QueueBatch::Equals(const QueueOperation & /*other*/) {
+	//Batches are never merged
+	return false;
+}
+
+int QueueBatch::GetItemCount() {
+	return (int)m_items.size();
+}
+
+const BatchItem & QueueBatch::GetItem(int i) {
+	return m_items[i];
+}
+
+//////////////////////////////////////
+
+QueueFollow::QueueFollow(HWND hNotify, const char * externalFile, const TCHAR * localFile, long offset, int notifyCode, void * notifyData) :
+	QueueOperation(QueueTypeFollow, hNotify, notifyCode, notifyData),
+	m_initial(offset < 0),
+	m_offset(offset),
+	m_received(0)
+{
+	m_localFile = SU::DupString(localFile);
+	m_externalFile = SU::strdup(externalFile);
+}
+
+QueueFollow::~QueueFollow() {
+	SU::FreeTChar(m_localFile);
+	SU::free(m_externalFile);
+}
+
+int QueueFollow::Perform() {
+	if (m_doConnect && !m_client->IsConnected()) {
+		m_result = m_client->Connect();
+		if (m_result == -1)
+			return m_result;
+		m_result = -1;
+	}
+
+	long size = 0;
+	m_result = m_client->GetSize(m_externalFile, &size);
+	if (m_result == -1)
+		return m_result;
+
+	if (size == m_offset)
+		return m_result;
+
+	bool restart = (m_offset < 0 || size < m_offset);
+	if (restart) {
+		//First poll, or the file was truncated or replaced (e.g. rotated): fetch all of it
+		m_result = m_client->ReceiveFileRange(m_localFile, m_externalFile, 0, 0, false);
+	} else {
+		//Only up to the size just seen, anything appended meanwhile is fetched by the next poll
+		m_result = m_client->ReceiveFileRange(m_localFile, m_externalFile, m_offset, size - m_offset, true);
+	}
+
+	if (m_result != -1) {
+		m_received = restart?size:(size - m_offset);
+		m_offset = size;
+	}
+
+	//The local copy no longer matches any listed version
+	SyncState * syncState = m_client->GetSyncState();
+	if (syncState)
+		syncState->ClearCached(m_externalFile);
+
+	return m_result;
+}
+
+bool QueueFollow::Equals(const QueueOperation & other) {
+	if (!QueueOperation::Equals(other))
+		return false;
+	const QueueFollow & otherFollow = (QueueFollow&) other;
+
+	return (!lstrcmp(otherFollow.m_localFile, m_localFile) && !strcmp(otherFollow.m_externalFile, m_externalFile) && !m_running && !otherFollow.m_running);
+}
+
+const TCHAR* QueueFollow::GetLocalPath() {
+	return m_localFile;
+}
+
+const char* QueueFollow::GetExternalPath() {
+	return m_externalFile;
+}
+
+bool QueueFollow::IsInitial() {
+	return m_initial;
+}
+
+long QueueFollow::GetOffset() {
+	return m_offset;
+}
+
+long QueueFollow::GetReceived() {
+	return m_received;
+}
+
+//////////////////////////////////////
+
+QueueSearch::QueueSearch(HWND hNotify, const char * path, const char * pattern, int notifyCode, void * notifyData) :
+	QueueOperation(QueueTypeSearch, hNotify, notifyCode, notifyData),
+	m_nextFile(0),
+	m_doneFiles(0),
+	m_stop(false),
+	m_searchMonitor(0),
+	m_found(0)
+{
+	m_path = SU::strdup(path);
+	m_pattern = SU::strdup(pattern);
+}
+
+QueueSearch::~QueueSearch() {
+	SU::free(m_path);
+	SU::free(m_pattern);
+}
+
+int QueueSearch::Perform() {
+	if (m_doConnect && !m_client->IsConnected()) {
+		m_result = m_client->Connect();
+		if (m_result == -1)
+			return m_result;
+		m_result = -1;
+	}
+
+	//The server can search much faster than when every file is transferred
+	if (m_client->GetType() == Client_SSH) {
+		m_result = ((FTPClientWrapperSSH*)m_client)->ExecSearch(m_path, m_pattern, this);
+		if (m_result != -1 || m_client->WasAborted())
+			return m_result;
+		if (m_found > 0)	//partial results, transferring the files would report them again
+			return m_result;
+		OutMsg("[NppFTP.Search] The server cannot search, the files are transferred instead");
+	}
+
+	m_result = ListFiles();
+	if (m_result == -1)
+		return m_result;
+
+	OutMsg("[NppFTP.Search] Searching %u files", (unsigned int)m_files.size());
+
+	//No more connections than files
+	ThreadHandle threads[SEARCH_CONNECTIONS];
+	int nrThreads = 0;
+	for(int i = 1; i < SEARCH_CONNECTIONS && (size_t)i < m_files.size(); i++) {
+		threads[nrThreads] = Thread::Start(&ScanThread, this);
+		if (threads[nrThreads] != NULL)
+			nrThreads++;
+	}
+
+	m_result = ScanFiles(m_client);
+
+	//Aborted: stop the other connections as well
+	if (m_stop) {
+		m_searchMonitor.Enter();
+			for(size_t i = 0; i < m_workers.size(); i++)
+				m_workers[i]->Abort();
+		m_searchMonitor.Exit();
+	}
+
+	Thread::Join(threads, nrThreads);
+	AddVerified(m_workerTally);
+
+	return m_result;
+}
+
+bool QueueSearch::Equals(const QueueOperation & /*other*/) {
+	//Searches are never merged
+	return false;
+}
+
+int QueueSearch::SetProgress(float /*progress*/) {
+	return 0;
+}
+
+const char* QueueSearch::GetPath() {
+	return m_path;
+}
+
+const char* QueueSearch::GetPattern() {
+	return m_pattern;
+}
+
+int QueueSearch::GetFileCount() {
+	return (int)m_doneFiles;
+}
+
+int QueueSearch::GetFoundCount() {
+	return m_found;
+}
+
+int QueueSearch::OnFileFound(const char * path) {
+	m_searchMonitor.Enter();
+		m_found++;
+	m_searchMonitor.Exit();
+
+	//Results show up in the output window as they are found
+	OutMsg("[NppFTP.Search] Found in %s", path);
+
+	return 0;
+}
+
+int QueueSearch::ListFiles() {
+	std::deque<std::string> dirs;
+	dirs.push_back(m_path);
+
+	while(!dirs.empty()) {
+		std::string dir = dirs.front();
+		dirs.pop_front();
+
+		FTPFile * files = NULL;
+		int count = m_client->GetDir(dir.c_str(), &files);
+		if (count == -1) {
+			if (m_client->WasAborted())
+				return -1;
+			OutErr("[NppFTP.Search] Unable to list %s", dir.c_str());
+			continue;
+		}
+
+		//Links are skipped, they may point back up the tree
+		for(int i = 0; i < count; i++) {
+			if (files[i].fileType == FTPTypeDir)
+				dirs.push_back(files[i].filePath);
+			else if (files[i].fileType == FTPTypeFile)
+				m_files.push_back(files[i].filePath);
+		}
+
+		FTPClientWrapper::ReleaseDir(files, count);
+	}
+
+	return 0;
+}
+
+int QueueSearch::ScanFiles(FTPClientWrapper * wrapper) {
+	ContentMatcher matcher(m_pattern);
+	LONG fileCount = (LONG)m_files.size();
+
+	while(!m_stop) {
+		LONG index = InterlockedIncrement(&m_nextFile) - 1;
+		if (index >= fileCount)
+			break;
+
+		const char * file = m_files[index].c_str();
+		int res = wrapper->ScanFile(file, &matcher);
+		if (res == -1) {
+			if (wrapper->WasAborted()) {
+				m_stop = true;
+				return -1;
+			}
+			OutErr("[NppFTP.Search] Unable to search %s", file);
+		} else if (matcher.Found()) {
+			OnFileFound(file);
+		}
+
+		LONG done = InterlockedIncrement(&m_doneFiles);
+
+		//Notifications only come from the queue thread
+		if (wrapper == m_client) {
+			m_progress = (float)done/(float)fileCount * 100.0f;
+			SendNotification(QueueEventProgress);
+		}
+	}
+
+	return 0;
+}
+
+int QueueSearch::ScanWorker() {
+	//Only the queue thread reports to the queue, the verifications are added up when the operation ends
+	VerifyTally tally;
+	FTPClientWrapper * wrapper = m_client->Clone();
+	wrapper->SetProgressMonitor(&tally);
+
+	m_searchMonitor.Enter();
+		m_workers.push_back(wrapper);
+	m_searchMonitor.Exit();
+
+	if (!m_stop && wrapper->Connect() != -1)
+		ScanFiles(wrapper);
+
+	m_searchMonitor.Enter();
+		for(size_t i = 0; i < m_workers.size(); i++) {
+			if (m_workers[i] == wrapper) {
+				m_workers.erase(m_workers.begin()+i);
+				break;
+			}
+		}
+		m_workerTally.Add(tally);
+	m_searchMonitor.Exit();
+
+	wrapper->Disconnect();
+	delete wrapper;
+
+	return 0;
+}
+
+int QueueSearch::ScanThread(void * param) {
+	QueueSearch * search = (QueueSearch*)param;
+	return search->ScanWorker();
+}
+
+//////////////////////////////////////
+
+static bool CompareListed(const FTPFile * a, const FTPFile * b) {
+	return strcmp(PU::FindExternalFilename(a->filePath), PU::FindExternalFilename(b->filePath)) < 0;
+}
+
+static bool CompareListedName(const FTPFile * file, const char * name) {
+	return strcmp(PU::FindExternalFilename(file->filePath), name) < 0;
+}
+
+QueueSync::QueueSync(HWND hNotify, const char * externalDir, const TCHAR * localDir, FTPProfile * profile,
+                     bool useHashes, int notifyCode, void * notifyData) :
+	QueueOperation(QueueTypeSync, hNotify, notifyCode, notifyData),
+	m_profile(profile),
+	m_useHashes(useHashes),
+	m_syncMonitor(ConditionCount),
+	m_nrThreads(0),
+	m_walkDone(false),
+	m_stop(false),
+	m_planned(0),
+	m_done(0),
+	m_uploads(0),
+	m_downloads(0),
+	m_deletes(0),
+	m_conflicts(0),
+	m_failed(0)
+{
+	m_externalDir = SU::strdup(externalDir);
+	m_localDir = SU::DupString(localDir);
+	m_profile->AddRef();
+}
+
+QueueSync::~QueueSync() {
+	SU::free(m_externalDir);
+	SU::FreeTChar(m_localDir);
+	m_profile->Release();
+}
+
+int QueueSync::Perform() {
+	if (m_doConnect && !m_client->IsConnected()) {
+		m_result = m_client->Connect();
+		if (m_result == -1)
+			return m_result;
+		m_result = -1;
+	}
+
+	if (PU::CreateLocalDir(m_localDir) == -1)
+		return m_result;
+
+	//Depth first, only the directories along the current path wait to be walked
+	std::vector<SyncPath> paths;
+	SyncPath root;
+	root.externalDir = m_externalDir;
+	root.localDir = m_localDir;
+	paths.push_back(root);
+
+	while(!paths.empty() && !m_stop) {
+		SyncPath path = paths.back();
+		paths.pop_back();
+
+		if (PlanDirectory(path, paths) == -1)
+			break;
+
+		UpdateProgress();
+	}
+
+	//Walk done, help the workers with the remaining actions
+	SyncTask task;
+	m_syncMonitor.Enter();
+		m_walkDone = true;
+		m_syncMonitor.Signal(ConditionTask);
+		while(!m_stop && TakeTask(&task)) {
+			m_syncMonitor.Exit();
+			PerformTask(m_client, task);
+			UpdateProgress();
+			m_syncMonitor.Enter();
+		}
+	m_syncMonitor.Exit();
+
+	Thread::Join(m_threads, m_nrThreads);
+	m_nrThreads = 0;
+	AddVerified(m_workerTally);
+
+	//Only when stopped: the manifests of unfinished directories are not saved, they are planned again next time
+	for(size_t i = 0; i < m_dirs.size(); i++)
+		delete m_dirs[i];
+	m_dirs.clear();
+	m_tasks.clear();
+
+	m_result = (m_stop || m_failed > 0)?-1:0;
+
+	return m_result;
+}
+
+bool QueueSync::Equals(const QueueOperation & other) {
+	if (!QueueOperation::Equals(other))
+		return false;
+	const QueueSync & otherSync = (QueueSync&) other;
+
+	return (!lstrcmp(otherSync.m_localDir, m_localDir) && !strcmp(otherSync.m_externalDir, m_externalDir) && !m_running && !otherSync.m_running);
+}
+
+int QueueSync::SetProgress(float /*progress*/) {
+	return 0;
+}
+
+const char* QueueSync::GetExternalPath() {
+	return m_externalDir;
+}
+
+const TCHAR* QueueSync::GetLocalPath() {
+	return m_localDir;
+}
+
+int QueueSync::GetUploadCount() {
+	return (int)m_uploads;
+}
+
+int QueueSync::GetDownloadCount() {
+	return (int)m_downloads;
+}
+
+int QueueSync::GetDeleteCount() {
+	return (int)m_deletes;
+}
+
+int QueueSync::GetConflictCount() {
+	return (int)m_conflicts;
+}
+
+int QueueSync::GetFailedCount() {
+	return (int)m_failed;
+}
+
+int QueueSync::PlanDirectory(const SyncPath & path, std::vector<SyncPath> & subdirs) {
+	FTPFile * files = NULL;
+	int count = m_client->GetDir(path.externalDir.c_str(), &files);
+	if (count == -1) {
+		if (m_client->WasAborted()) {
+			Stop();
+			return -1;
+		}
+		//Without a listing every file would look new or deleted, so the directory is left alone
+		OutErr("[NppFTP.Sync] Unable to list %s, skipped", path.externalDir.c_str());
+		InterlockedIncrement(&m_failed);
+		return 0;
+	}
+	if (!m_client->WasListComplete()) {
+		//Left out entries would look deleted on the server
+		OutErr("[NppFTP.Sync] Listing of %s is incomplete, skipped", path.externalDir.c_str());
+		InterlockedIncrement(&m_failed);
+		FTPClientWrapper::ReleaseDir(files, count);
+		return 0;
+	}
+
+	std::vector<LocalEntry> locals;
+	if (ListLocal(path.localDir.c_str(), locals) == -1) {
+		OutErr("[NppFTP.Sync] Unable to list %T, skipped", path.localDir.c_str());
+		InterlockedIncrement(&m_failed);
+		FTPClientWrapper::ReleaseDir(files, count);
+		return 0;
+	}
+
+	//A missing or unreadable manifest is as if nothing was synchronized before, nothing gets deleted
+	SyncManifest base;
+	base.Load(path.localDir.c_str());
+
+	SyncDir * dir = new SyncDir;
+	dir->externalDir = path.externalDir;
+	dir->localDir = path.localDir;
+	dir->pending = 0;
+	dir->uploaded = false;
+
+	std::vector<SyncTask> tasks;
+	TCHAR localName[MAX_PATH];
+	TCHAR localFile[MAX_PATH];
+	char externalFile[MAX_PATH];
+	bool aborted = false;
+
+	for(int i = 0; i < count; i++) {
+		const FTPFile & remote = files[i];
+		const char * name = PU::FindExternalFilename(remote.filePath);
+		if (!name || PU::ExternalToLocalPath(name, localName, MAX_PATH) == -1)
+			continue;
+		if (PU::ConcatLocal(path.localDir.c_str(), localName, localFile, MAX_PATH) == -1)
+			continue;
+
+		LocalEntry * local = NULL;
+		std::vector<LocalEntry>::iterator it = std::lower_bound(locals.begin(), locals.end(), localName, CompareLocal);
+		if (it != locals.end() && !lstrcmpi(it->name.c_str(), localName)) {
+			local = &(*it);
+			if (local->matched) {
+				//Names that only differ in case, or in characters Windows does not allow
+				OutErr("[NppFTP.Sync] %s has the same local name as another file, skipped", remote.filePath);
+				continue;
+			}
+			local->matched = true;
+			if (local->ignored)
+				continue;
+		}
+
+		if (remote.fileType == FTPTypeLink)
+			continue;
+
+		bool remoteDir = (remote.fileType == FTPTypeDir);
+		if (local && local->isDir != remoteDir) {
+			OutMsg("[NppFTP.Sync] Conflict: %s is a file on one side and a directory on the other, skipped", remote.filePath);
+			InterlockedIncrement(&m_conflicts);
+			continue;
+		}
+
+		if (remoteDir) {
+			if (!local && PU::CreateLocalDir(localFile) == -1) {
+				InterlockedIncrement(&m_failed);
+				continue;
+			}
+			SyncPath subdir;
+			subdir.externalDir = remote.filePath;
+			subdir.localDir = localFile;
+			subdirs.push_back(subdir);
+			continue;
+		}
+
+		PlanFile(dir, tasks, name, remote.filePath, &remote, local, localFile, base.Find(name));
+	}
+
+	for(size_t i = 0; i < locals.size() && !aborted; i++) {
+		const LocalEntry & local = locals[i];
+		if (local.matched || local.ignored)
+			continue;
+
+		if (PU::ConcatLocal(path.localDir.c_str(), local.name.c_str(), localFile, MAX_PATH) == -1)
+			continue;
+		if (PU::ConcatLocalToExternal(path.externalDir.c_str(), local.name.c_str(), externalFile, MAX_PATH) == -1)
+			continue;
+		const char * name = PU::FindExternalFilename(externalFile);
+		if (!name)
+			continue;
+
+		if (local.isDir) {
+			if (m_client->MkDir(externalFile) == -1) {
+				if (m_client->WasAborted()) {
+					aborted = true;
+					break;
+				}
+				OutErr("[NppFTP.Sync] Unable to create directory %s", externalFile);
+				InterlockedIncrement(&m_failed);
+				continue;
+			}
+			SyncPath subdir;
+			subdir.externalDir = externalFile;
+			subdir.localDir = localFile;
+			subdirs.push_back(subdir);
+			continue;
+		}
+
+		PlanFile(dir, tasks, name, externalFile, NULL, &local, localFile, base.Find(name));
+	}
+
+	FTPClientWrapper::ReleaseDir(files, count);
+
+	if (aborted) {
+		delete dir;
+		Stop();
+		return -1;
+	}
+
+	if (tasks.empty())
+		return FinishDirectory(m_client, dir);
+
+	//All actions are known before the first is queued, so the directory cannot finish early
+	dir->pending = (int)tasks.size();
+	m_syncMonitor.Enter();
+		m_dirs.push_back(dir);
+	m_syncMonitor.Exit();
+	InterlockedExchangeAdd(&m_planned, (LONG)tasks.size());
+
+	for(size_t i = 0; i < tasks.size(); i++) {
+		if (QueueTask(tasks[i]) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+int QueueSync::PlanFile(SyncDir * dir, std::vector<SyncTask> & tasks, const char * name, const char * externalFile,
+                        const FTPFile * remote, const LocalEntry * local, const TCHAR * localFile, const SyncRecord * base) {
+	bool remoteChanged = false;
+	bool localChanged = false;
+	if (base) {
+		if (remote)
+			remoteChanged = (remote->fileSize != base->remoteSize || CompareFileTime(&(remote->mtime), &(base->remoteTime)) != 0);
+		if (local)
+			localChanged = (local->size != base->localSize || CompareFileTime(&(local->time), &(base->localTime)) != 0);
+
+		//Only touched, e.g. saved without changes, if the content is the same as last time
+		if (localChanged && m_useHashes && base->hasHash && local->size == base->localSize) {
+			unsigned char hash[SYNC_HASH_SIZE];
+			if (SyncManifest::HashLocal(localFile, hash) == 0 && !memcmp(hash, base->hash, SYNC_HASH_SIZE))
+				localChanged = false;
+		}
+	}
+
+	bool sameSize = (remote && local && remote->fileSize >= 0 && (ULONGLONG)remote->fileSize == local->size);
+	SyncAction action = Decide(remote != NULL, local != NULL, base != NULL, remoteChanged, localChanged, sameSize);
+
+	SyncRecord record;
+	if (base) {
+		record = *base;
+	} else {
+		record.name = name;
+		record.remoteSize = -1;
+		record.remoteTime.dwLowDateTime = 0;
+		record.remoteTime.dwHighDateTime = 0;
+		record.localSize = 0;
+		record.localTime = record.remoteTime;
+		record.hasHash = false;
+	}
+
+	switch(action) {
+		case ActionNone: {
+			record.localSize = local->size;	//the time may differ if only touched
+			record.localTime = local->time;
+			dir->manifest.Add(record);
+			return 0; }
+		case ActionConflict: {
+			if (base)
+				OutMsg("[NppFTP.Sync] Conflict: %s changed on both sides, skipped", externalFile);
+			else
+				OutMsg("[NppFTP.Sync] Conflict: %s exists on both sides with different sizes, skipped", externalFile);
+			InterlockedIncrement(&m_conflicts);
+			if (base)
+				dir->manifest.Add(record);
+			return 0; }
+		default:
+			break;
+	}
+
+	SyncTask task;
+	task.action = action;
+	task.dir = dir;
+	task.record = dir->manifest.Add(record);
+	task.hadBase = (base != NULL);
+	task.externalFile = externalFile;
+	task.localFile = localFile;
+	task.remoteSize = remote?remote->fileSize:-1;
+	if (remote) {
+		task.remoteTime = remote->mtime;
+	} else {
+		task.remoteTime.dwLowDateTime = 0;
+		task.remoteTime.dwHighDateTime = 0;
+	}
+	tasks.push_back(task);
+
+	return 0;
+}
+
+QueueSync::SyncAction QueueSync::Decide(bool hasRemote, bool hasLocal, bool hasBase, bool remoteChanged, bool localChanged, bool sameSize) {
+	if (hasRemote && hasLocal) {
+		if (!hasBase)	//never synchronized, with equal sizes the content may still be the same
+			return sameSize?ActionCompare:ActionConflict;
+		if (remoteChanged && localChanged)
+			return ActionConflict;
+		if (localChanged)
+			return ActionUpload;
+		if (remoteChanged)
+			return ActionDownload;
+		return ActionNone;
+	}
+
+	if (hasRemote) {
+		//Deleted locally. The cache drops the record of a file it evicts, so that one is downloaded again
+		if (hasBase && !remoteChanged)
+			return ActionDeleteRemote;
+		return ActionDownload;
+	}
+
+	//Deleted on the server
+	if (hasBase)
+		return localChanged?ActionConflict:ActionDeleteLocal;
+	return ActionUpload;
+}
+
+int QueueSync::QueueTask(const SyncTask & task) {
+	SyncTask next;
+
+	m_syncMonitor.Enter();
+		//The transfers are slower than the walk, rather than planning ahead without limit the walking connection helps out
+		while(!m_stop && m_tasks.size() >= SYNC_MAX_PENDING && TakeTask(&next)) {
+			m_syncMonitor.Exit();
+			PerformTask(m_client, next);
+			m_syncMonitor.Enter();
+		}
+
+		if (m_stop) {
+			m_syncMonitor.Exit();
+			return -1;
+		}
+
+		//Another connection when the existing ones are all busy
+		bool startWorker = (m_nrThreads < SYNC_CONNECTIONS && (m_nrThreads == 0 || !m_tasks.empty()));
+
+		m_tasks.push_back(task);
+		m_syncMonitor.Signal(ConditionTask);
+	m_syncMonitor.Exit();
+
+	if (startWorker) {
+		ThreadHandle thread = Thread::Start(&SyncThread, this);
+		if (thread != NULL)
+			m_threads[m_nrThreads++] = thread;
+	}
+
+	return 0;
+}
+
+bool QueueSync::TakeTask(SyncTask * task) {
+	if (m_tasks.empty())
+		return false;
+
+	*task = m_tasks.front();
+	m_tasks.pop_front();
+
+	//Signals are not counted, wake the next worker for the remaining tasks
+	if (!m_tasks.empty())
+		m_syncMonitor.Signal(ConditionTask);
+
+	return true;
+}
+
+int QueueSync::PerformTask(FTPClientWrapper * wrapper, const SyncTask & task) {
+	SyncDir * dir = task.dir;
+	SyncRecord record = *(dir->manifest.GetRecord(task.record));
+	const char * externalFile = task.externalFile.c_str();
+	const TCHAR * localFile = task.localFile.c_str();
+	SyncState * syncState = wrapper->GetSyncState();
+	int res = -1;
+
+	if (wrapper->GetType() == Client_SSL && (task.action == ActionUpload || task.action == ActionDownload)) {
+		Transfer_Mode tMode = m_profile->GetFileTransferMode(PU::FindLocalFilename(localFile));
+		((FTPClientWrapperSSL*)wrapper)->SetTransferMode(tMode);
+	}
+
+	switch(task.action) {
+		case ActionDownload: {
+			FILETIME mtime = {0, 0};
+			bool exact = (syncState && wrapper->GetModTime(externalFile, &mtime) == 0);
+			if (syncState && wrapper->WasAborted()) {
+				res = wrapper->EndAbort();
+				break;
+			}
+			wrapper->SetTransferSize(task.remoteSize);
+			res = wrapper->ReceiveFile(localFile, externalFile);
+			if (res != -1) {
+				record.remoteSize = task.remoteSize;
+				record.remoteTime = task.remoteTime;
+				res = SyncManifest::ReadLocal(localFile, &record, m_useHashes);
+			}
+			//The local file is the listed version, opening it needs no download
+			if (syncState) {
+				if (res != -1 && exact)
+					syncState->SetCached(externalFile, localFile, task.remoteSize, mtime);
+				else
+					syncState->ClearCached(externalFile);
+			}
+			if (res != -1) {
+				InterlockedIncrement(&m_downloads);
+				OutMsg("[NppFTP.Sync] Downloaded %s", externalFile);
+			}
+			break; }
+		case ActionUpload: {
+			res = wrapper->SendFile(localFile, externalFile);
+			if (res != -1)
+				res = SyncManifest::ReadLocal(localFile, &record, m_useHashes);
+			if (syncState)
+				syncState->ClearCached(externalFile);
+			if (res != -1) {
+				record.remoteSize = -1;	//listed once the directory is finished
+				m_syncMonitor.Enter();
+					dir->uploaded = true;
+				m_syncMonitor.Exit();
+				InterlockedIncrement(&m_uploads);
+				OutMsg("[NppFTP.Sync] Uploaded %s", externalFile);
+			}
+			break; }
+		case ActionCompare: {
+			//Only recorded as synchronized when the server has the same content, otherwise left alone
+			res = 0;
+			if (wrapper->CompareFile(localFile, externalFile) == 0) {
+				record.remoteSize = task.remoteSize;
+				record.remoteTime = task.remoteTime;
+				res = SyncManifest::ReadLocal(localFile, &record, m_useHashes);
+			} else {
+				if (!m_stop) {
+					OutMsg("[NppFTP.Sync] Conflict: %s exists on both sides, not known to be the same, skipped", externalFile);
+					InterlockedIncrement(&m_conflicts);
+				}
+				record.name.clear();	//no base, planned as never synchronized next time
+			}
+			break; }
+		case ActionDeleteLocal: {
+			res = ::DeleteFile(localFile)?0:-1;
+			if (res != -1) {
+				InterlockedIncrement(&m_deletes);
+				OutMsg("[NppFTP.Sync] Deleted %T, it was removed from the server", localFile);
+			}
+			break; }
+		case ActionDeleteRemote: {
+			res = wrapper->DeleteFile(externalFile);
+			if (syncState)
+				syncState->ClearCached(externalFile);
+			if (res != -1) {
+				InterlockedIncrement(&m_deletes);
+				OutMsg("[NppFTP.Sync] Deleted %s, it was removed locally", externalFile);
+			}
+			break; }
+		default:
+			break;
+	}
+
+	if (res != -1) {
+		if (task.action == ActionDeleteLocal || task.action == ActionDeleteRemote)
+			dir->manifest.Remove(task.record);
+		else
+			*(dir->manifest.GetRecord(task.record)) = record;
+	} else {
+		if (task.action != ActionDeleteLocal && wrapper->WasAborted()) {
+			Stop();
+		} else {
+			OutErr("[NppFTP.Sync] Unable to synchronize %s", externalFile);
+			InterlockedIncrement(&m_failed);
+		}
+		//The record of the last synchronization stays, so the next one tries again
+		if (!task.hadBase)
+			dir->manifest.Remove(task.record);
+	}
+
+	InterlockedIncrement(&m_done);
+
+	m_syncMonitor.Enter();
+		dir->pending--;
+		bool finished = (dir->pending == 0);
+	m_syncMonitor.Exit();
+
+	if (finished)
+		FinishDirectory(wrapper, dir);
+
+	return res;
+}
+
+int QueueSync::FinishDirectory(FTPClientWrapper * wrapper, SyncDir * dir) {
+	//Uploaded files only get their remote time from a new listing
+	if (dir->uploaded) {
+		FTPFile * files = NULL;
+		int count = wrapper->GetDir(dir->externalDir.c_str(), &files);
+
+		std::vector<const FTPFile*> listed;
+		for(int i = 0; i < count; i++) {
+			if (PU::FindExternalFilename(files[i].filePath) != NULL)
+				listed.push_back(&files[i]);
+		}
+		std::sort(listed.begin(), listed.end(), CompareListed);
+
+		SyncRecord * record = NULL;
+		for(int i = 0; (record = dir->manifest.GetRecord(i)) != NULL; i++) {
+			if (record->name.empty() || record->remoteSize != -1)
+				continue;
+
+			std::vector<const FTPFile*>::iterator it = std::lower_bound(listed.begin(), listed.end(), record->name.c_str(), CompareListedName);
+			if (it != listed.end() && record->name == PU::FindExternalFilename((*it)->filePath)) {
+				record->remoteSize = (*it)->fileSize;
+				record->remoteTime = (*it)->mtime;
+			} else {
+				dir->manifest.Remove(i);	//unknown, planned as never synchronized next time
+			}
+		}
+
+		if (count != -1)
+			FTPClientWrapper::ReleaseDir(files, count);
+	}
+
+	dir->manifest.Save(dir->localDir.c_str());
+
+	m_syncMonitor.Enter();
+		for(size_t i = 0; i < m_dirs.size(); i++) {
+			if (m_dirs[i] == dir) {
+				m_dirs.erase(m_dirs.begin()+i);
+				break;
+			}
+		}
+	m_syncMonitor.Exit();
+
+	delete dir;
+
+	return 0;
+}
+
+int QueueSync::UpdateProgress() {
+	LONG planned = m_planned;
+	if (planned > 0)
+		m_progress = (float)m_done/(float)planned * 100.0f;
+	SendNotification(QueueEventProgress);
+
+	return 0;
+}
+
+int QueueSync::Stop() {
+	m_syncMonitor.Enter();
+		m_stop = true;
+		for(size_t i = 0; i < m_workers.size(); i++)
+			m_workers[i]->Abort();
+		m_syncMonitor.Signal(ConditionTask);
+	m_syncMonitor.Exit();
+
+	return 0;
+}
+
+int QueueSync::SyncWorker() {
+	//Only the queue thread reports to the queue, the verifications are added up when the operation ends
+	VerifyTally tally;
+	FTPClientWrapper * wrapper = m_client->Clone();
+	wrapper->SetProgressMonitor(&tally);
+
+	m_syncMonitor.Enter();
+		m_workers.push_back(wrapper);
+	m_syncMonitor.Exit();
+
+	if (!m_stop && wrapper->Connect() != -1) {
+		SyncTask task;
+		m_syncMonitor.Enter();
+			while(!m_stop) {
+				if (!TakeTask(&task)) {
+					if (m_walkDone)
+						break;
+					m_syncMonitor.Wait(ConditionTask);
+					continue;
+				}
+				m_syncMonitor.Exit();
+				PerformTask(wrapper, task);
+				m_syncMonitor.Enter();
+			}
+			m_syncMonitor.Signal(ConditionTask);	//pass the end on to the other workers
+		m_syncMonitor.Exit();
+	} else {
+		OutDebug("[NppFTP.Sync] No additional connection, continuing with fewer");
+	}
+
+	m_syncMonitor.Enter();
+		for(size_t i = 0; i < m_workers.size(); i++) {
+			if (m_workers[i] == wrapper) {
+				m_workers.erase(m_workers.begin()+i);
+				break;
+			}
+		}
+		m_workerTally.Add(tally);
+	m_syncMonitor.Exit();
+
+	wrapper->Disconnect();
+	delete wrapper;
+
+	return 0;
+}
+
+int QueueSync::SyncThread(void * param) {
+	QueueSync * sync = (QueueSync*)param;
+	return sync->SyncWorker();
+}
+
+int QueueSync::ListLocal(const TCHAR * localDir, std::vector<LocalEntry> & entries) {
+	TCHAR pattern[MAX_PATH];
+	if (PU::ConcatLocal(localDir, TEXT("*"), pattern, MAX_PATH) == -1)
+		return -1;
+
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = ::FindFirstFile(pattern, &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return (::GetLastError() == ERROR_FILE_NOT_FOUND)?0:-1;
+
+	do {
+		if (!lstrcmp(findData.cFileName, TEXT(".")) || !lstrcmp(findData.cFileName, TEXT("..")))
+			continue;
+
+		LocalEntry entry;
+		entry.name = findData.cFileName;
+		entry.isDir = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+		entry.time = findData.ftLastWriteTime;
+		entry.matched = false;
+
+		//The manifest is hidden, previews are read-only
+		DWORD ignore = FILE_ATTRIBUTE_HIDDEN|FILE_ATTRIBUTE_SYSTEM;
+		if (!entry.isDir)
+			ignore |= FILE_ATTRIBUTE_READONLY;
+		entry.ignored = (findData.dwFileAttributes & ignore) != 0;
+
+		entries.push_back(entry);
+	} while(::FindNextFile(hFind, &findData));
+
+	::FindClose(hFind);
+
+	std::sort(entries.begin(), entries.end(), CompareEntries);
+
+	return 0;
+}
+
+bool QueueSync::CompareLocal(const LocalEntry & entry, const TCHAR * name) {
+	return lstrcmpi(entry.name.c_str(), name) < 0;
+}
+
+bool QueueSync::CompareEntries(const LocalEntry & a, const LocalEntry & b) {
+	return lstrcmpi(a.name.c_str(), b.name.c_str()) < 0;
+}
@@ -21,8 +21,12 @@
 
 #include "FTPClientWrapper.h"
 #include "Monitor.h"
+#include "NotifySink.h"
+#include "Thread.h"
+#include "SyncManifest.h"
 
 class FTPQueue;
+class FTPProfile;
 
 const int NotifyMessageMIN               = WM_USER + 500;
 
@@ -39,6 +43,23 @@ Queue will delete/free data gathered during operations, but not given at constru
 e.g. getdir will free FTPFile array, but not FileObject
 */
 
+//Verifications of a worker connection, whose progress does not go through the queue
+class VerifyTally : public ProgressMonitor {
+public:
+							VerifyTally();
+
+	virtual int				OnDataReceived(long received, long total);
+	virtual int				OnDataSent(long sent, long total);
+	virtual int				OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result);
+
+	virtual int				Add(const VerifyTally & other);
+
+	LONGLONG				m_hashTime;
+	LONGLONG				m_checkTime;
+	int						m_verified;
+	int						m_mismatches;
+};
+
 class QueueOperation {
 	friend class FTPQueue;
 	friend class FTPSession;
@@ -46,7 +67,8 @@ public:
 	enum QueueType { QueueTypeConnect, QueueTypeDisconnect, QueueTypeDownload, QueueTypeUpload,
 	                 QueueTypeDirectoryGet, QueueTypeDirectoryCreate, QueueTypeDirectoryRemove,
 	                 QueueTypeFileCreate, QueueTypeFileDelete, QueueTypeFileRename, QueueTypeQuote,
-	                 QueueTypeDownloadHandle, QueueTypeNoOp
+	                 QueueTypeDownloadHandle, QueueTypeNoOp, QueueTypeBatch, QueueTypeFollow,
+	                 QueueTypeSearch, QueueTypeSync, QueueTypeCount
 	               };
 
 	enum QueueEvent { QueueEventStart=0x01, QueueEventEnd=0x02, QueueEventAdd=0x04, QueueEventRemove=0x08, QueueEventProgress=0x10 };
@@ -61,6 +83,7 @@ public:
 	virtual void*			GetNotifyData() const;
 	virtual void*			GetData() const;
 	virtual QueueType		GetType() const;
+	virtual bool			UsesDataConnection() const;
 
 	virtual bool			GetRunning() const;
 	virtual int				SetRunning(bool running);
@@ -72,6 +95,27 @@ public:
 	virtual int				SetProgress(float progress);
 	virtual float			GetProgress() const;
 
+	//Timing, in microseconds (OperationMetrics::Now)
+	virtual int				OnEnqueued();
+	virtual int				OnStarted();
+	virtual int				OnTransferred(long bytes, long total);
+	virtual int				OnVerified(LONGLONG hashTime, LONGLONG checkTime, int result);
+	virtual int				AddVerified(const VerifyTally & tally);	//of the worker connections, once they are done
+	virtual int				OnCompleted();
+
+	virtual LONGLONG		GetBytes() const;
+	virtual LONGLONG		GetWaitTime() const;
+	virtual LONGLONG		GetRunTime() const;
+	virtual LONGLONG		GetDuration() const;
+	virtual LONGLONG		GetTimeToFirstByte() const;	//-1 if no data was transferred
+	virtual double			GetRate() const;			//bytes per second, recent
+	virtual int				GetRemainingTime() const;	//seconds, -1 if unknown
+
+	virtual LONGLONG		GetHashTime() const;
+	virtual LONGLONG		GetCheckTime() const;		//waiting for the hash of the server
+	virtual int				GetVerifiedCount() const;	//transfers compared with the hash of the server
+	virtual int				GetMismatchCount() const;
+
 	virtual bool			Equals(const QueueOperation & other);
 protected:
 	virtual int				SetClient(FTPClientWrapper* wrapper);
@@ -81,6 +125,7 @@ protected:
 	FTPClientWrapper*		m_client;
 
 	HWND					m_hNotify;
+	NotifySink*				m_notifySink;	//NULL if nothing is notified
 	int						m_notifyCode;	//WPARAM
 	void*					m_notifyData;
 
@@ -92,11 +137,24 @@ protected:
 	float					m_progress;	//0.0-100.0
 	unsigned int			m_notifSent;
 
+	LONGLONG				m_enqueueTime;
+	LONGLONG				m_startTime;
+	LONGLONG				m_firstByteTime;
+	LONGLONG				m_endTime;
+	LONGLONG				m_bytes;
+	LONGLONG				m_totalBytes;	//-1 if unknown
+	LONGLONG				m_rateTime;		//start of the current rate sample
+	LONGLONG				m_rateBytes;
+	double					m_rate;
+	LONGLONG				m_hashTime;
+	LONGLONG				m_checkTime;
+	int						m_verified;
+	int						m_mismatches;
+
 	bool					m_running;
 
 	Monitor					m_ackMonitor;
 	bool					m_terminating;
-	DWORD					m_winThread;
 
 };
 
@@ -144,10 +202,17 @@ public:
 
 	virtual const TCHAR*	GetLocalPath();
 	virtual const char*		GetExternalPath();
+
+	virtual int				SetSize(long size);	//size from the listing, saves a roundtrip
+	virtual int				SetPreview(long previewSize);	//only fetch the first and last previewSize bytes, requires the size
 protected:
+	virtual int				PerformPreview();
+
 	char*					m_externalFile;
 	TCHAR*					m_localFile;
 	Transfer_Mode			m_tMode;
+	long					m_size;
+	long					m_previewSize;
 };
 
 class QueueDownloadHandle : public QueueOperation {
@@ -161,10 +226,13 @@ public:
 
 	virtual const TCHAR*	GetLocalPath();
 	virtual const char*		GetExternalPath();
+
+	virtual int				SetSize(long size);
 protected:
 	char*					m_externalFile;
 	HANDLE					m_hFile;
 	Transfer_Mode			m_tMode;
+	long					m_size;
 };
 
 /*
@@ -295,4 +363,195 @@ protected:
 	char*					m_quote;
 };
 
+class QueueBatch : public QueueOperation {
+public:
+							QueueBatch(HWND hNotify, const vBatch & items, int notifyCode = 0, void * notifyData = NULL);
+	virtual					~QueueBatch();
+
+	virtual int				Perform();
+
+	virtual bool			Equals(const QueueOperation & other);
+
+	virtual int				GetItemCount();
+	virtual const BatchItem&	GetItem(int i);
+protected:
+	vBatch					m_items;
+};
+
+//Brings the local copy of a growing file up to date, by fetching only what was appended since offset
+class QueueFollow : public QueueOperation {
+public:
+							QueueFollow(HWND hNotify, const char * externalFile, const TCHAR * localFile, long offset, int notifyCode = 0, void * notifyData = NULL);
+	virtual					~QueueFollow();
+
+	virtual int				Perform();
+
+	virtual bool			Equals(const QueueOperation & other);
+
+	virtual const TCHAR*	GetLocalPath();
+	virtual const char*		GetExternalPath();
+	virtual bool			IsInitial();	//true if the local copy did not exist yet
+	virtual long			GetOffset();	//size of the remote file in the local copy, after performing
+	virtual long			GetReceived();	//bytes written to the local copy
+protected:
+	char*					m_externalFile;
+	TCHAR*					m_localFile;
+	bool					m_initial;
+	long					m_offset;
+	long					m_received;
+};
+
+//Connections a content search scans files with, including the one of its queue
+#define SEARCH_CONNECTIONS		3
+
+//Finds the files below a directory that contain a string. Over SFTP grep is run on the server if it allows,
+//otherwise every file is streamed through a ContentMatcher, by several connections at once
+class QueueSearch : public QueueOperation, public SearchListener {
+public:
+							QueueSearch(HWND hNotify, const char * path, const char * pattern, int notifyCode = 0, void * notifyData = NULL);
+	virtual					~QueueSearch();
+
+	virtual int				Perform();
+
+	virtual bool			Equals(const QueueOperation & other);
+
+	virtual int				SetProgress(float progress);	//files searched, not the progress of the current file
+
+	virtual const char*		GetPath();
+	virtual const char*		GetPattern();
+	virtual int				GetFileCount();		//files searched, 0 if the server searched
+	virtual int				GetFoundCount();
+
+	virtual int				OnFileFound(const char * path);
+protected:
+	virtual int				ListFiles();
+	virtual int				ScanFiles(FTPClientWrapper * wrapper);	//takes files until none are left
+	virtual int				ScanWorker();
+
+	static int				ScanThread(void * param);
+
+	char*					m_path;
+	char*					m_pattern;
+
+	std::vector<std::string>	m_files;
+	volatile LONG			m_nextFile;
+	volatile LONG			m_doneFiles;
+	volatile bool			m_stop;
+
+	Monitor					m_searchMonitor;
+	std::vector<FTPClientWrapper*>	m_workers;	//connections of the worker threads
+	VerifyTally				m_workerTally;	//of the finished workers
+	int						m_found;
+};
+
+//Connections transferring files for a synchronization, besides the one walking the directories
+#define SYNC_CONNECTIONS		2
+//Planned actions waiting for a connection. Beyond this the walking connection performs actions itself,
+//so the plan of a large tree is never held in memory as a whole
+#define SYNC_MAX_PENDING		64
+
+//Two-way synchronization of a remote directory and its local directory, recursively.
+//Each directory is planned on its own, against the manifest of the last synchronization:
+//changes on one side are copied to the other, deletions are copied as well, changes on both sides are conflicts and left alone.
+//The planned actions are performed by worker connections while the walk continues
+class QueueSync : public QueueOperation {
+public:
+							QueueSync(HWND hNotify, const char * externalDir, const TCHAR * localDir, FTPProfile * profile,
+							          bool useHashes, int notifyCode = 0, void * notifyData = NULL);
+	virtual					~QueueSync();
+
+	virtual int				Perform();
+
+	virtual bool			Equals(const QueueOperation & other);
+
+	virtual int				SetProgress(float progress);	//actions done, not the progress of the current file
+
+	virtual const char*		GetExternalPath();
+	virtual const TCHAR*	GetLocalPath();
+
+	virtual int				GetUploadCount();
+	virtual int				GetDownloadCount();
+	virtual int				GetDeleteCount();
+	virtual int				GetConflictCount();
+	virtual int				GetFailedCount();
+protected:
+	enum SyncAction { ActionNone, ActionConflict, ActionCompare, ActionUpload, ActionDownload, ActionDeleteLocal, ActionDeleteRemote };
+	enum SyncCondition { ConditionTask = 0, ConditionCount };
+
+	struct SyncDir {
+		std::string			externalDir;
+		tstring				localDir;
+		SyncManifest		manifest;	//records of this synchronization
+		int					pending;	//actions not performed yet
+		bool				uploaded;	//the remote times of uploaded files are still to be listed
+	};
+
+	struct SyncTask {
+		SyncAction			action;
+		SyncDir*			dir;
+		int					record;		//index in dir->manifest
+		bool				hadBase;	//the file was synchronized before
+		std::string			externalFile;
+		tstring				localFile;
+		long				remoteSize;
+		FILETIME			remoteTime;
+	};
+
+	struct SyncPath {
+		std::string			externalDir;
+		tstring				localDir;
+	};
+
+	struct LocalEntry {
+		tstring				name;
+		bool				isDir;
+		ULONGLONG			size;
+		FILETIME			time;
+		bool				ignored;	//hidden, system or read-only: not synchronized, nor is the remote file
+		bool				matched;	//a remote entry has the same name
+	};
+
+	virtual int				PlanDirectory(const SyncPath & path, std::vector<SyncPath> & subdirs);
+	virtual int				PlanFile(SyncDir * dir, std::vector<SyncTask> & tasks, const char * name, const char * externalFile,
+							         const FTPFile * remote, const LocalEntry * local, const TCHAR * localFile, const SyncRecord * base);
+	virtual SyncAction		Decide(bool hasRemote, bool hasLocal, bool hasBase, bool remoteChanged, bool localChanged, bool sameSize);
+
+	virtual int				QueueTask(const SyncTask & task);
+	virtual bool			TakeTask(SyncTask * task);	//must be locked
+	virtual int				PerformTask(FTPClientWrapper * wrapper, const SyncTask & task);
+	virtual int				FinishDirectory(FTPClientWrapper * wrapper, SyncDir * dir);
+	virtual int				UpdateProgress();
+	virtual int				Stop();
+
+	virtual int				SyncWorker();
+	static int				SyncThread(void * param);
+
+	static int				ListLocal(const TCHAR * localDir, std::vector<LocalEntry> & entries);
+	static bool				CompareLocal(const LocalEntry & entry, const TCHAR * name);
+	static bool				CompareEntries(const LocalEntry & a, const LocalEntry & b);
+
+	char*					m_externalDir;
+	TCHAR*					m_localDir;
+	FTPProfile*				m_profile;	//transfer mode of the files
+	bool					m_useHashes;
+
+	Monitor					m_syncMonitor;
+	std::deque<SyncTask>	m_tasks;
+	std::vector<SyncDir*>	m_dirs;		//planned, not all actions performed yet
+	std::vector<FTPClientWrapper*>	m_workers;	//connections of the worker threads
+	VerifyTally				m_workerTally;	//of the finished workers
+	ThreadHandle			m_threads[SYNC_CONNECTIONS];
+	int						m_nrThreads;
+	bool					m_walkDone;
+	volatile bool			m_stop;
+
+	volatile LONG			m_planned;
+	volatile LONG			m_done;
+	volatile LONG			m_uploads;
+	volatile LONG			m_downloads;
+	volatile LONG			m_deletes;
+	volatile LONG			m_conflicts;
+	volatile LONG			m_failed;
+};
+
 #endif //QUEUEOPERATION_H
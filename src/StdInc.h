@@ -33,6 +33,7 @@
 
 //Common project headers
 #include "Output.h"
+#include "Trace.h"
 #include "StringUtils.h"
 #include "PathUtils.h"
 #include "WinPlatform.h"
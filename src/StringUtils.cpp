@@ -20,6 +20,9 @@
 //#include "StringUtils.h"
 
 #include <wchar.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifdef UNICODE
 #define EXECUNICODE(s) {s}
@@ -29,46 +32,100 @@
 #define EXECMBYTE(s) {s}
 #endif //UNICODE
 
-TCHAR* SU::Utf8ToTChar(const char * utf8string) {
-	if (utf8string == NULL)
-		return NULL;
+//Pure ASCII strings convert by widening or narrowing each character, without the Win32 conversion functions
+static bool IsAscii(const char * string, size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	for(; i+16 <= len; i += 16) {
+		__m128i chars = _mm_loadu_si128((const __m128i*)(string+i));
+		if (_mm_movemask_epi8(chars) != 0)
+			return false;
+	}
+#else
+	for(; i+4 <= len; i += 4) {
+		DWORD chars;
+		memcpy(&chars, string+i, 4);
+		if (chars & 0x80808080)
+			return false;
+	}
+#endif
+	for(; i < len; i++) {
+		if ((unsigned char)string[i] & 0x80)
+			return false;
+	}
+	return true;
+}
 
-	if (utf8string[0] == 0) {
-		TCHAR * empty = new TCHAR[1];
-		empty[0] = 0;
-		return empty;
+#ifdef UNICODE
+static bool IsAscii(const wchar_t * string, size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i highMask = _mm_set1_epi16((short)0xFF80);
+	const __m128i zero = _mm_setzero_si128();
+	for(; i+8 <= len; i += 8) {
+		__m128i chars = _mm_loadu_si128((const __m128i*)(string+i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chars, highMask), zero)) != 0xFFFF)
+			return false;
 	}
+#endif
+	for(; i < len; i++) {
+		if (string[i] & 0xFF80)
+			return false;
+	}
+	return true;
+}
 
-	int size = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, NULL, 0);
-	if (size == 0)
-		return NULL;
+//len+1 characters are copied, including the terminator
+static void WidenAscii(const char * string, wchar_t * buffer, size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for(; i+16 <= len; i += 16) {
+		__m128i chars = _mm_loadu_si128((const __m128i*)(string+i));
+		_mm_storeu_si128((__m128i*)(buffer+i), _mm_unpacklo_epi8(chars, zero));
+		_mm_storeu_si128((__m128i*)(buffer+i+8), _mm_unpackhi_epi8(chars, zero));
+	}
+#endif
+	for(; i <= len; i++) {
+		buffer[i] = (unsigned char)string[i];
+	}
+}
 
-	wchar_t * wstring = new wchar_t[size];
-	int ret = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, wstring, size);
-	if (ret == 0) {
-		delete [] wstring;
-		return NULL;
+static void NarrowAscii(const wchar_t * string, char * buffer, size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	for(; i+16 <= len; i += 16) {
+		__m128i low = _mm_loadu_si128((const __m128i*)(string+i));
+		__m128i high = _mm_loadu_si128((const __m128i*)(string+i+8));
+		_mm_storeu_si128((__m128i*)(buffer+i), _mm_packus_epi16(low, high));
+	}
+#endif
+	for(; i <= len; i++) {
+		buffer[i] = (char)string[i];
 	}
+}
+#endif //UNICODE
 
-#ifdef UNICODE
-	return wstring;
-#else
-	size = ::WideCharToMultiByte(CP_ACP, 0, wstring, -1, NULL, 0, NULL, NULL);
-	if (size == 0) {
-		delete [] wstring;
+//ASCII is the same in UTF-8 and the ANSI codepages
+static bool IsAsciiCompatible(int cp) {
+	return (cp == CP_UTF8 || cp == CP_ACP);
+}
+
+TCHAR* SU::Utf8ToTChar(const char * utf8string) {
+	if (utf8string == NULL)
 		return NULL;
-	}
-	char * tstring = new char[size];
-	ret = ::WideCharToMultiByte(CP_ACP, 0, wstring, -1, tstring, size, NULL, NULL);
-	delete [] wstring;
 
-	if (ret == 0) {
+	int size = Utf8ToTCharSize(utf8string);
+	if (size == 0)
+		return NULL;
+
+	TCHAR * tstring = new TCHAR[size];
+	if (Utf8ToTChar(utf8string, tstring, size) == -1) {
 		delete [] tstring;
 		return NULL;
 	}
 
 	return tstring;
-#endif //UNICODE
 }
 
 char* SU::TCharToUtf8(const TCHAR * string) {
@@ -76,48 +133,145 @@ char* SU::TCharToUtf8(const TCHAR * string) {
 }
 
 char* SU::TCharToCP(const TCHAR * string, int cp) {
-	int size = 0;
-	int ret = 0;
-
 	if (string == NULL)
 		return NULL;
 
-	if (string[0] == 0) {
-		char * empty = new char[1];
-		empty[0] = 0;
-		return empty;
-	}
-
-#ifndef UNICODE
-	size = ::MultiByteToWideChar(CP_ACP, 0, string, -1, NULL, 0);
+	int size = TCharToCPSize(string, cp);
 	if (size == 0)
 		return NULL;
 
-	wchar_t * wstring = new wchar_t[size];
-	ret = ::MultiByteToWideChar(CP_ACP, 0, string, -1, wstring, size);
-	if (ret == 0) {
-		delete [] wstring;
+	char * cpstring = new char[size];
+	if (TCharToCP(string, cp, cpstring, size) == -1) {
+		delete [] cpstring;
 		return NULL;
 	}
+
+	return cpstring;
+}
+
+int SU::Utf8ToTChar(const char * utf8string, TCHAR * buffer, int bufferSize) {
+	if (utf8string == NULL || buffer == NULL || bufferSize < 1)
+		return -1;
+
+	buffer[0] = 0;
+
+	size_t len = strlen(utf8string);
+	if (IsAscii(utf8string, len)) {
+		if (len+1 > (size_t)bufferSize)
+			return -1;
+#ifdef UNICODE
+		WidenAscii(utf8string, buffer, len);
 #else
-	const wchar_t * wstring = string;
+		memcpy(buffer, utf8string, len+1);
+#endif
+		return (int)len;
+	}
+
+#ifdef UNICODE
+	int ret = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, buffer, bufferSize);
+	if (ret == 0) {
+		buffer[0] = 0;
+		return -1;
+	}
+	return ret-1;
+#else
+	int size = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, NULL, 0);
+	if (size == 0)
+		return -1;
+	wchar_t * wstring = new wchar_t[size];
+	int ret = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, wstring, size);
+	if (ret != 0)
+		ret = ::WideCharToMultiByte(CP_ACP, 0, wstring, -1, buffer, bufferSize, NULL, NULL);
+	delete [] wstring;
+	if (ret == 0) {
+		buffer[0] = 0;
+		return -1;
+	}
+	return ret-1;
 #endif //UNICODE
+}
 
-	size = ::WideCharToMultiByte(cp, 0, wstring, -1, NULL, 0, NULL, NULL);
-	if (size == 0) {
-		EXECMBYTE(delete [] wstring;)
-		return NULL;
+int SU::TCharToUtf8(const TCHAR * string, char * buffer, int bufferSize) {
+	return TCharToCP(string, CP_UTF8, buffer, bufferSize);
+}
+
+int SU::TCharToCP(const TCHAR * string, int cp, char * buffer, int bufferSize) {
+	if (string == NULL || buffer == NULL || bufferSize < 1)
+		return -1;
+
+	buffer[0] = 0;
+
+	size_t len = lstrlen(string);
+	if (IsAsciiCompatible(cp) && IsAscii(string, len)) {
+		if (len+1 > (size_t)bufferSize)
+			return -1;
+#ifdef UNICODE
+		NarrowAscii(string, buffer, len);
+#else
+		memcpy(buffer, string, len+1);
+#endif
+		return (int)len;
 	}
-	char * utf8string = new char[size];
-	ret = ::WideCharToMultiByte(cp, 0, wstring, -1, utf8string, size, NULL, NULL);
-	EXECMBYTE(delete [] wstring;)
 
+#ifdef UNICODE
+	int ret = ::WideCharToMultiByte(cp, 0, string, -1, buffer, bufferSize, NULL, NULL);
+#else
+	int ret = 0;
+	wchar_t * wstring = CharToWChar(string);
+	if (wstring != NULL) {
+		ret = ::WideCharToMultiByte(cp, 0, wstring, -1, buffer, bufferSize, NULL, NULL);
+		FreeWChar(wstring);
+	}
+#endif //UNICODE
 	if (ret == 0) {
-		delete [] utf8string;
-		return NULL;
+		buffer[0] = 0;
+		return -1;
 	}
+	return ret-1;
+}
 
-	return utf8string;
+int SU::Utf8ToTCharSize(const char * utf8string) {
+	if (utf8string == NULL)
+		return 0;
+
+	size_t len = strlen(utf8string);
+	if (IsAscii(utf8string, len))
+		return (int)len+1;
+
+#ifdef UNICODE
+	return ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, NULL, 0);
+#else
+	int size = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, NULL, 0);
+	if (size == 0)
+		return 0;
+	wchar_t * wstring = new wchar_t[size];
+	int ret = ::MultiByteToWideChar(CP_UTF8, 0, utf8string, -1, wstring, size);
+	if (ret != 0)
+		ret = ::WideCharToMultiByte(CP_ACP, 0, wstring, -1, NULL, 0, NULL, NULL);
+	delete [] wstring;
+	return ret;
+#endif //UNICODE
+}
+
+int SU::TCharToCPSize(const TCHAR * string, int cp) {
+	if (string == NULL)
+		return 0;
+
+	size_t len = lstrlen(string);
+	if (IsAsciiCompatible(cp) && IsAscii(string, len))
+		return (int)len+1;
+
+#ifdef UNICODE
+	return ::WideCharToMultiByte(cp, 0, string, -1, NULL, 0, NULL, NULL);
+#else
+	int ret = 0;
+	wchar_t * wstring = CharToWChar(string);
+	if (wstring != NULL) {
+		ret = ::WideCharToMultiByte(cp, 0, wstring, -1, NULL, 0, NULL, NULL);
+		FreeWChar(wstring);
+	}
+	return ret;
+#endif //UNICODE
 }
 
 TCHAR* SU::DupString(const TCHAR* string) {
@@ -376,3 +530,42 @@ char* SU::HexToData(const char * hex, int len, bool addZero) {
 
 	return (char*)data;
 }
+
+Utf8ToTCharStr::Utf8ToTCharStr(const char * utf8string) :
+	m_string(NULL)
+{
+	if (utf8string == NULL)
+		return;
+
+	if (SU::Utf8ToTChar(utf8string, m_buffer, MAX_PATH) != -1) {
+		m_string = m_buffer;
+		return;
+	}
+
+	//does not fit, or invalid
+	m_string = SU::Utf8ToTChar(utf8string);
+}
+
+Utf8ToTCharStr::~Utf8ToTCharStr() {
+	if (m_string != m_buffer)
+		SU::FreeTChar(m_string);
+}
+
+TCharToCPStr::TCharToCPStr(const TCHAR * string, int cp) :
+	m_string(NULL)
+{
+	if (string == NULL)
+		return;
+
+	if (SU::TCharToCP(string, cp, m_buffer, MAX_PATH*2) != -1) {
+		m_string = m_buffer;
+		return;
+	}
+
+	m_string = SU::TCharToCP(string, cp);
+}
+
+TCharToCPStr::~TCharToCPStr() {
+	if (m_string != m_buffer)
+		SU::FreeChar(m_string);
+}
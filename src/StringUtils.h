@@ -31,6 +31,16 @@ public:
 	static char*			TCharToUtf8(const TCHAR * string);
 	static char*			TCharToCP(const TCHAR * string, int cp);
 
+							//Convert into a caller provided buffer: return length without terminator, -1 on error or if the buffer is too small
+							//The buffer is always zero terminated if bufferSize > 0
+	static int				Utf8ToTChar(const char * utf8string, TCHAR * buffer, int bufferSize);
+	static int				TCharToUtf8(const TCHAR * string, char * buffer, int bufferSize);
+	static int				TCharToCP(const TCHAR * string, int cp, char * buffer, int bufferSize);
+
+							//Required buffer size including terminator, 0 on error
+	static int				Utf8ToTCharSize(const char * utf8string);
+	static int				TCharToCPSize(const TCHAR * string, int cp);
+
 	static TCHAR*			DupString(const TCHAR * string);
 	static char*			strdup(const char * string);
 
@@ -53,4 +63,34 @@ public:
 private:
 };
 
+//Converted string for temporary use, short strings do not allocate
+//c_str() returns NULL if the source was NULL or could not be converted
+class Utf8ToTCharStr {
+public:
+							Utf8ToTCharStr(const char * utf8string);
+							~Utf8ToTCharStr();
+
+	const TCHAR*			c_str() const { return m_string; };
+private:
+							Utf8ToTCharStr(const Utf8ToTCharStr &);
+	Utf8ToTCharStr&			operator=(const Utf8ToTCharStr &);
+
+	TCHAR					m_buffer[MAX_PATH];
+	TCHAR*					m_string;
+};
+
+class TCharToCPStr {
+public:
+							TCharToCPStr(const TCHAR * string, int cp = CP_UTF8);
+							~TCharToCPStr();
+
+	const char*				c_str() const { return m_string; };
+private:
+							TCharToCPStr(const TCharToCPStr &);
+	TCharToCPStr&			operator=(const TCharToCPStr &);
+
+	char					m_buffer[MAX_PATH*2];
+	char*					m_string;
+};
+
 #endif //STRINGUTILS_H
@@ -0,0 +1,284 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "SyncManifest.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+//Manifests are rewritten by synchronizations and by the eviction of the cache
+static Monitor _ManifestMonitor(0);
+
+static bool CompareRecords(const SyncRecord & a, const SyncRecord & b) {
+	return a.name < b.name;
+}
+
+//Same mapping of remote names as synchronization uses
+static bool LocalNameOf(const std::string & name, TCHAR * localName) {
+	return PU::ExternalToLocalPath(name.c_str(), localName, MAX_PATH) != -1;
+}
+
+SyncManifest::SyncManifest() {
+}
+
+SyncManifest::~SyncManifest() {
+}
+
+int SyncManifest::Load(const TCHAR * localDir) {
+	Clear();
+
+	TCHAR path[MAX_PATH];
+	if (PU::ConcatLocal(localDir, SYNC_MANIFEST_NAME, path, MAX_PATH) == -1)
+		return -1;
+
+	HANDLE hFile = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		DWORD error = ::GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+			return 1;
+		OutErr("[NppFTP.Sync] Unable to open %T", path);
+		return -1;
+	}
+
+	std::string contents;
+	char buffer[16*1024];
+	DWORD bytesRead = 0;
+	while(::ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0)
+		contents.append(buffer, bytesRead);
+	::CloseHandle(hFile);
+
+	size_t pos = contents.find('\n');
+	if (pos == std::string::npos || contents.compare(0, pos, SYNC_MANIFEST_HEADER) != 0) {
+		OutErr("[NppFTP.Sync] Unknown manifest format in %T", path);
+		return -1;
+	}
+	pos++;
+
+	//Lines that cannot be parsed are skipped, those files count as never synchronized
+	SyncRecord record;
+	char hash[SYNC_HASH_SIZE*2+1];
+	while(pos < contents.size()) {
+		size_t end = contents.find('\n', pos);
+		if (end == std::string::npos)
+			break;	//incomplete, the manifest was cut off
+		std::string line = contents.substr(pos, end-pos);
+		pos = end+1;
+
+		//The name is the rest of the line after the single space that follows the hash, it may start with spaces itself
+		int nameOffset = 0;
+		int res = sscanf(line.c_str(), "%ld %lu %lu %I64u %lu %lu %40s%n",
+						&record.remoteSize, &record.remoteTime.dwHighDateTime, &record.remoteTime.dwLowDateTime,
+						&record.localSize, &record.localTime.dwHighDateTime, &record.localTime.dwLowDateTime,
+						hash, &nameOffset);
+		if (res < 7 || nameOffset == 0 || (size_t)nameOffset+1 >= line.size() || line[nameOffset] != ' ')
+			continue;
+		nameOffset++;
+
+		record.hasHash = (strlen(hash) == SYNC_HASH_SIZE*2);
+		if (record.hasHash) {
+			char * data = SU::HexToData(hash, SYNC_HASH_SIZE*2, false);
+			memcpy(record.hash, data, SYNC_HASH_SIZE);
+			SU::FreeChar(data);
+		}
+
+		record.name = line.substr(nameOffset);
+		m_records.push_back(record);
+	}
+
+	std::sort(m_records.begin(), m_records.end(), CompareRecords);
+
+	return 0;
+}
+
+int SyncManifest::Save(const TCHAR * localDir) {
+	TCHAR path[MAX_PATH];
+	if (PU::ConcatLocal(localDir, SYNC_MANIFEST_NAME, path, MAX_PATH) == -1)
+		return -1;
+
+	_ManifestMonitor.Enter();
+
+	//A file evicted meanwhile must not keep its record
+	std::string contents = SYNC_MANIFEST_HEADER "\n";
+	char buffer[128];
+	TCHAR localName[MAX_PATH];
+	TCHAR localFile[MAX_PATH];
+	int count = 0;
+	for(size_t i = 0; i < m_records.size(); i++) {
+		const SyncRecord & record = m_records[i];
+		if (record.name.empty() || record.name.find('\n') != std::string::npos)
+			continue;
+		if (!LocalNameOf(record.name, localName) || PU::ConcatLocal(localDir, localName, localFile, MAX_PATH) == -1)
+			continue;
+		if (::GetFileAttributes(localFile) == INVALID_FILE_ATTRIBUTES)
+			continue;
+
+		sprintf(buffer, "%ld %lu %lu %I64u %lu %lu ",
+				record.remoteSize, record.remoteTime.dwHighDateTime, record.remoteTime.dwLowDateTime,
+				record.localSize, record.localTime.dwHighDateTime, record.localTime.dwLowDateTime);
+		contents += buffer;
+		if (record.hasHash) {
+			char * hex = SU::DataToHex((const char*)record.hash, SYNC_HASH_SIZE);
+			contents += hex;
+			SU::FreeChar(hex);
+		} else {
+			contents += "-";
+		}
+		contents += " ";
+		contents += record.name;
+		contents += "\n";
+		count++;
+	}
+
+	if (count == 0) {
+		::SetFileAttributes(path, FILE_ATTRIBUTE_NORMAL);
+		::DeleteFile(path);
+		_ManifestMonitor.Exit();
+		return 0;
+	}
+
+	//An existing hidden file can only be overwritten when the attribute is given again
+	HANDLE hFile = ::CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		_ManifestMonitor.Exit();
+		OutErr("[NppFTP.Sync] Unable to create %T", path);
+		return -1;
+	}
+
+	DWORD written = 0;
+	BOOL res = ::WriteFile(hFile, contents.c_str(), (DWORD)contents.size(), &written, NULL);
+	::CloseHandle(hFile);
+	_ManifestMonitor.Exit();
+	if (res == FALSE || written != contents.size()) {
+		OutErr("[NppFTP.Sync] Unable to write %T", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+const SyncRecord* SyncManifest::Find(const char * name) const {
+	vSyncRecord::const_iterator it = std::lower_bound(m_records.begin(), m_records.end(), name, CompareName);
+	if (it == m_records.end() || it->name != name)
+		return NULL;
+
+	return &(*it);
+}
+
+int SyncManifest::Add(const SyncRecord & record) {
+	m_records.push_back(record);
+	return (int)m_records.size() - 1;
+}
+
+SyncRecord* SyncManifest::GetRecord(int index) {
+	if (index < 0 || index >= (int)m_records.size())
+		return NULL;
+
+	return &m_records[index];
+}
+
+int SyncManifest::Remove(int index) {
+	if (index < 0 || index >= (int)m_records.size())
+		return -1;
+
+	m_records[index].name.clear();
+	return 0;
+}
+
+int SyncManifest::Clear() {
+	m_records.clear();
+	return 0;
+}
+
+int SyncManifest::EvictLocal(const TCHAR * localFile) {
+	const TCHAR * name = PU::FindLocalFilename(localFile);
+	if (name == NULL || name == localFile)
+		return -1;
+
+	TCHAR localDir[MAX_PATH];
+	lstrcpyn(localDir, localFile, (int)(name - localFile));	//without the separator
+
+	//Locked from the deletion until the record is gone, so a synchronization finishing meanwhile cannot save it again
+	_ManifestMonitor.Enter();
+		::SetFileAttributes(localFile, FILE_ATTRIBUTE_NORMAL);	//previews are read-only
+		if (!::DeleteFile(localFile)) {
+			_ManifestMonitor.Exit();
+			return -1;
+		}
+
+		SyncManifest manifest;
+		if (manifest.Load(localDir) == 0) {
+			TCHAR localName[MAX_PATH];
+			SyncRecord * record = NULL;
+			for(int i = 0; (record = manifest.GetRecord(i)) != NULL; i++) {
+				if (LocalNameOf(record->name, localName) && !lstrcmpi(localName, name)) {
+					manifest.Remove(i);
+					manifest.Save(localDir);
+					break;
+				}
+			}
+		}
+	_ManifestMonitor.Exit();
+
+	return 0;
+}
+
+int SyncManifest::ReadLocal(const TCHAR * localFile, SyncRecord * record, bool hash) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesEx(localFile, GetFileExInfoStandard, &attributes))
+		return -1;
+
+	record->localSize = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	record->localTime = attributes.ftLastWriteTime;
+	record->hasHash = false;
+
+	if (hash) {
+		if (HashLocal(localFile, record->hash) == -1)
+			return -1;
+		record->hasHash = true;
+	}
+
+	return 0;
+}
+
+int SyncManifest::HashLocal(const TCHAR * localFile, unsigned char * hash) {
+	HANDLE hFile = ::CreateFile(localFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return -1;
+
+	SHA_CTX context;
+	SHA1_Init(&context);
+
+	char buffer[64*1024];
+	DWORD bytesRead = 0;
+	BOOL res = TRUE;
+	while((res = ::ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL)) && bytesRead > 0)
+		SHA1_Update(&context, buffer, bytesRead);
+	::CloseHandle(hFile);
+
+	if (!res)
+		return -1;
+
+	SHA1_Final(hash, &context);
+
+	return 0;
+}
+
+bool SyncManifest::CompareName(const SyncRecord & record, const char * name) {
+	return record.name < name;
+}
@@ -0,0 +1,72 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNCMANIFEST_H
+#define SYNCMANIFEST_H
+
+#include "SyncState.h"
+
+//File kept in every synchronized local directory, hidden
+#define SYNC_MANIFEST_NAME		TEXT(".nppftpsync")
+#define SYNC_MANIFEST_HEADER	"NppFTP sync 1"
+
+//Both sides of a file as they were when it was last synchronized
+struct SyncRecord {
+	std::string				name;			//remote name
+	long					remoteSize;
+	FILETIME				remoteTime;		//as listed
+	ULONGLONG				localSize;
+	FILETIME				localTime;		//last write time
+	bool					hasHash;
+	unsigned char			hash[SYNC_HASH_SIZE];	//SHA-1 of the local file, optional
+};
+
+typedef std::vector<SyncRecord> vSyncRecord;
+
+//Sync base of a single local directory: the records of the files synchronized last time.
+//Directories are loaded one at a time, so only the tree being walked is kept in memory
+class SyncManifest {
+public:
+							SyncManifest();
+	virtual					~SyncManifest();
+
+	virtual int				Load(const TCHAR * localDir);	//return 1 if there is no manifest, which is not an error
+	virtual int				Save(const TCHAR * localDir);	//drops records of missing local files, removes the manifest if none are left
+
+	virtual const SyncRecord*	Find(const char * name) const;	//NULL if unknown, only after Load
+
+							//Records of a manifest being built, accessed by index as the files get synchronized
+	virtual int				Add(const SyncRecord & record);		//returns the index
+	virtual SyncRecord*		GetRecord(int index);
+	virtual int				Remove(int index);	//the file is gone on both sides, not saved
+	virtual int				Clear();
+
+							//Delete a file of the cache and drop its record. A record of a missing file means the user deleted it,
+							//which synchronization copies to the server, so the cache must not leave one behind
+	static int				EvictLocal(const TCHAR * localFile);
+
+							//Fill the local part of record from the file, hashing it if requested
+	static int				ReadLocal(const TCHAR * localFile, SyncRecord * record, bool hash);
+	static int				HashLocal(const TCHAR * localFile, unsigned char * hash);
+private:
+	static bool				CompareName(const SyncRecord & record, const char * name);
+
+	vSyncRecord				m_records;	//sorted by name when loaded, removed records have no name
+};
+
+#endif //SYNCMANIFEST_H
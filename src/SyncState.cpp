@@ -0,0 +1,268 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "SyncState.h"
+
+SyncSignature::SyncSignature() :
+	m_blockFill(0),
+	m_size(0)
+{
+	SHA1_Init(&m_context);
+}
+
+SyncSignature::~SyncSignature() {
+}
+
+int SyncSignature::Update(const char * data, size_t len) {
+	while(len > 0) {
+		size_t part = SYNC_BLOCK_SIZE - m_blockFill;
+		if (part > len)
+			part = len;
+
+		SHA1_Update(&m_context, data, part);
+		m_blockFill += part;
+		m_size += (long)part;
+		data += part;
+		len -= part;
+
+		if (m_blockFill == SYNC_BLOCK_SIZE) {
+			unsigned char hash[SYNC_HASH_SIZE];
+			SHA1_Final(hash, &m_context);
+			m_hashes.insert(m_hashes.end(), hash, hash+SYNC_HASH_SIZE);
+			SHA1_Init(&m_context);
+			m_blockFill = 0;
+		}
+	}
+
+	return 0;
+}
+
+int SyncSignature::Finish() {
+	if (m_blockFill == 0)
+		return 0;
+
+	unsigned char hash[SYNC_HASH_SIZE];
+	SHA1_Final(hash, &m_context);
+	m_hashes.insert(m_hashes.end(), hash, hash+SYNC_HASH_SIZE);
+	SHA1_Init(&m_context);
+	m_blockFill = 0;
+
+	return 0;
+}
+
+int SyncSignature::Clear() {
+	SHA1_Init(&m_context);
+	m_blockFill = 0;
+	m_size = 0;
+	m_hashes.clear();
+
+	return 0;
+}
+
+long SyncSignature::GetSize() const {
+	return m_size;
+}
+
+int SyncSignature::GetBlockCount() const {
+	return (int)(m_hashes.size()/SYNC_HASH_SIZE);
+}
+
+const unsigned char* SyncSignature::GetBlockHash(int block) const {
+	if (block < 0 || block >= GetBlockCount())
+		return NULL;
+
+	return &m_hashes[block*SYNC_HASH_SIZE];
+}
+
+bool SyncSignature::BlockEquals(const SyncSignature & other, int block) const {
+	const unsigned char * hash = GetBlockHash(block);
+	const unsigned char * otherHash = other.GetBlockHash(block);
+	if (hash == NULL || otherHash == NULL)
+		return false;
+
+	return !memcmp(hash, otherHash, SYNC_HASH_SIZE);
+}
+
+//////////////////////////////////////
+
+SyncState::SyncState() :
+	m_monitor(0)
+{
+}
+
+SyncState::~SyncState() {
+	Clear();
+}
+
+int SyncState::Set(const char * externalPath, const SyncSignature & signature, unsigned long remoteTime) {
+	m_monitor.Enter();
+		SyncEntry * entry = Acquire(externalPath);
+		entry->hasSignature = true;
+		entry->remoteTime = remoteTime;
+		entry->signature = signature;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int SyncState::Get(const char * externalPath, SyncSignature * signature, unsigned long * remoteTime) {
+	int ret = -1;
+
+	m_monitor.Enter();
+		int index = Find(externalPath);
+		if (index != -1 && m_entries[index]->hasSignature) {
+			*signature = m_entries[index]->signature;
+			*remoteTime = m_entries[index]->remoteTime;
+			ret = 0;
+		}
+	m_monitor.Exit();
+
+	return ret;
+}
+
+int SyncState::SetCached(const char * externalPath, const TCHAR * localPath, long remoteSize, FILETIME remoteTime) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesEx(localPath, GetFileExInfoStandard, &attributes)) {
+		ClearCached(externalPath);
+		return -1;
+	}
+
+	m_monitor.Enter();
+		SyncEntry * entry = Acquire(externalPath);
+		SU::FreeTChar(entry->localPath);
+		entry->isCached = true;
+		entry->localPath = SU::DupString(localPath);
+		entry->listedSize = remoteSize;
+		entry->modTime = remoteTime;
+		entry->localSize = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+		entry->localTime = attributes.ftLastWriteTime;
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int SyncState::ClearCached(const char * externalPath) {
+	m_monitor.Enter();
+		int index = Find(externalPath);
+		if (index != -1) {
+			SyncEntry * entry = m_entries[index];
+			entry->isCached = false;
+			SU::FreeTChar(entry->localPath);
+			entry->localPath = NULL;
+		}
+	m_monitor.Exit();
+
+	return 0;
+}
+
+bool SyncState::IsCacheCurrent(const char * externalPath, const TCHAR * localPath, long remoteSize, FILETIME remoteTime) {
+	bool current = false;
+	ULONGLONG localSize = 0;
+	FILETIME localTime = {0, 0};
+
+	m_monitor.Enter();
+		int index = Find(externalPath);
+		if (index != -1) {
+			const SyncEntry * entry = m_entries[index];
+			current = entry->isCached &&
+					  !lstrcmpi(entry->localPath, localPath) &&
+					  entry->listedSize == remoteSize &&
+					  !CompareFileTime(&(entry->modTime), &remoteTime);
+			localSize = entry->localSize;
+			localTime = entry->localTime;
+		}
+	m_monitor.Exit();
+
+	if (!current)
+		return false;
+
+	//The local copy must not have been changed since
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesEx(localPath, GetFileExInfoStandard, &attributes))
+		return false;
+
+	ULONGLONG size = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	return (size == localSize && !CompareFileTime(&(attributes.ftLastWriteTime), &localTime));
+}
+
+int SyncState::Remove(const char * externalPath) {
+	m_monitor.Enter();
+		int index = Find(externalPath);
+		if (index != -1) {
+			FreeEntry(m_entries[index]);
+			m_entries.erase(m_entries.begin()+index);
+		}
+	m_monitor.Exit();
+
+	return 0;
+}
+
+int SyncState::Clear() {
+	m_monitor.Enter();
+		for(size_t i = 0; i < m_entries.size(); i++) {
+			FreeEntry(m_entries[i]);
+		}
+		m_entries.clear();
+	m_monitor.Exit();
+
+	return 0;
+}
+
+SyncState::SyncEntry* SyncState::Acquire(const char * externalPath) {
+	SyncEntry * entry = NULL;
+
+	int index = Find(externalPath);
+	if (index != -1) {
+		entry = m_entries[index];
+		m_entries.erase(m_entries.begin()+index);
+	} else {
+		if (m_entries.size() >= SYNC_MAX_ENTRIES) {
+			FreeEntry(m_entries[0]);
+			m_entries.erase(m_entries.begin());
+		}
+		entry = new SyncEntry;
+		entry->externalPath = SU::strdup(externalPath);
+		entry->hasSignature = false;
+		entry->remoteTime = 0;
+		entry->isCached = false;
+		entry->localPath = NULL;
+		entry->listedSize = -1;
+		entry->localSize = 0;
+	}
+	m_entries.push_back(entry);	//most recent last
+
+	return entry;
+}
+
+int SyncState::FreeEntry(SyncEntry * entry) {
+	SU::free(entry->externalPath);
+	SU::FreeTChar(entry->localPath);
+	delete entry;
+
+	return 0;
+}
+
+int SyncState::Find(const char * externalPath) {
+	for(size_t i = 0; i < m_entries.size(); i++) {
+		if (!strcmp(m_entries[i]->externalPath, externalPath))
+			return (int)i;
+	}
+
+	return -1;
+}
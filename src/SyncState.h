@@ -0,0 +1,98 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNCSTATE_H
+#define SYNCSTATE_H
+
+#include "Monitor.h"
+#include <openssl/sha.h>
+
+//Block size of the signatures, a changed byte causes a rewrite of its whole block
+#define SYNC_BLOCK_SIZE		(16*1024)
+#define SYNC_HASH_SIZE		SHA_DIGEST_LENGTH
+//Max number of files a signature is kept for, the oldest is dropped
+#define SYNC_MAX_ENTRIES	256
+
+//SHA-1 of each SYNC_BLOCK_SIZE block of a file, built while the file is transferred
+class SyncSignature {
+public:
+							SyncSignature();
+	virtual					~SyncSignature();
+
+	virtual int				Update(const char * data, size_t len);	//sequential data of the file
+	virtual int				Finish();								//hash the last, partial, block
+
+	virtual int				Clear();
+
+	virtual long			GetSize() const;
+	virtual int				GetBlockCount() const;
+	virtual const unsigned char*	GetBlockHash(int block) const;
+	virtual bool			BlockEquals(const SyncSignature & other, int block) const;
+private:
+	SHA_CTX					m_context;
+	size_t					m_blockFill;	//bytes hashed of the current block
+	long					m_size;
+	std::vector<unsigned char>	m_hashes;
+};
+
+//State of the last synchronized version of each remote file:
+//-The block signature and remote modification time, used for delta uploads
+//-The size and exact modification time of the remote file and the state of the local copy, used to skip downloads
+//Shared by the wrappers and queues of a session, so all access is locked
+class SyncState {
+public:
+							SyncState();
+	virtual					~SyncState();
+
+	virtual int				Set(const char * externalPath, const SyncSignature & signature, unsigned long remoteTime);
+	virtual int				Get(const char * externalPath, SyncSignature * signature, unsigned long * remoteTime);	//return -1 if unknown
+
+							//remoteSize as listed, remoteTime to the second (MDTM or SFTP), the local file has just been downloaded
+	virtual int				SetCached(const char * externalPath, const TCHAR * localPath, long remoteSize, FILETIME remoteTime);
+	virtual int				ClearCached(const char * externalPath);
+							//true if localPath is still the download of the remote file as it is now
+	virtual bool			IsCacheCurrent(const char * externalPath, const TCHAR * localPath, long remoteSize, FILETIME remoteTime);
+
+	virtual int				Remove(const char * externalPath);
+	virtual int				Clear();
+private:
+	struct SyncEntry {
+		char*				externalPath;
+
+		bool				hasSignature;
+		unsigned long		remoteTime;
+		SyncSignature		signature;
+
+		bool				isCached;
+		TCHAR*				localPath;
+		long				listedSize;
+		FILETIME			modTime;
+		ULONGLONG			localSize;
+		FILETIME			localTime;		//last write time of the local copy
+	};
+
+	SyncEntry*				Acquire(const char * externalPath);	//existing or new entry, moved to the back
+	static int				FreeEntry(SyncEntry * entry);
+
+	int						Find(const char * externalPath);
+
+	Monitor					m_monitor;
+	std::vector<SyncEntry*>	m_entries;	//oldest first
+};
+
+#endif //SYNCSTATE_H
@@ -0,0 +1,79 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "Thread.h"
+
+struct ThreadStart {
+	ThreadFunction			function;
+	void*					param;
+};
+
+static DWORD WINAPI ThreadEntry(LPVOID param) {
+	ThreadStart start = *(ThreadStart*)param;
+	delete (ThreadStart*)param;
+
+	return (DWORD)start.function(start.param);
+}
+
+ThreadHandle Thread::Start(ThreadFunction function, void * param, int priority) {
+	ThreadStart * start = new ThreadStart;
+	start->function = function;
+	start->param = param;
+
+	//Created suspended, so the priority applies from the first instruction
+	HANDLE hThread = ::CreateThread(NULL, 0, &ThreadEntry, start, CREATE_SUSPENDED, NULL);
+	if (hThread == NULL) {
+		delete start;
+		return NULL;
+	}
+
+	int winPriority = THREAD_PRIORITY_NORMAL;
+	if (priority < PriorityNormal)
+		winPriority = THREAD_PRIORITY_BELOW_NORMAL;
+	else if (priority > PriorityNormal)
+		winPriority = THREAD_PRIORITY_ABOVE_NORMAL;
+	if (winPriority != THREAD_PRIORITY_NORMAL)
+		::SetThreadPriority(hThread, winPriority);
+	::ResumeThread(hThread);
+
+	return (ThreadHandle)hThread;
+}
+
+int Thread::Join(ThreadHandle * threads, int count) {
+	if (count <= 0)
+		return 0;
+
+	::WaitForMultipleObjects(count, (HANDLE*)threads, TRUE, INFINITE);
+	for(int i = 0; i < count; i++)
+		::CloseHandle((HANDLE)threads[i]);
+
+	return 0;
+}
+
+int Thread::Detach(ThreadHandle thread) {
+	if (thread == NULL)
+		return -1;
+
+	::CloseHandle((HANDLE)thread);
+	return 0;
+}
+
+unsigned long Thread::CurrentId() {
+	return ::GetCurrentThreadId();
+}
@@ -0,0 +1,37 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+//Threads of the core. Only Thread.cpp calls the platform for them, so the queue does not depend on Win32 here
+
+typedef void* ThreadHandle;
+typedef int (*ThreadFunction)(void * param);
+
+class Thread {
+public:
+	enum Priority { PriorityBelowNormal = -1, PriorityNormal = 0, PriorityAboveNormal = 1 };
+
+	static ThreadHandle		Start(ThreadFunction function, void * param, int priority = PriorityNormal);	//NULL on failure
+	static int				Join(ThreadHandle * threads, int count);	//waits for all, then releases them
+	static int				Detach(ThreadHandle thread);				//releases a thread that is not waited for
+	static unsigned long	CurrentId();
+};
+
+#endif //THREAD_H
@@ -0,0 +1,137 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "Trace.h"
+
+volatile bool _TraceEnabled = false;
+
+static HANDLE _TraceFile = INVALID_HANDLE_VALUE;
+static HANDLE _TraceMapping = NULL;
+static TraceHeader * _TraceHeader = NULL;
+static TraceEntry * _TraceEntries = NULL;
+static DWORD _TraceMask = 0;
+
+int TraceStart(const TCHAR * path, DWORD maxSize) {
+	if (_TraceHeader != NULL) {
+		//already mapped, resume writing into the same file
+		_TraceEnabled = true;
+		return 0;
+	}
+
+	if (!path)
+		return -1;
+
+	//largest power of two that fits
+	DWORD capacity = 1;
+	while(sizeof(TraceHeader) + (capacity*2)*sizeof(TraceEntry) <= maxSize)
+		capacity *= 2;
+	DWORD fileSize = sizeof(TraceHeader) + capacity*sizeof(TraceEntry);
+
+	//Keep the trace of the previous session
+	TCHAR oldPath[MAX_PATH];
+	if (lstrlen(path) + 4 < MAX_PATH) {
+		lstrcpy(oldPath, path);
+		lstrcat(oldPath, TEXT(".old"));
+		::MoveFileEx(path, oldPath, MOVEFILE_REPLACE_EXISTING);
+	}
+
+	_TraceFile = ::CreateFile(path, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_TraceFile == INVALID_HANDLE_VALUE) {
+		OutErr("[NppFTP.Trace] Unable to create trace file %T", path);
+		return -1;
+	}
+
+	_TraceMapping = ::CreateFileMapping(_TraceFile, NULL, PAGE_READWRITE, 0, fileSize, NULL);
+	if (_TraceMapping == NULL) {
+		OutErr("[NppFTP.Trace] Unable to map trace file %T", path);
+		::CloseHandle(_TraceFile);
+		_TraceFile = INVALID_HANDLE_VALUE;
+		return -1;
+	}
+
+	void * view = ::MapViewOfFile(_TraceMapping, FILE_MAP_WRITE, 0, 0, fileSize);
+	if (view == NULL) {
+		OutErr("[NppFTP.Trace] Unable to map trace file %T", path);
+		::CloseHandle(_TraceMapping);
+		::CloseHandle(_TraceFile);
+		_TraceMapping = NULL;
+		_TraceFile = INVALID_HANDLE_VALUE;
+		return -1;
+	}
+
+	//A new mapping is zero filled, so all entries start out unwritten
+	TraceHeader * header = (TraceHeader*)view;
+	LARGE_INTEGER frequency, ticks;
+	::QueryPerformanceFrequency(&frequency);
+	::QueryPerformanceCounter(&ticks);
+
+	memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+	header->version = TRACE_VERSION;
+	header->headerSize = sizeof(TraceHeader);
+	header->entrySize = sizeof(TraceEntry);
+	header->capacity = capacity;
+	header->frequency = frequency.QuadPart;
+	header->startTicks = ticks.QuadPart;
+	::GetSystemTimeAsFileTime(&header->startTime);
+	header->writeIndex = 0;
+
+	_TraceEntries = (TraceEntry*)((char*)view + sizeof(TraceHeader));
+	_TraceMask = capacity - 1;
+	_TraceHeader = header;
+	_TraceEnabled = true;
+
+	TraceWrite(Trace_Open, TRACE_VERSION, ::GetCurrentProcessId());
+
+	OutDebug("[NppFTP.Trace] Tracing to %T, %u events", path, capacity);
+
+	return 0;
+}
+
+int TraceStop() {
+	_TraceEnabled = false;
+
+	if (_TraceHeader != NULL)
+		::FlushViewOfFile(_TraceHeader, 0);
+
+	return 0;
+}
+
+int TraceWrite(Trace_Event event, int code, LONGLONG value) {
+	TraceHeader * header = _TraceHeader;
+	if (header == NULL)
+		return -1;
+
+	LARGE_INTEGER ticks;
+	::QueryPerformanceCounter(&ticks);
+
+	DWORD index = (DWORD)InterlockedIncrement(&header->writeIndex) - 1;
+	TraceEntry * entry = &_TraceEntries[index & _TraceMask];
+
+	//The sequence is cleared first and set last, so the decoder can skip entries torn by a crash
+	entry->sequence = 0;
+	entry->ticks = ticks.QuadPart;
+	entry->event = (WORD)event;
+	entry->reserved = 0;
+	entry->thread = ::GetCurrentThreadId();
+	entry->code = code;
+	entry->value = value;
+	entry->sequence = index + 1;
+
+	return 0;
+}
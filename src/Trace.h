@@ -0,0 +1,119 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+//Binary trace of protocol and timing events.
+//The events are written to a memory mapped file of fixed size, used as a ring:
+//when full, the oldest events are overwritten. The file of the previous session
+//is kept with the extension .old. Use tools/TraceDump to decode a trace file.
+
+enum Trace_Event {
+	Trace_None = 0,
+	Trace_Open,				//code: trace version, value: process id
+	Trace_CommandSent,		//code: first four characters of the command, value: length
+	Trace_ReplyReceived,	//code: reply code
+	Trace_DataOpen,
+	Trace_DataClose,
+	Trace_BytesReceived,	//value: bytes transferred so far
+	Trace_BytesSent,		//value: bytes transferred so far
+	Trace_QueueAdd,			//code: operation type, value: queue size
+	Trace_QueueStart,		//code: operation type
+	Trace_QueueEnd,			//code: operation type, value: result
+	Trace_Notify,			//code: queue event, value: ticks until the window acknowledged
+	Trace_SpanBegin,		//code: Trace_Span, value: argument, or id for Span_QueueWait
+	Trace_SpanEnd,			//code: Trace_Span, value: 0, or id for Span_QueueWait
+	Trace_EventCount
+};
+
+//Spans nest per thread, except Span_QueueWait which starts and ends on different threads
+enum Trace_Span {
+	Span_None = 0,
+	Span_QueueWait,			//operation added until it is started
+	Span_QueueDelay,		//pause before starting an operation
+	Span_Perform,			//QueueOperation::Perform, argument: operation type
+	Span_WindowEvent,		//window handling a queue notification, argument: notify code
+	Span_Connect,			//FTPClientWrapper calls
+	Span_Disconnect,
+	Span_GetDir,
+	Span_SendFile,
+	Span_ReceiveFile,
+	Span_Batch,				//argument: item count
+	Span_SocketConnect,		//CUT_WSClient::Connect, including the handshake
+	Span_Handshake,			//TLS handshake
+	Span_Count
+};
+
+#define TRACE_MAGIC				"NPPTRACE"
+#define TRACE_VERSION			1
+#define TRACE_DEFAULT_SIZE		(4*1024*1024)
+
+//File layout: TraceHeader followed by capacity TraceEntry records
+struct TraceHeader {
+	char					magic[8];		//TRACE_MAGIC, not terminated
+	DWORD					version;
+	DWORD					headerSize;
+	DWORD					entrySize;
+	DWORD					capacity;		//number of entries, power of two
+	LONGLONG				frequency;		//ticks per second
+	LONGLONG				startTicks;		//ticks when the file was created
+	FILETIME				startTime;		//UTC time at startTicks
+	volatile LONG			writeIndex;		//number of entries written so far
+	DWORD					reserved[3];
+};
+
+struct TraceEntry {
+	LONGLONG				ticks;			//QueryPerformanceCounter
+	volatile DWORD			sequence;		//writeIndex+1 at the time of writing, 0 while being written
+	WORD					event;			//Trace_Event
+	WORD					reserved;
+	DWORD					thread;
+	int						code;
+	LONGLONG				value;
+};
+
+extern volatile bool _TraceEnabled;
+
+int TraceStart(const TCHAR * path, DWORD maxSize = TRACE_DEFAULT_SIZE);
+int TraceStop();	//the file remains mapped until the process ends, as other threads may still be writing
+int TraceWrite(Trace_Event event, int code, LONGLONG value);
+
+//Costs a single test when tracing is off
+#define TraceEvent(event, code, value) do { if (_TraceEnabled) TraceWrite(event, (int)(code), (LONGLONG)(value)); } while(0)
+
+//Records a span for the lifetime of the object
+class TraceSpan {
+public:
+							TraceSpan(Trace_Span span, LONGLONG argument = 0) :
+								m_span(span),
+								m_active(_TraceEnabled)
+							{
+								if (m_active)
+									TraceWrite(Trace_SpanBegin, m_span, argument);
+							}
+							~TraceSpan() {
+								if (m_active)	//also when tracing was turned off meanwhile, to keep begin and end paired
+									TraceWrite(Trace_SpanEnd, m_span, 0);
+							}
+private:
+	Trace_Span				m_span;
+	bool					m_active;
+};
+
+#endif //TRACE_H
@@ -0,0 +1,172 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "TransferHash.h"
+
+#include "OperationMetrics.h"
+#include <zlib.h>
+
+static const char * HashNames[Hash_TypeMax] = {"", "CRC32", "MD5", "SHA-1", "SHA-256"};
+static const int HashSizes[Hash_TypeMax] = {0, 4, MD5_DIGEST_LENGTH, SHA_DIGEST_LENGTH, SHA256_DIGEST_LENGTH};
+
+//-1 if not a hexadecimal digit, either case
+static int HexValue(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+TransferHash::TransferHash(Hash_Type type) :
+	m_type(type),
+	m_crc(0),
+	m_time(0)
+{
+	switch(m_type) {
+		case Hash_CRC32:
+			m_crc = crc32(0L, Z_NULL, 0);
+			break;
+		case Hash_MD5:
+			MD5_Init(&m_md5);
+			break;
+		case Hash_SHA1:
+			SHA1_Init(&m_sha1);
+			break;
+		case Hash_SHA256:
+			SHA256_Init(&m_sha256);
+			break;
+		default:
+			m_type = Hash_None;
+			break;
+	}
+}
+
+TransferHash::~TransferHash() {
+}
+
+int TransferHash::Update(const char * data, size_t len) {
+	if (m_type == Hash_None || len == 0)
+		return 0;
+
+	LONGLONG start = OperationMetrics::Now();
+
+	switch(m_type) {
+		case Hash_CRC32:
+			m_crc = crc32(m_crc, (const Bytef*)data, (uInt)len);
+			break;
+		case Hash_MD5:
+			MD5_Update(&m_md5, data, len);
+			break;
+		case Hash_SHA1:
+			SHA1_Update(&m_sha1, data, len);
+			break;
+		case Hash_SHA256:
+			SHA256_Update(&m_sha256, data, len);
+			break;
+		default:
+			break;
+	}
+
+	m_time += OperationMetrics::Now() - start;
+
+	return 0;
+}
+
+int TransferHash::Finish(unsigned char * digest) {
+	switch(m_type) {
+		case Hash_CRC32:
+			//Most significant byte first, as the hexadecimal notation of the servers
+			digest[0] = (unsigned char)((m_crc >> 24) & 0xFF);
+			digest[1] = (unsigned char)((m_crc >> 16) & 0xFF);
+			digest[2] = (unsigned char)((m_crc >> 8) & 0xFF);
+			digest[3] = (unsigned char)(m_crc & 0xFF);
+			break;
+		case Hash_MD5:
+			MD5_Final(digest, &m_md5);
+			break;
+		case Hash_SHA1:
+			SHA1_Final(digest, &m_sha1);
+			break;
+		case Hash_SHA256:
+			SHA256_Final(digest, &m_sha256);
+			break;
+		default:
+			break;
+	}
+
+	return GetSize(m_type);
+}
+
+Hash_Type TransferHash::GetType() const {
+	return m_type;
+}
+
+LONGLONG TransferHash::GetTime() const {
+	return m_time;
+}
+
+int TransferHash::GetSize(Hash_Type type) {
+	if (type < Hash_None || type >= Hash_TypeMax)
+		return 0;
+	return HashSizes[type];
+}
+
+const char* TransferHash::GetName(Hash_Type type) {
+	if (type < Hash_None || type >= Hash_TypeMax)
+		return "";
+	return HashNames[type];
+}
+
+int TransferHash::ParseDigest(const char * text, Hash_Type type, unsigned char * digest) {
+	int size = GetSize(type);
+	if (size == 0 || text == NULL)
+		return -1;
+
+	const char * word = text;
+	while(*word != 0) {
+		while(*word == ' ' || *word == '\t' || *word == '*')
+			word++;
+
+		const char * end = word;
+		while(*end != 0 && *end != ' ' && *end != '\t')
+			end++;
+
+		const char * hex = word;
+		if (end - hex > 2 && hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X'))
+			hex += 2;
+
+		bool isHex = (end - hex == size*2);
+		for(const char * c = hex; isHex && c < end; c++) {
+			isHex = (HexValue(*c) != -1);
+		}
+
+		if (isHex) {
+			for(int i = 0; i < size; i++)
+				digest[i] = (unsigned char)(HexValue(hex[i*2]) * 16 + HexValue(hex[i*2+1]));
+			return 0;
+		}
+
+		word = end;
+	}
+
+	return -1;
+}
@@ -0,0 +1,57 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSFERHASH_H
+#define TRANSFERHASH_H
+
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+
+//Hashes a server can compute of a file. Ordered by cost, cheapest first
+enum Hash_Type {Hash_None = 0, Hash_CRC32 = 1, Hash_MD5 = 2, Hash_SHA1 = 3, Hash_SHA256 = 4, Hash_TypeMax = 5};
+
+#define HASH_MAX_SIZE		SHA256_DIGEST_LENGTH
+//Number of times a file is transferred at most while its hash does not match the one of the server
+#define VERIFY_ATTEMPTS		3
+
+//Hash of the data of a transfer, fed by the transfer loop itself so the data is only read once
+class TransferHash {
+public:
+							TransferHash(Hash_Type type);
+	virtual					~TransferHash();
+
+	virtual int				Update(const char * data, size_t len);
+	virtual int				Finish(unsigned char * digest);	//return the size of the digest
+
+	virtual Hash_Type		GetType() const;
+	virtual LONGLONG		GetTime() const;	//microseconds spent hashing
+
+	static int				GetSize(Hash_Type type);
+	static const char*		GetName(Hash_Type type);	//as used by the FTP HASH command
+							//First hexadecimal word in text with the size of the digest, e.g. in a server reply
+	static int				ParseDigest(const char * text, Hash_Type type, unsigned char * digest);
+private:
+	Hash_Type				m_type;
+	unsigned long			m_crc;
+	MD5_CTX					m_md5;
+	SHA_CTX					m_sha1;
+	SHA256_CTX				m_sha256;
+	LONGLONG				m_time;
+};
+
+#endif //TRANSFERHASH_H
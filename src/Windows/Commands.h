@@ -57,6 +57,13 @@
 //settings popup menus
 #define IDM_POPUP_SETTINGSGENERAL	10022
 #define IDM_POPUP_SETTINGSPROFILE	10023
+#define IDM_POPUP_SETTINGSMETRICS	10024
+//file popup menu, continued
+#define IDM_POPUP_PREVIEWFILE		10025
+#define IDM_POPUP_FOLLOWFILE		10026
+//directory popup menu, continued
+#define IDM_POPUP_SEARCHDIR			10027
+#define IDM_POPUP_SYNCDIR			10028
 
 //Range for profile items in popupmenu. Go over 1000 profiles and the menu will not work anymore
 #define IDM_POPUP_PROFILE_FIRST		11000
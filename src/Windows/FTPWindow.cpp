@@ -42,6 +42,7 @@ FTPWindow::FTPWindow() :
 	m_ftpSession(NULL),
 	m_vProfiles(NULL),
 	m_ftpSettings(NULL),
+	m_cacheManager(NULL),
 	m_connecting(false),
 	m_busy(false),
 	m_cancelOperation(NULL),
@@ -173,10 +174,11 @@ int FTPWindow::Focus() {
 	return m_treeview.Focus();
 }
 
-int FTPWindow::Init(FTPSession * session, vProfile * vProfiles, FTPSettings * ftpSettings) {
+int FTPWindow::Init(FTPSession * session, vProfile * vProfiles, FTPSettings * ftpSettings, CacheManager * cacheManager) {
 	m_ftpSession = session;
 	m_vProfiles = vProfiles;
 	m_ftpSettings = ftpSettings;
+	m_cacheManager = cacheManager;
 
 	OnProfileChange();
 	m_splitter.SetRatio(m_ftpSettings->GetSplitRatio());
@@ -303,6 +305,7 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 			}
 			break; }
 		case WM_COMMAND: {
+			std::vector<FileObject*> marked;
 			switch(LOWORD(wParam)) {
 				case IDM_POPUP_QUEUE_ABORT: {
 					if (m_cancelOperation && m_cancelOperation->GetRunning()) {
@@ -341,9 +344,9 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 
                     // Read the input directory name.
                     const TCHAR *dirName    = id.GetValue();
-                    char *dirNameCP         = SU::TCharToCP(dirName, CP_ACP);
+                    TCharToCPStr dirNameCP(dirName, CP_ACP);
 
-                    m_ftpSession->GetDirectoryHierarchy(dirNameCP);
+                    m_ftpSession->GetDirectoryHierarchy(dirNameCP.c_str());
                     break;
                 }
 
@@ -351,7 +354,7 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 				case IDB_BUTTON_TOOLBAR_DOWNLOAD: {
 					SHORT state = GetKeyState(VK_CONTROL);
 					if (!(state & 0x8000)) {
-						m_ftpSession->DownloadFileCache(m_currentSelection->GetPath());
+						OpenRemoteFile(m_currentSelection);
 						result = TRUE;
 						break;
 					}
@@ -366,6 +369,20 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 					}
 					result = TRUE;
 					break; }
+				case IDM_POPUP_PREVIEWFILE: {
+					m_ftpSession->PreviewFileCache(m_currentSelection->GetPath());
+					result = TRUE;
+					break; }
+				case IDM_POPUP_FOLLOWFILE: {
+					const char * followPath = m_ftpSession->GetFollowPath();
+					if (followPath && !strcmp(followPath, m_currentSelection->GetPath())) {
+						OutMsg("[NppFTP.FTPWindow] Stopped following %s", followPath);
+						m_ftpSession->StopFollow();
+					} else {
+						m_ftpSession->StartFollow(m_currentSelection->GetPath());
+					}
+					result = TRUE;
+					break; }
 				case IDM_POPUP_UPLOADFILE:
 				case IDB_BUTTON_TOOLBAR_UPLOAD: {
 					//upload(TRUE, TRUE);		//upload to cached folder is present, else upload to last selected folder
@@ -426,15 +443,43 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 					result = TRUE;
 					break; }
 				case IDM_POPUP_DELETEDIR: {
-					this->DeleteDirectory(m_currentSelection);
+					if (m_treeview.GetMarkedObjects(marked) > 0)
+						this->DeleteMarked(marked);
+					else
+						this->DeleteDirectory(m_currentSelection);
 					result = TRUE;
 					break; }
 				case IDM_POPUP_NEWFILE: {
 					this->CreateFile(m_currentSelection);
 					result = TRUE;
 					break; }
+				case IDM_POPUP_SEARCHDIR: {
+					InputDialog id;
+					int res = id.Create(m_hwnd, TEXT("Search in files"), TEXT("Find files containing:"), TEXT(""));
+					if (res == 1) {
+						TCharToCPStr pattern(id.GetValue());
+						m_ftpSession->Search(m_currentSelection->GetPath(), pattern.c_str());
+					}
+					result = TRUE;
+					break; }
+				case IDM_POPUP_SYNCDIR: {
+					int res = m_ftpSession->Sync(m_currentSelection->GetPath());
+					if (res == 1)
+						OutErr("[NppFTP.FTPWindow] %s has no cache location, unable to synchronize", m_currentSelection->GetPath());
+					result = TRUE;
+					break; }
 				case IDM_POPUP_DELETEFILE: {
-					this->DeleteFile(m_currentSelection);
+					if (m_treeview.GetMarkedObjects(marked) > 0)
+						this->DeleteMarked(marked);
+					else
+						this->DeleteFile(m_currentSelection);
+					result = TRUE;
+					break; }
+				case IDM_POPUP_PERMISSIONFILE:
+				case IDM_POPUP_PERMISSIONDIR: {
+					if (m_treeview.GetMarkedObjects(marked) == 0)
+						marked.push_back(m_currentSelection);
+					this->ChangePermissions(marked);
 					result = TRUE;
 					break; }
 				case IDM_POPUP_RENAMEFILE:
@@ -444,12 +489,25 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 					break; }
 				case IDM_POPUP_SETTINGSGENERAL: {
 					m_settingsDialog.Create(m_hwnd, m_ftpSettings);
+					m_cacheManager->SetLimit((ULONGLONG)m_ftpSettings->GetCacheSizeLimit() * 1024 * 1024);
+					EvictCache();
 					result = TRUE;
 					break; }
 				case IDM_POPUP_SETTINGSPROFILE: {
 					m_profilesDialog.Create(m_hwnd, this, m_vProfiles, m_ftpSettings->GetGlobalCache());
 					result = TRUE;
 					break; }
+				case IDM_POPUP_SETTINGSMETRICS: {
+					TCHAR target[MAX_PATH];
+					lstrcpy(target, TEXT("NppFTP.metrics.json"));
+					int res = PU::GetSaveFilename(target, MAX_PATH, m_hwnd);
+					if (res == 0) {
+						res = m_ftpSession->ExportMetrics(target);
+						if (res == 0)
+							OutMsg("[NppFTP.FTPWindow] Metrics written to %T", target);
+					}
+					result = TRUE;
+					break; }
 				default: {
 					unsigned int value = LOWORD(wParam);
 					if (!m_busy && value >= IDM_POPUP_PROFILE_FIRST && value <= IDM_POPUP_PROFILE_MAX) {
@@ -525,7 +583,12 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 					case NM_RCLICK:
 					case NM_DBLCLK:
 					case NM_CLICK: {
-						HTREEITEM res = m_treeview.OnClick();
+						if (nmh.code == (UINT)NM_CLICK && (::GetKeyState(VK_CONTROL) & 0x8000)) {
+							m_treeview.OnMarkClick();
+							result = TRUE;	//keep the selection
+							break;
+						}
+						HTREEITEM res = m_treeview.OnClick(nmh.code == (UINT)NM_RCLICK);
 						if (res) {
 							m_currentSelection = m_treeview.GetItemFileObject(res);
 							SetToolbarState();
@@ -631,6 +694,9 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 					hContext = m_popupDir;
 				} else {
 					hContext = m_popupFile;
+					const char * followPath = m_ftpSession->GetFollowPath();
+					bool following = (followPath && !strcmp(followPath, m_currentSelection->GetPath()));
+					::CheckMenuItem(m_popupFile, IDM_POPUP_FOLLOWFILE, MF_BYCOMMAND|(following?MF_CHECKED:MF_UNCHECKED));
 				}
 			} else if (hWinContext == m_queueWindow.GetHWND()) {
 				QueueOperation * op = m_queueWindow.GetSelectedQueueOperation();
@@ -667,6 +733,13 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 			::TrackPopupMenu(hContext, TPM_LEFTALIGN, menuPos.x, menuPos.y, 0, m_hwnd, NULL);
 			result = TRUE;
 			break; }
+		case WM_TIMER: {
+			if (wParam == FOLLOW_TIMER_ID) {
+				m_ftpSession->OnFollowTimer();
+			} else {
+				doDefaultProc = true;
+			}
+			break; }
 		case WM_OUTPUTSHOWN: {
 			if (wParam == TRUE) {
 				m_outputShown = true;
@@ -684,6 +757,7 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 			int code = (int)wParam;
 			QueueOperation * queueOp = (QueueOperation*)lParam;
 			void * notifyData = queueOp->GetNotifyData();
+			TraceSpan span(Span_WindowEvent, code);
 			int res = OnEvent(queueOp, code, notifyData, isStart);
 			if (res != 1)	//if res == 1, then queueop becomes invalid
 				queueOp->AckNotification();
@@ -692,12 +766,16 @@ LRESULT FTPWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 		case NotifyMessageAdd: {
 			QueueOperation * queueOp = (QueueOperation*)lParam;
 			m_queueWindow.PushQueueItem(queueOp);
+			if (queueOp->GetType() == QueueOperation::QueueTypeUpload)
+				m_cacheManager->Pin(((QueueUpload*)queueOp)->GetLocalPath());
 			queueOp->AckNotification();
 			return TRUE;
 			break; }
 		case NotifyMessageRemove: {
 			QueueOperation * queueOp = (QueueOperation*)lParam;
 			m_queueWindow.RemoveQueueItem(queueOp);
+			if (queueOp->GetType() == QueueOperation::QueueTypeUpload)
+				m_cacheManager->Unpin(((QueueUpload*)queueOp)->GetLocalPath());
 			queueOp->AckNotification();
 			return TRUE;
 			break; }
@@ -845,16 +923,20 @@ int FTPWindow::CreateMenus() {
 	m_popupSettings = CreatePopupMenu();
 	AppendMenu(m_popupSettings,MF_STRING,IDM_POPUP_SETTINGSGENERAL,TEXT("&General settings"));
 	AppendMenu(m_popupSettings,MF_STRING,IDM_POPUP_SETTINGSPROFILE,TEXT("&Profile settings"));
+	AppendMenu(m_popupSettings,MF_SEPARATOR,0,0);
+	AppendMenu(m_popupSettings,MF_STRING,IDM_POPUP_SETTINGSMETRICS,TEXT("Export &metrics..."));
 
 	//Create context menu for files in folder window
 	m_popupFile = CreatePopupMenu();
 	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_DOWNLOADFILE,TEXT("&Download file"));
 	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_DLDTOLOCATION,TEXT("&Save file as..."));
+	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_PREVIEWFILE,TEXT("&Preview start and end"));
+	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_FOLLOWFILE,TEXT("&Follow file"));
 	AppendMenu(m_popupFile,MF_SEPARATOR,0,0);
 	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_RENAMEFILE,TEXT("&Rename File"));
 	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_DELETEFILE,TEXT("D&elete File"));
+	AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_PERMISSIONFILE,TEXT("Change &permissions..."));
 	//AppendMenu(m_popupFile,MF_SEPARATOR,0,0);
-	//AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_PERMISSIONFILE,TEXT("Permissions"));
 	//AppendMenu(m_popupFile,MF_STRING,IDM_POPUP_PROPSFILE,TEXT("&Properties"));
 
 	//Create context menu for directories in folder window
@@ -864,13 +946,15 @@ int FTPWindow::CreateMenus() {
 	AppendMenu(m_popupDir,MF_SEPARATOR,0,0);
 	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_RENAMEDIR,TEXT("&Rename Directory"));
 	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_DELETEDIR,TEXT("D&elete directory"));
+	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_PERMISSIONDIR,TEXT("Change &permissions..."));
 	AppendMenu(m_popupDir,MF_SEPARATOR,0,0);
     AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_UPLOADFILE,TEXT("&Upload current file here"));
 	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_UPLOADOTHERFILE,TEXT("Upload &other file here..."));
 	AppendMenu(m_popupDir,MF_SEPARATOR,0,0);
+	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_SEARCHDIR,TEXT("&Search in files..."));
+	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_SYNCDIR,TEXT("S&ynchronize with cache"));
 	AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_REFRESHDIR,TEXT("Re&fresh"));
 	//AppendMenu(m_popupDir,MF_SEPARATOR,0,0);
-	//AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_PERMISSIONDIR,TEXT("Permissions"));
 	//AppendMenu(m_popupDir,MF_STRING,IDM_POPUP_PROPSDIR,TEXT("&Properties"));
 
 	//Create special context menu for links
@@ -927,7 +1011,9 @@ int FTPWindow::OnEvent(QueueOperation * queueOp, int code, void * data, bool isS
 	switch(queueOp->GetType()) {
 		case QueueOperation::QueueTypeDownload:
 		case QueueOperation::QueueTypeDownloadHandle:
-		case QueueOperation::QueueTypeUpload: {
+		case QueueOperation::QueueTypeUpload:
+		case QueueOperation::QueueTypeSearch:
+		case QueueOperation::QueueTypeSync: {
 			m_busy = isStart;
 			break; }
 		case QueueOperation::QueueTypeConnect:
@@ -939,6 +1025,7 @@ int FTPWindow::OnEvent(QueueOperation * queueOp, int code, void * data, bool isS
 		case QueueOperation::QueueTypeFileDelete:
 		case QueueOperation::QueueTypeFileRename:
 		case QueueOperation::QueueTypeQuote:
+		case QueueOperation::QueueTypeBatch:
 		default: {
 			//Other operations cannot be aborted
 			break; }
@@ -1020,6 +1107,8 @@ int FTPWindow::OnEvent(QueueOperation * queueOp, int code, void * data, bool isS
 					OutMsg("[NppFTP.FTPWindow] Download of %s succeeded, opening file.", opdld->GetExternalPath());
 					::SendMessage(m_hNpp, NPPM_DOOPEN, (WPARAM)0, (LPARAM)opdld->GetLocalPath());
 					::SendMessage(m_hNpp, NPPM_RELOADFILE, (WPARAM)0, (LPARAM)opdld->GetLocalPath());
+					m_cacheManager->Touch(opdld->GetLocalPath());
+					EvictCache();
 				} else {
 					//Download to other location: Ask
 					int ret = ::MessageBox(m_hNpp, TEXT("The download is complete. Do you wish to open the file?"), TEXT("Download complete"), MB_YESNO);
@@ -1113,6 +1202,89 @@ int FTPWindow::OnEvent(QueueOperation * queueOp, int code, void * data, bool isS
 				break;	//failure
 			}
 			break; }
+		case QueueOperation::QueueTypeBatch: {
+			QueueBatch * opbatch = (QueueBatch*)queueOp;
+			if (isStart)
+				break;
+			const char * verbs[] = {"delete", "create directory", "remove directory", "rename", "change permissions of"};
+			int failed = 0;
+			for(int i = 0; i < opbatch->GetItemCount(); i++) {
+				const BatchItem & item = opbatch->GetItem(i);
+				if (item.result == -1) {
+					OutErr("[NppFTP.FTPWindow] Unable to %s %s", verbs[item.operation], item.path);
+					failed++;
+				}
+			}
+			OutMsg("[NppFTP.FTPWindow] Batch operation finished, %d of %d succeeded", opbatch->GetItemCount()-failed, opbatch->GetItemCount());
+
+			//Refresh each affected directory once
+			std::vector<std::string> dirs;
+			for(int i = 0; i < opbatch->GetItemCount(); i++) {
+				const BatchItem & item = opbatch->GetItem(i);
+				for(int j = 0; j < 2; j++) {
+					const char * path = (j == 0)?item.path:item.newPath;
+					const char * name = PU::FindExternalFilename(path);
+					if (!name)
+						continue;
+					std::string dir(path, name - path);
+					if (dir.size() > 1)
+						dir.erase(dir.size()-1);	//trailing slash
+					size_t k = 0;
+					while(k < dirs.size() && dirs[k] != dir)
+						k++;
+					if (k == dirs.size())
+						dirs.push_back(dir);
+				}
+			}
+			for(size_t i = 0; i < dirs.size(); i++)
+				m_ftpSession->GetDirectory(dirs[i].c_str());
+			break; }
+		case QueueOperation::QueueTypeFollow: {
+			QueueFollow * opfollow = (QueueFollow*)queueOp;
+			if (isStart)
+				break;
+			if (queueResult == -1) {
+				OutErr("[NppFTP.FTPWindow] Unable to update followed file %s", opfollow->GetExternalPath());
+			} else if (opfollow->IsInitial()) {
+				OutMsg("[NppFTP.FTPWindow] Following %s", opfollow->GetExternalPath());
+				::SendMessage(m_hNpp, NPPM_DOOPEN, (WPARAM)0, (LPARAM)opfollow->GetLocalPath());
+				::SendMessage(m_hNpp, NPPM_RELOADFILE, (WPARAM)0, (LPARAM)opfollow->GetLocalPath());
+				m_cacheManager->Touch(opfollow->GetLocalPath());
+			} else if (opfollow->GetReceived() > 0) {
+				//Reloading keeps the buffer open, it grows in place
+				::SendMessage(m_hNpp, NPPM_RELOADFILE, (WPARAM)0, (LPARAM)opfollow->GetLocalPath());
+				m_cacheManager->Touch(opfollow->GetLocalPath());
+			}
+			m_ftpSession->OnFollowDone(opfollow);
+			break; }
+		case QueueOperation::QueueTypeSearch: {
+			QueueSearch * opsearch = (QueueSearch*)queueOp;
+			if (isStart) {
+				OutMsg("[NppFTP.FTPWindow] Searching %s for \"%s\"", opsearch->GetPath(), opsearch->GetPattern());
+				break;
+			}
+			if (queueResult == -1) {
+				OutErr("[NppFTP.FTPWindow] Search of %s did not complete, %d files found so far", opsearch->GetPath(), opsearch->GetFoundCount());
+				break;	//failure
+			}
+			OutMsg("[NppFTP.FTPWindow] Search of %s finished, found in %d files", opsearch->GetPath(), opsearch->GetFoundCount());
+			break; }
+		case QueueOperation::QueueTypeSync: {
+			QueueSync * opsync = (QueueSync*)queueOp;
+			if (isStart) {
+				OutMsg("[NppFTP.FTPWindow] Synchronizing %s with %T", opsync->GetExternalPath(), opsync->GetLocalPath());
+				break;
+			}
+			if (queueResult == -1) {
+				OutErr("[NppFTP.FTPWindow] Synchronization of %s did not complete: %d uploaded, %d downloaded, %d deleted, %d conflicts, %d failed",
+						opsync->GetExternalPath(), opsync->GetUploadCount(), opsync->GetDownloadCount(), opsync->GetDeleteCount(), opsync->GetConflictCount(), opsync->GetFailedCount());
+			} else {
+				OutMsg("[NppFTP.FTPWindow] Synchronization of %s finished: %d uploaded, %d downloaded, %d deleted, %d conflicts",
+						opsync->GetExternalPath(), opsync->GetUploadCount(), opsync->GetDownloadCount(), opsync->GetDeleteCount(), opsync->GetConflictCount());
+			}
+
+			m_ftpSession->GetDirectory(opsync->GetExternalPath());
+			break; }
 		default: {
 			//Other operations do not require change in GUI atm (update tree for delete/rename/create later on)
 			break; }
@@ -1157,12 +1329,32 @@ int FTPWindow::OnItemActivation() {
 	if (m_currentSelection->isDir()) {
 		m_ftpSession->GetDirectory(m_currentSelection->GetPath());
 	} else {
-		m_ftpSession->DownloadFileCache(m_currentSelection->GetPath());
+		OpenRemoteFile(m_currentSelection);
 	}
 	return 0;
 }
 
+int FTPWindow::OpenRemoteFile(FileObject * file) {
+	TCHAR cachefile[MAX_PATH];
+
+	int res = m_ftpSession->DownloadFileCache(file->GetPath(), cachefile, MAX_PATH);
+	if (res == 2) {
+		//The cached copy is up to date, open it without a download
+		OutMsg("[NppFTP.FTPWindow] %s is unchanged, opening cached file.", file->GetPath());
+		::SendMessage(m_hNpp, NPPM_DOOPEN, (WPARAM)0, (LPARAM)cachefile);
+		res = 0;
+	}
+
+	return res;
+}
+
 int FTPWindow::OnConnect(int code) {
+	//Index the cache of the profile, also for automated connects as those upload from it
+	std::vector<const TCHAR*> cachePaths;
+	m_ftpSession->GetCurrentProfile()->GetCache()->GetLocalPaths(cachePaths);
+	for(size_t i = 0; i < cachePaths.size(); i++)
+		m_cacheManager->AddDirectory(cachePaths[i]);
+
 	if (code != 0)	//automated connect
 		return 0;
 
@@ -1198,6 +1390,7 @@ int FTPWindow::OnDisconnect(int /*code*/) {
 
 	if (m_ftpSettings->GetClearCache()) {
 		m_ftpSession->GetCurrentProfile()->GetCache()->ClearCurrentCache( m_ftpSettings->GetClearCachePermanent() );
+		m_cacheManager->Clear();	//indexed again on the next connect
 	}
 
 	SetInfo(TEXT("Disconnected"));
@@ -1209,6 +1402,31 @@ int FTPWindow::OnDisconnect(int /*code*/) {
 	return 0;
 }
 
+//Evict cached files over the size limit, except those open in Notepad++
+int FTPWindow::EvictCache() {
+	int nrFiles = (int)::SendMessage(m_hNpp, NPPM_GETNBOPENFILES, (WPARAM)0, (LPARAM)ALL_OPEN_FILES);
+	if (nrFiles < 0)
+		nrFiles = 0;
+
+	TCHAR ** files = new TCHAR*[nrFiles+1];
+	for(int i = 0; i < nrFiles; i++) {
+		files[i] = new TCHAR[MAX_PATH];
+		files[i][0] = 0;
+	}
+
+	int count = 0;
+	if (nrFiles > 0)
+		count = (int)::SendMessage(m_hNpp, NPPM_GETOPENFILENAMES, (WPARAM)files, (LPARAM)nrFiles);
+
+	m_cacheManager->Evict((const TCHAR**)files, count);
+
+	for(int i = 0; i < nrFiles; i++)
+		delete [] files[i];
+	delete [] files;
+
+	return 0;
+}
+
 int FTPWindow::CreateDirectory(FileObject * parent) {
 	InputDialog id;
 
@@ -1258,12 +1476,12 @@ int FTPWindow::CreateFile(FileObject * parent) {
 
     // Check if there is already an existing file of the same name
     int childcount = parent->GetChildCount();
-    char *newFileName_CP = SU::TCharToCP(newName, CP_ACP);
+    TCharToCPStr newFileName_CP(newName, CP_ACP);
 
 	for(int i = 0; i < childcount; i++) {
 
 	    const char *currentFileName = parent->GetChild(i)->GetName();
-		if (!strcmp(currentFileName, newFileName_CP)) {
+		if (!strcmp(currentFileName, newFileName_CP.c_str())) {
 
             res = ::MessageBox(m_hwnd, TEXT("A file/directory by the same name already exists. Do you want to create a new blank file ?"), TEXT("Creating file"), MB_YESNO);
             if (res == IDNO) {
@@ -1306,6 +1524,61 @@ int FTPWindow::DeleteFile(FileObject * file) {
 	return 0;
 }
 
+int FTPWindow::DeleteMarked(const std::vector<FileObject*> & objects) {
+	MessageDialog md;
+
+	TCHAR message[100];
+	wsprintf(message, TEXT("Are you sure you want to delete these %d items?"), (int)objects.size());
+	int res = md.Create(m_hwnd, TEXT("Deleting"), message);
+	if (res != 1)
+		return 0;
+
+	vBatch items;
+	for(size_t i = 0; i < objects.size(); i++) {
+		BatchItem item;
+		item.operation = objects[i]->isDir()?Batch_RmDir:Batch_Delete;
+		item.path = (char*)objects[i]->GetPath();	//copied by the batch
+		item.newPath = NULL;
+		item.mode = 0;
+		item.result = -1;
+		items.push_back(item);
+	}
+
+	m_treeview.ClearMarks();
+
+	return m_ftpSession->Batch(items);
+}
+
+int FTPWindow::ChangePermissions(const std::vector<FileObject*> & objects) {
+	InputDialog id;
+
+	int res = id.Create(m_hwnd, TEXT("Changing permissions"), TEXT("Please enter the new permissions (octal, e.g. 644):"), TEXT("644"));
+	if (res != 1)
+		return 0;
+
+	TCHAR * end = NULL;
+	long mode = _tcstol(id.GetValue(), &end, 8);
+	if (end == id.GetValue() || *end != 0 || mode < 0 || mode > 07777) {
+		OutErr("[NppFTP.FTPWindow] Invalid permissions %T", id.GetValue());
+		return -1;
+	}
+
+	vBatch items;
+	for(size_t i = 0; i < objects.size(); i++) {
+		BatchItem item;
+		item.operation = Batch_Chmod;
+		item.path = (char*)objects[i]->GetPath();	//copied by the batch
+		item.newPath = NULL;
+		item.mode = (int)mode;
+		item.result = -1;
+		items.push_back(item);
+	}
+
+	m_treeview.ClearMarks();
+
+	return m_ftpSession->Batch(items);
+}
+
 int FTPWindow::Rename(FileObject * fo) {
 	InputDialog id;
 
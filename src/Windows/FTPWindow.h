@@ -32,6 +32,7 @@
 #include "ProfilesDialog.h"
 #include "DragDropSupport.h"
 #include "DragDropWindow.h"
+#include "CacheManager.h"
 
 class FTPSession;
 
@@ -49,7 +50,7 @@ public:
 	virtual int				Show(bool show);
 	virtual int				Focus();
 
-	virtual int				Init(FTPSession * session, vProfile * vProfiles, FTPSettings * ftpSettings);
+	virtual int				Init(FTPSession * session, vProfile * vProfiles, FTPSettings * ftpSettings, CacheManager * cacheManager);
 	
 	virtual int				OnSize(int newWidth, int newHeight);
 	virtual int				OnProfileChange();
@@ -83,10 +84,13 @@ protected:
 	virtual int				OnError(QueueOperation * queueOp, int code, void * data, bool isStart);
 
 	virtual int				OnItemActivation();
+	virtual int				OpenRemoteFile(FileObject * file);	//download to cache and open
 
 	virtual int				OnConnect(int code);
 	virtual int				OnDisconnect(int code);
 
+	virtual int				EvictCache();
+
 	virtual int				CreateDirectory(FileObject * parent);
 	virtual int				DeleteDirectory(FileObject * dir);
 
@@ -95,6 +99,10 @@ protected:
 
 	virtual int				Rename(FileObject * fo);
 
+	//Operate on the items marked in the tree as a single batch
+	virtual int				DeleteMarked(const std::vector<FileObject*> & objects);
+	virtual int				ChangePermissions(const std::vector<FileObject*> & objects);
+
 	//virtual int				UploadCurrentFile(FileObject * parent);
 	//virtual int				UploadOtherFile(FileObject * parent);
 
@@ -126,6 +134,7 @@ protected:
 	FTPSession*				m_ftpSession;
 	vProfile*				m_vProfiles;
 	FTPSettings*			m_ftpSettings;
+	CacheManager*			m_cacheManager;
 
 	bool					m_connecting;
 	bool					m_busy;
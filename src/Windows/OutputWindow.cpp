@@ -30,9 +30,8 @@ Output* _MainOutput = NULL;
 
 const TCHAR * OutputWindow::OUTWINDOWCLASS = TEXT("NPPFTPOUTPUT");
 
-const int WM_OUT_ADDLINE_SYST = WM_USER + 1;
-const int WM_OUT_ADDLINE_CLNT = WM_USER + 2;
-const int WM_OUT_ADDLINE_ERR = WM_USER + 3;
+const UINT_PTR OUTPUT_TIMER_ID = 1;
+const UINT OUTPUT_TIMER_INTERVAL = 100;	//milliseconds between updates of the output window
 
 const int STYLE_CLIENT = STYLE_LASTPREDEFINED + 1;
 const int STYLE_SYSTEM = STYLE_LASTPREDEFINED + 2;
@@ -46,6 +45,10 @@ const int STYLE_MARGINOFFSET = 3;
 
 OutputWindow::OutputWindow() :
 	DockableWindow(OUTWINDOWCLASS),
+	m_entries(NULL),
+	m_enqueuePos(0),
+	m_dequeuePos(0),
+	m_dropped(0),
 	m_winThread(0),
 	m_hContextMenu(NULL),
 	m_hScintilla(NULL),
@@ -55,10 +58,16 @@ OutputWindow::OutputWindow() :
 	m_style = 0;
 	m_exStyle = 0;
 
+	m_entries = new OutputEntry[OUTPUT_QUEUE_SIZE];
+	for(int i = 0; i < OUTPUT_QUEUE_SIZE; i++) {
+		m_entries[i].sequence = i;
+	}
+
 	_MainOutput = this;
 }
 
 OutputWindow::~OutputWindow() {
+	delete [] m_entries;
 }
 
 int OutputWindow::Create(HWND hParent, HWND hNpp, int MenuID, int MenuCommand, HWND hNotify) {
@@ -94,10 +103,13 @@ int OutputWindow::Create(HWND hParent, HWND hNpp, int MenuID, int MenuCommand, H
 	::SendMessage(m_hwnd, WM_SIZE, 0, 0);
 	::ShowWindow(m_hScintilla, SW_SHOW);
 
+	::SetTimer(m_hwnd, OUTPUT_TIMER_ID, OUTPUT_TIMER_INTERVAL, NULL);
+
 	return 0;
 }
 
 int OutputWindow::Destroy() {
+	::KillTimer(m_hwnd, OUTPUT_TIMER_ID);
 	DestroyWindow(m_hScintilla);
 	return DockableWindow::Destroy();
 }
@@ -161,26 +173,12 @@ LRESULT OutputWindow::MessageProc(UINT uMsg, WPARAM wParam, LPARAM lParam) {
 			FillRect(hDC, &rectClient, ::GetSysColorBrush(COLOR_3DFACE));
 			result = TRUE;
 			break; }
-		case WM_OUT_ADDLINE_SYST: {
-			TCHAR * msg = (TCHAR*)lParam;
-			time_t time = (time_t)wParam;
-			AddMessage(msg, Output_System, time);
-			delete [] msg;
-			result = TRUE;
-			break; }
-		case WM_OUT_ADDLINE_CLNT: {
-			TCHAR * msg = (TCHAR*)lParam;
-			time_t time = (time_t)wParam;
-			AddMessage(msg, Output_Client, time);
-			delete [] msg;
-			result = TRUE;
-			break; }
-		case WM_OUT_ADDLINE_ERR: {
-			TCHAR * msg = (TCHAR*)lParam;
-			time_t time = (time_t)wParam;
-			AddMessage(msg, Output_Error, time);
-			delete [] msg;
-			result = TRUE;
+		case WM_TIMER: {
+			if (wParam == OUTPUT_TIMER_ID) {
+				AddMessages();
+			} else {
+				doDefaultProc = true;
+			}
 			break; }
 		case WM_COMMAND: {
 			switch (LOWORD(wParam)) {
@@ -232,12 +230,13 @@ int OutputWindow::OutVA(Output_Type type, const TCHAR * message, va_list vaList)
 	if (!message)
 		return -1;
 
-	TCHAR * msgBuffer = new TCHAR[1024];
+	TCHAR msgBuffer[1024];
 	msgBuffer[0] = 0;
 
 	/*int ret =*/SU::TSprintfV(msgBuffer, 1024, message, vaList);
     //if (ret == -1)	//-1 indicates truncation, not necessarily failure
 	//	return -1;
+	msgBuffer[1023] = 0;
 
 	//Replace newline characters, otherwise screw up output
 	TCHAR * curChar = msgBuffer;
@@ -247,33 +246,60 @@ int OutputWindow::OutVA(Output_Type type, const TCHAR * message, va_list vaList)
 		curChar++;
 	}
 
-	time_t t = time(NULL);
+	//The window thread picks up the message on its next timer tick
+	return Enqueue(type, time(NULL), msgBuffer);
+}
 
-	UINT msg = WM_OUT_ADDLINE_SYST;
-	switch(type) {
-		case Output_System:
-			msg = WM_OUT_ADDLINE_SYST;
-			break;
-		case Output_Client:
-			msg = WM_OUT_ADDLINE_CLNT;
-			break;
-		case Output_Error:
-			msg = WM_OUT_ADDLINE_ERR;
-			break;
-		default:
-			break;
+int OutputWindow::Enqueue(Output_Type type, time_t time, const TCHAR * message) {
+	OutputEntry * entry = NULL;
+	LONG pos = m_enqueuePos;
+
+	for(;;) {
+		entry = &m_entries[pos & (OUTPUT_QUEUE_SIZE-1)];
+		LONG diff = entry->sequence - pos;
+		if (diff == 0) {
+			//entry is free, try to claim it
+			LONG prevPos = InterlockedCompareExchange(&m_enqueuePos, pos+1, pos);
+			if (prevPos == pos)
+				break;
+			pos = prevPos;
+		} else if (diff < 0) {
+			//queue full, the window thread is not keeping up
+			InterlockedIncrement(&m_dropped);
+			return -1;
+		} else {
+			pos = m_enqueuePos;
+		}
 	}
 
-	DWORD curThread = GetCurrentThreadId();
-	if (m_winThread == curThread) {
-		::PostMessage(m_hwnd, msg, (WPARAM)t, (LPARAM)msgBuffer);
-		return 0;
-	} else {
-		::PostMessage(m_hwnd, msg, (WPARAM)t, (LPARAM)msgBuffer);
+	entry->type = type;
+	entry->time = time;
+	if (SU::TCharToUtf8(message, entry->message, OUTPUT_MESSAGE_SIZE) == -1) {
+		//Too long: every character takes at most 3 bytes in UTF-8, so this fits
+		TCHAR shortMessage[OUTPUT_MESSAGE_SIZE/3];
+		lstrcpyn(shortMessage, message, OUTPUT_MESSAGE_SIZE/3);
+		SU::TCharToUtf8(shortMessage, entry->message, OUTPUT_MESSAGE_SIZE);
 	}
 
+	//publish the entry
+	InterlockedExchange(&entry->sequence, pos+1);
 
-    return 0;
+	return 0;
+}
+
+OutputEntry* OutputWindow::Dequeue() {
+	OutputEntry * entry = &m_entries[m_dequeuePos & (OUTPUT_QUEUE_SIZE-1)];
+	LONG diff = entry->sequence - (m_dequeuePos+1);
+	if (diff < 0)
+		return NULL;	//empty
+
+	return entry;
+}
+
+int OutputWindow::Release(OutputEntry * entry) {
+	InterlockedExchange(&entry->sequence, m_dequeuePos+OUTPUT_QUEUE_SIZE);
+	m_dequeuePos++;
+	return 0;
 }
 
 int OutputWindow::ScrollLastLine() {
@@ -324,82 +350,122 @@ int OutputWindow::SetScintillaParameters() {
 	return 0;
 }
 
-int OutputWindow::AddMessage(const TCHAR * message, Output_Type type, time_t ttime) {
-	int style = STYLE_DEFAULT;
+int OutputWindow::AddMessages() {
+	OutputEntry * entry = Dequeue();
+	LONG dropped = InterlockedExchange(&m_dropped, 0);
+	if (entry == NULL && dropped == 0)
+		return 0;
 
-	switch(type) {
-		case Output_System:
-			style = STYLE_SYSTEM;
-			break;
-		case Output_Client:
-			style = STYLE_CLIENT;
-			break;
-		case Output_Error:
-			style = STYLE_ERROR;
-			break;
-		default:
-			style = STYLE_DEFAULT;
-			break;
+	//Collect all queued messages, so they can be added in one go
+	std::string text;
+	std::string styles;
+	std::vector<int> lineStyles;
+	std::vector<time_t> lineTimes;
+
+	for(; entry != NULL; entry = Dequeue()) {
+		int style = STYLE_SYSTEM;
+		switch(entry->type) {
+			case Output_System:
+				style = STYLE_SYSTEM;
+				break;
+			case Output_Client:
+				style = STYLE_CLIENT;
+				break;
+			case Output_Error:
+				style = STYLE_ERROR;
+				break;
+			default:
+				style = STYLE_DEFAULT;
+				break;
+		}
+
+		size_t len = strlen(entry->message);
+		text.append(entry->message, len);
+		text.append("\r\n", 2);
+		styles.append(len+2, (char)style);
+		lineStyles.push_back(style);
+		lineTimes.push_back(entry->time);
+
+		Release(entry);
 	}
 
-	char * utf8Buffer = SU::TCharToUtf8(message);
-	char * timeString = new char[11];
-
-	struct tm * systime = localtime(&ttime);
-	if(strftime(timeString, 10, "%H:%M:%S", systime) == 0) {
-		timeString[0] = 0;
+	if (dropped > 0) {
+		char droppedMessage[100];
+		int len = sprintf(droppedMessage, "[NppFTP.OutputWindow] %ld messages were not shown, output too fast", dropped);
+		text.append(droppedMessage, len);
+		text.append("\r\n", 2);
+		styles.append(len+2, (char)STYLE_ERROR);
+		lineStyles.push_back(STYLE_ERROR);
+		lineTimes.push_back(time(NULL));
 	}
 
 	int lastPos = ::SendMessage(m_hScintilla, SCI_GETTEXTLENGTH, 0, 0);
 	int curPos = ::SendMessage(m_hScintilla, SCI_GETCURRENTPOS, 0, 0);
+	int firstLine = ::SendMessage(m_hScintilla, SCI_GETLINECOUNT, 0, 0) - 1;	//ignore final newline
+
+	//if the last line is in view, keep it in view
+	int visible = ::SendMessage(m_hScintilla, SCI_LINESONSCREEN, 0, 0);
+	int firstvisible = ::SendMessage(m_hScintilla, SCI_GETFIRSTVISIBLELINE, 0, 0);
+	bool scrollView = ((firstvisible+visible+1) >= firstLine);
 
 	::SendMessage(m_hScintilla, SCI_SETREADONLY, (WPARAM)false, 0);
-	::SendMessage(m_hScintilla, SCI_APPENDTEXT, (WPARAM)strlen(utf8Buffer), (LPARAM)utf8Buffer);
-	::SendMessage(m_hScintilla, SCI_APPENDTEXT, (WPARAM)2, (LPARAM)"\r\n");
-	::SendMessage(m_hScintilla, SCI_SETREADONLY, (WPARAM)true, 0);
+	::SendMessage(m_hScintilla, SCI_APPENDTEXT, (WPARAM)text.size(), (LPARAM)text.c_str());
 
 	::SendMessage(m_hScintilla, SCI_STARTSTYLING, (WPARAM)lastPos, (LPARAM)0xff);
-	::SendMessage(m_hScintilla, SCI_SETSTYLING, strlen(utf8Buffer)+2, style);
-
-	int lineCount = ::SendMessage(m_hScintilla, SCI_GETLINECOUNT, 0, 0);
-	lineCount--;	//ignore final newline
-
-	::SendMessage(m_hScintilla, SCI_MARGINSETTEXT, (WPARAM)lineCount-1, (LPARAM)timeString);
-	::SendMessage(m_hScintilla, SCI_MARGINSETSTYLE, (WPARAM)lineCount-1, (LPARAM)style+STYLE_MARGINOFFSET);
+	::SendMessage(m_hScintilla, SCI_SETSTYLINGEX, (WPARAM)styles.size(), (LPARAM)styles.c_str());
+
+	//Time in the margin, consecutive messages often share the same second
+	char timeString[11];
+	timeString[0] = 0;
+	time_t lastTime = (time_t)-1;
+	for(size_t i = 0; i < lineStyles.size(); i++) {
+		if (lineTimes[i] != lastTime) {
+			lastTime = lineTimes[i];
+			struct tm * systime = localtime(&lastTime);
+			if (systime == NULL || strftime(timeString, 10, "%H:%M:%S", systime) == 0) {
+				timeString[0] = 0;
+			}
+		}
+		::SendMessage(m_hScintilla, SCI_MARGINSETTEXT, (WPARAM)firstLine+i, (LPARAM)timeString);
+		::SendMessage(m_hScintilla, SCI_MARGINSETSTYLE, (WPARAM)firstLine+i, (LPARAM)lineStyles[i]+STYLE_MARGINOFFSET);
+	}
 
+	//Remove the oldest lines at once
+	int lineCount = ::SendMessage(m_hScintilla, SCI_GETLINECOUNT, 0, 0) - 1;	//ignore final newline
 	if (lineCount > m_maxLines) {
-		::SendMessage(m_hScintilla, SCI_SETREADONLY, (WPARAM)false, 0);
-		int endPos = ::SendMessage(m_hScintilla, SCI_POSITIONFROMLINE, (WPARAM)1, 0);
+		int excess = lineCount - m_maxLines;
+		int endPos = ::SendMessage(m_hScintilla, SCI_POSITIONFROMLINE, (WPARAM)excess, 0);
+
+		//the margin of the first line is kept when deleting, so take over the one of the new first line
 		char buffer[13];
-		::SendMessage(m_hScintilla, SCI_MARGINGETTEXT, (WPARAM)1, (LPARAM)buffer);
+		buffer[0] = 0;
+		int marginLen = ::SendMessage(m_hScintilla, SCI_MARGINGETTEXT, (WPARAM)excess, 0);
+		if (marginLen >= 0 && marginLen < (int)sizeof(buffer))
+			::SendMessage(m_hScintilla, SCI_MARGINGETTEXT, (WPARAM)excess, (LPARAM)buffer);
+		int marginStyle = ::SendMessage(m_hScintilla, SCI_MARGINGETSTYLE, (WPARAM)excess, 0);
 
 		::SendMessage(m_hScintilla, SCI_SETTARGETSTART, 0, 0);
 		::SendMessage(m_hScintilla, SCI_SETTARGETEND, endPos, 0);
 		::SendMessage(m_hScintilla, SCI_REPLACETARGET, 0, (LPARAM)"");
 
 		::SendMessage(m_hScintilla, SCI_MARGINSETTEXT, (WPARAM)0, (LPARAM)buffer);
+		::SendMessage(m_hScintilla, SCI_MARGINSETSTYLE, (WPARAM)0, (LPARAM)marginStyle);
 
-		::SendMessage(m_hScintilla, SCI_SETREADONLY, (WPARAM)true, 0);
+		lastPos -= endPos;
+		curPos -= endPos;
 	}
 
-	delete [] timeString;
+	::SendMessage(m_hScintilla, SCI_SETREADONLY, (WPARAM)true, 0);
 
 	if (curPos == lastPos || curPos == lastPos - 2) {	//if at last line, scroll the caret
-		lastPos = ::SendMessage(m_hScintilla, SCI_GETTEXTLENGTH, 0, 0);
-		::SendMessage(m_hScintilla, SCI_SETANCHOR, lastPos, 0);
-		::SendMessage(m_hScintilla, SCI_SETCURRENTPOS, lastPos, 0);
-		//::SendMessage(m_hScintilla, SCI_SCROLLCARET, 0, 0);
+		int endPos = ::SendMessage(m_hScintilla, SCI_GETTEXTLENGTH, 0, 0);
+		::SendMessage(m_hScintilla, SCI_SETANCHOR, endPos, 0);
+		::SendMessage(m_hScintilla, SCI_SETCURRENTPOS, endPos, 0);
 	}
 
-	//if the last line is in view, scroll the view
-	int visible = ::SendMessage(m_hScintilla, SCI_LINESONSCREEN, 0, 0);
-	int firstvisible = ::SendMessage(m_hScintilla, SCI_GETFIRSTVISIBLELINE, 0, 0);
-	int lastline = lineCount-1;	//ignore very last line
-	if ((firstvisible+visible+1) >= lastline) {
-		::SendMessage(m_hScintilla, SCI_LINESCROLL, 0, (LPARAM)1);	//scroll down one line, as one line was added
+	if (scrollView) {
+		ScrollLastLine();
 	}
 
-	SU::FreeChar(utf8Buffer);
-
 	return 0;
 }
@@ -21,6 +21,18 @@
 
 #include "DockableWindow.h"
 
+//Size of the message queue, must be a power of two
+#define OUTPUT_QUEUE_SIZE		512
+//Maximum length of a single message in UTF-8, including terminator
+#define OUTPUT_MESSAGE_SIZE		2048
+
+struct OutputEntry {
+	volatile LONG			sequence;	//position the entry is ready for: writing when equal to the enqueue position, reading when one ahead
+	Output_Type				type;
+	time_t					time;
+	char					message[OUTPUT_MESSAGE_SIZE];	//UTF-8
+};
+
 class OutputWindow : public DockableWindow, Output {
 public:
 
@@ -44,7 +56,17 @@ public:
 	virtual int				ScrollLastLine();
 protected:
 	virtual int				SetScintillaParameters();
-	virtual int				AddMessage(const TCHAR * message, Output_Type type, time_t time);
+	virtual int				AddMessages();	//drain the message queue
+
+	virtual int				Enqueue(Output_Type type, time_t time, const TCHAR * message);
+	virtual OutputEntry*	Dequeue();
+	virtual int				Release(OutputEntry * entry);
+
+	//Lock free queue, any thread can add messages, only the window thread removes them
+	OutputEntry*			m_entries;
+	volatile LONG			m_enqueuePos;
+	LONG					m_dequeuePos;
+	volatile LONG			m_dropped;	//messages lost because the queue was full
 
 	DWORD					m_winThread;
 	HMENU					m_hContextMenu;
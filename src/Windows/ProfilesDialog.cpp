@@ -380,6 +380,20 @@ INT_PTR ProfilesDialog::OnCommand(int ctrlId, int notifCode, HWND idHwnd) {
 			}
 			break; }
 
+		case IDC_CHECK_EPRT: {
+			if (notifCode == BN_CLICKED) {
+				LRESULT checked = Button_GetCheck(idHwnd);
+				m_currentProfile->SetUseEPRT(checked == BST_CHECKED);
+			}
+			break; }
+		case IDC_EDIT_PORTPOOL: {
+			if (notifCode == EN_USERCHANGE) {
+				BOOL success = FALSE;
+				int size = GetDlgItemInt(m_hPageFTP, ctrlId, &success, FALSE);
+				if (success)
+					m_currentProfile->SetDataPortPool(size);
+			}
+			break; }
 		case IDC_EDIT_LISTPARAMS: {
 			if (notifCode == EN_USERCHANGE) {
 				GetWindowTextA(idHwnd, aTextBuffer, MAX_PATH);
@@ -557,6 +571,7 @@ INT_PTR ProfilesDialog::OnInitDialog() {
 	::SetWindowLongPtr(::GetDlgItem(m_hPageTransfer, IDC_EDIT_PORT_MAX), GWLP_WNDPROC, (LONG_PTR)&Dialog::EditProc);
 
 	::SetWindowLongPtr(::GetDlgItem(m_hPageFTP, IDC_EDIT_LISTPARAMS), GWLP_WNDPROC, (LONG_PTR)&Dialog::EditProc);
+	::SetWindowLongPtr(::GetDlgItem(m_hPageFTP, IDC_EDIT_PORTPOOL), GWLP_WNDPROC, (LONG_PTR)&Dialog::EditProc);
 
 	::SetWindowLongPtr(::GetDlgItem(m_hPageCache, IDC_EDIT_CACHELOCAL), GWLP_WNDPROC, (LONG_PTR)&Dialog::EditProc);
 	::SetWindowLongPtr(::GetDlgItem(m_hPageCache, IDC_EDIT_CACHEEXTERNAL), GWLP_WNDPROC, (LONG_PTR)&Dialog::EditProc);
@@ -668,6 +683,8 @@ int ProfilesDialog::OnSelectProfile(FTPProfile * profile) {
 		::EnableWindow(::GetDlgItem(m_hPageTransfer, IDC_EDIT_PORT_MAX), enableSettings);
 
 		::EnableWindow(::GetDlgItem(m_hPageFTP, IDC_EDIT_LISTPARAMS), enableSettings);
+		::EnableWindow(::GetDlgItem(m_hPageFTP, IDC_CHECK_EPRT), enableSettings);
+		::EnableWindow(::GetDlgItem(m_hPageFTP, IDC_EDIT_PORTPOOL), enableSettings);
 
 		::EnableWindow(::GetDlgItem(m_hPageCache, IDC_LIST_CACHE), enableSettings);
 		::EnableWindow(::GetDlgItem(m_hPageCache, IDC_SPIN_CACHE), enableSettings);
@@ -728,6 +745,8 @@ int ProfilesDialog::OnSelectProfile(FTPProfile * profile) {
 	::SetDlgItemInt(m_hPageTransfer, IDC_EDIT_PORT_MAX, max, FALSE);
 
 	::SetDlgItemTextA(m_hPageFTP, IDC_EDIT_LISTPARAMS, m_currentProfile->GetListParams());
+	Button_SetCheck(::GetDlgItem(m_hPageFTP, IDC_CHECK_EPRT), m_currentProfile->GetUseEPRT()?TRUE:FALSE);
+	::SetDlgItemInt(m_hPageFTP, IDC_EDIT_PORTPOOL, m_currentProfile->GetDataPortPool(), FALSE);
 
 	LoadFiletypes();
 	LoadCacheMaps();
@@ -834,9 +853,8 @@ int ProfilesDialog::LoadCacheMaps() {
 		int index = ListView_InsertItem(hListview,  &lvi);
 		if (index == -1)
 			return -1;
-		TCHAR * external = SU::Utf8ToTChar(pathmap.externalpath);
-		ListView_SetItemText(hListview, index, 1, external);
-		SU::FreeTChar(external);
+		Utf8ToTCharStr external(pathmap.externalpath);
+		ListView_SetItemText(hListview, index, 1, (TCHAR*)external.c_str());
 	}
 
 	OnCacheMapSelect();
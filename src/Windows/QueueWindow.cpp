@@ -57,6 +57,16 @@ int QueueWindow::Create(HWND hParent) {
 	lvc.pszText = strFile;
 	ListView_InsertColumn(m_hwnd, 2, &lvc);
 
+	lvc.cx = 70;
+	TCHAR strRate[] = TEXT("Rate");
+	lvc.pszText = strRate;
+	ListView_InsertColumn(m_hwnd, 3, &lvc);
+
+	lvc.cx = 50;
+	TCHAR strETA[] = TEXT("ETA");
+	lvc.pszText = strETA;
+	ListView_InsertColumn(m_hwnd, 4, &lvc);
+
 	return 0;
 }
 
@@ -70,7 +80,12 @@ int QueueWindow::PushQueueItem(QueueOperation * op) {
 	lvi.iItem = GetNrItems();
 	lvi.iSubItem = 0;
 	lvi.lParam = (LPARAM)op;
-	lvi.pszText = (TCHAR*)(type==QueueOperation::QueueTypeDownload||type==QueueOperation::QueueTypeDownloadHandle?TEXT("Download"):TEXT("Upload"));
+	if (type == QueueOperation::QueueTypeSearch)
+		lvi.pszText = (TCHAR*)TEXT("Search");
+	else if (type == QueueOperation::QueueTypeSync)
+		lvi.pszText = (TCHAR*)TEXT("Sync");
+	else
+		lvi.pszText = (TCHAR*)(type==QueueOperation::QueueTypeDownload||type==QueueOperation::QueueTypeDownloadHandle?TEXT("Download"):TEXT("Upload"));
 
 	int index = ListView_InsertItem(m_hwnd,  &lvi);
 	if (index == -1)
@@ -78,20 +93,26 @@ int QueueWindow::PushQueueItem(QueueOperation * op) {
 
 	ListView_SetItemText(m_hwnd, index, 1, TEXT("0.0%") );
 
-	TCHAR * path = NULL;
+	const char * externalPath = NULL;
 	if (type == QueueOperation::QueueTypeDownload) {
 		QueueDownload * qdld = (QueueDownload*)op;
-		path = SU::Utf8ToTChar(qdld->GetExternalPath());
+		externalPath = qdld->GetExternalPath();
 	} else if (type == QueueOperation::QueueTypeDownloadHandle) {
 		QueueDownloadHandle * qdld = (QueueDownloadHandle*)op;
-		path = SU::Utf8ToTChar(qdld->GetExternalPath());
+		externalPath = qdld->GetExternalPath();
 	} else if (type == QueueOperation::QueueTypeUpload) {
 		QueueUpload * quld = (QueueUpload*)op;
-		path = SU::Utf8ToTChar(quld->GetExternalPath());
+		externalPath = quld->GetExternalPath();
+	} else if (type == QueueOperation::QueueTypeSearch) {
+		QueueSearch * qsearch = (QueueSearch*)op;
+		externalPath = qsearch->GetPath();
+	} else if (type == QueueOperation::QueueTypeSync) {
+		QueueSync * qsync = (QueueSync*)op;
+		externalPath = qsync->GetExternalPath();
 	}
 
-	ListView_SetItemText(m_hwnd, index, 2, path );
-	SU::FreeTChar(path);
+	Utf8ToTCharStr path(externalPath);
+	ListView_SetItemText(m_hwnd, index, 2, (TCHAR*)path.c_str() );
 
 	return 0;
 }
@@ -184,6 +205,26 @@ int QueueWindow::ProgressQueueItem(QueueOperation * op) {
 
 	ListView_SetItemText(m_hwnd, index, 1, buffer );
 
+	TCHAR rateBuffer[20];
+	double rate = op->GetRate();
+	if (rate >= 1024.0*1024.0) {
+		SU::TSprintf(rateBuffer, 20, TEXT("%.1f MB/s"), rate/(1024.0*1024.0));
+	} else {
+		SU::TSprintf(rateBuffer, 20, TEXT("%.1f KB/s"), rate/1024.0);
+	}
+	ListView_SetItemText(m_hwnd, index, 3, rateBuffer );
+
+	TCHAR etaBuffer[20];
+	int remaining = op->GetRemainingTime();
+	if (remaining < 0) {
+		lstrcpy(etaBuffer, TEXT("??"));
+	} else if (remaining >= 3600) {
+		SU::TSprintf(etaBuffer, 20, TEXT("%d:%02d:%02d"), remaining/3600, (remaining/60)%60, remaining%60);
+	} else {
+		SU::TSprintf(etaBuffer, 20, TEXT("%d:%02d"), remaining/60, remaining%60);
+	}
+	ListView_SetItemText(m_hwnd, index, 4, etaBuffer );
+
 	return 0;
 }
 
@@ -224,6 +265,8 @@ bool QueueWindow::ValidType(QueueOperation::QueueType type) {
 	return (
 		type == QueueOperation::QueueTypeDownload ||
 		type == QueueOperation::QueueTypeDownloadHandle ||
-		type == QueueOperation::QueueTypeUpload
+		type == QueueOperation::QueueTypeUpload ||
+		type == QueueOperation::QueueTypeSearch ||
+		type == QueueOperation::QueueTypeSync
 		);
 }
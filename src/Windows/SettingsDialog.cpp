@@ -55,8 +55,19 @@ INT_PTR SettingsDialog::OnInitDialog() {
 	Button_SetCheck(::GetDlgItem(m_hwnd, IDC_CHECK_CLEARCACHE), (m_ftpSettings->GetClearCache())?TRUE:FALSE);
 	Button_SetCheck(::GetDlgItem(m_hwnd, IDC_CHECK_CLEARNORECYCLE), (m_ftpSettings->GetClearCachePermanent())?TRUE:FALSE);
 	::EnableWindow( ::GetDlgItem(m_hwnd, IDC_CHECK_CLEARNORECYCLE), (m_ftpSettings->GetClearCache()) );
+	::SetDlgItemInt(m_hwnd, IDC_EDIT_CACHELIMIT, m_ftpSettings->GetCacheSizeLimit(), FALSE);
+
+	//Same order as Hash_Type
+	HWND hCombobox = ::GetDlgItem(m_hwnd, IDC_COMBO_VERIFYHASH);
+	ComboBox_AddString(hCombobox, TEXT("Off"));
+	ComboBox_AddString(hCombobox, TEXT("CRC32"));
+	ComboBox_AddString(hCombobox, TEXT("MD5"));
+	ComboBox_AddString(hCombobox, TEXT("SHA-1"));
+	ComboBox_AddString(hCombobox, TEXT("SHA-256"));
+	ComboBox_SetCurSel(hCombobox, (int)m_ftpSettings->GetVerifyHash());
 	
 	Button_SetCheck(::GetDlgItem(m_hwnd, IDC_CHECK_DEBUGMODE), (m_ftpSettings->GetDebugMode())?TRUE:FALSE);		
+	Button_SetCheck(::GetDlgItem(m_hwnd, IDC_CHECK_TRACEMODE), (m_ftpSettings->GetTraceMode())?TRUE:FALSE);
 
 	return Dialog::OnInitDialog();
 }
@@ -83,7 +94,10 @@ INT_PTR SettingsDialog::OnCommand(int ctrlId, int notifCode, HWND idHwnd) {
 			SaveGlobalPath();
 			SaveMasterPassword();
 			SaveClearCache();
+			SaveCacheSizeLimit();
+			SaveVerifyHash();
 			SaveDebugMode();
+			SaveTraceMode();
 			EndDialog(m_hwnd, 0);
 			break; }
 		case IDC_CHECK_CLEARCACHE: {
@@ -120,6 +134,15 @@ int SettingsDialog::SaveDebugMode() {
 	return 0;	
 }
 
+int SettingsDialog::SaveTraceMode() {
+	LRESULT checked = Button_GetCheck(::GetDlgItem(m_hwnd, IDC_CHECK_TRACEMODE));
+	bool traceMode = (checked == BST_CHECKED);
+	if (traceMode != m_ftpSettings->GetTraceMode())
+		m_ftpSettings->SetTraceMode(traceMode);
+
+	return 0;
+}
+
 int SettingsDialog::SaveMasterPassword() {
 	char password[Encryption::KeySize+1];
 	::GetDlgItemTextA(m_hwnd, IDC_EDIT_MASTERPASS, password, Encryption::KeySize+1);
@@ -137,3 +160,20 @@ int SettingsDialog::SaveClearCache() {
 	return 0;
 }
 
+int SettingsDialog::SaveCacheSizeLimit() {
+	BOOL success = FALSE;
+	int limit = GetDlgItemInt(m_hwnd, IDC_EDIT_CACHELIMIT, &success, FALSE);
+	if (success == TRUE)
+		m_ftpSettings->SetCacheSizeLimit(limit);
+
+	return 0;
+}
+
+int SettingsDialog::SaveVerifyHash() {
+	int selection = ComboBox_GetCurSel(::GetDlgItem(m_hwnd, IDC_COMBO_VERIFYHASH));
+	if (selection >= Hash_None && selection < Hash_TypeMax)
+		m_ftpSettings->SetVerifyHash((Hash_Type)selection);
+
+	return 0;
+}
+
@@ -36,9 +36,12 @@ protected:
 	virtual INT_PTR			OnNotify(NMHDR * pnmh);
 
 	int						SaveDebugMode();
+	int						SaveTraceMode();
 	int						SaveGlobalPath();
 	int						SaveMasterPassword();
 	int						SaveClearCache();
+	int						SaveCacheSizeLimit();
+	int						SaveVerifyHash();
 
 	FTPSettings*			m_ftpSettings;
 };
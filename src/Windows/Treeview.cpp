@@ -133,6 +133,8 @@ int Treeview::FillTreeDirectory(FileObject * dir) {
 }
 
 int Treeview::RemoveAllChildItems(HTREEITEM parent) {
+	ForgetMarks(parent);
+
 	HTREEITEM child;
 	while( (child = TreeView_GetChild(m_hwnd, parent)) != NULL) {
 		TreeView_DeleteItem(m_hwnd, child);
@@ -176,23 +178,38 @@ int Treeview::GetDispInfo(TV_DISPINFO* ptvdi) {
 	return TRUE;
 }
 
-HTREEITEM Treeview::OnClick() {
-	HTREEITEM selected = NULL;
-	DWORD dPos = GetMessagePos();			//get current mouse pos
-	POINTS pts = MAKEPOINTS(dPos);
-	POINT pos = {pts.x, pts.y};
-	ScreenToClient(m_hwnd, &pos);
+HTREEITEM Treeview::OnClick(bool keepMarks) {
+	HTREEITEM selected = HitTest();
+	if (selected == NULL)
+		return NULL;
 
-	TV_HITTESTINFO ht;
-	ht.pt = pos;
-	selected = TreeView_HitTest(m_hwnd, &ht);
+	if (!keepMarks || !IsMarked(selected))
+		ClearMarks();
 
-	if (selected != NULL && (ht.flags & TVHT_ONITEM)) {
-		TreeView_Select(m_hwnd, selected, TVGN_CARET);
-		return selected;
+	TreeView_Select(m_hwnd, selected, TVGN_CARET);
+
+	//Selecting unhighlights the previous item, which may be marked
+	for(size_t i = 0; i < m_marked.size(); i++)
+		TreeView_SetItemState(m_hwnd, m_marked[i], TVIS_SELECTED, TVIS_SELECTED);
+
+	return selected;
+}
+
+HTREEITEM Treeview::OnMarkClick() {
+	HTREEITEM clicked = HitTest();
+	if (clicked == NULL || TreeView_GetParent(m_hwnd, clicked) == NULL)
+		return NULL;	//the root cannot be marked
+
+	if (m_marked.empty()) {
+		//Marking starts from the selected item, like in Explorer
+		HTREEITEM selected = TreeView_GetSelection(m_hwnd);
+		if (selected != NULL && selected != clicked && TreeView_GetParent(m_hwnd, selected) != NULL)
+			SetMark(selected, true);
 	}
 
-	return NULL;
+	SetMark(clicked, !IsMarked(clicked));
+
+	return clicked;
 }
 
 int Treeview::OnToolTip(const NMTVGETINFOTIP* nmt) {
@@ -221,11 +238,12 @@ int Treeview::OnToolTip(const NMTVGETINFOTIP* nmt) {
 		}
 	}
 	
-	wchar_t txtMod[11];
+	wchar_t txtMod[20];
 	if (strcmp(fo->GetMod(), "") == 0) {
-		_stprintf(txtMod, 15, TEXT(""));
+		_stprintf(txtMod, 20, TEXT(""));
 	} else {
-		_stprintf(txtMod, 15, TEXT("Mod: %s\n"), SU::CharToWChar(fo->GetMod()));	
+		Utf8ToTCharStr mod(fo->GetMod());
+		_stprintf(txtMod, 20, TEXT("Mod: %s\n"), mod.c_str());
 	}
 
 	_stprintf(nmt->pszText,
@@ -392,6 +410,8 @@ int Treeview::EnsureObjectVisible(FileObject * fo) {
 }
 
 int Treeview::ClearAll() {
+	m_marked.clear();
+
 	HTREEITEM root = TreeView_GetRoot(m_hwnd);
 	if (root == NULL)
 		return 0;
@@ -404,6 +424,84 @@ int Treeview::ClearAll() {
 	return 0;
 }
 
+int Treeview::GetMarkedObjects(std::vector<FileObject*> & objects) {
+	objects.clear();
+	for(size_t i = 0; i < m_marked.size(); i++) {
+		FileObject * fo = GetItemFileObject(m_marked[i]);
+		if (fo)
+			objects.push_back(fo);
+	}
+
+	return (int)objects.size();
+}
+
+int Treeview::ClearMarks() {
+	HTREEITEM selected = TreeView_GetSelection(m_hwnd);
+	for(size_t i = 0; i < m_marked.size(); i++) {
+		if (m_marked[i] != selected)
+			TreeView_SetItemState(m_hwnd, m_marked[i], 0, TVIS_SELECTED);
+	}
+	m_marked.clear();
+
+	return 0;
+}
+
+HTREEITEM Treeview::HitTest() {
+	DWORD dPos = GetMessagePos();			//get current mouse pos
+	POINTS pts = MAKEPOINTS(dPos);
+	POINT pos = {pts.x, pts.y};
+	ScreenToClient(m_hwnd, &pos);
+
+	TV_HITTESTINFO ht;
+	ht.pt = pos;
+	HTREEITEM item = TreeView_HitTest(m_hwnd, &ht);
+
+	if (item != NULL && (ht.flags & TVHT_ONITEM))
+		return item;
+
+	return NULL;
+}
+
+bool Treeview::IsMarked(HTREEITEM item) {
+	for(size_t i = 0; i < m_marked.size(); i++) {
+		if (m_marked[i] == item)
+			return true;
+	}
+
+	return false;
+}
+
+int Treeview::SetMark(HTREEITEM item, bool mark) {
+	for(size_t i = 0; i < m_marked.size(); i++) {
+		if (m_marked[i] == item) {
+			m_marked.erase(m_marked.begin()+i);
+			break;
+		}
+	}
+
+	if (mark)
+		m_marked.push_back(item);
+
+	TreeView_SetItemState(m_hwnd, item, mark?TVIS_SELECTED:0, TVIS_SELECTED);
+
+	return 0;
+}
+
+int Treeview::ForgetMarks(HTREEITEM parent) {
+	for(size_t i = 0; i < m_marked.size(); ) {
+		HTREEITEM ancestor = TreeView_GetParent(m_hwnd, m_marked[i]);
+		while(ancestor != NULL && ancestor != parent)
+			ancestor = TreeView_GetParent(m_hwnd, ancestor);
+
+		if (ancestor == parent)
+			m_marked.erase(m_marked.begin()+i);
+		else
+			i++;
+	}
+
+	return 0;
+}
+
 int Treeview::ClearObjectDataRecursive(FileObject * fo, bool includeTop) {
 	if (!fo)
 		return -1;
@@ -572,9 +670,8 @@ int TreeImageList::GetIconIndex(const FileObject* fo, bool isSelected) {
 			if (isSelected)
 				flags |= SHGFI_SELECTED;
 
-			TCHAR * wName = SU::Utf8ToTChar(fo->GetName());
-			SHGetFileInfo(wName, FILE_ATTRIBUTE_NORMAL, &shfi, sizeof(SHFILEINFO), flags);
-			SU::FreeTChar(wName);
+			Utf8ToTCharStr wName(fo->GetName());
+			SHGetFileInfo(wName.c_str(), FILE_ATTRIBUTE_NORMAL, &shfi, sizeof(SHFILEINFO), flags);
 			index = shfi.iIcon;
 		}
 	} else {
@@ -45,7 +45,8 @@ public:
 	virtual int				RemoveAllChildItems(HTREEITEM parent);
 
 	virtual int				GetDispInfo(TV_DISPINFO* ptvdi);
-	virtual HTREEITEM		OnClick();
+	virtual HTREEITEM		OnClick(bool keepMarks = false);	//keepMarks: keep the marks when clicking a marked item
+	virtual HTREEITEM		OnMarkClick();	//ctrl+click, toggles the mark of the item without selecting it
 	virtual int				OnExpanding(const NM_TREEVIEW* nmt);	//return true when refresh is required
 	virtual int       OnToolTip(const NMTVGETINFOTIP* nmt);
 
@@ -59,13 +60,22 @@ public:
 	virtual int				EnsureObjectVisible(FileObject * fo);
 
 	virtual int				ClearAll();
+
+	//Marked items, to operate on several items at once. The selected item is not marked unless ctrl+clicked
+	virtual int				GetMarkedObjects(std::vector<FileObject*> & objects);
+	virtual int				ClearMarks();
 protected:
 	virtual int				ClearObjectDataRecursive(FileObject * fo, bool includeTop);
+	virtual HTREEITEM		HitTest();
+	virtual bool			IsMarked(HTREEITEM item);
+	virtual int				SetMark(HTREEITEM item, bool mark);
+	virtual int				ForgetMarks(HTREEITEM parent);	//the children of parent are about to be deleted
 
 	virtual int				RedrawItem(HTREEITEM item);
 
 	TreeImageList*			m_treeImagelist;
 	HTREEITEM               curSelectedItem;
+	std::vector<HTREEITEM>	m_marked;
 };
 
 class TreeImageList {
@@ -89,6 +89,8 @@
 	#define IDC_EDIT_PORT_MAX			187
 #define IDD_DIALOG_PROFILESFTP			188
 	#define IDC_EDIT_LISTPARAMS			189
+	#define IDC_CHECK_EPRT				200
+	#define IDC_EDIT_PORTPOOL			201
 #define IDD_DIALOG_PROFILESCACHE		156
 	#define IDC_LIST_CACHE				157
 	#define IDC_SPIN_CACHE				158
@@ -105,6 +107,9 @@
 	#define IDC_CHECK_CLEARCACHE		190
 	#define IDC_CHECK_CLEARNORECYCLE	191
 	#define IDC_CHECK_DEBUGMODE	196
+	#define IDC_CHECK_TRACEMODE	197
+	#define IDC_EDIT_CACHELIMIT	198
+	#define IDC_COMBO_VERIFYHASH	199
 	//#define IDC_BUTTON_CLOSE			169
 #define IDD_DIALOG_ABOUT				170
 	#define IDC_STATIC_ZLIBVERSION		194
@@ -122,4 +127,4 @@
 	#define IDC_EDIT_PROMPTMAX			182
 	#define IDC_EDIT_ANSWERMAX			183
 	#define IDC_STATIC_MARKER			184
-//next id:								197
+//next id:								202
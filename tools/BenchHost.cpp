@@ -0,0 +1,249 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StdInc.h"
+#include "BenchHost.h"
+
+#include "OperationMetrics.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+//Set up by NppFTP.cpp in the plugin. Without a window the core has no one to ask, so the
+//drivers have to trust the stand-ins up front (certificates, known hosts)
+HWND _MainOutputWindow = NULL;
+char * _HostsFile = NULL;
+TCHAR * _ConfigPath = NULL;
+
+BenchOutput* BenchHost::m_output = NULL;
+
+BenchOutput::BenchOutput(bool verbose) :
+	m_verbose(verbose)
+{
+}
+
+BenchOutput::~BenchOutput() {
+}
+
+int BenchOutput::OutVA(Output_Type type, const TCHAR * message, va_list vaList) {
+	if (!message)
+		return -1;
+
+	if (!m_verbose && type != Output_Error)
+		return 0;
+
+	TCHAR msgBuffer[1024];
+	msgBuffer[0] = 0;
+	SU::TSprintfV(msgBuffer, 1024, message, vaList);
+	msgBuffer[1023] = 0;
+
+	char utf8Buffer[3*1024];
+	if (SU::TCharToUtf8(msgBuffer, utf8Buffer, sizeof(utf8Buffer)) == -1)
+		return -1;
+
+	fprintf(stderr, "%s\n", utf8Buffer);
+	return 0;
+}
+
+BenchReport::BenchReport(Bench_Format format, FILE * out) :
+	m_format(format),
+	m_out(out),
+	m_count(0),
+	m_failures(0)
+{
+}
+
+BenchReport::~BenchReport() {
+}
+
+int BenchReport::Begin() {
+	if (m_format == Format_JSON)
+		fprintf(m_out, "[\n");
+	else
+		fprintf(m_out, "scenario,client,security,iterations,failures,total_us,per_op_us,ops_per_s,bytes,mb_per_s\n");
+
+	return 0;
+}
+
+int BenchReport::Add(const BenchResult & result) {
+	double time = (double)result.time;
+	double perOp = (result.iterations > 0)?time/result.iterations:0.0;
+	double opsPerSecond = (time > 0)?result.iterations*1000000.0/time:0.0;
+	double mbPerSecond = (time > 0)?(double)result.bytes/time:0.0;	//bytes per microsecond
+
+	if (m_format == Format_JSON) {
+		fprintf(m_out, "%s  {\"scenario\": \"%s\", \"client\": \"%s\", \"security\": \"%s\", "
+			"\"iterations\": %d, \"failures\": %d, \"total_us\": %.0f, \"per_op_us\": %.1f, "
+			"\"ops_per_s\": %.2f, \"bytes\": %.0f, \"mb_per_s\": %.3f}",
+			(m_count > 0)?",\n":"", result.scenario, result.client, result.security,
+			result.iterations, result.failures, time, perOp, opsPerSecond, (double)result.bytes, mbPerSecond);
+	} else {
+		fprintf(m_out, "%s,%s,%s,%d,%d,%.0f,%.1f,%.2f,%.0f,%.3f\n",
+			result.scenario, result.client, result.security,
+			result.iterations, result.failures, time, perOp, opsPerSecond, (double)result.bytes, mbPerSecond);
+	}
+	fflush(m_out);
+
+	m_count++;
+	m_failures += result.failures;
+
+	return 0;
+}
+
+int BenchReport::End() {
+	if (m_format == Format_JSON)
+		fprintf(m_out, "%s]\n", (m_count > 0)?"\n":"");
+	fflush(m_out);
+
+	return 0;
+}
+
+int BenchReport::GetFailures() {
+	return m_failures;
+}
+
+int BenchHost::Init(bool verbose) {
+	_DebugMode = verbose;
+
+	m_output = new BenchOutput(verbose);
+	_MainOutput = m_output;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)
+		return -1;
+
+	return 0;
+}
+
+int BenchHost::Deinit() {
+	WSACleanup();
+
+	_MainOutput = NULL;
+	delete m_output;
+	m_output = NULL;
+
+	return 0;
+}
+
+LONGLONG BenchHost::Now() {
+	return OperationMetrics::Now();
+}
+
+BenchResult BenchHost::NewResult(const char * scenario, const char * client, const char * security) {
+	BenchResult result;
+	result.scenario = scenario;
+	result.client = client;
+	result.security = security;
+	result.iterations = 0;
+	result.failures = 0;
+	result.time = 0;
+	result.bytes = 0;
+	return result;
+}
+
+int BenchHost::Count(BenchResult & result, bool success, LONGLONG bytes) {
+	result.iterations++;
+	if (success)
+		result.bytes += bytes;
+	else
+		result.failures++;
+	return success?0:-1;
+}
+
+//1 if argv[*index] is the option, which is then moved past its value. 0 if it is not, -1 if the value is missing
+int BenchHost::GetOption(int argc, char ** argv, int * index, const char * name, const char ** value) {
+	if (strcmp(argv[*index], name) != 0)
+		return 0;
+	if (*index+1 >= argc)
+		return -1;
+
+	(*index)++;
+	*value = argv[*index];
+	return 1;
+}
+
+int BenchHost::GetOption(int argc, char ** argv, int * index, const char * name, long * value) {
+	const char * str = NULL;
+	int res = GetOption(argc, argv, index, name, &str);
+	if (res == 1)
+		*value = atol(str);
+
+	return res;
+}
+
+int BenchHost::CreateTempDir(const TCHAR * name, TCHAR * path) {
+	TCHAR tempPath[MAX_PATH];
+	if (GetTempPath(MAX_PATH, tempPath) == 0)
+		return -1;
+
+	SU::TSprintf(path, MAX_PATH, TEXT("%T%T%lu"), tempPath, name, GetCurrentProcessId());
+	path[MAX_PATH-1] = 0;
+
+	RemoveDir(path);	//left behind by an earlier run
+	if (CreateDirectory(path, NULL) == FALSE)
+		return -1;
+
+	return 0;
+}
+
+int BenchHost::RemoveDir(const TCHAR * path) {
+	TCHAR findPath[MAX_PATH];
+	SU::TSprintf(findPath, MAX_PATH, TEXT("%T\\*"), path);
+
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = FindFirstFile(findPath, &findData);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (!lstrcmp(findData.cFileName, TEXT(".")) || !lstrcmp(findData.cFileName, TEXT("..")))
+				continue;
+
+			TCHAR childPath[MAX_PATH];
+			SU::TSprintf(childPath, MAX_PATH, TEXT("%T\\%T"), path, findData.cFileName);
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				RemoveDir(childPath);
+			else
+				DeleteFile(childPath);
+		} while(FindNextFile(hFind, &findData) != FALSE);
+		FindClose(hFind);
+	}
+
+	return (RemoveDirectory(path) == FALSE)?-1:0;
+}
+
+int BenchHost::WriteTestFile(const TCHAR * path, long size) {
+	HANDLE hFile = ::CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return -1;
+
+	//26 * 2520 bytes, so the pattern continues seamlessly from one write to the next
+	static char pattern[65520];
+	for(int i = 0; i < (int)sizeof(pattern); i++)
+		pattern[i] = (char)('a' + (i%26));
+
+	BOOL res = TRUE;
+	long written = 0;
+	while(written < size && res == TRUE) {
+		DWORD len = (DWORD)((size-written < (long)sizeof(pattern))?(size-written):(long)sizeof(pattern));
+		DWORD done = 0;
+		res = WriteFile(hFile, pattern, len, &done, NULL);
+		written += done;
+	}
+
+	CloseHandle(hFile);
+	return (res == TRUE)?0:-1;
+}
@@ -0,0 +1,88 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHHOST_H
+#define BENCHHOST_H
+
+//Shared by the benchmark drivers: provides what the plugin normally sets up for the core,
+//times the scenarios and writes the results as CSV or JSON to stdout. Log output goes to stderr
+
+#include <stdio.h>
+
+enum Bench_Format { Format_CSV = 0, Format_JSON = 1 };
+
+struct BenchResult {
+	const char *			scenario;
+	const char *			client;		//class that was measured
+	const char *			security;	//"ftp", "ftpes", "ftps" or "sftp"
+	int						iterations;
+	int						failures;
+	LONGLONG				time;		//microseconds, all iterations
+	LONGLONG				bytes;		//payload of all iterations, 0 if nothing was transferred
+};
+
+class BenchOutput : public Output {
+public:
+							BenchOutput(bool verbose);
+	virtual					~BenchOutput();
+
+	virtual int				OutVA(Output_Type type, const TCHAR * message, va_list vaList);
+private:
+	bool					m_verbose;	//everything instead of only errors
+};
+
+class BenchReport {
+public:
+							BenchReport(Bench_Format format, FILE * out);
+	virtual					~BenchReport();
+
+	virtual int				Begin();
+	virtual int				Add(const BenchResult & result);
+	virtual int				End();
+
+	virtual int				GetFailures();	//failed iterations of all results
+private:
+	Bench_Format			m_format;
+	FILE*					m_out;
+	int						m_count;
+	int						m_failures;
+};
+
+class BenchHost {
+public:
+	static int				Init(bool verbose);
+	static int				Deinit();
+
+	static LONGLONG			Now();	//microseconds
+
+	static BenchResult		NewResult(const char * scenario, const char * client, const char * security);
+	static int				Count(BenchResult & result, bool success, LONGLONG bytes);	//one iteration, -1 if it failed
+
+							//Parses "-name value" options, -1 if the value is missing
+	static int				GetOption(int argc, char ** argv, int * index, const char * name, long * value);
+	static int				GetOption(int argc, char ** argv, int * index, const char * name, const char ** value);
+
+							//Fresh directory below the temp folder, path must hold MAX_PATH characters
+	static int				CreateTempDir(const TCHAR * name, TCHAR * path);
+	static int				RemoveDir(const TCHAR * path);	//recursive
+	static int				WriteTestFile(const TCHAR * path, long size);	//filled with the pattern of the stand-ins
+private:
+	static BenchOutput*		m_output;
+};
+
+#endif //BENCHHOST_H
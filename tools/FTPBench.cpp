@@ -0,0 +1,452 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Benchmarks CUT_FTPClient and FTPClientWrapperSSL against FTPStandIn, which runs in this process
+//Usage: FTPBench [-format csv|json] [-security ftp,ftpes,ftps] [-active] [-latency ms] [-bandwidth bytes/s]
+//                [-connects n] [-files n] [-filesize bytes] [-large bytes] [-v]
+//Results go to stdout, one line or object per scenario. The exit code is 1 if any iteration failed
+
+#include "StdInc.h"
+#include "FTPClientWrapper.h"
+#include "FTPStandIn.h"
+#include "BenchHost.h"
+
+struct BenchConfig {
+	int						connects;	//iterations of the connect scenario
+	int						lists;		//iterations of the 1k listing, the 100k listing is done once
+	int						files;		//files of the small file scenarios
+	long					fileSize;
+	long					largeSize;
+	bool					active;
+	int						latency;
+	long					bandwidth;
+};
+
+//Generates the pattern of the stand-in when read, counts and discards what is written
+class BenchDataSource : public CUT_DataSource {
+public:
+	BenchDataSource(long size) : m_size(size), m_pos(0), m_written(0) {};
+	virtual ~BenchDataSource() {};
+
+	virtual CUT_DataSource * clone() { return new BenchDataSource(m_size); };
+
+	virtual int Open(OpenMsgType type) {
+		m_pos = 0;
+		if (type != UTM_OM_APPEND)
+			m_written = 0;
+		return 0;
+	};
+	virtual int Close() { return 0; };
+
+	virtual int ReadLine(LPSTR /*buffer*/, size_t /*maxsize*/) { return -1; };
+	virtual int WriteLine(LPCSTR buffer) { return Write(buffer, strlen(buffer)); };
+
+	virtual int Read(LPSTR buffer, size_t count) {
+		long len = (long)count;
+		if (len > m_size-m_pos)
+			len = m_size-m_pos;
+		for(long i = 0; i < len; i++)
+			buffer[i] = (char)('a' + ((m_pos+i)%26));
+		m_pos += len;
+		return (int)len;
+	};
+	virtual int Write(LPCSTR /*buffer*/, size_t count) {
+		m_written += (long)count;
+		return (int)count;
+	};
+
+	virtual long Seek(long offset, int origin) {
+		long end = (m_written > m_size)?m_written:m_size;
+		if (origin == SEEK_SET)
+			m_pos = offset;
+		else if (origin == SEEK_CUR)
+			m_pos += offset;
+		else
+			m_pos = end + offset;
+		return m_pos;
+	};
+
+	long GetWritten() { return m_written; };
+private:
+	long					m_size;
+	long					m_pos;
+	long					m_written;
+};
+
+//Trusts the certificate of the stand-in only, like FtpSSLWrapper does with accepted certificates
+class BenchFTPClient : public CUT_FTPClient {
+public:
+	BenchFTPClient(const X509 * trusted) : m_trusted(trusted) {};
+protected:
+	virtual int OnSSLCertificate(const SSL * /*ssl*/, const X509* certificate, int /*verifyResult*/) {
+		if (certificate == NULL || m_trusted == NULL || X509_cmp((X509*)certificate, (X509*)m_trusted) != 0)
+			return UTE_ERROR;
+		return UTE_SUCCESS;
+	};
+private:
+	const X509*				m_trusted;
+};
+
+static int SetupClient(BenchFTPClient & client, int port, CUT_FTPClient::FTPSMode mode, const BenchConfig & config) {
+	client.SetControlPort(port);
+	client.setsMode(mode);
+	client.SetFireWallMode(config.active?FALSE:TRUE);
+	client.SetDataPortRange(10000, 32000);
+	client.SetConnectTimeout(30);
+	client.SetReceiveTimeOut(30000);
+	client.SetSendTimeOut(30000);
+	return 0;
+}
+
+static int BenchClient(FTPStandIn & standIn, CUT_FTPClient::FTPSMode mode, const char * security, const BenchConfig & config, BenchReport & report) {
+	const char * name = "CUT_FTPClient";
+	BenchFTPClient client(standIn.GetCertificate());
+	SetupClient(client, standIn.GetPort(), mode, config);
+
+	BenchResult result = BenchHost::NewResult("connect", name, security);
+	LONGLONG start = BenchHost::Now();
+	for(int i = 0; i < config.connects; i++) {
+		int res = client.FTPConnect("127.0.0.1", "bench", "bench", "");
+		client.Close();
+		BenchHost::Count(result, res == UTE_SUCCESS, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	if (client.FTPConnect("127.0.0.1", "bench", "bench", "") != UTE_SUCCESS) {
+		OutErr("[FTPBench] %s could not connect (%s)", name, security);
+		return -1;
+	}
+	client.SetTransferType(1);
+	client.MkDir("/bench");
+
+	result = BenchHost::NewResult("list-1k", name, security);
+	start = BenchHost::Now();
+	for(int i = 0; i < config.lists; i++)
+		BenchHost::Count(result, client.GetDirInfo("/list1000") == UTE_SUCCESS && client.GetDirInfoCount() == 1000, 0);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("list-100k", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, client.GetDirInfo("/list100000") == UTE_SUCCESS && client.GetDirInfoCount() == 100000, 0);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	char listPath[32];
+	_snprintf(listPath, sizeof(listPath), "/list%d", config.files);
+	listPath[sizeof(listPath)-1] = 0;
+
+	//the PASV of the next transfer is sent ahead only in passive mode, active mode always pools its listeners
+	for(int pipelined = 0; pipelined <= (config.active?0:1); pipelined++) {
+		client.SetPipelinePASV(pipelined?TRUE:FALSE);
+
+		result = BenchHost::NewResult(pipelined?"download-small-pipelined":"download-small", name, security);
+		start = BenchHost::Now();
+		for(int i = 0; i < config.files; i++) {
+			char path[64];
+			_snprintf(path, sizeof(path), "%s/file%06d.dat", listPath, i);
+			path[sizeof(path)-1] = 0;
+			BenchDataSource dest(0);
+			int res = client.ReceiveFile(dest, path);
+			BenchHost::Count(result, res == UTE_SUCCESS && dest.GetWritten() == config.fileSize, config.fileSize);
+		}
+		result.time = BenchHost::Now() - start;
+		report.Add(result);
+
+		result = BenchHost::NewResult(pipelined?"upload-small-pipelined":"upload-small", name, security);
+		start = BenchHost::Now();
+		for(int i = 0; i < config.files; i++) {
+			char path[64];
+			_snprintf(path, sizeof(path), "/bench/up%06d.dat", i);
+			path[sizeof(path)-1] = 0;
+			BenchDataSource source(config.fileSize);
+			BenchHost::Count(result, client.SendFile(source, path) == UTE_SUCCESS, config.fileSize);
+		}
+		result.time = BenchHost::Now() - start;
+		report.Add(result);
+	}
+	client.SetPipelinePASV(FALSE);
+
+	result = BenchHost::NewResult("download-large", name, security);
+	start = BenchHost::Now();
+	{
+		BenchDataSource dest(0);
+		int res = client.ReceiveFile(dest, "/large.bin");
+		BenchHost::Count(result, res == UTE_SUCCESS && dest.GetWritten() == config.largeSize, config.largeSize);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("upload-large", name, security);
+	start = BenchHost::Now();
+	{
+		BenchDataSource source(config.largeSize);
+		BenchHost::Count(result, client.SendFile(source, "/bench/large.bin") == UTE_SUCCESS, config.largeSize);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	client.Close();
+	return 0;
+}
+
+static FTPClientWrapperSSL* CreateWrapper(FTPStandIn & standIn, CUT_FTPClient::FTPSMode mode, const BenchConfig & config, vX509 * certificates) {
+	FTPClientWrapperSSL * wrapper = new FTPClientWrapperSSL("127.0.0.1", standIn.GetPort(), "bench", "bench");
+	wrapper->SetMode(mode);
+	wrapper->SetConnectionMode(config.active?Mode_Active:Mode_Passive);
+	wrapper->SetPortRange(10000, 32000);
+	wrapper->SetDataPortPool(FTP_DATAPORT_POOL_SIZE);
+	wrapper->SetListParams("");
+	wrapper->SetTimeout(30);
+	wrapper->SetCertificates(certificates);
+	return wrapper;
+}
+
+static int BenchWrapper(FTPStandIn & standIn, CUT_FTPClient::FTPSMode mode, const char * security, const BenchConfig & config, const TCHAR * tempDir, BenchReport & report) {
+	const char * name = "FTPClientWrapperSSL";
+
+	vX509 certificates;
+	if (standIn.GetCertificate() != NULL)
+		certificates.push_back(standIn.GetCertificate());
+
+	FTPClientWrapperSSL * wrapper = CreateWrapper(standIn, mode, config, &certificates);
+
+	BenchResult result = BenchHost::NewResult("connect", name, security);
+	LONGLONG start = BenchHost::Now();
+	for(int i = 0; i < config.connects; i++) {
+		int res = wrapper->Connect();
+		wrapper->Disconnect();
+		BenchHost::Count(result, res == 0, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	if (wrapper->Connect() != 0) {
+		OutErr("[FTPBench] %s could not connect (%s)", name, security);
+		delete wrapper;
+		return -1;
+	}
+	wrapper->SetTransferMode(Mode_Binary);
+	wrapper->MkDir("/bench");
+
+	result = BenchHost::NewResult("list-1k", name, security);
+	start = BenchHost::Now();
+	for(int i = 0; i < config.lists; i++) {
+		FTPFile * files = NULL;
+		int count = wrapper->GetDir("/list1000", &files);
+		if (count > 0)
+			FTPClientWrapper::ReleaseDir(files, count);
+		BenchHost::Count(result, count == 1000, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("list-100k", name, security);
+	start = BenchHost::Now();
+	{
+		FTPFile * files = NULL;
+		int count = wrapper->GetDir("/list100000", &files);
+		if (count > 0)
+			FTPClientWrapper::ReleaseDir(files, count);
+		BenchHost::Count(result, count == 100000, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	TCHAR smallFile[MAX_PATH];
+	TCHAR largeFile[MAX_PATH];
+	TCHAR receivedFile[MAX_PATH];
+	SU::TSprintf(smallFile, MAX_PATH, TEXT("%T\\small.dat"), tempDir);
+	SU::TSprintf(largeFile, MAX_PATH, TEXT("%T\\large.dat"), tempDir);
+	SU::TSprintf(receivedFile, MAX_PATH, TEXT("%T\\received.dat"), tempDir);
+	if (BenchHost::WriteTestFile(smallFile, config.fileSize) == -1 || BenchHost::WriteTestFile(largeFile, config.largeSize) == -1) {
+		OutErr("[FTPBench] Unable to create the local files in %T", tempDir);
+		wrapper->Disconnect();
+		delete wrapper;
+		return -1;
+	}
+
+	//like the queue: pipelining is announced for every transfer that another one follows
+	for(int pipelined = 0; pipelined <= (config.active?0:1); pipelined++) {
+		result = BenchHost::NewResult(pipelined?"download-small-pipelined":"download-small", name, security);
+		start = BenchHost::Now();
+		for(int i = 0; i < config.files; i++) {
+			char path[64];
+			_snprintf(path, sizeof(path), "/list%d/file%06d.dat", config.files, i);
+			path[sizeof(path)-1] = 0;
+			wrapper->SetPipelining(pipelined && i+1 < config.files);
+			wrapper->SetTransferSize(config.fileSize);
+			BenchHost::Count(result, wrapper->ReceiveFile(receivedFile, path) == 0, config.fileSize);
+		}
+		result.time = BenchHost::Now() - start;
+		report.Add(result);
+
+		result = BenchHost::NewResult(pipelined?"upload-small-pipelined":"upload-small", name, security);
+		start = BenchHost::Now();
+		for(int i = 0; i < config.files; i++) {
+			char path[64];
+			_snprintf(path, sizeof(path), "/bench/up%06d.dat", i);
+			path[sizeof(path)-1] = 0;
+			wrapper->SetPipelining(pipelined && i+1 < config.files);
+			BenchHost::Count(result, wrapper->SendFile(smallFile, path) == 0, config.fileSize);
+		}
+		result.time = BenchHost::Now() - start;
+		report.Add(result);
+	}
+	wrapper->SetPipelining(false);
+
+	result = BenchHost::NewResult("download-large", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, wrapper->ReceiveFile(receivedFile, "/large.bin") == 0, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("upload-large", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, wrapper->SendFile(largeFile, "/bench/large.bin") == 0, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	wrapper->Disconnect();
+	delete wrapper;
+
+	DeleteFile(smallFile);
+	DeleteFile(largeFile);
+	DeleteFile(receivedFile);
+
+	return 0;
+}
+
+static int Usage() {
+	fprintf(stderr,
+		"Usage: FTPBench [-format csv|json] [-security ftp,ftpes,ftps] [-active] [-latency ms]\n"
+		"                [-bandwidth bytes/s] [-connects n] [-files n] [-filesize bytes] [-large bytes] [-v]\n");
+	return 2;
+}
+
+int main(int argc, char ** argv) {
+	BenchConfig config;
+	config.connects = 20;
+	config.lists = 10;
+	config.files = 200;
+	config.fileSize = 4096;
+	config.largeSize = 64*1024*1024;
+	config.active = false;
+	config.latency = 0;
+	config.bandwidth = 0;
+
+	const char * format = "csv";
+	const char * security = "ftp,ftpes,ftps";
+	bool verbose = false;
+
+	for(int i = 1; i < argc; i++) {
+		long value = 0;
+		int res = 0;
+		if (!strcmp(argv[i], "-active")) {
+			config.active = true;
+			continue;
+		} else if (!strcmp(argv[i], "-v")) {
+			verbose = true;
+			continue;
+		}
+
+		if ((res = BenchHost::GetOption(argc, argv, &i, "-format", &format)) != 0 ||
+			(res = BenchHost::GetOption(argc, argv, &i, "-security", &security)) != 0) {
+			if (res == -1)
+				return Usage();
+			continue;
+		}
+
+		if ((res = BenchHost::GetOption(argc, argv, &i, "-latency", &value)) == 1)
+			config.latency = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-bandwidth", &value)) == 1)
+			config.bandwidth = value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-connects", &value)) == 1)
+			config.connects = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-files", &value)) == 1)
+			config.files = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-filesize", &value)) == 1)
+			config.fileSize = value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-large", &value)) == 1)
+			config.largeSize = value;
+
+		if (res != 1 || value < 0)
+			return Usage();
+	}
+
+	if (strcmp(format, "csv") && strcmp(format, "json"))
+		return Usage();
+
+	if (BenchHost::Init(verbose) == -1)
+		return 1;
+
+	TCHAR tempDir[MAX_PATH];
+	if (BenchHost::CreateTempDir(TEXT("NppFTPBench"), tempDir) == -1) {
+		OutErr("[FTPBench] Unable to create a temporary directory");
+		BenchHost::Deinit();
+		return 1;
+	}
+
+	static const struct { const char * name; CUT_FTPClient::FTPSMode mode; int security; } modes[] = {
+		{"ftp", CUT_FTPClient::FTP, StandIn_Plain},
+		{"ftpes", CUT_FTPClient::FTPES, StandIn_Explicit},
+		{"ftps", CUT_FTPClient::FTPS, StandIn_Implicit}
+	};
+
+	BenchReport report(strcmp(format, "json")?Format_CSV:Format_JSON, stdout);
+	report.Begin();
+
+	int res = 0;
+	for(int i = 0; i < 3; i++) {
+		//-security is a comma separated list
+		const char * found = strstr(security, modes[i].name);
+		size_t len = strlen(modes[i].name);
+		if (found == NULL || (found != security && found[-1] != ',') || (found[len] != 0 && found[len] != ','))
+			continue;
+
+		FTPStandInConfig standInConfig;
+		FTPStandIn::DefaultConfig(&standInConfig);
+		standInConfig.security = modes[i].security;
+		standInConfig.latency = config.latency;
+		standInConfig.bandwidth = config.bandwidth;
+		standInConfig.fileSize = config.fileSize;
+		standInConfig.largeFileSize = config.largeSize;
+
+		FTPStandIn standIn;
+		if (standIn.Start(standInConfig) == -1) {
+			OutErr("[FTPBench] Unable to start the stand-in server (%s)", modes[i].name);
+			res = -1;
+			continue;
+		}
+
+		if (BenchClient(standIn, modes[i].mode, modes[i].name, config, report) == -1)
+			res = -1;
+		if (BenchWrapper(standIn, modes[i].mode, modes[i].name, config, tempDir, report) == -1)
+			res = -1;
+
+		standIn.Stop();
+	}
+
+	report.End();
+
+	BenchHost::RemoveDir(tempDir);
+	BenchHost::Deinit();
+
+	return (res == -1 || report.GetFailures() > 0)?1:0;
+}
@@ -0,0 +1,926 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FTPStandIn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <openssl/err.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#define STANDIN_ACCEPT_TIMEOUT	10		//seconds to wait for the data connection
+#define STANDIN_STOP_TIMEOUT	10000	//ms to wait for the sessions to end
+#define STANDIN_MAX_LIST		10000000
+
+struct StandInSession {
+	FTPStandIn*				server;
+	SOCKET					control;
+	SSL*					ssl;
+	bool					protect;		//PROT P
+	std::string				cwd;
+	std::string				renameFrom;
+	long					restOffset;
+	SOCKET					pasvListener;
+	sockaddr_in				activeAddr;
+	bool					activeSet;		//PORT or EPRT was received
+	char					buffer[4096];
+	int						bufferPos;
+	int						bufferLen;
+};
+
+struct StandInData {
+	SOCKET					sock;
+	SSL*					ssl;
+	long					bandwidth;
+	DWORD					start;
+	LONGLONG				bytes;
+};
+
+static CRITICAL_SECTION * _sslLocks = NULL;
+
+static void SSLLockingCallback(int mode, int n, const char * /*file*/, int /*line*/) {
+	if (mode & CRYPTO_LOCK)
+		EnterCriticalSection(&_sslLocks[n]);
+	else
+		LeaveCriticalSection(&_sslLocks[n]);
+}
+
+static void SetNoDelay(SOCKET sock) {
+	BOOL noDelay = TRUE;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+}
+
+static SOCKET ListenLoopback(int port, int * boundPort) {
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((u_short)port);
+
+	int addrLen = sizeof(addr);
+	if (bind(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+		listen(sock, SOMAXCONN) == SOCKET_ERROR ||
+		getsockname(sock, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR) {
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	*boundPort = ntohs(addr.sin_port);
+	return sock;
+}
+
+//"file000042.dat" is number 42, -1 for any other name
+static int FileIndex(const std::string & name) {
+	if (name.size() != 14 || name.compare(0, 4, "file") != 0 || name.compare(10, 4, ".dat") != 0)
+		return -1;
+	for(int i = 4; i < 10; i++) {
+		if (!isdigit((unsigned char)name[i]))
+			return -1;
+	}
+	return atoi(name.c_str()+4);
+}
+
+static std::string ParentOf(const std::string & path) {
+	size_t pos = path.rfind('/');
+	if (pos == 0 || pos == std::string::npos)
+		return "/";
+	return path.substr(0, pos);
+}
+
+FTPStandIn::FTPStandIn() :
+	m_listener(INVALID_SOCKET),
+	m_port(0),
+	m_listenThread(NULL),
+	m_ctx(NULL),
+	m_key(NULL),
+	m_cert(NULL),
+	m_monitor(1)
+{
+	DefaultConfig(&m_config);
+
+	for(int i = 0; i < (int)sizeof(m_pattern); i++)
+		m_pattern[i] = (char)('a' + (i%26));
+}
+
+FTPStandIn::~FTPStandIn() {
+	Stop();
+
+	if (m_ctx)
+		SSL_CTX_free(m_ctx);
+	if (m_cert)
+		X509_free(m_cert);
+	if (m_key)
+		EVP_PKEY_free(m_key);
+}
+
+int FTPStandIn::DefaultConfig(FTPStandInConfig * config) {
+	config->port = 0;
+	config->security = StandIn_Plain;
+	config->latency = 0;
+	config->bandwidth = 0;
+	config->listingSize = 1000;
+	config->fileSize = 4096;
+	config->largeFileSize = 64*1024*1024;
+
+	return 0;
+}
+
+int FTPStandIn::Start(const FTPStandInConfig & config) {
+	if (m_listener != INVALID_SOCKET)
+		return -1;
+
+	m_config = config;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)
+		return -1;
+
+	if (m_config.security != StandIn_Plain && m_ctx == NULL) {
+		if (CreateCertificate() == -1) {
+			WSACleanup();
+			return -1;
+		}
+	}
+
+	m_listener = ListenLoopback(m_config.port, &m_port);
+	if (m_listener == INVALID_SOCKET) {
+		WSACleanup();
+		return -1;
+	}
+
+	m_listenThread = Thread::Start(&ListenThread, this);
+	if (m_listenThread == NULL) {
+		closesocket(m_listener);
+		m_listener = INVALID_SOCKET;
+		WSACleanup();
+		return -1;
+	}
+
+	return 0;
+}
+
+int FTPStandIn::Stop() {
+	if (m_listener == INVALID_SOCKET)
+		return 0;
+
+	//accept fails once the listener is closed, which ends the thread
+	closesocket(m_listener);
+	m_listener = INVALID_SOCKET;
+	Thread::Join(&m_listenThread, 1);
+	m_listenThread = NULL;
+
+	//the sessions remove themselves
+	m_monitor.Enter();
+	for(std::set<SOCKET>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it)
+		shutdown(*it, SD_BOTH);
+	m_monitor.Exit();
+
+	DWORD start = GetTickCount();
+	while(GetSessionCount() > 0 && GetTickCount() - start < STANDIN_STOP_TIMEOUT)
+		Sleep(10);
+
+	WSACleanup();
+	return 0;
+}
+
+int FTPStandIn::GetPort() {
+	return m_port;
+}
+
+const X509* FTPStandIn::GetCertificate() {
+	return m_cert;
+}
+
+int FTPStandIn::GetSessionCount() {
+	m_monitor.Enter();
+	int count = (int)m_sessions.size();
+	m_monitor.Exit();
+
+	return count;
+}
+
+int FTPStandIn::ListenThread(void * param) {
+	FTPStandIn * server = (FTPStandIn*)param;
+
+	for(;;) {
+		SOCKET sock = accept(server->m_listener, NULL, NULL);
+		if (sock == INVALID_SOCKET)
+			break;
+		SetNoDelay(sock);
+
+		StandInSession * session = new StandInSession;
+		session->server = server;
+		session->control = sock;
+		session->ssl = NULL;
+		session->protect = false;
+		session->cwd = "/";
+		session->restOffset = 0;
+		session->pasvListener = INVALID_SOCKET;
+		session->activeSet = false;
+		session->bufferPos = 0;
+		session->bufferLen = 0;
+
+		server->m_monitor.Enter();
+		server->m_sessions.insert(sock);
+		server->m_monitor.Exit();
+
+		ThreadHandle thread = Thread::Start(&SessionThread, session);
+		if (thread == NULL) {
+			server->m_monitor.Enter();
+			server->m_sessions.erase(sock);
+			server->m_monitor.Exit();
+			closesocket(sock);
+			delete session;
+			continue;
+		}
+		Thread::Detach(thread);
+	}
+
+	return 0;
+}
+
+int FTPStandIn::SessionThread(void * param) {
+	StandInSession * session = (StandInSession*)param;
+	FTPStandIn * server = session->server;
+
+	server->Serve(*session);
+
+	if (session->ssl)
+		SSL_free(session->ssl);
+	if (session->pasvListener != INVALID_SOCKET)
+		closesocket(session->pasvListener);
+
+	//Stop only shuts down sockets that are still in the set
+	server->m_monitor.Enter();
+	server->m_sessions.erase(session->control);
+	server->m_monitor.Exit();
+
+	closesocket(session->control);
+	delete session;
+
+	return 0;
+}
+
+int FTPStandIn::Serve(StandInSession & session) {
+	if (m_config.security == StandIn_Implicit) {
+		session.ssl = SSL_new(m_ctx);
+		SSL_set_fd(session.ssl, (int)session.control);
+		if (SSL_accept(session.ssl) != 1)
+			return -1;
+	}
+
+	if (Reply(session, "220 NppFTP stand-in ready") == -1)
+		return -1;
+
+	char line[1024];
+	while(ReadLine(session, line, sizeof(line)) == 0) {
+		char * arg = strchr(line, ' ');
+		if (arg) {
+			*arg = 0;
+			arg++;
+		} else {
+			arg = line+strlen(line);
+		}
+
+		for(char * verb = line; *verb; verb++)
+			*verb = (char)toupper((unsigned char)*verb);
+
+		int res = Dispatch(session, line, arg);
+		if (res != 0)
+			return (res == 1)?0:-1;
+	}
+
+	return -1;
+}
+
+//0 to go on, 1 after QUIT, -1 when the control connection is gone
+int FTPStandIn::Dispatch(StandInSession & session, const char * verb, const char * arg) {
+	if (!strcmp(verb, "USER")) {
+		return Reply(session, "331 Password required");
+	} else if (!strcmp(verb, "PASS")) {
+		return Reply(session, "230 Logged in");
+	} else if (!strcmp(verb, "ACCT")) {
+		return Reply(session, "202 No account needed");
+	} else if (!strcmp(verb, "SYST")) {
+		return Reply(session, "215 UNIX Type: L8");
+	} else if (!strcmp(verb, "FEAT")) {
+		return Reply(session, "211-Features:\r\n MDTM\r\n SIZE\r\n REST STREAM\r\n EPSV\r\n EPRT\r\n%s211 End",
+			(m_config.security == StandIn_Plain)?"":" AUTH TLS\r\n PBSZ\r\n PROT\r\n");
+	} else if (!strcmp(verb, "OPTS") || !strcmp(verb, "TYPE") || !strcmp(verb, "NOOP")) {
+		return Reply(session, "200 OK");
+	} else if (!strcmp(verb, "MODE")) {
+		return Reply(session, (toupper((unsigned char)arg[0]) == 'S')?"200 OK":"504 Only stream mode");
+	} else if (!strcmp(verb, "STRU")) {
+		return Reply(session, (toupper((unsigned char)arg[0]) == 'F')?"200 OK":"504 Only file structure");
+	} else if (!strcmp(verb, "PWD") || !strcmp(verb, "XPWD")) {
+		return Reply(session, "257 \"%s\" is the current directory", session.cwd.c_str());
+	} else if (!strcmp(verb, "CWD") || !strcmp(verb, "CDUP")) {
+		std::string path = ResolvePath(session, (verb[1] == 'D')?"..":arg);
+		if (!IsDirectory(path))
+			return Reply(session, "550 %s: No such directory", path.c_str());
+		session.cwd = path;
+		return Reply(session, "250 Directory changed to %s", path.c_str());
+	} else if (!strcmp(verb, "PASV") || !strcmp(verb, "EPSV")) {
+		if (session.pasvListener != INVALID_SOCKET)
+			closesocket(session.pasvListener);
+		session.activeSet = false;
+		int port = 0;
+		session.pasvListener = ListenLoopback(0, &port);
+		if (session.pasvListener == INVALID_SOCKET)
+			return Reply(session, "425 Cannot open a passive port");
+		if (verb[0] == 'E')
+			return Reply(session, "229 Entering Extended Passive Mode (|||%d|)", port);
+		return Reply(session, "227 Entering Passive Mode (127,0,0,1,%d,%d)", port >> 8, port & 0xFF);
+	} else if (!strcmp(verb, "PORT") || !strcmp(verb, "EPRT")) {
+		char host[64];
+		int port = 0;
+		if (verb[0] == 'P') {
+			int h1, h2, h3, h4, p1, p2;
+			if (sscanf(arg, "%d,%d,%d,%d,%d,%d", &h1, &h2, &h3, &h4, &p1, &p2) != 6)
+				return Reply(session, "501 Syntax error in PORT");
+			_snprintf(host, sizeof(host), "%d.%d.%d.%d", h1, h2, h3, h4);
+			host[sizeof(host)-1] = 0;
+			port = p1*256 + p2;
+		} else {
+			//|1|127.0.0.1|5000|, with any delimiter
+			char delim = arg[0];
+			const char * addr = (delim != 0)?strchr(arg+1, delim):NULL;
+			const char * portStr = (addr != NULL)?strchr(addr+1, delim):NULL;
+			if (portStr == NULL || portStr-addr-1 >= (int)sizeof(host))
+				return Reply(session, "501 Syntax error in EPRT");
+			if (atoi(arg+1) != 1)
+				return Reply(session, "522 Network protocol not supported, use (1)");
+			memcpy(host, addr+1, portStr-addr-1);
+			host[portStr-addr-1] = 0;
+			port = atoi(portStr+1);
+		}
+		if (session.pasvListener != INVALID_SOCKET) {
+			closesocket(session.pasvListener);
+			session.pasvListener = INVALID_SOCKET;
+		}
+		memset(&session.activeAddr, 0, sizeof(session.activeAddr));
+		session.activeAddr.sin_family = AF_INET;
+		session.activeAddr.sin_addr.s_addr = inet_addr(host);
+		session.activeAddr.sin_port = htons((u_short)port);
+		session.activeSet = true;
+		return Reply(session, "200 %s command successful", verb);
+	} else if (!strcmp(verb, "LIST") || !strcmp(verb, "NLST")) {
+		//options like -al are ignored
+		while(*arg == '-') {
+			while(*arg && *arg != ' ')
+				arg++;
+			while(*arg == ' ')
+				arg++;
+		}
+		return SendList(session, ResolvePath(session, arg), verb[0] == 'N');
+	} else if (!strcmp(verb, "RETR")) {
+		return SendFile(session, ResolvePath(session, arg));
+	} else if (!strcmp(verb, "STOR") || !strcmp(verb, "APPE")) {
+		return StoreFile(session, ResolvePath(session, arg), verb[0] == 'A');
+	} else if (!strcmp(verb, "REST")) {
+		session.restOffset = atol(arg);
+		return Reply(session, "350 Restarting at %ld", session.restOffset);
+	} else if (!strcmp(verb, "SIZE")) {
+		long size = GetFileSize(ResolvePath(session, arg));
+		if (size < 0)
+			return Reply(session, "550 %s: No such file", arg);
+		return Reply(session, "213 %ld", size);
+	} else if (!strcmp(verb, "MDTM")) {
+		if (GetFileSize(ResolvePath(session, arg)) < 0)
+			return Reply(session, "550 %s: No such file", arg);
+		return Reply(session, "213 20100101000000");
+	} else if (!strcmp(verb, "DELE")) {
+		std::string path = ResolvePath(session, arg);
+		if (GetFileSize(path) < 0)
+			return Reply(session, "550 %s: No such file", arg);
+		//synthetic files stay, deleting them only costs the roundtrip
+		m_monitor.Enter();
+		m_stored.erase(path);
+		m_monitor.Exit();
+		return Reply(session, "250 Deleted %s", arg);
+	} else if (!strcmp(verb, "MKD") || !strcmp(verb, "XMKD")) {
+		std::string path = ResolvePath(session, arg);
+		if (IsDirectory(path) || GetFileSize(path) >= 0)
+			return Reply(session, "550 %s: Already exists", arg);
+		m_monitor.Enter();
+		m_dirs.insert(path);
+		m_monitor.Exit();
+		return Reply(session, "257 \"%s\" created", path.c_str());
+	} else if (!strcmp(verb, "RMD") || !strcmp(verb, "XRMD")) {
+		m_monitor.Enter();
+		size_t erased = m_dirs.erase(ResolvePath(session, arg));
+		m_monitor.Exit();
+		return Reply(session, (erased > 0)?"250 Directory removed":"550 No such directory");
+	} else if (!strcmp(verb, "RNFR")) {
+		session.renameFrom = ResolvePath(session, arg);
+		if (GetFileSize(session.renameFrom) < 0) {
+			session.renameFrom.clear();
+			return Reply(session, "550 %s: No such file", arg);
+		}
+		return Reply(session, "350 Ready for RNTO");
+	} else if (!strcmp(verb, "RNTO")) {
+		if (session.renameFrom.empty())
+			return Reply(session, "503 RNFR first");
+		long size = GetFileSize(session.renameFrom);
+		m_monitor.Enter();
+		m_stored.erase(session.renameFrom);
+		m_stored[ResolvePath(session, arg)] = size;
+		m_monitor.Exit();
+		session.renameFrom.clear();
+		return Reply(session, "250 Renamed");
+	} else if (!strcmp(verb, "AUTH")) {
+		if (m_config.security != StandIn_Explicit || session.ssl != NULL)
+			return Reply(session, "502 AUTH not available");
+		if (Reply(session, "234 Proceed with negotiation") == -1)
+			return -1;
+		session.ssl = SSL_new(m_ctx);
+		SSL_set_fd(session.ssl, (int)session.control);
+		return (SSL_accept(session.ssl) == 1)?0:-1;
+	} else if (!strcmp(verb, "PBSZ")) {
+		return Reply(session, (session.ssl != NULL)?"200 PBSZ=0":"503 AUTH first");
+	} else if (!strcmp(verb, "PROT")) {
+		if (session.ssl == NULL)
+			return Reply(session, "503 AUTH first");
+		char level = (char)toupper((unsigned char)arg[0]);
+		if (level != 'P' && level != 'C')
+			return Reply(session, "504 Only levels C and P");
+		session.protect = (level == 'P');
+		return Reply(session, "200 Protection level set");
+	} else if (!strcmp(verb, "ABOR")) {
+		//transfers are done synchronously, so there is nothing to abort anymore
+		return Reply(session, "226 Abort successful");
+	} else if (!strcmp(verb, "QUIT")) {
+		Reply(session, "221 Goodbye");
+		return 1;
+	}
+
+	return Reply(session, "502 %s not implemented", verb);
+}
+
+int FTPStandIn::Reply(StandInSession & session, const char * format, ...) {
+	if (m_config.latency > 0)
+		Sleep(m_config.latency);
+
+	char buf[1024];
+	va_list vaList;
+	va_start(vaList, format);
+	int len = _vsnprintf(buf, sizeof(buf)-2, format, vaList);
+	va_end(vaList);
+	if (len < 0 || len > (int)sizeof(buf)-2)
+		len = sizeof(buf)-2;
+
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+
+	return SendControl(session, buf, len);
+}
+
+int FTPStandIn::ReadLine(StandInSession & session, char * buf, int size) {
+	int pos = 0;
+
+	for(;;) {
+		if (session.bufferPos == session.bufferLen) {
+			int got;
+			if (session.ssl)
+				got = SSL_read(session.ssl, session.buffer, sizeof(session.buffer));
+			else
+				got = recv(session.control, session.buffer, sizeof(session.buffer), 0);
+			if (got <= 0)
+				return -1;
+			session.bufferPos = 0;
+			session.bufferLen = got;
+		}
+
+		char c = session.buffer[session.bufferPos++];
+		if (c == '\n')
+			break;
+		if (c != '\r' && pos < size-1)
+			buf[pos++] = c;
+	}
+
+	buf[pos] = 0;
+	return 0;
+}
+
+int FTPStandIn::SendControl(StandInSession & session, const char * data, int len) {
+	while(len > 0) {
+		int sent;
+		if (session.ssl)
+			sent = SSL_write(session.ssl, data, len);
+		else
+			sent = send(session.control, data, len, 0);
+		if (sent <= 0)
+			return -1;
+		data += sent;
+		len -= sent;
+	}
+
+	return 0;
+}
+
+//Sends the 150 reply once connected, the TLS handshake follows it: in active mode the client only accepts after the reply
+int FTPStandIn::OpenData(StandInSession & session, StandInData & data) {
+	data.sock = INVALID_SOCKET;
+	data.ssl = NULL;
+	data.bandwidth = m_config.bandwidth;
+	data.bytes = 0;
+
+	if (session.pasvListener != INVALID_SOCKET) {
+		fd_set set;
+		FD_ZERO(&set);
+		FD_SET(session.pasvListener, &set);
+		timeval timeout = {STANDIN_ACCEPT_TIMEOUT, 0};
+		if (select(0, &set, NULL, NULL, &timeout) == 1)
+			data.sock = accept(session.pasvListener, NULL, NULL);
+		closesocket(session.pasvListener);
+		session.pasvListener = INVALID_SOCKET;
+	} else if (session.activeSet) {
+		data.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (data.sock != INVALID_SOCKET && connect(data.sock, (sockaddr*)&session.activeAddr, sizeof(session.activeAddr)) == SOCKET_ERROR) {
+			closesocket(data.sock);
+			data.sock = INVALID_SOCKET;
+		}
+		session.activeSet = false;
+	}
+
+	if (data.sock == INVALID_SOCKET) {
+		Reply(session, "425 Cannot open data connection");
+		return -1;
+	}
+	SetNoDelay(data.sock);
+
+	Reply(session, "150 Opening data connection");
+
+	if (session.protect) {
+		data.ssl = SSL_new(m_ctx);
+		SSL_set_fd(data.ssl, (int)data.sock);
+		if (SSL_accept(data.ssl) != 1) {
+			CloseData(data);
+			Reply(session, "425 TLS negotiation failed");
+			return -1;
+		}
+	}
+
+	data.start = GetTickCount();
+	return 0;
+}
+
+int FTPStandIn::CloseData(StandInData & data) {
+	if (data.ssl) {
+		SSL_shutdown(data.ssl);
+		SSL_free(data.ssl);
+		data.ssl = NULL;
+	}
+	if (data.sock != INVALID_SOCKET) {
+		shutdown(data.sock, SD_SEND);
+		closesocket(data.sock);
+		data.sock = INVALID_SOCKET;
+	}
+
+	return 0;
+}
+
+static void Throttle(StandInData & data) {
+	if (data.bandwidth <= 0)
+		return;
+
+	DWORD due = (DWORD)(data.bytes * 1000 / data.bandwidth);
+	DWORD elapsed = GetTickCount() - data.start;
+	if (due > elapsed)
+		Sleep(due - elapsed);
+}
+
+int FTPStandIn::SendData(StandInData & data, const char * buf, int len) {
+	//small pieces when limited, so the rate stays even
+	int piece = len;
+	if (data.bandwidth > 0 && piece > data.bandwidth/10)
+		piece = (data.bandwidth/10 > 1024)?(int)(data.bandwidth/10):1024;
+
+	while(len > 0) {
+		int sent;
+		int size = (len < piece)?len:piece;
+		if (data.ssl)
+			sent = SSL_write(data.ssl, buf, size);
+		else
+			sent = send(data.sock, buf, size, 0);
+		if (sent <= 0)
+			return -1;
+
+		buf += sent;
+		len -= sent;
+		data.bytes += sent;
+		Throttle(data);
+	}
+
+	return 0;
+}
+
+//Bytes read, 0 at the end of the data, -1 on errors
+int FTPStandIn::ReceiveData(StandInData & data, char * buf, int len) {
+	if (data.bandwidth > 0 && len > data.bandwidth/10)
+		len = (data.bandwidth/10 > 1024)?(int)(data.bandwidth/10):1024;
+
+	int got;
+	if (data.ssl) {
+		got = SSL_read(data.ssl, buf, len);
+		if (got <= 0) {
+			//not every client sends close_notify before closing
+			int err = SSL_get_error(data.ssl, got);
+			return (err == SSL_ERROR_ZERO_RETURN || err == SSL_ERROR_SYSCALL)?0:-1;
+		}
+	} else {
+		got = recv(data.sock, buf, len, 0);
+		if (got < 0)
+			return -1;
+	}
+
+	data.bytes += got;
+	Throttle(data);
+
+	return got;
+}
+
+int FTPStandIn::SendList(StandInSession & session, const std::string & dir, bool namesOnly) {
+	int count = GetListSize(dir);
+	if (count < 0)
+		return Reply(session, "550 %s: No such directory", dir.c_str());
+
+	StandInData data;
+	if (OpenData(session, data) == -1)
+		return 0;
+
+	std::string prefix = (dir == "/")?"/":dir+"/";
+	std::string chunk;
+	char line[MAX_PATH+100];
+	int res = 0;
+
+	//synthetic entries first, then whatever was created in the directory
+	for(int i = 0; i <= count && res == 0; i++) {
+		char name[32];
+		long size = m_config.fileSize;
+		if (i < count) {
+			_snprintf(name, sizeof(name), "file%06d.dat", i);
+		} else if (dir == "/") {
+			strcpy(name, "large.bin");
+			size = m_config.largeFileSize;
+		} else {
+			break;
+		}
+		name[sizeof(name)-1] = 0;
+
+		if (namesOnly)
+			_snprintf(line, sizeof(line), "%s\r\n", name);
+		else
+			_snprintf(line, sizeof(line), "-rw-r--r--   1 ftp      ftp      %10ld Jan  1  2010 %s\r\n", size, name);
+		line[sizeof(line)-1] = 0;
+		chunk += line;
+
+		if (chunk.size() >= 65536) {
+			res = SendData(data, chunk.data(), (int)chunk.size());
+			chunk.clear();
+		}
+	}
+
+	m_monitor.Enter();
+	for(std::set<std::string>::iterator it = m_dirs.begin(); it != m_dirs.end(); ++it) {
+		if (ParentOf(*it) != dir)
+			continue;
+		const char * name = it->c_str()+prefix.size();
+		if (namesOnly)
+			_snprintf(line, sizeof(line), "%s\r\n", name);
+		else
+			_snprintf(line, sizeof(line), "drwxr-xr-x   2 ftp      ftp      %10d Jan  1  2010 %s\r\n", 0, name);
+		line[sizeof(line)-1] = 0;
+		chunk += line;
+	}
+	for(std::map<std::string, long>::iterator it = m_stored.begin(); it != m_stored.end(); ++it) {
+		if (ParentOf(it->first) != dir)
+			continue;
+		const char * name = it->first.c_str()+prefix.size();
+		if (namesOnly)
+			_snprintf(line, sizeof(line), "%s\r\n", name);
+		else
+			_snprintf(line, sizeof(line), "-rw-r--r--   1 ftp      ftp      %10ld Jan  1  2010 %s\r\n", it->second, name);
+		line[sizeof(line)-1] = 0;
+		chunk += line;
+	}
+	m_monitor.Exit();
+
+	if (res == 0 && !chunk.empty())
+		res = SendData(data, chunk.data(), (int)chunk.size());
+
+	CloseData(data);
+	return Reply(session, (res == 0)?"226 Transfer complete":"426 Connection closed; transfer aborted");
+}
+
+int FTPStandIn::SendFile(StandInSession & session, const std::string & path) {
+	long offset = session.restOffset;
+	session.restOffset = 0;
+
+	long size = GetFileSize(path);
+	if (size < 0)
+		return Reply(session, "550 %s: No such file", path.c_str());
+	if (offset > size)
+		offset = size;
+
+	StandInData data;
+	if (OpenData(session, data) == -1)
+		return 0;
+
+	//whole periods of the pattern, so every piece continues where the last one stopped
+	const long piece = sizeof(m_pattern) - 26;
+	long pos = offset;
+	int res = 0;
+	while(pos < size && res == 0) {
+		long len = (size-pos < piece)?(size-pos):piece;
+		res = SendData(data, m_pattern + (pos%26), (int)len);
+		pos += len;
+	}
+
+	CloseData(data);
+	return Reply(session, (res == 0)?"226 Transfer complete":"426 Connection closed; transfer aborted");
+}
+
+int FTPStandIn::StoreFile(StandInSession & session, const std::string & path, bool append) {
+	long size = session.restOffset;
+	session.restOffset = 0;
+
+	if (!IsDirectory(ParentOf(path)) || IsDirectory(path))
+		return Reply(session, "553 %s: Cannot store here", path.c_str());
+	if (append) {
+		size = GetFileSize(path);
+		if (size < 0)
+			size = 0;
+	}
+
+	StandInData data;
+	if (OpenData(session, data) == -1)
+		return 0;
+
+	char buf[65536];
+	int got;
+	while((got = ReceiveData(data, buf, sizeof(buf))) > 0)
+		size += got;
+
+	CloseData(data);
+
+	if (got < 0)
+		return Reply(session, "426 Connection closed; transfer aborted");
+
+	m_monitor.Enter();
+	m_stored[path] = size;
+	m_monitor.Exit();
+
+	return Reply(session, "226 Transfer complete");
+}
+
+std::string FTPStandIn::ResolvePath(const StandInSession & session, const char * arg) {
+	std::string path = arg;
+	if (path.empty())
+		return session.cwd;
+	if (path[0] != '/')
+		path = session.cwd + "/" + path;
+
+	//collapse empty, . and .. parts
+	std::string result;
+	size_t start = 0;
+	while(start <= path.size()) {
+		size_t end = path.find('/', start);
+		if (end == std::string::npos)
+			end = path.size();
+		std::string part = path.substr(start, end-start);
+		if (part == "..") {
+			size_t pos = result.rfind('/');
+			result.erase((pos == std::string::npos)?0:pos);
+		} else if (!part.empty() && part != ".") {
+			result += "/" + part;
+		}
+		start = end+1;
+	}
+
+	return result.empty()?"/":result;
+}
+
+long FTPStandIn::GetFileSize(const std::string & path) {
+	m_monitor.Enter();
+	std::map<std::string, long>::iterator it = m_stored.find(path);
+	long stored = (it != m_stored.end())?it->second:-1;
+	m_monitor.Exit();
+
+	if (stored >= 0)
+		return stored;
+	if (path == "/large.bin")
+		return m_config.largeFileSize;
+
+	int index = FileIndex(path.substr(path.rfind('/')+1));
+	if (index >= 0 && index < GetListSize(ParentOf(path)))
+		return m_config.fileSize;
+
+	return -1;
+}
+
+bool FTPStandIn::IsDirectory(const std::string & path) {
+	return GetListSize(path) >= 0;
+}
+
+int FTPStandIn::GetListSize(const std::string & dir) {
+	if (dir == "/")
+		return m_config.listingSize;
+
+	if (dir.compare(0, 5, "/list") == 0 && dir.size() > 5 && dir.size() <= 13) {
+		bool digits = true;
+		for(size_t i = 5; i < dir.size(); i++)
+			digits = digits && isdigit((unsigned char)dir[i]);
+		int count = atoi(dir.c_str()+5);
+		if (digits && count <= STANDIN_MAX_LIST)
+			return count;
+	}
+
+	m_monitor.Enter();
+	bool created = m_dirs.count(dir) > 0;
+	m_monitor.Exit();
+
+	return created?0:-1;
+}
+
+int FTPStandIn::CreateCertificate() {
+	SSL_library_init();
+	SSL_load_error_strings();
+	InitLocking();
+
+	BIGNUM * exponent = BN_new();
+	RSA * rsa = RSA_new();
+	BN_set_word(exponent, RSA_F4);
+	int res = RSA_generate_key_ex(rsa, 2048, exponent, NULL);
+	BN_free(exponent);
+	if (res != 1) {
+		RSA_free(rsa);
+		return -1;
+	}
+
+	m_key = EVP_PKEY_new();
+	EVP_PKEY_assign_RSA(m_key, rsa);
+
+	m_cert = X509_new();
+	X509_set_version(m_cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(m_cert), 1);
+	X509_gmtime_adj(X509_get_notBefore(m_cert), 0);
+	X509_gmtime_adj(X509_get_notAfter(m_cert), 60*60*24*365L);
+	X509_set_pubkey(m_cert, m_key);
+
+	X509_NAME * name = X509_get_subject_name(m_cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"127.0.0.1", -1, -1, 0);
+	X509_set_issuer_name(m_cert, name);
+	if (X509_sign(m_cert, m_key, EVP_sha256()) == 0)
+		return -1;
+
+	m_ctx = SSL_CTX_new(SSLv23_server_method());
+	if (m_ctx == NULL)
+		return -1;
+	SSL_CTX_set_options(m_ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+	if (SSL_CTX_use_certificate(m_ctx, m_cert) != 1 || SSL_CTX_use_PrivateKey(m_ctx, m_key) != 1)
+		return -1;
+
+	//data connections resume the session of the control connection
+	static const unsigned char sessionContext[] = "FTPStandIn";
+	SSL_CTX_set_session_id_context(m_ctx, sessionContext, sizeof(sessionContext)-1);
+	SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_SERVER);
+
+	return 0;
+}
+
+//OpenSSL 1.0.1 needs locks once the server threads and the client use it at the same time
+int FTPStandIn::InitLocking() {
+	if (CRYPTO_get_locking_callback() != NULL)
+		return 0;
+
+	int count = CRYPTO_num_locks();
+	_sslLocks = new CRITICAL_SECTION[count];	//kept for the lifetime of the process
+	for(int i = 0; i < count; i++)
+		InitializeCriticalSection(&_sslLocks[i]);
+	CRYPTO_set_locking_callback(&SSLLockingCallback);
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FTPSTANDIN_H
+#define FTPSTANDIN_H
+
+//Loopback FTP/FTPS server the benchmarks run against, see FTPBench.cpp
+//Files are synthetic: downloads are generated, uploads are counted and discarded. The latency is added
+//before every reply and the bandwidth limits every data connection, so a remote server can be imitated
+
+#include <winsock2.h>
+#include <windows.h>
+#include <openssl/ssl.h>
+#include <string>
+#include <map>
+#include <set>
+
+#include "Thread.h"
+#include "Monitor.h"
+
+enum StandIn_Security { StandIn_Plain = 0, StandIn_Explicit = 1, StandIn_Implicit = 2 };
+
+struct FTPStandInConfig {
+	int						port;			//0 for any free port
+	int						security;		//StandIn_Security
+	int						latency;		//ms before every reply
+	long					bandwidth;		//bytes per second per data connection, 0 for no limit
+	int						listingSize;	//files in the root directory, "/list<N>" holds N of them
+	long					fileSize;		//size of the listed files
+	long					largeFileSize;	//size of "/large.bin"
+};
+
+struct StandInSession;
+struct StandInData;
+
+class FTPStandIn {
+public:
+							FTPStandIn();
+	virtual					~FTPStandIn();
+
+	static int				DefaultConfig(FTPStandInConfig * config);
+
+	virtual int				Start(const FTPStandInConfig & config);	//listens on 127.0.0.1
+	virtual int				Stop();	//closes the listener and all sessions
+
+	virtual int				GetPort();
+	virtual const X509*		GetCertificate();	//self-signed, NULL for StandIn_Plain
+	virtual int				GetSessionCount();
+private:
+	static int				ListenThread(void * param);
+	static int				SessionThread(void * param);
+
+	int						Serve(StandInSession & session);
+	int						Dispatch(StandInSession & session, const char * verb, const char * arg);
+
+	int						Reply(StandInSession & session, const char * format, ...);
+	int						ReadLine(StandInSession & session, char * buf, int size);
+	int						SendControl(StandInSession & session, const char * data, int len);
+
+	int						OpenData(StandInSession & session, StandInData & data);
+	int						CloseData(StandInData & data);
+	int						SendData(StandInData & data, const char * buf, int len);
+	int						ReceiveData(StandInData & data, char * buf, int len);
+
+	int						SendList(StandInSession & session, const std::string & dir, bool namesOnly);
+	int						SendFile(StandInSession & session, const std::string & path);
+	int						StoreFile(StandInSession & session, const std::string & path, bool append);
+
+	std::string				ResolvePath(const StandInSession & session, const char * arg);
+	long					GetFileSize(const std::string & path);	//-1 if there is no such file
+	bool					IsDirectory(const std::string & path);
+	int						GetListSize(const std::string & dir);	//-1 if there is no such directory
+
+	int						CreateCertificate();
+	static int				InitLocking();
+
+	FTPStandInConfig		m_config;
+	SOCKET					m_listener;
+	int						m_port;
+	ThreadHandle			m_listenThread;
+
+	SSL_CTX*				m_ctx;
+	EVP_PKEY*				m_key;
+	X509*					m_cert;
+
+	Monitor					m_monitor;	//guards everything below
+	std::set<SOCKET>		m_sessions;
+	std::map<std::string, long>	m_stored;	//uploaded files and their size
+	std::set<std::string>	m_dirs;		//created directories
+
+	char					m_pattern[65520];	//content of every download, 26 * 2520 bytes so it repeats seamlessly
+};
+
+#endif //FTPSTANDIN_H
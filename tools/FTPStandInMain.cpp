@@ -0,0 +1,85 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Runs FTPStandIn on its own, to try NppFTP itself against it
+//Usage: FTPStandIn [-port n] [-security plain|explicit|implicit] [-latency ms] [-bandwidth bytes/s]
+//                  [-list n] [-filesize bytes] [-large bytes]
+
+#include "FTPStandIn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int Usage() {
+	fprintf(stderr,
+		"Usage: FTPStandIn [-port n] [-security plain|explicit|implicit] [-latency ms] [-bandwidth bytes/s]\n"
+		"                  [-list n] [-filesize bytes] [-large bytes]\n");
+	return 2;
+}
+
+int main(int argc, char ** argv) {
+	FTPStandInConfig config;
+	FTPStandIn::DefaultConfig(&config);
+	config.port = 2121;
+
+	for(int i = 1; i < argc; i++) {
+		if (i+1 >= argc)
+			return Usage();
+
+		const char * option = argv[i];
+		const char * value = argv[++i];
+		if (!strcmp(option, "-security")) {
+			if (!strcmp(value, "plain"))
+				config.security = StandIn_Plain;
+			else if (!strcmp(value, "explicit"))
+				config.security = StandIn_Explicit;
+			else if (!strcmp(value, "implicit"))
+				config.security = StandIn_Implicit;
+			else
+				return Usage();
+		} else if (!strcmp(option, "-port")) {
+			config.port = atoi(value);
+		} else if (!strcmp(option, "-latency")) {
+			config.latency = atoi(value);
+		} else if (!strcmp(option, "-bandwidth")) {
+			config.bandwidth = atol(value);
+		} else if (!strcmp(option, "-list")) {
+			config.listingSize = atoi(value);
+		} else if (!strcmp(option, "-filesize")) {
+			config.fileSize = atol(value);
+		} else if (!strcmp(option, "-large")) {
+			config.largeFileSize = atol(value);
+		} else {
+			return Usage();
+		}
+	}
+
+	FTPStandIn standIn;
+	if (standIn.Start(config) == -1) {
+		fprintf(stderr, "Unable to listen on 127.0.0.1:%d\n", config.port);
+		return 1;
+	}
+
+	printf("Listening on 127.0.0.1:%d, press Enter to stop\n", standIn.GetPort());
+	fflush(stdout);
+	getchar();
+
+	standIn.Stop();
+	return 0;
+}
@@ -0,0 +1,449 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Benchmarks FTPClientWrapperSSH against SFTPStandIn, which runs in this process and serves a temporary directory
+//Usage: SFTPBench [-format csv|json] [-latency ms] [-bandwidth bytes/s] [-connects n] [-dirsize n]
+//                 [-files n] [-filesize bytes] [-large bytes] [-depth n] [-v]
+//The wrapper has one request in flight at a time. Plain libssh reads the large file once more the same way and
+//once with -depth requests ahead, to show what pipelining gains. libssh has no asynchronous writes, so uploads
+//are only measured one request at a time. Results go to stdout, the exit code is 1 if any iteration failed
+
+#include "StdInc.h"
+#include "FTPClientWrapper.h"
+#include "SFTPStandIn.h"
+#include "BenchHost.h"
+
+#include <fcntl.h>
+
+#define BENCH_BLOCK_SIZE	16384	//bytes per request of the plain libssh scenarios, as many as SendHandle writes
+
+extern char * _HostsFile;
+
+struct BenchConfig {
+	int						connects;	//iterations of the connect scenario
+	int						lists;		//iterations of the huge listing
+	int						dirSize;	//entries of the huge directory
+	int						files;		//files of the small file scenarios
+	long					fileSize;
+	long					largeSize;
+	int						depth;		//read requests ahead in the pipelined scenario
+	int						latency;
+	long					bandwidth;
+};
+
+//The served tree: "/huge" with dirSize empty files, "/many" with the small files, "/large.bin" and "/up" for uploads
+static int CreateTree(const TCHAR * root, const BenchConfig & config) {
+	TCHAR path[MAX_PATH];
+
+	SU::TSprintf(path, MAX_PATH, TEXT("%T\\huge"), root);
+	if (CreateDirectory(path, NULL) == FALSE)
+		return -1;
+	for(int i = 0; i < config.dirSize; i++) {
+		SU::TSprintf(path, MAX_PATH, TEXT("%T\\huge\\entry%06d.dat"), root, i);
+		if (BenchHost::WriteTestFile(path, 0) == -1)
+			return -1;
+	}
+
+	SU::TSprintf(path, MAX_PATH, TEXT("%T\\many"), root);
+	if (CreateDirectory(path, NULL) == FALSE)
+		return -1;
+	for(int i = 0; i < config.files; i++) {
+		SU::TSprintf(path, MAX_PATH, TEXT("%T\\many\\file%06d.dat"), root, i);
+		if (BenchHost::WriteTestFile(path, config.fileSize) == -1)
+			return -1;
+	}
+
+	SU::TSprintf(path, MAX_PATH, TEXT("%T\\large.bin"), root);
+	if (BenchHost::WriteTestFile(path, config.largeSize) == -1)
+		return -1;
+
+	SU::TSprintf(path, MAX_PATH, TEXT("%T\\up"), root);
+	if (CreateDirectory(path, NULL) == FALSE)
+		return -1;
+
+	return 0;
+}
+
+//The host key of the stand-in is trusted through the known hosts file, as if it had been accepted before
+static int WriteKnownHosts(SFTPStandIn & standIn, const TCHAR * tempDir, char * hostsFile, int size) {
+	char line[1024];
+	if (standIn.GetKnownHostsLine(line, sizeof(line)) == -1)
+		return -1;
+
+	//libssh opens it with fopen
+	TCHAR path[MAX_PATH];
+	SU::TSprintf(path, MAX_PATH, TEXT("%T\\known_hosts"), tempDir);
+	if (SU::TCharToCP(path, CP_ACP, hostsFile, size) == -1)
+		return -1;
+
+	FILE * file = fopen(hostsFile, "w");
+	if (file == NULL)
+		return -1;
+	fprintf(file, "%s\n", line);
+	fclose(file);
+
+	return 0;
+}
+
+static int BenchWrapper(SFTPStandIn & standIn, const BenchConfig & config, const TCHAR * tempDir, BenchReport & report) {
+	const char * name = "FTPClientWrapperSSH";
+	const char * security = "sftp";
+
+	FTPClientWrapperSSH * wrapper = new FTPClientWrapperSSH("127.0.0.1", standIn.GetPort(), "bench", "bench");
+	wrapper->SetAcceptedMethods(Method_Password);
+	wrapper->SetTimeout(30);
+
+	BenchResult result = BenchHost::NewResult("connect", name, security);
+	LONGLONG start = BenchHost::Now();
+	for(int i = 0; i < config.connects; i++) {
+		int res = wrapper->Connect();
+		wrapper->Disconnect();
+		BenchHost::Count(result, res == 0, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	if (wrapper->Connect() != 0) {
+		OutErr("[SFTPBench] %s could not connect", name);
+		delete wrapper;
+		return -1;
+	}
+
+	result = BenchHost::NewResult("readdir-huge", name, security);
+	start = BenchHost::Now();
+	for(int i = 0; i < config.lists; i++) {
+		FTPFile * files = NULL;
+		int count = wrapper->GetDir("/huge", &files);
+		if (count > 0)
+			FTPClientWrapper::ReleaseDir(files, count);
+		BenchHost::Count(result, count == config.dirSize, 0);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	TCHAR smallFile[MAX_PATH];
+	TCHAR largeFile[MAX_PATH];
+	TCHAR receivedFile[MAX_PATH];
+	SU::TSprintf(smallFile, MAX_PATH, TEXT("%T\\small.dat"), tempDir);
+	SU::TSprintf(largeFile, MAX_PATH, TEXT("%T\\large.dat"), tempDir);
+	SU::TSprintf(receivedFile, MAX_PATH, TEXT("%T\\received.dat"), tempDir);
+	if (BenchHost::WriteTestFile(smallFile, config.fileSize) == -1 || BenchHost::WriteTestFile(largeFile, config.largeSize) == -1) {
+		OutErr("[SFTPBench] Unable to create the local files in %T", tempDir);
+		wrapper->Disconnect();
+		delete wrapper;
+		return -1;
+	}
+
+	result = BenchHost::NewResult("download-small", name, security);
+	start = BenchHost::Now();
+	for(int i = 0; i < config.files; i++) {
+		char path[64];
+		_snprintf(path, sizeof(path), "/many/file%06d.dat", i);
+		path[sizeof(path)-1] = 0;
+		wrapper->SetTransferSize(config.fileSize);
+		BenchHost::Count(result, wrapper->ReceiveFile(receivedFile, path) == 0, config.fileSize);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("upload-small", name, security);
+	start = BenchHost::Now();
+	for(int i = 0; i < config.files; i++) {
+		char path[64];
+		_snprintf(path, sizeof(path), "/up/up%06d.dat", i);
+		path[sizeof(path)-1] = 0;
+		BenchHost::Count(result, wrapper->SendFile(smallFile, path) == 0, config.fileSize);
+	}
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("download-large", name, security);
+	start = BenchHost::Now();
+	wrapper->SetTransferSize(config.largeSize);
+	BenchHost::Count(result, wrapper->ReceiveFile(receivedFile, "/large.bin") == 0, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("upload-large", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, wrapper->SendFile(largeFile, "/up/large.bin") == 0, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	wrapper->Disconnect();
+	delete wrapper;
+
+	DeleteFile(smallFile);
+	DeleteFile(largeFile);
+	DeleteFile(receivedFile);
+
+	return 0;
+}
+
+//Authenticated like the wrapper does, NULL on failure
+static ssh_session ConnectSession(int port, sftp_session * sftp) {
+	ssh_session session = ssh_new();
+	if (session == NULL)
+		return NULL;
+
+	long timeout = 30;
+	if (ssh_options_set(session, SSH_OPTIONS_KNOWNHOSTS, _HostsFile) < 0 ||
+		ssh_options_set(session, SSH_OPTIONS_USER, "bench") < 0 ||
+		ssh_options_set(session, SSH_OPTIONS_HOST, "127.0.0.1") < 0 ||
+		ssh_options_set(session, SSH_OPTIONS_PORT, &port) < 0 ||
+		ssh_options_set(session, SSH_OPTIONS_TIMEOUT, &timeout) < 0 ||
+		ssh_connect(session) != SSH_OK) {
+		ssh_free(session);
+		return NULL;
+	}
+
+	*sftp = NULL;
+	if (ssh_is_server_known(session) == SSH_SERVER_KNOWN_OK &&
+		ssh_userauth_password(session, NULL, "bench") == SSH_AUTH_SUCCESS) {
+		*sftp = sftp_new(session);
+		if (*sftp != NULL && sftp_init(*sftp) != SSH_OK) {
+			sftp_free(*sftp);
+			*sftp = NULL;
+		}
+	}
+
+	if (*sftp == NULL) {
+		ssh_disconnect(session);
+		ssh_free(session);
+		return NULL;
+	}
+
+	return session;
+}
+
+//Bytes read, -1 on errors. With depth 1 every request waits for the previous reply, like the wrapper
+static LONGLONG ReadRemote(sftp_session sftp, const char * path, LONGLONG size, int depth) {
+	sftp_file file = sftp_open(sftp, path, O_RDONLY, 0);
+	if (file == NULL)
+		return -1;
+
+	char buf[BENCH_BLOCK_SIZE];
+	LONGLONG total = 0;
+	bool failed = false;
+
+	if (depth <= 1) {
+		ssize_t got = 0;
+		while((got = sftp_read(file, buf, sizeof(buf))) > 0)
+			total += got;
+		failed = (got < 0);
+	} else {
+		std::deque<int> requests;
+		LONGLONG requested = 0;
+		while(!failed && (requested < size || !requests.empty())) {
+			while(requested < size && (int)requests.size() < depth) {
+				int id = sftp_async_read_begin(file, BENCH_BLOCK_SIZE);
+				if (id < 0) {
+					failed = true;
+					break;
+				}
+				requests.push_back(id);
+				requested += BENCH_BLOCK_SIZE;
+			}
+			if (failed || requests.empty())
+				break;
+
+			int got = sftp_async_read(file, buf, BENCH_BLOCK_SIZE, requests.front());
+			requests.pop_front();
+			if (got < 0)
+				failed = true;
+			else
+				total += got;
+		}
+	}
+
+	sftp_close(file);
+	return failed?-1:total;
+}
+
+static int WriteRemote(sftp_session sftp, const char * path, LONGLONG size) {
+	sftp_file file = sftp_open(sftp, path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (file == NULL)
+		return -1;
+
+	char buf[BENCH_BLOCK_SIZE];
+	for(int i = 0; i < BENCH_BLOCK_SIZE; i++)
+		buf[i] = (char)('a' + (i%26));
+
+	LONGLONG written = 0;
+	while(written < size) {
+		size_t len = (size-written < BENCH_BLOCK_SIZE)?(size_t)(size-written):BENCH_BLOCK_SIZE;
+		if (sftp_write(file, buf, len) != (ssize_t)len)
+			break;
+		written += len;
+	}
+
+	sftp_close(file);
+	return (written == size)?0:-1;
+}
+
+static int BenchLibssh(SFTPStandIn & standIn, const BenchConfig & config, BenchReport & report) {
+	const char * name = "libssh";
+	const char * security = "sftp";
+
+	sftp_session sftp = NULL;
+	ssh_session session = ConnectSession(standIn.GetPort(), &sftp);
+	if (session == NULL) {
+		OutErr("[SFTPBench] %s could not connect", name);
+		return -1;
+	}
+
+	BenchResult result = BenchHost::NewResult("download-large", name, security);
+	LONGLONG start = BenchHost::Now();
+	BenchHost::Count(result, ReadRemote(sftp, "/large.bin", config.largeSize, 1) == config.largeSize, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("download-large-pipelined", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, ReadRemote(sftp, "/large.bin", config.largeSize, config.depth) == config.largeSize, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	result = BenchHost::NewResult("upload-large", name, security);
+	start = BenchHost::Now();
+	BenchHost::Count(result, WriteRemote(sftp, "/up/libssh.bin", config.largeSize) == 0, config.largeSize);
+	result.time = BenchHost::Now() - start;
+	report.Add(result);
+
+	sftp_free(sftp);
+	ssh_disconnect(session);
+	ssh_free(session);
+
+	return 0;
+}
+
+static int Usage() {
+	fprintf(stderr,
+		"Usage: SFTPBench [-format csv|json] [-latency ms] [-bandwidth bytes/s] [-connects n] [-dirsize n]\n"
+		"                 [-files n] [-filesize bytes] [-large bytes] [-depth n] [-v]\n");
+	return 2;
+}
+
+int main(int argc, char ** argv) {
+	BenchConfig config;
+	config.connects = 20;
+	config.lists = 3;
+	config.dirSize = 10000;
+	config.files = 200;
+	config.fileSize = 4096;
+	config.largeSize = 64*1024*1024;
+	config.depth = 16;
+	config.latency = 0;
+	config.bandwidth = 0;
+
+	const char * format = "csv";
+	bool verbose = false;
+
+	for(int i = 1; i < argc; i++) {
+		long value = 0;
+		int res = 0;
+		if (!strcmp(argv[i], "-v")) {
+			verbose = true;
+			continue;
+		}
+
+		if ((res = BenchHost::GetOption(argc, argv, &i, "-format", &format)) != 0) {
+			if (res == -1)
+				return Usage();
+			continue;
+		}
+
+		if ((res = BenchHost::GetOption(argc, argv, &i, "-latency", &value)) == 1)
+			config.latency = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-bandwidth", &value)) == 1)
+			config.bandwidth = value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-connects", &value)) == 1)
+			config.connects = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-dirsize", &value)) == 1)
+			config.dirSize = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-files", &value)) == 1)
+			config.files = (int)value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-filesize", &value)) == 1)
+			config.fileSize = value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-large", &value)) == 1)
+			config.largeSize = value;
+		else if (res == 0 && (res = BenchHost::GetOption(argc, argv, &i, "-depth", &value)) == 1)
+			config.depth = (int)value;
+
+		if (res != 1 || value < 0)
+			return Usage();
+	}
+
+	if (strcmp(format, "csv") && strcmp(format, "json"))
+		return Usage();
+
+	if (BenchHost::Init(verbose) == -1)
+		return 1;
+
+	TCHAR tempDir[MAX_PATH];
+	TCHAR root[MAX_PATH];
+	if (BenchHost::CreateTempDir(TEXT("NppSFTPBench"), tempDir) == -1) {
+		OutErr("[SFTPBench] Unable to create a temporary directory");
+		BenchHost::Deinit();
+		return 1;
+	}
+	SU::TSprintf(root, MAX_PATH, TEXT("%T\\root"), tempDir);
+
+	if (CreateDirectory(root, NULL) == FALSE || CreateTree(root, config) == -1) {
+		OutErr("[SFTPBench] Unable to create the served files in %T", root);
+		BenchHost::RemoveDir(tempDir);
+		BenchHost::Deinit();
+		return 1;
+	}
+
+	SFTPStandInConfig standInConfig;
+	SFTPStandIn::DefaultConfig(&standInConfig);
+	standInConfig.root = root;
+	standInConfig.latency = config.latency;
+	standInConfig.bandwidth = config.bandwidth;
+
+	SFTPStandIn standIn;
+	char hostsFile[MAX_PATH];
+	if (standIn.Start(standInConfig) == -1 || WriteKnownHosts(standIn, tempDir, hostsFile, MAX_PATH) == -1) {
+		OutErr("[SFTPBench] Unable to start the stand-in server");
+		standIn.Stop();
+		BenchHost::RemoveDir(tempDir);
+		BenchHost::Deinit();
+		return 1;
+	}
+	_HostsFile = hostsFile;
+
+	BenchReport report(strcmp(format, "json")?Format_CSV:Format_JSON, stdout);
+	report.Begin();
+
+	int res = 0;
+	if (BenchWrapper(standIn, config, tempDir, report) == -1)
+		res = -1;
+	if (BenchLibssh(standIn, config, report) == -1)
+		res = -1;
+
+	report.End();
+
+	standIn.Stop();
+	_HostsFile = NULL;
+
+	BenchHost::RemoveDir(tempDir);
+	BenchHost::Deinit();
+
+	return (res == -1 || report.GetFailures() > 0)?1:0;
+}
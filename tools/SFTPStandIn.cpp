@@ -0,0 +1,844 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SFTPStandIn.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <libssh/callbacks.h>
+
+#define SFTPSTANDIN_STOP_TIMEOUT	10000	//ms to wait for the sessions to end
+#define SFTPSTANDIN_IDLE_TIMEOUT	3600	//seconds a session waits for the client
+#define SFTPSTANDIN_MAX_READ		65536	//largest reply to a read request
+#define SFTPSTANDIN_NAMES			100		//names per readdir reply
+
+struct SFTPStandInSession {
+	SFTPStandIn*			server;
+	ssh_session				session;
+	socket_t				sock;
+	ssh_channel				channel;
+	sftp_session			sftp;
+	std::set<SFTPStandInHandle*>	handles;	//closed when the session ends
+	char					buffer[SFTPSTANDIN_MAX_READ];
+};
+
+struct SFTPStandInHandle {
+	HANDLE					file;		//INVALID_HANDLE_VALUE for directories
+	HANDLE					find;		//INVALID_HANDLE_VALUE for files
+	WIN32_FIND_DATA			findData;
+	bool					findValid;	//findData holds an entry that was not sent yet
+	bool					append;
+	DWORD					start;		//of the first transfer
+	LONGLONG				bytes;
+};
+
+//libssh locks OpenSSL only with these, and the server and the clients of a benchmark run in parallel
+static int MutexInit(void ** lock) {
+	CRITICAL_SECTION * section = new CRITICAL_SECTION;
+	InitializeCriticalSection(section);
+	*lock = section;
+	return 0;
+}
+
+static int MutexDestroy(void ** lock) {
+	CRITICAL_SECTION * section = (CRITICAL_SECTION*)*lock;
+	DeleteCriticalSection(section);
+	delete section;
+	*lock = NULL;
+	return 0;
+}
+
+static int MutexLock(void ** lock) {
+	EnterCriticalSection((CRITICAL_SECTION*)*lock);
+	return 0;
+}
+
+static int MutexUnlock(void ** lock) {
+	LeaveCriticalSection((CRITICAL_SECTION*)*lock);
+	return 0;
+}
+
+static unsigned long ThreadId() {
+	return Thread::CurrentId();
+}
+
+static struct ssh_threads_callbacks_struct _threadCallbacks = {
+	"threads_win32", &MutexInit, &MutexDestroy, &MutexLock, &MutexUnlock, &ThreadId
+};
+
+static void SetNoDelay(socket_t sock) {
+	BOOL noDelay = TRUE;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+}
+
+static uint32_t UnixTime(const FILETIME & ft) {
+	LONGLONG ll = ((LONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+	ll -= Int32x32To64(116444736, 1000000000);
+	return (ll > 0)?(uint32_t)(ll / 10000000):0;
+}
+
+static FILETIME FileTime(uint32_t unixTime) {
+	LONGLONG ll = Int32x32To64(unixTime, 10000000);
+	ll += Int32x32To64(116444736, 1000000000);
+
+	FILETIME ft;
+	ft.dwLowDateTime = (DWORD)ll;
+	ft.dwHighDateTime = (DWORD)(ll >> 32);
+	return ft;
+}
+
+static void FillAttributes(sftp_attributes attr, DWORD attributes, ULONGLONG size, const FILETIME & atime, const FILETIME & mtime) {
+	memset(attr, 0, sizeof(*attr));
+
+	bool directory = (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	attr->flags = SSH_FILEXFER_ATTR_SIZE|SSH_FILEXFER_ATTR_PERMISSIONS|SSH_FILEXFER_ATTR_ACMODTIME;
+	attr->type = directory?SSH_FILEXFER_TYPE_DIRECTORY:SSH_FILEXFER_TYPE_REGULAR;
+	attr->size = directory?0:size;
+	if (directory)
+		attr->permissions = 040755;
+	else
+		attr->permissions = (attributes & FILE_ATTRIBUTE_READONLY)?0100444:0100644;
+	attr->atime = UnixTime(atime);
+	attr->mtime = UnixTime(mtime);
+}
+
+//"ls -l" line, libssh takes the owner and group from it
+static void LongName(const sftp_attributes attr, const char * name, char * buf, int size) {
+	char date[32] = "Jan  1  1970";
+	time_t mtime = (time_t)attr->mtime;
+	struct tm * tm = gmtime(&mtime);
+	if (tm != NULL)
+		strftime(date, sizeof(date), "%b %d %H:%M", tm);
+
+	_snprintf(buf, size, "%s    1 bench    bench    %12.0f %s %s",
+		(attr->type == SSH_FILEXFER_TYPE_DIRECTORY)?"drwxr-xr-x":"-rw-r--r--", (double)attr->size, date, name);
+	buf[size-1] = 0;
+}
+
+static int ReplyStatus(sftp_client_message msg, DWORD error) {
+	switch(error) {
+		case NO_ERROR:
+			return sftp_reply_status(msg, SSH_FX_OK, "Success");
+		case ERROR_FILE_NOT_FOUND:
+		case ERROR_PATH_NOT_FOUND:
+		case ERROR_INVALID_NAME:
+		case ERROR_DIRECTORY:
+			return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "No such file");
+		case ERROR_ACCESS_DENIED:
+		case ERROR_SHARING_VIOLATION:
+			return sftp_reply_status(msg, SSH_FX_PERMISSION_DENIED, "Permission denied");
+		case ERROR_INVALID_HANDLE:
+			return sftp_reply_status(msg, SSH_FX_INVALID_HANDLE, "Invalid handle");
+		default:
+			return sftp_reply_status(msg, SSH_FX_FAILURE, "Failure");
+	}
+}
+
+static int ReplyAttributes(sftp_client_message msg, const TCHAR * path) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (GetFileAttributesEx(path, GetFileExInfoStandard, &data) == FALSE)
+		return ReplyStatus(msg, GetLastError());
+
+	struct sftp_attributes_struct attr;
+	ULONGLONG size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	FillAttributes(&attr, data.dwFileAttributes, size, data.ftLastAccessTime, data.ftLastWriteTime);
+	return sftp_reply_attr(msg, &attr);
+}
+
+//Size and times, other attributes are ignored
+static DWORD ApplyAttributes(sftp_attributes attr, HANDLE hFile) {
+	if (attr == NULL)
+		return NO_ERROR;
+
+	if (attr->flags & SSH_FILEXFER_ATTR_SIZE) {
+		LONG high = (LONG)(attr->size >> 32);
+		if (SetFilePointer(hFile, (LONG)(attr->size & 0xFFFFFFFF), &high, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR)
+			return GetLastError();
+		if (SetEndOfFile(hFile) == FALSE)
+			return GetLastError();
+	}
+
+	if (attr->flags & SSH_FILEXFER_ATTR_ACMODTIME) {
+		FILETIME atime = FileTime(attr->atime);
+		FILETIME mtime = FileTime(attr->mtime);
+		if (SetFileTime(hFile, NULL, &atime, &mtime) == FALSE)
+			return GetLastError();
+	}
+
+	return NO_ERROR;
+}
+
+//Absolute and without "." and "..", relative paths start at "/". Empty if a name could leave the root on Windows
+static std::string NormalizePath(const char * path) {
+	if (path == NULL)
+		return "";
+
+	std::vector<std::string> parts;
+	const char * pos = path;
+	while(*pos) {
+		const char * end = strchr(pos, '/');
+		if (end == NULL)
+			end = pos+strlen(pos);
+
+		std::string part(pos, end-pos);
+		if (part == "..") {
+			if (!parts.empty())
+				parts.pop_back();
+		} else if (!part.empty() && part != ".") {
+			if (part.find_first_of("\\:") != std::string::npos)
+				return "";
+			parts.push_back(part);
+		}
+
+		pos = (*end)?end+1:end;
+	}
+
+	std::string normalized;
+	for(size_t i = 0; i < parts.size(); i++)
+		normalized += "/" + parts[i];
+
+	return normalized.empty()?"/":normalized;
+}
+
+SFTPStandIn::SFTPStandIn() :
+	m_bind(NULL),
+	m_port(0),
+	m_listenThread(NULL),
+	m_stopping(false),
+	m_key(NULL),
+	m_monitor(1)
+{
+	DefaultConfig(&m_config);
+}
+
+SFTPStandIn::~SFTPStandIn() {
+	Stop();
+
+	if (m_key)
+		ssh_key_free(m_key);
+}
+
+int SFTPStandIn::DefaultConfig(SFTPStandInConfig * config) {
+	config->port = 0;
+	config->root = NULL;
+	config->latency = 0;
+	config->bandwidth = 0;
+
+	return 0;
+}
+
+int SFTPStandIn::Start(const SFTPStandInConfig & config) {
+	if (m_bind != NULL || config.root == NULL)
+		return -1;
+
+	m_config = config;
+	m_root = config.root;
+	while(!m_root.empty() && (m_root[m_root.size()-1] == TEXT('\\') || m_root[m_root.size()-1] == TEXT('/')))
+		m_root.erase(m_root.size()-1);
+	m_stopping = false;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)
+		return -1;
+
+	if (InitThreads() == -1 || CreateHostKey() == -1) {
+		WSACleanup();
+		return -1;
+	}
+
+	//the bind reads the host key from a file, which is not needed after listening
+	char tempPath[MAX_PATH];
+	char keyFile[MAX_PATH];
+	if (GetTempPathA(MAX_PATH, tempPath) == 0 || GetTempFileNameA(tempPath, "ssh", 0, keyFile) == 0) {
+		WSACleanup();
+		return -1;
+	}
+
+	int port = m_config.port;
+	int res = -1;
+	m_bind = ssh_bind_new();
+	if (m_bind != NULL &&
+		ssh_pki_export_privkey_file(m_key, NULL, NULL, NULL, keyFile) == SSH_OK &&
+		ssh_bind_options_set(m_bind, SSH_BIND_OPTIONS_BINDADDR, "127.0.0.1") == SSH_OK &&
+		ssh_bind_options_set(m_bind, SSH_BIND_OPTIONS_BINDPORT, &port) == SSH_OK &&
+		ssh_bind_options_set(m_bind, SSH_BIND_OPTIONS_RSAKEY, keyFile) == SSH_OK &&
+		ssh_bind_listen(m_bind) == SSH_OK) {
+		sockaddr_in addr;
+		int addrLen = sizeof(addr);
+		if (getsockname(ssh_bind_get_fd(m_bind), (sockaddr*)&addr, &addrLen) == 0) {
+			m_port = ntohs(addr.sin_port);
+			res = 0;
+		}
+	}
+	DeleteFileA(keyFile);
+
+	if (res == 0) {
+		m_listenThread = Thread::Start(&ListenThread, this);
+		if (m_listenThread == NULL)
+			res = -1;
+	}
+
+	if (res == -1) {
+		if (m_bind != NULL)
+			ssh_bind_free(m_bind);
+		m_bind = NULL;
+		m_port = 0;
+		WSACleanup();
+		return -1;
+	}
+
+	return 0;
+}
+
+int SFTPStandIn::Stop() {
+	if (m_bind == NULL)
+		return 0;
+
+	//the bind cannot be freed while it accepts, so the thread is woken with a connection and ends on the flag
+	m_stopping = true;
+	SOCKET wake = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (wake != INVALID_SOCKET) {
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons((u_short)m_port);
+		connect(wake, (sockaddr*)&addr, sizeof(addr));
+		closesocket(wake);
+	}
+	Thread::Join(&m_listenThread, 1);
+	m_listenThread = NULL;
+
+	ssh_bind_free(m_bind);
+	m_bind = NULL;
+	m_port = 0;
+
+	//the sessions remove themselves
+	m_monitor.Enter();
+	for(std::set<socket_t>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it)
+		shutdown(*it, SD_BOTH);
+	m_monitor.Exit();
+
+	DWORD start = GetTickCount();
+	while(GetSessionCount() > 0 && GetTickCount() - start < SFTPSTANDIN_STOP_TIMEOUT)
+		Sleep(10);
+
+	WSACleanup();
+	return 0;
+}
+
+int SFTPStandIn::GetPort() {
+	return m_port;
+}
+
+int SFTPStandIn::GetKnownHostsLine(char * buf, int size) {
+	if (m_key == NULL || m_port == 0 || size < 1)
+		return -1;
+
+	char * base64 = NULL;
+	if (ssh_pki_export_pubkey_base64(m_key, &base64) != SSH_OK)
+		return -1;
+
+	int len = _snprintf(buf, size, "[127.0.0.1]:%d ssh-rsa %s", m_port, base64);
+	ssh_string_free_char(base64);
+	if (len < 0 || len >= size) {
+		buf[0] = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+int SFTPStandIn::GetSessionCount() {
+	m_monitor.Enter();
+	int count = (int)m_sessions.size();
+	m_monitor.Exit();
+
+	return count;
+}
+
+int SFTPStandIn::ListenThread(void * param) {
+	SFTPStandIn * server = (SFTPStandIn*)param;
+
+	for(;;) {
+		ssh_session sshSession = ssh_new();
+		if (sshSession == NULL)
+			break;
+
+		if (ssh_bind_accept(server->m_bind, sshSession) != SSH_OK || server->m_stopping) {
+			ssh_free(sshSession);
+			break;
+		}
+
+		long timeout = SFTPSTANDIN_IDLE_TIMEOUT;
+		ssh_options_set(sshSession, SSH_OPTIONS_TIMEOUT, &timeout);
+		socket_t sock = ssh_get_fd(sshSession);
+		SetNoDelay(sock);
+
+		SFTPStandInSession * session = new SFTPStandInSession;
+		session->server = server;
+		session->session = sshSession;
+		session->sock = sock;
+		session->channel = NULL;
+		session->sftp = NULL;
+
+		server->m_monitor.Enter();
+		server->m_sessions.insert(sock);
+		server->m_monitor.Exit();
+
+		ThreadHandle thread = Thread::Start(&SessionThread, session);
+		if (thread == NULL) {
+			server->m_monitor.Enter();
+			server->m_sessions.erase(sock);
+			server->m_monitor.Exit();
+			ssh_free(sshSession);
+			delete session;
+			continue;
+		}
+		Thread::Detach(thread);
+	}
+
+	return 0;
+}
+
+int SFTPStandIn::SessionThread(void * param) {
+	SFTPStandInSession * session = (SFTPStandInSession*)param;
+	SFTPStandIn * server = session->server;
+
+	server->Serve(*session);
+
+	while(!session->handles.empty())
+		server->Close(*session, *session->handles.begin());
+
+	//the sftp session owns the channel
+	if (session->sftp)
+		sftp_free(session->sftp);
+	else if (session->channel)
+		ssh_channel_free(session->channel);
+
+	//Stop only shuts down sockets that are still in the set
+	server->m_monitor.Enter();
+	server->m_sessions.erase(session->sock);
+	server->m_monitor.Exit();
+
+	ssh_disconnect(session->session);
+	ssh_free(session->session);
+	delete session;
+
+	return 0;
+}
+
+int SFTPStandIn::Serve(SFTPStandInSession & session) {
+	if (ssh_handle_key_exchange(session.session) != SSH_OK)
+		return -1;
+	ssh_set_auth_methods(session.session, SSH_AUTH_METHOD_PASSWORD);
+
+	session.channel = OpenSubsystem(session);
+	if (session.channel == NULL)
+		return -1;
+
+	session.sftp = sftp_server_new(session.session, session.channel);
+	if (session.sftp == NULL)
+		return -1;
+
+	Delay();
+	if (sftp_server_init(session.sftp) != 0)
+		return -1;
+
+	for(;;) {
+		sftp_client_message msg = sftp_get_client_message(session.sftp);
+		if (msg == NULL)
+			return 0;	//the client is gone
+
+		int res = Dispatch(session, msg);
+		sftp_client_message_free(msg);
+		if (res == -1)
+			return -1;
+	}
+}
+
+//Accepts any password and waits for the channel that asks for "sftp", NULL if the client leaves before
+ssh_channel SFTPStandIn::OpenSubsystem(SFTPStandInSession & session) {
+	ssh_channel channel = NULL;
+
+	for(;;) {
+		ssh_message message = ssh_message_get(session.session);
+		if (message == NULL)
+			break;
+
+		Delay();
+
+		int type = ssh_message_type(message);
+		int subtype = ssh_message_subtype(message);
+		int res = SSH_OK;
+		bool ready = false;
+		if (type == SSH_REQUEST_AUTH && subtype == SSH_AUTH_METHOD_PASSWORD) {
+			res = ssh_message_auth_reply_success(message, 0);
+		} else if (type == SSH_REQUEST_CHANNEL_OPEN && subtype == SSH_CHANNEL_SESSION && channel == NULL) {
+			channel = ssh_message_channel_request_open_reply_accept(message);
+			if (channel == NULL)
+				res = SSH_ERROR;
+		} else if (type == SSH_REQUEST_CHANNEL && subtype == SSH_CHANNEL_REQUEST_SUBSYSTEM && channel != NULL &&
+				   ssh_message_channel_request_subsystem(message) != NULL &&
+				   !strcmp(ssh_message_channel_request_subsystem(message), "sftp")) {
+			res = ssh_message_channel_request_reply_success(message);
+			ready = true;
+		} else {
+			//"none" and every other method learn that only passwords are taken
+			if (type == SSH_REQUEST_AUTH)
+				ssh_message_auth_set_methods(message, SSH_AUTH_METHOD_PASSWORD);
+			res = ssh_message_reply_default(message);
+		}
+		ssh_message_free(message);
+
+		if (res != SSH_OK)
+			break;
+		if (ready)
+			return channel;
+	}
+
+	if (channel != NULL)
+		ssh_channel_free(channel);
+	return NULL;
+}
+
+//0 to go on, -1 when a reply cannot be sent
+int SFTPStandIn::Dispatch(SFTPStandInSession & session, sftp_client_message msg) {
+	Delay();
+
+	int type = sftp_client_message_get_type(msg);
+	TCHAR path[MAX_PATH];
+	SFTPStandInHandle * handle = NULL;
+
+	switch(type) {
+		case SSH_FXP_READ:
+		case SSH_FXP_WRITE:
+		case SSH_FXP_FSTAT:
+		case SSH_FXP_FSETSTAT:
+		case SSH_FXP_READDIR:
+		case SSH_FXP_CLOSE: {
+			handle = (SFTPStandInHandle*)sftp_handle(session.sftp, msg->handle);
+			if (handle == NULL || session.handles.count(handle) == 0)
+				return ReplyStatus(msg, ERROR_INVALID_HANDLE);
+
+			bool directory = (handle->find != INVALID_HANDLE_VALUE);
+			if ((type == SSH_FXP_READDIR) != directory && type != SSH_FXP_CLOSE)
+				return ReplyStatus(msg, ERROR_INVALID_HANDLE);
+			break; }
+		case SSH_FXP_STAT:
+		case SSH_FXP_LSTAT:
+		case SSH_FXP_SETSTAT:
+		case SSH_FXP_REMOVE:
+		case SSH_FXP_MKDIR:
+		case SSH_FXP_RMDIR:
+		case SSH_FXP_RENAME:
+			if (LocalPath(msg->filename, path) == -1)
+				return ReplyStatus(msg, ERROR_PATH_NOT_FOUND);
+			break;
+		default:
+			break;
+	}
+
+	switch(type) {
+		case SSH_FXP_REALPATH: {
+			std::string normalized = NormalizePath(msg->filename);
+			if (normalized.empty())
+				return ReplyStatus(msg, ERROR_PATH_NOT_FOUND);
+			struct sftp_attributes_struct attr;
+			memset(&attr, 0, sizeof(attr));
+			return sftp_reply_name(msg, normalized.c_str(), &attr); }
+		case SSH_FXP_OPEN:
+		case SSH_FXP_OPENDIR:
+			return Open(session, msg, type == SSH_FXP_OPENDIR);
+		case SSH_FXP_CLOSE:
+			return ReplyStatus(msg, (Close(session, handle) == 0)?NO_ERROR:ERROR_WRITE_FAULT);
+		case SSH_FXP_READDIR:
+			return ReadDir(msg, handle);
+		case SSH_FXP_READ:
+			return Read(session, msg, handle);
+		case SSH_FXP_WRITE:
+			return Write(msg, handle);
+		case SSH_FXP_STAT:
+		case SSH_FXP_LSTAT:
+			return ReplyAttributes(msg, path);
+		case SSH_FXP_FSTAT: {
+			BY_HANDLE_FILE_INFORMATION info;
+			if (GetFileInformationByHandle(handle->file, &info) == FALSE)
+				return ReplyStatus(msg, GetLastError());
+			struct sftp_attributes_struct attr;
+			ULONGLONG size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+			FillAttributes(&attr, info.dwFileAttributes, size, info.ftLastAccessTime, info.ftLastWriteTime);
+			return sftp_reply_attr(msg, &attr); }
+		case SSH_FXP_SETSTAT:
+			return SetStat(msg, path);
+		case SSH_FXP_FSETSTAT:
+			return ReplyStatus(msg, ApplyAttributes(msg->attr, handle->file));
+		case SSH_FXP_REMOVE:
+			return ReplyStatus(msg, (::DeleteFile(path) == FALSE)?GetLastError():NO_ERROR);
+		case SSH_FXP_MKDIR:
+			return ReplyStatus(msg, (CreateDirectory(path, NULL) == FALSE)?GetLastError():NO_ERROR);
+		case SSH_FXP_RMDIR:
+			return ReplyStatus(msg, (RemoveDirectory(path) == FALSE)?GetLastError():NO_ERROR);
+		case SSH_FXP_RENAME: {
+			TCHAR newPath[MAX_PATH];
+			if (LocalPath(sftp_client_message_get_data(msg), newPath) == -1)
+				return ReplyStatus(msg, ERROR_PATH_NOT_FOUND);
+			return ReplyStatus(msg, (MoveFile(path, newPath) == FALSE)?GetLastError():NO_ERROR); }
+		default:
+			return sftp_reply_status(msg, SSH_FX_OP_UNSUPPORTED, "Unsupported");
+	}
+}
+
+int SFTPStandIn::Open(SFTPStandInSession & session, sftp_client_message msg, bool directory) {
+	TCHAR path[MAX_PATH];
+	if (LocalPath(msg->filename, path) == -1)
+		return ReplyStatus(msg, ERROR_PATH_NOT_FOUND);
+
+	SFTPStandInHandle * handle = new SFTPStandInHandle;
+	handle->file = INVALID_HANDLE_VALUE;
+	handle->find = INVALID_HANDLE_VALUE;
+	handle->findValid = false;
+	handle->append = false;
+	handle->start = 0;
+	handle->bytes = 0;
+
+	if (directory) {
+		TCHAR findPath[MAX_PATH];
+		SU::TSprintf(findPath, MAX_PATH, TEXT("%T\\*"), path);
+		handle->find = FindFirstFile(findPath, &handle->findData);
+		handle->findValid = (handle->find != INVALID_HANDLE_VALUE);
+	} else {
+		uint32_t flags = msg->flags;
+
+		DWORD access = 0;
+		if (flags & SSH_FXF_READ)
+			access |= GENERIC_READ;
+		if (flags & SSH_FXF_WRITE)
+			access |= GENERIC_WRITE;
+
+		DWORD disposition = OPEN_EXISTING;
+		if (flags & SSH_FXF_CREAT) {
+			if (flags & SSH_FXF_EXCL)
+				disposition = CREATE_NEW;
+			else if (flags & SSH_FXF_TRUNC)
+				disposition = CREATE_ALWAYS;
+			else
+				disposition = OPEN_ALWAYS;
+		} else if (flags & SSH_FXF_TRUNC) {
+			disposition = TRUNCATE_EXISTING;
+		}
+
+		handle->append = (flags & SSH_FXF_APPEND) != 0;
+		handle->file = ::CreateFile(path, access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+
+	if (handle->file == INVALID_HANDLE_VALUE && handle->find == INVALID_HANDLE_VALUE) {
+		DWORD error = GetLastError();
+		delete handle;
+		return ReplyStatus(msg, error);
+	}
+
+	ssh_string id = sftp_handle_alloc(session.sftp, handle);
+	if (id == NULL) {
+		if (handle->file != INVALID_HANDLE_VALUE)
+			CloseHandle(handle->file);
+		if (handle->find != INVALID_HANDLE_VALUE)
+			FindClose(handle->find);
+		delete handle;
+		return sftp_reply_status(msg, SSH_FX_FAILURE, "Too many open handles");
+	}
+
+	session.handles.insert(handle);
+	int res = sftp_reply_handle(msg, id);
+	ssh_string_free(id);
+
+	return res;
+}
+
+int SFTPStandIn::Close(SFTPStandInSession & session, SFTPStandInHandle * handle) {
+	BOOL res = TRUE;
+	if (handle->file != INVALID_HANDLE_VALUE)
+		res = CloseHandle(handle->file);
+	if (handle->find != INVALID_HANDLE_VALUE)
+		FindClose(handle->find);
+
+	sftp_handle_remove(session.sftp, handle);
+	session.handles.erase(handle);
+	delete handle;
+
+	return (res == FALSE)?-1:0;
+}
+
+int SFTPStandIn::ReadDir(sftp_client_message msg, SFTPStandInHandle * handle) {
+	int count = 0;
+	while(handle->findValid && count < SFTPSTANDIN_NAMES) {
+		const WIN32_FIND_DATA & data = handle->findData;
+		char name[MAX_PATH*3];
+		if (lstrcmp(data.cFileName, TEXT(".")) && lstrcmp(data.cFileName, TEXT("..")) &&
+			SU::TCharToUtf8(data.cFileName, name, sizeof(name)) != -1) {
+			struct sftp_attributes_struct attr;
+			ULONGLONG size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+			FillAttributes(&attr, data.dwFileAttributes, size, data.ftLastAccessTime, data.ftLastWriteTime);
+
+			char longName[MAX_PATH*3+64];
+			LongName(&attr, name, longName, sizeof(longName));
+			if (sftp_reply_names_add(msg, name, longName, &attr) != 0)
+				return -1;
+			count++;
+		}
+
+		handle->findValid = (FindNextFile(handle->find, &handle->findData) != FALSE);
+	}
+
+	if (count == 0)
+		return sftp_reply_status(msg, SSH_FX_EOF, "End of directory");
+
+	return sftp_reply_names(msg);
+}
+
+int SFTPStandIn::Read(SFTPStandInSession & session, sftp_client_message msg, SFTPStandInHandle * handle) {
+	//the offset of each request, so pipelined reads may come in any order
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)(msg->offset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = (DWORD)(msg->offset >> 32);
+
+	DWORD len = (msg->len < SFTPSTANDIN_MAX_READ)?msg->len:SFTPSTANDIN_MAX_READ;
+	DWORD done = 0;
+	if (ReadFile(handle->file, session.buffer, len, &done, &overlapped) == FALSE) {
+		DWORD error = GetLastError();
+		if (error != ERROR_HANDLE_EOF)
+			return ReplyStatus(msg, error);
+		done = 0;
+	}
+
+	if (done == 0 && len > 0)
+		return sftp_reply_status(msg, SSH_FX_EOF, "End of file");
+
+	Throttle(handle, (long)done);
+	return sftp_reply_data(msg, session.buffer, (int)done);
+}
+
+int SFTPStandIn::Write(sftp_client_message msg, SFTPStandInHandle * handle) {
+	if (msg->data == NULL)
+		return ReplyStatus(msg, ERROR_INVALID_PARAMETER);
+
+	//both offsets at 0xFFFFFFFF write to the end of the file
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = handle->append?0xFFFFFFFF:(DWORD)(msg->offset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = handle->append?0xFFFFFFFF:(DWORD)(msg->offset >> 32);
+
+	DWORD len = (DWORD)ssh_string_len(msg->data);
+	DWORD done = 0;
+	if (WriteFile(handle->file, ssh_string_data(msg->data), len, &done, &overlapped) == FALSE)
+		return ReplyStatus(msg, GetLastError());
+
+	Throttle(handle, (long)done);
+	return ReplyStatus(msg, (done == len)?NO_ERROR:ERROR_WRITE_FAULT);
+}
+
+int SFTPStandIn::SetStat(sftp_client_message msg, const TCHAR * path) {
+	if (msg->attr == NULL || !(msg->attr->flags & (SSH_FILEXFER_ATTR_SIZE|SSH_FILEXFER_ATTR_ACMODTIME)))
+		return ReplyStatus(msg, NO_ERROR);
+
+	//backup semantics open directories too, for their times
+	HANDLE hFile = ::CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return ReplyStatus(msg, GetLastError());
+
+	DWORD error = ApplyAttributes(msg->attr, hFile);
+	CloseHandle(hFile);
+
+	return ReplyStatus(msg, error);
+}
+
+int SFTPStandIn::Delay() {
+	if (m_config.latency > 0)
+		Sleep(m_config.latency);
+
+	return 0;
+}
+
+int SFTPStandIn::Throttle(SFTPStandInHandle * handle, long bytes) {
+	if (m_config.bandwidth <= 0)
+		return 0;
+
+	if (handle->bytes == 0)
+		handle->start = GetTickCount();
+	handle->bytes += bytes;
+
+	DWORD due = (DWORD)(handle->bytes * 1000 / m_config.bandwidth);
+	DWORD elapsed = GetTickCount() - handle->start;
+	if (due > elapsed)
+		Sleep(due - elapsed);
+
+	return 0;
+}
+
+int SFTPStandIn::LocalPath(const char * path, TCHAR * buf) {
+	std::string normalized = NormalizePath(path);
+	if (normalized.empty())
+		return -1;
+
+	tstring local = m_root;
+	if (normalized != "/") {
+		Utf8ToTCharStr relative(normalized.c_str());
+		if (relative.c_str() == NULL)
+			return -1;
+		local += relative.c_str();
+	}
+
+	if (local.size() >= MAX_PATH)
+		return -1;
+
+	for(size_t i = 0; i < local.size(); i++) {
+		if (local[i] == TEXT('/'))
+			local[i] = TEXT('\\');
+	}
+	lstrcpy(buf, local.c_str());
+
+	return 0;
+}
+
+int SFTPStandIn::CreateHostKey() {
+	if (m_key != NULL)
+		return 0;
+
+	if (ssh_pki_generate(SSH_KEYTYPE_RSA, 2048, &m_key) != SSH_OK) {
+		m_key = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+//libssh picks up the callbacks in its first ssh_init only
+int SFTPStandIn::InitThreads() {
+	static bool callbacksSet = false;
+
+	if (!callbacksSet) {
+		if (ssh_threads_set_callbacks(&_threadCallbacks) != SSH_OK)
+			return -1;
+		callbacksSet = true;
+	}
+
+	return (ssh_init() == 0)?0:-1;
+}
@@ -0,0 +1,97 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SFTPSTANDIN_H
+#define SFTPSTANDIN_H
+
+//Loopback SFTP server the benchmarks run against, see SFTPBench.cpp
+//Built on the server and sftp-server APIs of libssh, serves a local directory as "/". The latency is added
+//before every reply and the bandwidth limits every open file, so a remote server can be imitated
+//Start installs the thread callbacks of libssh, so it has to come before any other use of libssh in the process
+
+#include <winsock2.h>
+#include <windows.h>
+#include <libssh/libssh.h>
+#include <libssh/server.h>
+#include <libssh/sftp.h>
+#include <string>
+#include <set>
+
+#include "StringUtils.h"
+#include "Thread.h"
+#include "Monitor.h"
+
+struct SFTPStandInConfig {
+	int						port;			//0 for any free port
+	const TCHAR *			root;			//directory that is served
+	int						latency;		//ms before every reply
+	long					bandwidth;		//bytes per second per open file, 0 for no limit
+};
+
+struct SFTPStandInSession;
+struct SFTPStandInHandle;
+
+class SFTPStandIn {
+public:
+							SFTPStandIn();
+	virtual					~SFTPStandIn();
+
+	static int				DefaultConfig(SFTPStandInConfig * config);
+
+	virtual int				Start(const SFTPStandInConfig & config);	//listens on 127.0.0.1, any user and password is accepted
+	virtual int				Stop();	//closes the listener and all sessions
+
+	virtual int				GetPort();
+	virtual int				GetKnownHostsLine(char * buf, int size);	//"[127.0.0.1]:port ssh-rsa key", for the known_hosts file of the client
+	virtual int				GetSessionCount();
+private:
+	static int				ListenThread(void * param);
+	static int				SessionThread(void * param);
+
+	int						Serve(SFTPStandInSession & session);
+	ssh_channel				OpenSubsystem(SFTPStandInSession & session);
+	int						Dispatch(SFTPStandInSession & session, sftp_client_message msg);
+
+	int						Open(SFTPStandInSession & session, sftp_client_message msg, bool directory);
+	int						Close(SFTPStandInSession & session, SFTPStandInHandle * handle);
+	int						ReadDir(sftp_client_message msg, SFTPStandInHandle * handle);
+	int						Read(SFTPStandInSession & session, sftp_client_message msg, SFTPStandInHandle * handle);
+	int						Write(sftp_client_message msg, SFTPStandInHandle * handle);
+	int						SetStat(sftp_client_message msg, const TCHAR * path);
+
+	int						Delay();
+	int						Throttle(SFTPStandInHandle * handle, long bytes);
+
+	int						LocalPath(const char * path, TCHAR * buf);	//buf must hold MAX_PATH characters, -1 if the path is not valid
+
+	int						CreateHostKey();
+	static int				InitThreads();
+
+	SFTPStandInConfig		m_config;
+	tstring					m_root;
+	ssh_bind				m_bind;
+	int						m_port;
+	ThreadHandle			m_listenThread;
+	volatile bool			m_stopping;
+	ssh_key					m_key;
+
+	Monitor					m_monitor;	//guards everything below
+	std::set<socket_t>		m_sessions;
+};
+
+#endif //SFTPSTANDIN_H
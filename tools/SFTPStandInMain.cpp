@@ -0,0 +1,85 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Runs SFTPStandIn on its own, to try NppFTP itself against it
+//Usage: SFTPStandIn -root dir [-port n] [-latency ms] [-bandwidth bytes/s]
+//The host key is generated at every start, its known_hosts line is printed
+
+#include "SFTPStandIn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int Usage() {
+	fprintf(stderr, "Usage: SFTPStandIn -root dir [-port n] [-latency ms] [-bandwidth bytes/s]\n");
+	return 2;
+}
+
+int main(int argc, char ** argv) {
+	SFTPStandInConfig config;
+	SFTPStandIn::DefaultConfig(&config);
+	config.port = 2222;
+
+	TCHAR root[MAX_PATH];
+	root[0] = 0;
+
+	for(int i = 1; i < argc; i++) {
+		if (i+1 >= argc)
+			return Usage();
+
+		const char * option = argv[i];
+		const char * value = argv[++i];
+		if (!strcmp(option, "-root")) {
+#ifdef UNICODE
+			if (MultiByteToWideChar(CP_ACP, 0, value, -1, root, MAX_PATH) == 0)
+				return Usage();
+#else
+			lstrcpyn(root, value, MAX_PATH);
+#endif
+		} else if (!strcmp(option, "-port")) {
+			config.port = atoi(value);
+		} else if (!strcmp(option, "-latency")) {
+			config.latency = atoi(value);
+		} else if (!strcmp(option, "-bandwidth")) {
+			config.bandwidth = atol(value);
+		} else {
+			return Usage();
+		}
+	}
+
+	if (root[0] == 0)
+		return Usage();
+	config.root = root;
+
+	SFTPStandIn standIn;
+	if (standIn.Start(config) == -1) {
+		fprintf(stderr, "Unable to listen on 127.0.0.1:%d\n", config.port);
+		return 1;
+	}
+
+	char knownHost[1024];
+	if (standIn.GetKnownHostsLine(knownHost, sizeof(knownHost)) == 0)
+		printf("Host key: %s\n", knownHost);
+	printf("Listening on 127.0.0.1:%d, press Enter to stop\n", standIn.GetPort());
+	fflush(stdout);
+	getchar();
+
+	standIn.Stop();
+	return 0;
+}
@@ -0,0 +1,255 @@
+/*
+    NppFTP: FTP/SFTP functionality for Notepad++
+    Copyright (C) 2010  Harry (harrybharry@users.sourceforge.net)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Decodes an NppFTP trace file (see src/Trace.h) into text, CSV or Chrome trace event JSON
+//Usage: TraceDump [-csv|-chrome] NppFTP.trace
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+#include "Trace.h"
+
+static const char * EventNames[Trace_EventCount] = {
+	"none", "open", "command", "reply", "dataopen", "dataclose", "received", "sent",
+	"queueadd", "queuestart", "queueend", "notify", "begin", "end"
+};
+
+static const char * SpanNames[Span_Count] = {
+	"none", "queue wait", "queue delay", "perform", "window event", "connect", "disconnect",
+	"getdir", "sendfile", "receivefile", "batch", "socket connect", "handshake"
+};
+
+static bool CompareSequence(const TraceEntry & a, const TraceEntry & b) {
+	return a.sequence < b.sequence;
+}
+
+static const char * EventName(WORD event) {
+	if (event < Trace_EventCount)
+		return EventNames[event];
+	return "unknown";
+}
+
+static const char * SpanName(int span) {
+	if (span >= 0 && span < Span_Count)
+		return SpanNames[span];
+	return "unknown";
+}
+
+//Command verbs are packed into the code, e.g. 'RETR'
+static void UnpackVerb(int code, char * verb) {
+	for(int i = 0; i < 4; i++) {
+		char c = (char)((code >> (8*i)) & 0xFF);
+		bool alnum = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+		verb[i] = alnum?c:0;
+	}
+	verb[4] = 0;
+}
+
+struct PendingCommand {
+	double		time;
+	int			verb;
+};
+
+//Chrome trace event format, timestamps in microseconds
+static int DumpChrome(const TraceHeader & header, const std::vector<TraceEntry> & entries) {
+	double usPerTick = 1000000.0 / (double)header.frequency;
+	unsigned long pid = 0;
+	std::map< DWORD, std::deque<PendingCommand> > pending;	//commands awaiting a reply, per thread
+	char verb[5];
+	const char * separator = ",\n";
+
+	for(size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].event == Trace_Open)
+			pid = (unsigned long)entries[i].value;
+	}
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"args\":{\"name\":\"NppFTP\"}}", pid);
+
+	for(size_t i = 0; i < entries.size(); i++) {
+		const TraceEntry & e = entries[i];
+		double ts = (double)(e.ticks - header.startTicks) * usPerTick;
+
+		printf("%s", separator);
+		switch(e.event) {
+			case Trace_SpanBegin:
+			case Trace_SpanEnd: {
+				bool begin = (e.event == Trace_SpanBegin);
+				if (e.code == Span_QueueWait) {
+					printf("{\"name\":\"%s\",\"cat\":\"queue\",\"ph\":\"%s\",\"id\":\"0x%I64x\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+							SpanName(e.code), begin?"b":"e", e.value, ts, pid, e.thread);
+				} else {
+					printf("{\"name\":\"%s\",\"cat\":\"span\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"arg\":%I64d}}",
+							SpanName(e.code), begin?"B":"E", ts, pid, e.thread, e.value);
+				}
+				break; }
+			case Trace_CommandSent: {
+				PendingCommand command;
+				command.time = ts;
+				command.verb = e.code;
+				pending[e.thread].push_back(command);
+				UnpackVerb(e.code, verb);
+				printf("{\"name\":\"-> %s\",\"cat\":\"command\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+						verb, ts, pid, e.thread);
+				break; }
+			case Trace_ReplyReceived: {
+				//Replies arrive in the order the commands were sent, also when pipelined
+				std::deque<PendingCommand> & commands = pending[e.thread];
+				if (commands.empty()) {
+					printf("{\"name\":\"%d\",\"cat\":\"command\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+							e.code, ts, pid, e.thread);
+					break;
+				}
+				PendingCommand command = commands.front();
+				commands.pop_front();
+				UnpackVerb(command.verb, verb);
+				printf("{\"name\":\"%s\",\"cat\":\"command\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"reply\":%d}}",
+						verb, command.time, ts - command.time, pid, e.thread, e.code);
+				break; }
+			case Trace_Notify: {
+				double dur = (double)e.value * usPerTick;
+				printf("{\"name\":\"notify\",\"cat\":\"queue\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"event\":%d}}",
+						ts - dur, dur, pid, e.thread, e.code);
+				break; }
+			case Trace_BytesReceived:
+			case Trace_BytesSent: {
+				printf("{\"name\":\"transfer\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"%s\":%I64d}}",
+						ts, pid, e.thread, EventName(e.event), e.value);
+				break; }
+			default: {
+				printf("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"code\":%d,\"value\":%I64d}}",
+						EventName(e.event), ts, pid, e.thread, e.code, e.value);
+				break; }
+		}
+	}
+
+	printf("\n]}\n");
+
+	return 0;
+}
+
+int main(int argc, char ** argv) {
+	bool csv = false;
+	bool chrome = false;
+	const char * path = NULL;
+
+	for(int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-csv"))
+			csv = true;
+		else if (!strcmp(argv[i], "-chrome"))
+			chrome = true;
+		else
+			path = argv[i];
+	}
+
+	if (path == NULL) {
+		fprintf(stderr, "Usage: TraceDump [-csv|-chrome] <tracefile>\n");
+		return 1;
+	}
+
+	FILE * file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return 1;
+	}
+
+	TraceHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic))) {
+		fprintf(stderr, "%s is not a trace file\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	if (header.version != TRACE_VERSION || header.entrySize != sizeof(TraceEntry) || header.headerSize != sizeof(TraceHeader)) {
+		fprintf(stderr, "Unsupported trace version %lu\n", header.version);
+		fclose(file);
+		return 1;
+	}
+
+	std::vector<TraceEntry> entries;
+	TraceEntry entry;
+	for(DWORD i = 0; i < header.capacity; i++) {
+		if (fread(&entry, sizeof(entry), 1, file) != 1)
+			break;
+		if (entry.sequence != 0)
+			entries.push_back(entry);
+	}
+	fclose(file);
+
+	//The file is a ring, restore the order in which the entries were written
+	std::sort(entries.begin(), entries.end(), CompareSequence);
+
+	if (chrome)
+		return DumpChrome(header, entries);
+
+	double msPerTick = 1000.0 / (double)header.frequency;
+
+	SYSTEMTIME startTime;
+	FileTimeToSystemTime(&header.startTime, &startTime);
+
+	if (csv) {
+		printf("sequence,time_ms,thread,event,code,value\n");
+	} else {
+		printf("Trace started %04d-%02d-%02d %02d:%02d:%02d.%03d UTC, %u of %lu events recorded, %u in file\n",
+				startTime.wYear, startTime.wMonth, startTime.wDay, startTime.wHour, startTime.wMinute, startTime.wSecond, startTime.wMilliseconds,
+				(unsigned int)header.writeIndex, header.capacity, (unsigned int)entries.size());
+	}
+
+	char verb[5];
+	for(size_t i = 0; i < entries.size(); i++) {
+		const TraceEntry & e = entries[i];
+		double time = (double)(e.ticks - header.startTicks) * msPerTick;
+
+		if (csv) {
+			printf("%lu,%.4f,%lu,%s,%d,%I64d\n", e.sequence, time, e.thread, EventName(e.event), e.code, e.value);
+			continue;
+		}
+
+		printf("%12.4f ms  [%5lu]  %-10s ", time, e.thread, EventName(e.event));
+		switch(e.event) {
+			case Trace_CommandSent:
+				UnpackVerb(e.code, verb);
+				printf("%s (%I64d bytes)\n", verb, e.value);
+				break;
+			case Trace_ReplyReceived:
+				printf("%d\n", e.code);
+				break;
+			case Trace_BytesReceived:
+			case Trace_BytesSent:
+				printf("%I64d bytes\n", e.value);
+				break;
+			case Trace_Notify:
+				printf("event %d, %.4f ms\n", e.code, (double)e.value * msPerTick);
+				break;
+			case Trace_SpanBegin:
+			case Trace_SpanEnd:
+				printf("%s %I64d\n", SpanName(e.code), e.value);
+				break;
+			default:
+				printf("%d %I64d\n", e.code, e.value);
+				break;
+		}
+	}
+
+	return 0;
+}